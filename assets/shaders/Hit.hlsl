@@ -15,6 +15,7 @@
 //    TriColor triC[3];
 //}
 
+// Instance colors, stored as root constants in the hit group record
 cbuffer Colors : register(b0)
 {
     float4 A;
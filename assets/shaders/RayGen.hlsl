@@ -34,7 +34,8 @@ void RayGen()
     ray.TMin = 0;
     ray.TMax = 1e9;
     
-    TraceRay(SceneBVH, RAY_FLAG_NONE, 0xFF, 0, 0, 0, ray, payload);
+    // Ray type 0, with one hit group record per ray type for each geometry of an instance
+    TraceRay(SceneBVH, RAY_FLAG_NONE, 0xFF, 0, 1, 0, ray, payload);
 
     gOutput[launchIndex] = float4(payload.colorAndDistance.rgb, 1.f);
 }
\ No newline at end of file
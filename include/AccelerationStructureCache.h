@@ -0,0 +1,141 @@
+/*
+The acceleration structure cache stores built bottom-level hierarchies on disk, so that subsequent
+runs can skip the builds entirely. DXR can serialize an acceleration structure into an opaque,
+position-independent blob using CopyRaytracingAccelerationStructure, and deserialize it later on
+any device whose driver reports a compatible matching identifier. The blobs are stored one per
+file, named after a content hash of the geometry (vertex and index data, formats, strides,
+counts) and of the build flags, so any change to the inputs naturally results in a cache miss.
+
+Each file starts with a small versioned header, followed by the serialized blob aligned on 256
+bytes. On load the file is memory-mapped and copied once into an upload buffer, from which the
+deserialization is enqueued on the command list like any other build.
+
+Bottom-level hierarchies built on a cache miss are registered with AddPendingStore. Once the
+command list containing the builds has been executed and waited upon, StorePending serializes all
+of them in a single batch and writes the files.
+
+Example:
+
+// The flags are the ones the generator builds with, once ComputeASBufferSizes has been called
+uint64_t key = nv_helpers_dx12::AccelerationStructureCache::ComputeKey(
+    vertices, vertexCount * sizeof(Vertex), sizeof(Vertex), DXGI_FORMAT_R32G32B32_FLOAT, nullptr,
+    0, DXGI_FORMAT_UNKNOWN, bottomLevelAS.GetBuildFlags());
+
+AccelerationStructureBuffers buffers;
+if (!m_asCache.Load(m_device.Get(), m_commandList.Get(), key, &buffers.pResult,
+                    &buffers.pScratch))
+{
+  // Regular build into buffers.pResult
+  ...
+  m_asCache.AddPendingStore(key, buffers.pResult.Get());
+}
+
+// After the command list has been executed and the fence has been reached
+m_asCache.StorePending(m_device.Get(), m_commandQueue.Get());
+
+*/
+
+#pragma once
+
+#include "d3d12.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace nv_helpers_dx12
+{
+
+/// Helper class storing serialized bottom-level acceleration structures on disk
+class AccelerationStructureCache
+{
+public:
+  /// Set the directory in which the serialized hierarchies are stored. The directory is created if
+  /// it does not exist. The cache is disabled as long as no directory is set
+  void SetDirectory(const std::wstring& directory);
+
+  /// Compute the cache key of a geometry, from its vertex and optional index data and formats, and
+  /// the flags used for the build. For bottom-level hierarchies made of several geometries, the key
+  /// of the previous geometry is passed as seed to chain them
+  static uint64_t ComputeKey(const void* vertexData,   /// CPU copy of the vertex data
+                             uint64_t vertexDataSize,  /// Size of the vertex data in bytes
+                             UINT vertexStride,        /// Size of a vertex in bytes
+                             DXGI_FORMAT vertexFormat, /// Format of the vertex positions
+                             const void* indexData,    /// CPU copy of the index data, or nullptr
+                             uint64_t indexDataSize,   /// Size of the index data in bytes
+                             DXGI_FORMAT indexFormat,  /// Format of the indices, or UNKNOWN
+                             D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAGS flags,
+                             uint64_t seed = 0         /// Key of the previous geometry, if any
+  );
+
+  /// Look up a hierarchy in the cache. If a compatible one is found, the result buffer is allocated
+  /// and its deserialization is enqueued on the command list. The staging buffer holding the
+  /// serialized data must be kept alive until the command list has been executed, similarly to a
+  /// scratch buffer. Returns false on a cache miss
+  bool Load(ID3D12Device5* device,                   /// Device used to allocate the buffers
+            ID3D12GraphicsCommandList4* commandList, /// Command list on which to deserialize
+            uint64_t key,                            /// Key of the hierarchy
+            ID3D12Resource** resultBuffer,           /// Deserialized acceleration structure
+            ID3D12Resource** stagingBuffer           /// Upload buffer holding the serialized data
+  );
+
+  /// Copy the serialized blob of a cached hierarchy, for instance to embed it into a scene package.
+  /// Returns false if the hierarchy is not in the cache
+  bool ReadSerialized(uint64_t key, std::vector<uint8_t>& blob) const;
+
+  /// Enqueue the deserialization of a hierarchy serialized by CopyRaytracingAccelerationStructure.
+  /// The result buffer is allocated, and the staging buffer holding a copy of the serialized data
+  /// must be kept alive until the command list has been executed. Returns false if the blob was
+  /// produced by a driver incompatible with the device
+  static bool Deserialize(ID3D12Device5* device,                   /// Device used for allocation
+                          ID3D12GraphicsCommandList4* commandList, /// Command list to deserialize on
+                          const void* serializedData, /// Blob, starting with the serialized header
+                          uint64_t blobSize,          /// Size of the blob in bytes
+                          ID3D12Resource** resultBuffer, /// Deserialized acceleration structure
+                          ID3D12Resource** stagingBuffer /// Upload buffer holding the blob copy
+  );
+
+  /// Register a hierarchy built after a cache miss, so that it gets stored by the next call to
+  /// StorePending
+  void AddPendingStore(uint64_t key, ID3D12Resource* resultBuffer);
+
+  /// Serialize all the pending hierarchies and write them to disk. The builds of those hierarchies
+  /// must have completed on the GPU. The serialization is executed on the given queue, and this
+  /// call blocks until the files are written
+  void StorePending(ID3D12Device5* device, ID3D12CommandQueue* queue);
+
+  /// Number of hierarchies successfully loaded from the cache
+  uint32_t GetHitCount() const { return m_hitCount; }
+  /// Number of lookups which did not find a compatible hierarchy
+  uint32_t GetMissCount() const { return m_missCount; }
+
+private:
+  /// Header at the beginning of each cache file
+  struct FileHeader
+  {
+    uint32_t magic;      /// Always kFileMagic
+    uint32_t version;    /// Always kFileVersion, bumped whenever the layout changes
+    uint64_t key;        /// Key of the stored hierarchy, checked against the file name
+    uint64_t blobOffset; /// Offset of the serialized blob from the start of the file
+    uint64_t blobSize;   /// Size of the serialized blob in bytes
+  };
+
+  static constexpr uint32_t kFileMagic = 0x53415844; // "DXAS"
+  static constexpr uint32_t kFileVersion = 1;
+
+  /// Hierarchy waiting to be serialized
+  struct PendingStore
+  {
+    uint64_t key;
+    ID3D12Resource* resultBuffer;
+  };
+
+  std::wstring GetFileName(uint64_t key) const;
+
+  std::wstring m_directory;
+  std::vector<PendingStore> m_pendingStores;
+
+  uint32_t m_hitCount = 0;
+  uint32_t m_missCount = 0;
+};
+} // namespace nv_helpers_dx12
@@ -0,0 +1,114 @@
+/*
+The async build queue submits the builds and refits of acceleration structures on a dedicated
+compute queue, so that they overlap with the rendering work of the direct queue instead of being
+serialized with it. The two queues are only synchronized on the GPU, using fences:
+- A frame tracing an acceleration structure makes the direct queue wait for the submission which
+  built it, with MakeQueueWait. The CPU does not block.
+- A build overwriting an acceleration structure which may still be traced by frames in flight
+  makes the compute queue wait for the fence of the last of those frames, with WaitOnGpu.
+
+A refit can then be recorded and submitted while the previous frame is being traced, as long as it
+writes into another version of the acceleration structure than the one the frames in flight use.
+
+The queue owns a small ring of command allocators, one per submission in flight, and a single
+command list reset on each Begin. Begin only blocks if the submission which last used the
+allocator has not completed yet.
+
+Example:
+
+nv_helpers_dx12::AsyncBuildQueue buildQueue;
+buildQueue.Initialize(m_device.Get());
+
+ID3D12GraphicsCommandList4* buildList = buildQueue.Begin();
+// Wait for the frames still tracing the buffers about to be overwritten
+buildQueue.WaitOnGpu(frameFence, lastFrameUsingTheBuffers);
+m_topLevelASGenerator.Generate(buildList, scratch, result, instanceDescs, true, previousResult);
+uint64_t buildFenceValue = buildQueue.Submit();
+
+// The next frames submitted on the direct queue wait for the refit on the GPU
+buildQueue.MakeQueueWait(m_commandQueue.Get(), buildFenceValue);
+
+// Before destroying the resources
+buildQueue.WaitForIdle();
+
+*/
+
+#pragma once
+
+#include "d3d12.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace nv_helpers_dx12
+{
+
+/// Compute queue on which acceleration structures are built asynchronously
+class AsyncBuildQueue
+{
+public:
+  AsyncBuildQueue() = default;
+  ~AsyncBuildQueue();
+
+  AsyncBuildQueue(const AsyncBuildQueue&) = delete;
+  AsyncBuildQueue& operator=(const AsyncBuildQueue&) = delete;
+
+  /// Create the compute queue, its fence, and the command allocators of the submissions in
+  /// flight. Throws std::logic_error if the objects cannot be created
+  void Initialize(ID3D12Device* device,       /// Device used to create the queue
+                  uint32_t allocatorCount = 2 /// Maximum number of submissions in flight
+  );
+
+  /// Start recording builds, and return the reset command list. Waits if the GPU has not
+  /// completed the submission which last used the next allocator
+  ID3D12GraphicsCommandList4* Begin();
+
+  /// Close the command list and submit it on the compute queue. Returns the fence value signaled
+  /// once the builds have completed
+  uint64_t Submit();
+
+  /// Make the next submission wait on the GPU until another queue has signaled a fence value
+  void WaitOnGpu(ID3D12Fence* fence, uint64_t fenceValue);
+
+  /// Make the commands submitted next on another queue wait on the GPU until the submission which
+  /// returned the fence value has completed
+  void MakeQueueWait(ID3D12CommandQueue* queue, uint64_t fenceValue) const;
+
+  /// Block until the GPU has completed all the submissions
+  void WaitForIdle();
+
+  /// Last fence value reached by the compute queue
+  uint64_t GetCompletedFenceValue() const { return m_fence->GetCompletedValue(); }
+  ID3D12CommandQueue* GetQueue() const { return m_queue; }
+  ID3D12Fence* GetFence() const { return m_fence; }
+  /// Number of times Begin had to wait for the GPU
+  uint32_t GetStallCount() const { return m_stallCount; }
+
+private:
+  /// Command allocator, and the fence value signaled by the last submission which used it
+  struct Submission
+  {
+    ID3D12CommandAllocator* allocator = nullptr;
+    uint64_t fenceValue = 0;
+  };
+
+  /// Block until the fence has reached the value
+  void WaitForFenceValue(uint64_t value);
+
+  void Release();
+
+  ID3D12CommandQueue* m_queue = nullptr;
+  ID3D12Fence* m_fence = nullptr;
+  HANDLE m_fenceEvent = nullptr;
+  ID3D12GraphicsCommandList4* m_commandList = nullptr;
+  std::vector<Submission> m_submissions;
+
+  /// Index of the allocator used by the current recording
+  uint32_t m_currentSubmission = 0;
+  /// True between Begin and Submit
+  bool m_recording = false;
+  /// Value signaled by the next submission
+  uint64_t m_nextFenceValue = 1;
+  uint32_t m_stallCount = 0;
+};
+} // namespace nv_helpers_dx12
@@ -43,6 +43,13 @@ finally compute the acceleration structure and store it in the result buffer.
 Note that the build is enqueued in the command list, meaning that the scratch
 buffer needs to be kept until the command list execution is finished.
 
+When a ResourceStateTracker is given to Generate, the UAV barrier on the result
+is deferred, so that several builds recorded in a row execute concurrently on
+the GPU. Nothing then separates their accesses to the scratch space: each of
+these builds needs its own scratch buffer, or its own non-overlapping range of
+a larger one. Reusing a scratch buffer between two deferred builds requires
+flushing the tracker in between, or calling Generate without a tracker.
+
 
 Example:
 
@@ -74,6 +81,8 @@ return buffers;
 namespace nv_helpers_dx12
 {
 
+class ResourceStateTracker;
+
 /// Helper class to generate bottom-level acceleration structures for raytracing
 class BottomLevelASGenerator
 {
@@ -140,6 +149,10 @@ public:
                                   /// acceleration structure
   );
 
+  /// Flags used to build the acceleration structure, as set by ComputeASBufferSizes. These are
+  /// for instance part of the key of the AccelerationStructureCache
+  D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAGS GetBuildFlags() const { return m_flags; }
+
   /// Enqueue the construction of the acceleration structure on a command list, using
   /// application-provided buffers and possibly a pointer to the previous acceleration structure in
   /// case of iterative updates. Note that the update can be done in place: the result and
@@ -150,8 +163,13 @@ public:
                                      /// store temporary data
       ID3D12Resource* resultBuffer,  /// Result buffer storing the acceleration structure
       bool updateOnly = false,       /// If true, simply refit the existing acceleration structure
-      ID3D12Resource* previousResult = nullptr /// Optional previous acceleration structure, used
-                                               /// if an iterative update is requested
+      ID3D12Resource* previousResult = nullptr, /// Optional previous acceleration structure, used
+                                                /// if an iterative update is requested
+      ResourceStateTracker* stateTracker = nullptr /// Optional tracker in which to queue the
+                                                   /// UAV barrier on the result, instead of
+                                                   /// recording it right away. The scratch
+                                                   /// buffer must then not be used by another
+                                                   /// build until the tracker is flushed
   );
 
 private:
@@ -166,6 +184,7 @@ private:
 
   /// Flags for the builder, specifying whether to allow iterative updates, or
   /// when to perform an update
-  D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAGS m_flags;
+  D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAGS m_flags =
+      D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_NONE;
 };
 } // namespace nv_helpers_dx12
@@ -0,0 +1,150 @@
+/*
+The chunked builder creates the bottom-level hierarchies of meshes which are too large to be
+uploaded at once. The geometry is pulled from a GeometryChunkSource in blocks of bounded size,
+each block is written directly into a mapped upload buffer and built into its own bottom-level
+AS. The bottom-level hierarchy only references the geometry during the build, so the upload
+buffers are recycled as soon as the build of their chunk has completed on the GPU. Two sets of
+upload and scratch buffers are used in turn, so that the next chunk is produced on the CPU while
+the previous one is being built.
+
+The resulting hierarchies are then merged at the top: each of them is added to the top-level AS
+as an instance with the same transform and hit group, which is equivalent to a single instance of
+the whole mesh. Peak memory usage for the inputs is bounded by the chunk size, regardless of the
+mesh size.
+
+Two sources are provided: IndexedMeshChunkSource slices an existing indexed mesh, and
+MengerSpongeChunkSource (DXRHelper.h) generates the procedural sponge on demand.
+
+Example:
+
+nv_helpers_dx12::IndexedMeshChunkSource source(vertices, sizeof(Vertex), vertexCount, indices,
+                                               indexCount);
+nv_helpers_dx12::ChunkedBottomLevelASBuilder builder(m_device.Get(), m_commandQueue.Get(),
+                                                     sizeof(Vertex), 1 << 20, 1 << 20);
+// The hierarchies are released along with the vector, which is kept as long as the top-level AS
+std::vector<ComPtr<ID3D12Resource>> chunks = builder.Build(source);
+for (const ComPtr<ID3D12Resource>& blas : chunks)
+{
+  m_topLevelASGenerator.AddInstance(blas.Get(), transform, instanceId, hitGroupIndex);
+}
+
+*/
+
+#pragma once
+
+#include "d3d12.h"
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include <wrl/client.h>
+
+namespace nv_helpers_dx12
+{
+
+/// Interface of a geometry producer pulled by the chunked builder. The vertices are in an
+/// arbitrary layout, as long as each of them starts with its position as 3 float32 values
+class GeometryChunkSource
+{
+public:
+  virtual ~GeometryChunkSource() = default;
+
+  /// Write the next chunk of triangles into the vertex and index arrays, which can hold up to
+  /// maxVertices vertices and maxIndices 32-bit indices. The indices are relative to the first
+  /// vertex of the chunk. Returns false once the source is exhausted, in which case nothing has
+  /// been written
+  virtual bool NextChunk(uint32_t maxVertices, /// Capacity of the vertex array
+                         uint32_t maxIndices,  /// Capacity of the index array, multiple of 3
+                         void* vertices,       /// Destination of the vertex data
+                         UINT* indices,        /// Destination of the triangle indices
+                         uint32_t* vertexCount, /// Number of vertices written
+                         uint32_t* indexCount   /// Number of indices written
+                         ) = 0;
+};
+
+/// Chunk source reading an indexed triangle mesh, which can for instance be memory-mapped so that
+/// only the pages of the current chunk are resident. Each chunk contains a contiguous range of
+/// triangles, and the vertices they reference are remapped into a compact local array
+class IndexedMeshChunkSource : public GeometryChunkSource
+{
+public:
+  /// The index array can be nullptr for non-indexed meshes, in which case each triplet of vertices
+  /// forms a triangle
+  IndexedMeshChunkSource(const void* vertices, UINT vertexStride, uint32_t vertexCount,
+                         const UINT* indices, uint32_t indexCount);
+
+  bool NextChunk(uint32_t maxVertices, uint32_t maxIndices, void* vertices, UINT* indices,
+                 uint32_t* vertexCount, uint32_t* indexCount) override;
+
+private:
+  const uint8_t* m_vertices;
+  UINT m_vertexStride;
+  uint32_t m_vertexCount;
+  const UINT* m_indices;
+  uint32_t m_indexCount;
+
+  /// Index of the first triangle index of the next chunk
+  uint32_t m_cursor = 0;
+  /// Mapping from the mesh vertex indices to the chunk vertex indices, reused between chunks
+  std::unordered_map<UINT, UINT> m_remap;
+};
+
+/// Helper class building one bottom-level AS per chunk of a geometry source
+class ChunkedBottomLevelASBuilder
+{
+public:
+  /// The upload buffers are allocated once, with the given capacity, and reused for all chunks
+  ChunkedBottomLevelASBuilder(ID3D12Device5* device,      /// Device used for the builds
+                              ID3D12CommandQueue* queue,  /// Direct or compute queue
+                              UINT vertexStride,          /// Size of a vertex in bytes
+                              uint32_t maxVerticesPerChunk, /// Vertex capacity of a chunk
+                              uint32_t maxTrianglesPerChunk /// Triangle capacity of a chunk
+  );
+  ~ChunkedBottomLevelASBuilder();
+
+  ChunkedBottomLevelASBuilder(const ChunkedBottomLevelASBuilder&) = delete;
+  ChunkedBottomLevelASBuilder& operator=(const ChunkedBottomLevelASBuilder&) = delete;
+
+  /// Pull all the chunks of the source and build their bottom-level hierarchies. The call returns
+  /// once all the builds have completed on the GPU, including when it throws, in which case the
+  /// hierarchies built so far are released
+  std::vector<Microsoft::WRL::ComPtr<ID3D12Resource>> Build(GeometryChunkSource& source,
+                                                            bool allowUpdate = false);
+
+private:
+  /// Upload and scratch buffers used for a chunk, along with the command list building it
+  struct Slot
+  {
+    Microsoft::WRL::ComPtr<ID3D12Resource> vertexBuffer;
+    Microsoft::WRL::ComPtr<ID3D12Resource> indexBuffer;
+    Microsoft::WRL::ComPtr<ID3D12Resource> scratchBuffer;
+    UINT64 scratchSizeInBytes = 0;
+    uint8_t* mappedVertices = nullptr;
+    UINT* mappedIndices = nullptr;
+    Microsoft::WRL::ComPtr<ID3D12CommandAllocator> allocator;
+    Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList4> commandList;
+    /// Fence value signaled once the build of the last chunk using this slot has completed
+    UINT64 fenceValue = 0;
+  };
+
+  /// Build the chunks of the source, adding each hierarchy to the results once created
+  void BuildChunks(GeometryChunkSource& source, bool allowUpdate,
+                   std::vector<Microsoft::WRL::ComPtr<ID3D12Resource>>& results);
+
+  /// Block until the GPU has reached the fence value
+  void WaitForFence(UINT64 value);
+
+  static const uint32_t kSlotCount = 2;
+
+  ID3D12Device5* m_device;
+  ID3D12CommandQueue* m_queue;
+  UINT m_vertexStride;
+  uint32_t m_maxVertices;
+  uint32_t m_maxIndices;
+
+  Slot m_slots[kSlotCount];
+  Microsoft::WRL::ComPtr<ID3D12Fence> m_fence;
+  HANDLE m_fenceEvent = nullptr;
+  UINT64 m_lastFenceValue = 0;
+};
+} // namespace nv_helpers_dx12
@@ -0,0 +1,99 @@
+/*
+The command list pool is the D3D12 backend of the ParallelCommandRecorder. Each command list it
+hands out comes with its own command allocator, as an allocator can only be used by one thread at
+a time, and the pair is only reused once the GPU has completed the frame which executed it. The
+pool grows to the number of command lists recorded per frame times the number of frames in flight,
+after which no object is created anymore.
+
+The submitted command lists are tagged with the fence value of their frame by FinishFrame, and
+Reclaim returns to the pool the ones whose frame has completed, like the UploadRingAllocator.
+
+Example:
+
+nv_helpers_dx12::CommandListPool commandListPool;
+commandListPool.Initialize(m_device.Get(), m_commandQueue.Get());
+
+// Each frame, once the frame context has been acquired
+commandListPool.Reclaim(frameRing.GetCompletedFenceValue());
+recorder.Execute(commandListPool);
+...
+commandListPool.FinishFrame(frameRing.GetFrameFenceValue());
+frameRing.EndFrame();
+
+*/
+
+#pragma once
+
+#include "d3d12.h"
+#include "ParallelCommandRecorder.h"
+
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace nv_helpers_dx12
+{
+
+/// Pool of command lists and their allocators, submitted to a queue
+class CommandListPool : public CommandListBackend<ID3D12GraphicsCommandList4>
+{
+public:
+  CommandListPool() = default;
+  ~CommandListPool() override;
+
+  CommandListPool(const CommandListPool&) = delete;
+  CommandListPool& operator=(const CommandListPool&) = delete;
+
+  /// Set the device creating the command lists and the queue executing them
+  void Initialize(ID3D12Device* device, ID3D12CommandQueue* queue,
+                  D3D12_COMMAND_LIST_TYPE type = D3D12_COMMAND_LIST_TYPE_DIRECT);
+
+  /// Get a reset command list and its allocator from the pool, creating them if none is
+  /// available. Thread-safe. Throws std::logic_error if the objects cannot be created
+  ID3D12GraphicsCommandList4* BeginCommandList() override;
+  /// Close a recorded command list. Thread-safe
+  void EndCommandList(ID3D12GraphicsCommandList4* commandList) override;
+  /// Execute recorded command lists on the queue, in order
+  void Submit(ID3D12GraphicsCommandList4* const* commandLists, uint32_t count) override;
+  /// Return a command list which will not be submitted to the available ones. Thread-safe
+  void AbortCommandList(ID3D12GraphicsCommandList4* commandList) override;
+
+  /// Tag the command lists submitted since the last call with the fence value signaled once the
+  /// frame has completed
+  void FinishFrame(uint64_t fenceValue);
+  /// Return to the pool the command lists whose fence value is lower or equal to the completed
+  /// value
+  void Reclaim(uint64_t completedFenceValue);
+
+  /// Number of command lists created, available or not
+  uint32_t GetCommandListCount() const;
+
+private:
+  /// Command list and the allocator it records into
+  struct Entry
+  {
+    ID3D12GraphicsCommandList4* commandList = nullptr;
+    ID3D12CommandAllocator* allocator = nullptr;
+    uint64_t fenceValue = 0;
+  };
+
+  void Release();
+
+  ID3D12Device* m_device = nullptr;
+  ID3D12CommandQueue* m_queue = nullptr;
+  D3D12_COMMAND_LIST_TYPE m_type = D3D12_COMMAND_LIST_TYPE_DIRECT;
+
+  /// Guards the entries, which move between the states below
+  mutable std::mutex m_mutex;
+  /// Entries ready to be recorded
+  std::vector<Entry> m_available;
+  /// Entries being recorded or recorded, by command list
+  std::unordered_map<ID3D12GraphicsCommandList4*, Entry> m_recording;
+  /// Entries submitted in the current frame, not tagged with a fence value yet
+  std::vector<Entry> m_submitted;
+  /// Entries of the frames in flight, in increasing order of fence values
+  std::deque<Entry> m_inFlight;
+};
+} // namespace nv_helpers_dx12
@@ -0,0 +1,67 @@
+/*
+Small helpers to compute 64-bit content hashes, used as keys by the on-disk caches. The hash is the
+64-bit FNV-1a, which is stable across runs, compilers and platforms so that keys written to disk
+by one build can be looked up by another. It is not a cryptographic hash: it is only used to
+detect whether an input changed.
+
+Example:
+
+uint64_t key = nv_helpers_dx12::kContentHashSeed;
+key = nv_helpers_dx12::HashBytes(vertices.data(), vertices.size() * sizeof(Vertex), key);
+key = nv_helpers_dx12::HashValue(buildFlags, key);
+
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace nv_helpers_dx12
+{
+
+/// Initial value of a content hash, the FNV-1a 64-bit offset basis
+static const uint64_t kContentHashSeed = 14695981039346656037ull;
+
+/// Accumulate size bytes starting at data into the hash value
+inline uint64_t HashBytes(const void* data, size_t size, uint64_t hash = kContentHashSeed)
+{
+  const uint8_t* bytes = static_cast<const uint8_t*>(data);
+  for (size_t i = 0; i < size; i++)
+  {
+    hash ^= bytes[i];
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
+
+/// Accumulate a trivially copyable value into the hash value
+template <class T>
+inline uint64_t HashValue(const T& value, uint64_t hash = kContentHashSeed)
+{
+  return HashBytes(&value, sizeof(T), hash);
+}
+
+/// Accumulate the characters of a string into the hash value. The length is hashed as well, so
+/// that consecutive strings cannot collide by moving characters from one to the other
+inline uint64_t HashString(const std::wstring& str, uint64_t hash = kContentHashSeed)
+{
+  hash = HashValue(static_cast<uint64_t>(str.size()), hash);
+  return HashBytes(str.data(), str.size() * sizeof(wchar_t), hash);
+}
+
+/// Format a hash as a fixed-width hexadecimal string, used to build cache file names
+inline std::wstring HashToString(uint64_t hash)
+{
+  static const wchar_t kDigits[] = L"0123456789abcdef";
+  std::wstring result(16, L'0');
+  for (int i = 15; i >= 0; i--)
+  {
+    result[i] = kDigits[hash & 0xF];
+    hash >>= 4;
+  }
+  return result;
+}
+
+} // namespace nv_helpers_dx12
@@ -14,12 +14,25 @@
 
 #pragma once
 
+#include <deque>
+#include <future>
 #include <vector>
 #include <dxcapi.h>
 
+#include "DXPipelineHelper.h"
 #include "DXPipeline.h"
 #include "TopLevelASGenerator.h"
+#include "AccelerationStructureCache.h"
+#include "AsyncBuildQueue.h"
+#include "CommandListPool.h"
 #include "ShaderBindingTableGenerator.h"
+#include "DirectoryWatcher.h"
+#include "DescriptorAllocator.h"
+#include "FrameContextRing.h"
+#include "ParallelCommandRecorder.h"
+#include "PlacedResourceAllocator.h"
+#include "ResourceStateTracker.h"
+#include "UploadRingAllocator.h"
 #include "glm.hpp"
 
 using namespace DirectX;
@@ -43,9 +56,28 @@ public:
 	virtual void OnUpdate();
 	virtual void OnRender();
 	virtual void OnDestroy();
+	virtual void SetCameraPose(const CameraPose &pose);
+	virtual bool PopCapturedFrame(nv_helpers_dx12::FrameImage &frame, bool wait);
 
 private:
 	static const uint32_t frameCount = 2;
+	// Size of the ring holding the per-frame constants of the frames in flight
+	static const uint64_t uploadRingSize = 64 * 1024;
+	// Sizes of the regions of the shader-visible descriptor heap, the transient
+	// one being per frame in flight
+	static const uint32_t persistentDescriptorCount = 1024;
+	static const uint32_t transientDescriptorCount = 64;
+	// Number of versions of the TLAS, a refit building into one version while
+	// the frames in flight trace another
+	static const uint32_t tlasVersionCount = 2;
+	// Rotation speed of the animated instances, in radians per second
+	static constexpr float animationSpeed = 1.2f;
+	// Number of hit group records per geometry, matching the TraceRay multiplier in RayGen.hlsl
+	static const uint32_t rayTypeCount = 1;
+
+	static constexpr LPCWSTR rayGenShaderFile = L"assets/shaders/RayGen.hlsl";
+	static constexpr LPCWSTR missShaderFile = L"assets/shaders/Miss.hlsl";
+	static constexpr LPCWSTR hitShaderFile = L"assets/shaders/Hit.hlsl";
 
 	struct Vertex
 	{
@@ -53,18 +85,24 @@ private:
 		XMFLOAT4 color;
 	};
 
+	// Matches the Colors constant buffer of the hit shader
+	struct InstanceColors
+	{
+		XMFLOAT4 colors[4];
+	};
+
 	// Pipeline objects
 	CD3DX12_VIEWPORT m_viewport;
 	CD3DX12_RECT m_scissorRect;
 	ComPtr<IDXGISwapChain3> m_swapchain;
 	ComPtr<ID3D12Device5> m_device;
+	// Declared before the buffers placed in its heaps, so that it is destroyed after them
+	nv_helpers_dx12::PlacedResourceAllocator m_resourceAllocator;
 	ComPtr<ID3D12Resource> m_renderTargets[frameCount];
-	ComPtr<ID3D12CommandAllocator> m_commandAllocator;
 	ComPtr<ID3D12CommandQueue> m_commandQueue;
 	ComPtr<ID3D12RootSignature> m_rootSignature;
 	ComPtr<ID3D12DescriptorHeap> m_rtvHeap;
 	ComPtr<ID3D12PipelineState> m_pipelineState;
-	ComPtr<ID3D12GraphicsCommandList4> m_commandList;
 	uint32_t m_rtvDescriptorSize;
 
 	// App resources
@@ -73,15 +111,38 @@ private:
 	ComPtr<ID3D12Resource> m_planeBuffer;
 	D3D12_VERTEX_BUFFER_VIEW m_planeBufferView;
 	ComPtr<ID3D12Resource> m_globalConstBuffer;
-	std::vector<ComPtr<ID3D12Resource>> m_perInstanceConstBuffers;
+	std::vector<InstanceColors> m_instanceColors;
 
-	// Synchronization objects
+	// Synchronization objects. m_frameIndex is the index of the back buffer,
+	// the per-frame CPU-written resources are indexed by the slot of the ring
 	uint32_t m_frameIndex;
-	HANDLE m_fenceEvent;
-	ComPtr<ID3D12Fence> m_fence;
-	uint64_t m_fenceValue;
+	nv_helpers_dx12::FrameContextRing m_frameRing;
+	nv_helpers_dx12::UploadRingAllocator m_uploadRing;
+	// The passes of a frame are recorded in parallel, into command lists of the pool
+	nv_helpers_dx12::CommandListPool m_commandListPool;
+	nv_helpers_dx12::ParallelCommandRecorder<ID3D12GraphicsCommandList4> m_frameRecorder;
+	// Current state of the render targets and the RT output, to batch the barriers
+	nv_helpers_dx12::ResourceStateTracker m_stateTracker;
+	// Barriers of the acceleration structure builds. The build queue executes
+	// its lists out of order with the frames, which must not flush its barriers
+	nv_helpers_dx12::ResourceStateTracker m_buildStateTracker;
 	bool m_raster = true;
 
+	// Offline rendering. The render targets are textures instead of swapchain
+	// buffers, and each frame is copied to the readback buffer of its slot of
+	// the ring until the GPU has completed it
+	struct PendingCapture
+	{
+		uint32_t slot;
+		uint64_t fenceValue;
+		uint64_t frameNumber;
+	};
+	ComPtr<ID3D12Resource> m_readbackBuffers[frameCount];
+	D3D12_PLACED_SUBRESOURCE_FOOTPRINT m_readbackFootprint = {};
+	std::deque<PendingCapture> m_pendingCaptures;
+	std::deque<nv_helpers_dx12::FrameImage> m_capturedFrames;
+	uint64_t m_capturedFrameCount = 0;
+
 	// Input
 	float m_mousePosX, m_mousePosY;
 
@@ -89,15 +150,24 @@ private:
 	float m_cameraYaw, m_cameraPitch;
 	glm::vec3 m_cameraEye;
 	glm::vec3 m_cameraDir;
-	ComPtr<ID3D12Resource> m_cameraBuffer;
-	ComPtr<ID3D12DescriptorHeap> m_constHeap;
-	uint32_t m_cameraBufferSize = 0;
+	// Camera constants of the current frame, in the upload ring
+	D3D12_GPU_VIRTUAL_ADDRESS m_cameraAddress = 0;
 
 	// DXR AS
 	ComPtr<ID3D12Resource> m_bottomLevelAS;
 	nv_helpers_dx12::TopLevelASGenerator m_topLevelASGenerator;
-	AccelerationStructureBuffers m_topLevelASBuffers;
+	AccelerationStructureBuffers m_topLevelASBuffers[tlasVersionCount];
+	// Version of the TLAS traced by the next frame, and the fence value of the
+	// last frame which used each version
+	uint32_t m_tlasVersion = 0;
+	uint64_t m_tlasVersionFenceValues[tlasVersionCount] = {};
+	// Builds and refits are submitted on a compute queue, overlapping the frames
+	nv_helpers_dx12::AsyncBuildQueue m_buildQueue;
+	bool m_animateInstances = false;
+	float m_animationAngle = 0.f;
 	std::vector<std::pair<ComPtr<ID3D12Resource>, DirectX::XMMATRIX>> m_instances;
+	// Serialized bottom-level AS from previous runs, to skip the builds on startup
+	nv_helpers_dx12::AccelerationStructureCache m_asCache;
 
 	// DXR
 	ComPtr<IDxcBlob> m_rayGenLibrary;
@@ -109,43 +179,112 @@ private:
 	ComPtr<ID3D12RootSignature> m_hitSignature;
 
 	ComPtr<ID3D12Resource> m_outputResource;
-	ComPtr<ID3D12DescriptorHeap> m_srvUavHeap;
+	nv_helpers_dx12::DescriptorAllocator m_descriptorAllocator;
+	// Index of the ray generation tables, one per TLAS version, each made of
+	// the output UAV followed by the TLAS SRV
+	uint32_t m_rayGenDescriptors = 0;
 
 	nv_helpers_dx12::ShaderBindingTableGenerator m_sbtHelper;
-	ComPtr<ID3D12Resource> m_sbtStorage;
+	ComPtr<ID3D12Resource> m_sbtStorage[frameCount];
+	// Hit group records, indexed like m_instances, to update the root arguments of an instance
+	std::vector<nv_helpers_dx12::ShaderBindingTableGenerator::RecordHandle> m_hitGroupRecords;
+	// Offset of the hit group records of each instance in the SBT, indexed like m_instances
+	std::vector<uint32_t> m_instanceContributions;
+	nv_helpers_dx12::ShaderBindingTableGenerator::RecordHandle m_rayGenRecord = {};
 
 	// RT pipeline state
 	ComPtr<ID3D12StateObject> m_rtStateObject;
+	// One collection per material hit group, compiled once and linked into the pipeline
+	std::vector<ComPtr<ID3D12StateObject>> m_hitGroupCollections;
 	// Ray tracing pipeline state properties, retaining the shader identifiers
 	// to use in the Shader Binding Table
 	ComPtr<ID3D12StateObjectProperties> m_rtStateObjectProps;
 
+	// Shader hot reload. The pipeline is rebuilt on a background thread when a
+	// shader is modified, and swapped at the beginning of the next frame
+	struct PipelineReload
+	{
+		ComPtr<IDxcBlob> rayGenLibrary;
+		ComPtr<IDxcBlob> missLibrary;
+		ComPtr<IDxcBlob> hitLibrary;
+		std::vector<ComPtr<ID3D12StateObject>> hitGroupCollections;
+		ComPtr<ID3D12StateObject> stateObject;
+	};
+	// Library being compiled in the background. Its reference is released even
+	// if it is never taken, e.g. when preparing the rest of the pipeline throws
+	class PendingLibrary
+	{
+	public:
+		PendingLibrary() = default;
+		explicit PendingLibrary(std::future<IDxcBlob*>&& library) : m_library(std::move(library)) {}
+		PendingLibrary(const PendingLibrary&) = delete;
+		PendingLibrary& operator=(const PendingLibrary&) = delete;
+		~PendingLibrary()
+		{
+			// The compilation cannot be cancelled: wait for it and drop its result
+			if (!m_library.valid())
+				return;
+			try
+			{
+				IDxcBlob* library = m_library.get();
+				if (library)
+					library->Release();
+			}
+			catch (const std::exception&)
+			{
+			}
+		}
+		// Wait for the library, and rethrow its compilation error if any
+		ComPtr<IDxcBlob> Take()
+		{
+			ComPtr<IDxcBlob> library;
+			library.Attach(m_library.get());
+			return library;
+		}
+
+	private:
+		std::future<IDxcBlob*> m_library;
+	};
+	nv_helpers_dx12::DirectoryWatcher m_shaderWatcher;
+	std::future<PipelineReload> m_pipelineReload;
+
 	void InitPipelineObjects();
+	void GetHardwareAdapter(_In_ IDXGIFactory2 *pFactory, _Outptr_result_maybenull_ IDXGIAdapter1 **ppAdapter);
 	void LoadAssets();
 	void PopulateCommandList();
-	void WaitForPreviousFrame();
+	void WaitForGpu();
+	void ReadCompletedCaptures();
 	void CheckRaytracingSupport();
-	void CreateCameraBuffer();
 	void UpdateCameraBuffer();
 	void CreatePlaneBV();
 	void CreateGlobalConstantBuffer();
-	void CreatePerInstanceConstantBuffers();
+	void InitInstanceColors();
 	void InitCamera();
 	virtual void OnKeyUp(uint8_t key);
 	virtual void OnKeyDown(uint8_t key);
-	virtual void OnMouseMove(uint8_t wParam, uint32_t lParam);
+	virtual void OnMouseMove(int32_t x, int32_t y, uint32_t buttons);
 
 	// DXR AS
-	AccelerationStructureBuffers CreateBottomLevelAS(std::vector<std::pair<ComPtr<ID3D12Resource>, uint32_t>> vVertexBuffers);
-	void CreateTopLevelAS(const std::vector<std::pair<ComPtr<ID3D12Resource>, DirectX::XMMATRIX>> &instances);
+	AccelerationStructureBuffers CreateBottomLevelAS(ID3D12GraphicsCommandList4 *commandList, std::vector<std::pair<ComPtr<ID3D12Resource>, uint32_t>> vVertexBuffers);
+	void CreateTopLevelAS(ID3D12GraphicsCommandList4 *commandList, const std::vector<std::pair<ComPtr<ID3D12Resource>, DirectX::XMMATRIX>> &instances,
+						  const std::vector<uint32_t> &instanceContributions);
 	void CreateAccelerationStructures();
+	void UpdateTopLevelAS();
 
 	// DXR
 	ComPtr<ID3D12RootSignature> CreateGenSignature();
 	ComPtr<ID3D12RootSignature> CreateMissSignature();
 	ComPtr<ID3D12RootSignature> CreateHitSignature();
+	ComPtr<ID3D12StateObject> CreateHitGroupCollection(IDxcBlob* hitLibrary, const std::wstring& hitGroup, const std::wstring& closestHit);
+	std::vector<ComPtr<ID3D12StateObject>> CreateHitGroupCollections(IDxcBlob* hitLibrary);
+	ComPtr<ID3D12StateObject> LinkRaytracingPipeline(IDxcBlob* rayGenLibrary, IDxcBlob* missLibrary,
+		const std::vector<ComPtr<ID3D12StateObject>>& hitGroupCollections);
 	void CreateRaytracingPipeline();
+	void StartShaderReload(const std::vector<std::wstring>& modifiedFiles);
+	void UpdateShaderReload();
 	void CreateRaytracingOutputBuffer();
 	void CreateShaderResourceHeap();
+	nv_helpers_dx12::ShaderRecordArguments GetRayGenArguments() const;
+	void ReserveHitGroupRecords();
 	void CreateShaderBindingTable();
 };
\ No newline at end of file
@@ -13,8 +13,32 @@
 //*********************************************************
 
 #pragma once
-#include "DXPipelineHelper.h"
-#include "Win32Application.h"
+#include <cstdint>
+#include <string>
+
+#include "FrameWriter.h"
+#include "Platform.h"
+
+// Settings of the offline rendering, which renders frames to disk without a window
+struct HeadlessSettings
+{
+	bool enabled = false;
+	// Number of frames to render. 0 renders one frame per camera keyframe, or a
+	// single frame without a camera path
+	uint32_t frameCount = 0;
+	// Camera keyframes, one "eyeX eyeY eyeZ dirX dirY dirZ" line per keyframe
+	std::wstring cameraPathFile;
+	std::wstring outputDirectory = L"frames";
+	// Frames per second of the offline clock, which drives the animations
+	float frameRate = 60.f;
+};
+
+// Placement of the camera for a frame of a camera path
+struct CameraPose
+{
+	float eye[3];
+	float direction[3];
+};
 
 class DXPipeline
 {
@@ -28,18 +52,35 @@ public:
 	virtual void OnDestroy() = 0;
 	virtual void OnKeyDown(uint8_t key);
 	virtual void OnKeyUp(uint8_t key);
-	virtual void OnMouseMove(uint8_t wParam, uint32_t lParam);
+	// Mouse position in pixels from the top-left corner of the viewport, and
+	// the MouseButton flags of the buttons held
+	virtual void OnMouseMove(int32_t x, int32_t y, uint32_t buttons);
+
+	// Services of the operating system, set by the application before OnInit
+	void SetPlatform(Platform *platform);
+	Platform *GetPlatform() const { return m_platform; }
+	// Advance the frame clock, then update and render a frame
+	void RenderFrame();
+
+	// Offline rendering. The camera is placed before each frame, and the frames
+	// are read back in order once the GPU has rendered them. PopCapturedFrame
+	// returns false if no frame is ready, or if no frame is left when waiting
+	virtual void SetCameraPose(const CameraPose &pose);
+	virtual bool PopCapturedFrame(nv_helpers_dx12::FrameImage &frame, bool wait);
+	const HeadlessSettings &GetHeadlessSettings() const { return m_headless; }
+	bool IsHeadless() const { return m_headless.enabled; }
 
 	uint32_t GetViewportWidth() const { return m_width; }
 	uint32_t GetViewportHeight() const { return m_height; }
-	const WCHAR *GetTitle() const { return m_title.c_str(); }
+	const wchar_t *GetTitle() const { return m_title.c_str(); }
 
-	void ParseCommandLineArgs(_In_reads_(argc) WCHAR *argv[], int argc);
+	void ParseCommandLineArgs(const wchar_t *const argv[], int argc);
 
 protected:
-	std::wstring GetAssetFullPath(LPCWSTR assetName);
-	void GetHardwareAdapter(_In_ IDXGIFactory2 *pFactory, _Outptr_result_maybenull_ IDXGIAdapter1 **ppAdapter);
-	void SetCustomWindowText(LPCWSTR text);
+	std::wstring GetAssetFullPath(const std::wstring &assetName);
+	void SetCustomWindowText(const std::wstring &text);
+	// Duration of the previous frame in seconds, 0 for the first frame
+	float GetFrameTime() const { return m_frameTime; }
 
 	float m_aspectRatio;
 
@@ -52,4 +93,9 @@ protected:
 private:
 	std::wstring m_title;
 	std::wstring m_assetsPath;
+	HeadlessSettings m_headless;
+	Platform *m_platform = nullptr;
+	bool m_frameClockStarted = false;
+	double m_lastFrameStart = 0.0;
+	float m_frameTime = 0.f;
 };
\ No newline at end of file
@@ -13,7 +13,6 @@
 //*********************************************************
 
 #pragma once
-#include "Win32Application.h"
 #include <d3d12.h>
 #include <wrl/client.h>
 
@@ -24,25 +23,3 @@ inline void ThrowIfFailed(HRESULT hr)
 		throw std::exception();
 	}
 }
-
-
-inline void GetAssetsPath(_Out_writes_(pathSize) WCHAR* path, UINT pathSize)
-{
-	if (path == nullptr)
-	{
-		throw std::exception();
-	}
-
-	DWORD size = GetModuleFileName(nullptr, path, pathSize);
-	if (size == 0 || size == pathSize)
-	{
-		// Method failed or path was truncated.
-		throw std::exception();
-	}
-
-	WCHAR* lastSlash = wcsrchr(path, L'\\');
-	if (lastSlash)
-	{
-		*(lastSlash + 1) = L'\0';
-	}
-}
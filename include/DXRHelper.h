@@ -9,8 +9,18 @@
 #include <string>
 #include <d3d12.h>
 #include "DXPipelineHelper.h"
+#include "ShaderCache.h"
+#include "ChunkedBottomLevelASBuilder.h"
 #include <dxcapi.h>
 
+#include <array>
+#include <cmath>
+#include <deque>
+#include <future>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <unordered_map>
 #include <vector>
 
 namespace nv_helpers_dx12
@@ -57,70 +67,13 @@ static const D3D12_HEAP_PROPERTIES kDefaultHeapProps = {
     D3D12_HEAP_TYPE_DEFAULT, D3D12_CPU_PAGE_PROPERTY_UNKNOWN, D3D12_MEMORY_POOL_UNKNOWN, 0, 0};
 
 //--------------------------------------------------------------------------------------------------
-// Compile a HLSL file into a DXIL library
+// Compile a HLSL file into a DXIL library. The library is loaded from the shader cache if it has
+// already been compiled with the same source and includes. Throws std::logic_error containing the
+// compiler output if the compilation fails
 //
 IDxcBlob* CompileShaderLibrary(LPCWSTR fileName)
 {
-  static IDxcCompiler* pCompiler = nullptr;
-  static IDxcLibrary* pLibrary = nullptr;
-  static IDxcIncludeHandler* dxcIncludeHandler;
-
-  HRESULT hr;
-
-  // Initialize the DXC compiler and compiler helper
-  if (!pCompiler)
-  {
-    ThrowIfFailed(DxcCreateInstance(CLSID_DxcCompiler, __uuidof(IDxcCompiler), (void **)&pCompiler));
-    ThrowIfFailed(DxcCreateInstance(CLSID_DxcLibrary, __uuidof(IDxcLibrary), (void **)&pLibrary));
-    ThrowIfFailed(pLibrary->CreateIncludeHandler(&dxcIncludeHandler));
-  }
-  // Open and read the file
-  std::ifstream shaderFile(fileName);
-  if (shaderFile.good() == false)
-  {
-    throw std::logic_error("Cannot find shader file");
-  }
-  std::stringstream strStream;
-  strStream << shaderFile.rdbuf();
-  std::string sShader = strStream.str();
-
-  // Create blob from the string
-  IDxcBlobEncoding* pTextBlob;
-  ThrowIfFailed(pLibrary->CreateBlobWithEncodingFromPinned(
-      (LPBYTE)sShader.c_str(), (uint32_t)sShader.size(), 0, &pTextBlob));
-
-  // Compile
-  IDxcOperationResult* pResult;
-  ThrowIfFailed(pCompiler->Compile(pTextBlob, fileName, L"", L"lib_6_3", nullptr, 0, nullptr, 0,
-                                   dxcIncludeHandler, &pResult));
-
-  // Verify the result
-  HRESULT resultCode;
-  ThrowIfFailed(pResult->GetStatus(&resultCode));
-  if (FAILED(resultCode))
-  {
-    IDxcBlobEncoding* pError;
-    hr = pResult->GetErrorBuffer(&pError);
-    if (FAILED(hr))
-    {
-      throw std::logic_error("Failed to get shader compiler error");
-    }
-
-    // Convert error blob to a string
-    std::vector<char> infoLog(pError->GetBufferSize() + 1);
-    memcpy(infoLog.data(), pError->GetBufferPointer(), pError->GetBufferSize());
-    infoLog[pError->GetBufferSize()] = 0;
-
-    std::string errorMsg = "Shader Compiler Error:\n";
-    errorMsg.append(infoLog.data());
-
-    MessageBoxA(nullptr, errorMsg.c_str(), "Error!", MB_OK);
-    throw std::logic_error("Failed compile shader");
-  }
-
-  IDxcBlob* pBlob;
-  ThrowIfFailed(pResult->GetResult(&pBlob));
-  return pBlob;
+  return ShaderCache::Get().CompileLibrary(fileName);
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -141,168 +94,330 @@ ID3D12DescriptorHeap* CreateDescriptorHeap(ID3D12Device* device, uint32_t count,
 }
 
 //--------------------------------------------------------------------------------------------------
+// Menger sponge generation. The sponge is generated on an integer lattice: at a given level each
+// axis is split into 3^level cells, and whether a cell is filled is a pure function of its
+// coordinates. This allows generating the sponge in independent chunks, in parallel, while
+// producing the same output regardless of the number of threads, and makes it cheap to test
+// whether the neighbor of a cube is filled, so that the faces between two adjacent cubes are
+// culled.
 //
-//
-template <class Vertex>
-void GenerateMengerSponge(int32_t level, float probability, std::vector<Vertex>& outputVertices,
-                          std::vector<UINT>& outputIndices)
+
+/// Maximum subdivision level, so that the lattice coordinates of a vertex fit in 20 bits
+static const int32_t kMengerSpongeMaxLevel = 12;
+
+//--------------------------------------------------------------------------------------------------
+// Deterministic per-cube random number in [0,1], obtained by hashing the seed, the subdivision
+// level and the integer coordinates of the cube at that level (splitmix64 finalizer)
+inline float MengerSpongeRandom(uint32_t seed, int32_t level, uint32_t x, uint32_t y, uint32_t z)
 {
-  struct Cube
+  uint64_t h = (static_cast<uint64_t>(x) | (static_cast<uint64_t>(y) << 20) |
+                (static_cast<uint64_t>(z) << 40)) ^
+               (static_cast<uint64_t>(level) << 60) ^
+               (static_cast<uint64_t>(seed) * 0x9E3779B97F4A7C15ull);
+  h = (h ^ (h >> 30)) * 0xBF58476D1CE4E5B9ull;
+  h = (h ^ (h >> 27)) * 0x94D049BB133111EBull;
+  h ^= h >> 31;
+  return static_cast<float>(h >> 40) / static_cast<float>(1 << 24);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Test whether the child (x, y, z) of a cube is kept when subdividing. With a negative probability
+// this is the regular sponge, which removes the center of each face and the center of the cube.
+// Otherwise each child is kept randomly with the given probability. The coordinates are the ones
+// of the child at the given level
+inline bool MengerSpongeKeepChild(int32_t level, float probability, uint32_t seed, uint32_t x,
+                                  uint32_t y, uint32_t z)
+{
+  if (probability < 0.f)
   {
-    Cube(const XMVECTOR& tlf, float s) : m_topLeftFront(tlf), m_size(s)
+    int centered = (x % 3 == 1) + (y % 3 == 1) + (z % 3 == 1);
+    return centered < 2;
+  }
+  return MengerSpongeRandom(seed, level, x, y, z) <= probability;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Test whether the cell (x, y, z) of the lattice at the given level is filled, by checking that
+// each of its ancestors has been kept. Coordinates outside of the lattice are empty
+inline bool MengerSpongeIsFilled(int32_t level, float probability, uint32_t seed, int64_t x,
+                                 int64_t y, int64_t z)
+{
+  int64_t size = 1;
+  for (int32_t i = 0; i < level; i++)
+  {
+    size *= 3;
+  }
+  if (x < 0 || y < 0 || z < 0 || x >= size || y >= size || z >= size)
+  {
+    return false;
+  }
+  for (int32_t l = level; l > 0; l--)
+  {
+    if (!MengerSpongeKeepChild(l, probability, seed, static_cast<uint32_t>(x),
+                               static_cast<uint32_t>(y), static_cast<uint32_t>(z)))
     {
+      return false;
     }
-    XMVECTOR m_topLeftFront;
-    float m_size;
+    x /= 3;
+    y /= 3;
+    z /= 3;
+  }
+  return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Geometry of a chunk of the sponge: an indexed mesh whose indices are relative to its vertices
+template <class Vertex>
+struct MengerSpongeChunk
+{
+  std::vector<Vertex> vertices;
+  std::vector<UINT> indices;
+};
 
-    void enqueueQuad(std::vector<Vertex>& vertices, std::vector<UINT>& indices,
-                     const XMVECTOR& bottomLeft4, const XMVECTOR& dx, const XMVECTOR& dy, bool flip)
+//--------------------------------------------------------------------------------------------------
+// Build the geometry of the chunk whose root is the given cell of the chunk level.
+// Within a chunk, the vertices are shared between the coplanar faces using an index buffer, and
+// the faces between two filled cubes are culled. Each vertex holds a position, a normal and a
+// color, and the triangles are clockwise when seen from outside the sponge.
+template <class Vertex>
+MengerSpongeChunk<Vertex> BuildMengerSpongeChunk(int32_t level, int32_t chunkLevel,
+                                                 float probability, uint32_t seed,
+                                                 std::array<uint32_t, 3> root)
+{
+  uint32_t latticeSize = 1;
+  for (int32_t i = 0; i < level; i++)
+  {
+    latticeSize *= 3;
+  }
+  const float cellSize = 1.f / static_cast<float>(latticeSize);
+
+  MengerSpongeChunk<Vertex> chunk;
+  // Vertices are shared by faces with the same orientation only, since they carry the normal.
+  // The key packs the 20-bit lattice coordinates and the face direction
+  std::unordered_map<uint64_t, UINT> vertexIndices;
+
+  auto addVertex = [&](uint32_t x, uint32_t y, uint32_t z, uint32_t direction,
+                       const DirectX::XMFLOAT4& normal) {
+    uint64_t key = static_cast<uint64_t>(x) | (static_cast<uint64_t>(y) << 20) |
+                   (static_cast<uint64_t>(z) << 40) | (static_cast<uint64_t>(direction) << 60);
+    auto inserted = vertexIndices.emplace(key, static_cast<UINT>(chunk.vertices.size()));
+    if (inserted.second)
     {
-      UINT currentIndex = static_cast<UINT>(vertices.size());
-      XMFLOAT3 bottomLeft(bottomLeft4.m128_f32);
-      XMVECTOR normal = XMVector3Cross(XMVector3Normalize(dy), XMVector3Normalize(dx));
-      if (flip)
-      {
-        normal = -normal;
+      chunk.vertices.push_back({{-0.5f + x * cellSize, -0.5f + y * cellSize,
+                                 -0.5f + z * cellSize, 1.f},
+                                normal,
+                                {fabsf(normal.x), fabsf(normal.y), fabsf(normal.z), 1.f}});
+    }
+    return inserted.first->second;
+  };
 
-        indices.push_back(currentIndex + 0);
-        indices.push_back(currentIndex + 2);
-        indices.push_back(currentIndex + 1);
+  // Emit the visible faces of a filled leaf cube
+  auto emitCube = [&](uint32_t x, uint32_t y, uint32_t z) {
+    const uint32_t cell[3] = {x, y, z};
+    for (uint32_t direction = 0; direction < 6; direction++)
+    {
+      const uint32_t axis = direction / 2;
+      const bool positive = (direction % 2) == 0;
 
-        indices.push_back(currentIndex + 3);
-        indices.push_back(currentIndex + 1);
-        indices.push_back(currentIndex + 2);
-      }
-      else
+      int64_t neighbor[3] = {x, y, z};
+      neighbor[axis] += positive ? 1 : -1;
+      if (MengerSpongeIsFilled(level, probability, seed, neighbor[0], neighbor[1], neighbor[2]))
       {
+        continue;
+      }
 
-        indices.push_back(currentIndex + 0);
-        indices.push_back(currentIndex + 1);
-        indices.push_back(currentIndex + 2);
+      // Tangents u and v such that cross(v, u) is the outward normal, for a clockwise winding
+      // seen from outside
+      const uint32_t b = (axis + 1) % 3;
+      const uint32_t c = (axis + 2) % 3;
+      const uint32_t uAxis = positive ? c : b;
+      const uint32_t vAxis = positive ? b : c;
 
-        indices.push_back(currentIndex + 2);
-        indices.push_back(currentIndex + 1);
-        indices.push_back(currentIndex + 3);
-      }
+      DirectX::XMFLOAT4 normal = {0.f, 0.f, 0.f, 0.f};
+      (&normal.x)[axis] = positive ? 1.f : -1.f;
 
-      const DirectX::XMFLOAT4 n = {normal.m128_f32[0], normal.m128_f32[1], normal.m128_f32[2], 0.f};
-      vertices.push_back(
-          {{bottomLeft.x, bottomLeft.y, bottomLeft.z, 1.f}, n, {1.f, 0.f, 0.f, 1.f}});
-      vertices.push_back({{bottomLeft.x + dx.m128_f32[0], bottomLeft.y + dx.m128_f32[1],
-                           bottomLeft.z + dx.m128_f32[2], 1.f},
-                          n,
-                          {0.5f, 1.f, 0.f, 1.f}});
-      vertices.push_back({{bottomLeft.x + dy.m128_f32[0], bottomLeft.y + dy.m128_f32[1],
-                           bottomLeft.z + dy.m128_f32[2], 1.f},
-                          n,
-                          {0.5f, 0.f, 1.f, 1.f}});
-
-      vertices.push_back({{bottomLeft.x + dx.m128_f32[0] + dy.m128_f32[0],
-                           bottomLeft.y + dx.m128_f32[1] + dy.m128_f32[1],
-                           bottomLeft.z + dx.m128_f32[2] + dy.m128_f32[2], 1.f},
-                          n,
-                          {0.f, 1.f, 0.f, 1.f}});
+      uint32_t corner[3] = {cell[0], cell[1], cell[2]};
+      corner[axis] += positive ? 1 : 0;
+      UINT quad[4];
+      for (uint32_t i = 0; i < 4; i++)
+      {
+        uint32_t p[3] = {corner[0], corner[1], corner[2]};
+        p[uAxis] += i & 1;
+        p[vAxis] += (i >> 1) & 1;
+        quad[i] = addVertex(p[0], p[1], p[2], direction, normal);
+      }
+      chunk.indices.insert(chunk.indices.end(),
+                           {quad[0], quad[1], quad[2], quad[2], quad[1], quad[3]});
     }
-    void enqueueVertices(std::vector<Vertex>& vertices, std::vector<UINT>& indices)
-    {
+  };
 
-      XMVECTOR current = m_topLeftFront;
-      enqueueQuad(vertices, indices, current, {m_size, 0, 0}, {0, m_size, 0}, false);
-      enqueueQuad(vertices, indices, current, {m_size, 0, 0}, {0, 0, m_size}, true);
-      enqueueQuad(vertices, indices, current, {0, m_size, 0}, {0, 0, m_size}, false);
-
-      current.m128_f32[0] += m_size;
-      current.m128_f32[1] += m_size;
-      current.m128_f32[2] += m_size;
-      enqueueQuad(vertices, indices, current, {-m_size, 0, 0}, {0, -m_size, 0}, true);
-      enqueueQuad(vertices, indices, current, {-m_size, 0, 0}, {0, 0, -m_size}, false);
-      enqueueQuad(vertices, indices, current, {0, -m_size, 0}, {0, 0, -m_size}, true);
+  // Depth-first traversal of the kept descendants of the chunk root
+  struct Cell
+  {
+    uint32_t x, y, z;
+    int32_t level;
+  };
+  std::vector<Cell> stack = {{root[0], root[1], root[2], chunkLevel}};
+  while (!stack.empty())
+  {
+    Cell current = stack.back();
+    stack.pop_back();
+    if (current.level == level)
+    {
+      emitCube(current.x, current.y, current.z);
+      continue;
     }
-    void split(std::vector<Cube>& cubes)
+    for (uint32_t i = 0; i < 27; i++)
     {
-      float size = m_size / 3.f;
-      XMVECTOR topLeftFront = m_topLeftFront;
-      for (int x = 0; x < 3; x++)
+      Cell child = {current.x * 3 + i % 3, current.y * 3 + (i / 3) % 3, current.z * 3 + i / 9,
+                    current.level + 1};
+      if (MengerSpongeKeepChild(child.level, probability, seed, child.x, child.y, child.z))
       {
-        topLeftFront.m128_f32[0] = m_topLeftFront.m128_f32[0] + static_cast<float>(x) * size;
-        for (int y = 0; y < 3; y++)
-        {
-          if (x == 1 && y == 1)
-            continue;
-          topLeftFront.m128_f32[1] = m_topLeftFront.m128_f32[1] + static_cast<float>(y) * size;
-          for (int z = 0; z < 3; z++)
-          {
-            if (x == 1 && z == 1)
-              continue;
-            if (y == 1 && z == 1)
-              continue;
-
-            topLeftFront.m128_f32[2] = m_topLeftFront.m128_f32[2] + static_cast<float>(z) * size;
-            cubes.push_back({topLeftFront, size});
-          }
-        }
+        stack.push_back(child);
       }
     }
+  }
+  return chunk;
+}
 
-    void splitProb(std::vector<Cube>& cubes, float prob)
+//--------------------------------------------------------------------------------------------------
+// Generator of the chunks of a sponge. The chunks are built in parallel, but are always returned in
+// the same order, so that the output is deterministic. At most a few chunks per hardware thread
+// are kept in memory at any time, hence the peak memory usage does not depend on the level
+template <class Vertex>
+class MengerSpongeChunkGenerator
+{
+public:
+  MengerSpongeChunkGenerator(int32_t level, float probability, uint32_t seed)
+      : m_level(level), m_probability(probability), m_seed(seed)
+  {
+    if (level < 0 || level > kMengerSpongeMaxLevel)
     {
-
-      float size = m_size / 3.f;
-      XMVECTOR topLeftFront = m_topLeftFront;
-      for (int x = 0; x < 3; x++)
-      {
-        topLeftFront.m128_f32[0] = m_topLeftFront.m128_f32[0] + static_cast<float>(x) * size;
-        for (int y = 0; y < 3; y++)
-        {
-          topLeftFront.m128_f32[1] = m_topLeftFront.m128_f32[1] + static_cast<float>(y) * size;
-          for (int z = 0; z < 3; z++)
-          {
-            float sample = rand() / static_cast<float>(RAND_MAX);
-            if (sample > prob)
-              continue;
-            topLeftFront.m128_f32[2] = m_topLeftFront.m128_f32[2] + static_cast<float>(z) * size;
-            cubes.push_back({topLeftFront, size});
-          }
-        }
-      }
+      throw std::logic_error("Invalid Menger sponge level");
     }
-  };
 
-  XMVECTOR orig;
-  orig.m128_f32[0] = -0.5f;
-  orig.m128_f32[1] = -0.5f;
-  orig.m128_f32[2] = -0.5f;
-  orig.m128_f32[3] = 1.f;
+    // The chunks are the filled cubes of the second level (at most 400). Low levels use coarser
+    // chunks, so that each of them still contains enough cubes to share vertices
+    m_chunkLevel = level / 2 < 2 ? level / 2 : 2;
+    uint32_t chunkSize = m_chunkLevel == 0 ? 1 : (m_chunkLevel == 1 ? 3 : 9);
+    for (uint32_t x = 0; x < chunkSize; x++)
+      for (uint32_t y = 0; y < chunkSize; y++)
+        for (uint32_t z = 0; z < chunkSize; z++)
+          if (MengerSpongeIsFilled(m_chunkLevel, probability, seed, x, y, z))
+            m_chunkCells.push_back({x, y, z});
+
+    const unsigned int threadCount = std::thread::hardware_concurrency();
+    m_window = 2 * static_cast<size_t>(threadCount > 0 ? threadCount : 1);
+  }
+
+  /// Get the next chunk, keeping the window of chunks in flight full. Returns false once all the
+  /// chunks have been returned
+  bool Next(MengerSpongeChunk<Vertex>& chunk)
+  {
+    while (m_inFlight.size() < m_window && m_nextCell < m_chunkCells.size())
+    {
+      m_inFlight.push_back(std::async(std::launch::async, BuildMengerSpongeChunk<Vertex>, m_level,
+                                      m_chunkLevel, m_probability, m_seed,
+                                      m_chunkCells[m_nextCell++]));
+    }
+    if (m_inFlight.empty())
+    {
+      return false;
+    }
+    chunk = m_inFlight.front().get();
+    m_inFlight.pop_front();
+    return true;
+  }
 
-  Cube cube(orig, 1.f);
+private:
+  int32_t m_level;
+  int32_t m_chunkLevel;
+  float m_probability;
+  uint32_t m_seed;
+  std::vector<std::array<uint32_t, 3>> m_chunkCells;
+  size_t m_nextCell = 0;
+  size_t m_window;
+  std::deque<std::future<MengerSpongeChunk<Vertex>>> m_inFlight;
+};
 
-  std::vector<Cube> cubes1 = {cube};
-  std::vector<Cube> cubes2 = {};
+//--------------------------------------------------------------------------------------------------
+// Generate the sponge in chunks, and pass each of them to onChunk(vertices, indices) on the calling
+// thread, in a deterministic order. See MengerSpongeChunkGenerator
+template <class Vertex, class ChunkCallback>
+void GenerateMengerSpongeChunks(int32_t level, float probability, uint32_t seed,
+                                ChunkCallback&& onChunk)
+{
+  MengerSpongeChunkGenerator<Vertex> generator(level, probability, seed);
+  MengerSpongeChunk<Vertex> chunk;
+  while (generator.Next(chunk))
+  {
+    onChunk(chunk.vertices, chunk.indices);
+  }
+}
 
-  auto previous = &cubes1;
-  auto next = &cubes2;
+//--------------------------------------------------------------------------------------------------
+// Chunk source pulled by the ChunkedBottomLevelASBuilder, generating the sponge on demand. The
+// generated chunks are sliced to the capacity requested by the builder, so only the chunks in
+// flight in the generator are ever in memory. The vertex stride of the builder must be
+// sizeof(Vertex)
+template <class Vertex>
+class MengerSpongeChunkSource : public GeometryChunkSource
+{
+public:
+  MengerSpongeChunkSource(int32_t level, float probability, uint32_t seed = 0)
+      : m_generator(level, probability, seed)
+  {
+  }
 
-  for (int i = 0; i < level; i++)
+  bool NextChunk(uint32_t maxVertices, uint32_t maxIndices, void* vertices, UINT* indices,
+                 uint32_t* vertexCount, uint32_t* indexCount) override
   {
-    for (Cube& c : *previous)
+    for (;;)
     {
-      if (probability < 0.f)
-        c.split(*next);
-      else
-        c.splitProb(*next, 20.f / 27.f);
+      if (m_slicer &&
+          m_slicer->NextChunk(maxVertices, maxIndices, vertices, indices, vertexCount, indexCount))
+      {
+        return true;
+      }
+      // The current chunk has been consumed, or culled entirely: move to the next one
+      if (!m_generator.Next(m_chunk))
+      {
+        m_slicer.reset();
+        return false;
+      }
+      m_slicer = std::make_unique<IndexedMeshChunkSource>(
+          m_chunk.vertices.data(), static_cast<UINT>(sizeof(Vertex)),
+          static_cast<uint32_t>(m_chunk.vertices.size()), m_chunk.indices.data(),
+          static_cast<uint32_t>(m_chunk.indices.size()));
     }
-    auto temp = previous;
-    previous = next;
-    next = temp;
-    next->clear();
   }
 
-  outputVertices.reserve(24 * previous->size());
-  outputIndices.reserve(24 * previous->size());
-  for (Cube& c : *previous)
-  {
-    c.enqueueVertices(outputVertices, outputIndices);
-  }
+private:
+  MengerSpongeChunkGenerator<Vertex> m_generator;
+  /// Chunk being sliced into the builder buffers
+  MengerSpongeChunk<Vertex> m_chunk;
+  std::unique_ptr<IndexedMeshChunkSource> m_slicer;
+};
+
+//--------------------------------------------------------------------------------------------------
+// Generate the whole sponge in a single indexed mesh. A negative probability generates the regular
+// sponge, otherwise each sub-cube is kept with the given probability, using a random sequence
+// determined by the seed
+template <class Vertex>
+void GenerateMengerSponge(int32_t level, float probability, std::vector<Vertex>& outputVertices,
+                          std::vector<UINT>& outputIndices, uint32_t seed = 0)
+{
+  GenerateMengerSpongeChunks<Vertex>(
+      level, probability, seed,
+      [&outputVertices, &outputIndices](const std::vector<Vertex>& vertices,
+                                        const std::vector<UINT>& indices) {
+        UINT baseIndex = static_cast<UINT>(outputVertices.size());
+        outputVertices.insert(outputVertices.end(), vertices.begin(), vertices.end());
+        for (UINT index : indices)
+        {
+          outputIndices.push_back(baseIndex + index);
+        }
+      });
 }
 
 } // namespace nv_helpers_dx12
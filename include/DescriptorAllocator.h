@@ -0,0 +1,130 @@
+/*
+The descriptor allocator manages a single large descriptor heap, typically the shader-visible
+CBV/SRV/UAV heap bound for the whole frame. Descriptors are referenced by their index in the heap,
+from which both the CPU handle used to create the view and the GPU handle used in the shader
+records are derived. Resources can then be added and removed at any time without rebuilding the
+heap, and the records of the shader binding table reference them by index instead of each
+needing its own descriptor table.
+
+The heap is split into two regions:
+- The persistent region holds the descriptors living across frames, such as the views of the
+  output buffer, the acceleration structures or the material textures. Contiguous ranges are
+  allocated from a free list, first fit, and adjacent free ranges are merged back. A range freed
+  while the GPU may still use it is tagged with a fence value, and only reused once Reclaim is
+  called with a completed value at least as large.
+- The transient region holds one linear range per frame in flight, for the descriptors written
+  while recording a frame. BeginFrame resets the range of the frame, which is not used by the GPU
+  anymore once its frame context has been acquired.
+
+Since the persistent descriptors are allocated at stable indices, the whole persistent region can
+also be bound as a single unbounded table, the shaders indexing it with the indices passed as root
+constants or stored in their records.
+
+Example:
+
+nv_helpers_dx12::DescriptorAllocator descriptors;
+descriptors.Initialize(m_device.Get(), D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, 1024, 64,
+                       frameCount, true);
+
+uint32_t outputIndex = descriptors.Allocate(2);
+m_device->CreateUnorderedAccessView(output, nullptr, &uavDesc,
+                                    descriptors.GetCpuHandle(outputIndex));
+m_device->CreateShaderResourceView(nullptr, &tlasDesc,
+                                   descriptors.GetCpuHandle(outputIndex + 1));
+m_sbtHelper.AddRayGenerationRecord(
+    L"RayGen", ShaderRecordArguments().AddDescriptorTable(descriptors.GetGpuHandle(outputIndex)));
+
+// Each frame, once the frame context has been acquired
+descriptors.BeginFrame(frameRing.GetFrameIndex());
+descriptors.Reclaim(frameRing.GetCompletedFenceValue());
+
+*/
+
+#pragma once
+
+#include "d3d12.h"
+
+#include <cstdint>
+#include <deque>
+#include <map>
+
+namespace nv_helpers_dx12
+{
+
+/// Allocator of persistent and per-frame descriptors within a single descriptor heap
+class DescriptorAllocator
+{
+public:
+  DescriptorAllocator() = default;
+  ~DescriptorAllocator();
+
+  DescriptorAllocator(const DescriptorAllocator&) = delete;
+  DescriptorAllocator& operator=(const DescriptorAllocator&) = delete;
+
+  /// Create the descriptor heap, holding the persistent descriptors followed by the transient
+  /// descriptors of each frame in flight. Throws std::logic_error if the heap cannot be created
+  void Initialize(ID3D12Device* device, D3D12_DESCRIPTOR_HEAP_TYPE type,
+                  uint32_t persistentCount,        /// Size of the persistent region
+                  uint32_t transientCountPerFrame, /// Size of the transient range of each frame
+                  uint32_t frameCount,             /// Number of frames in flight
+                  bool shaderVisible);
+
+  /// Allocate a contiguous range of persistent descriptors, and return the index of the first
+  /// one. Throws std::logic_error if no free range is large enough
+  uint32_t Allocate(uint32_t count = 1);
+
+  /// Free a range of persistent descriptors. The range is only reused once the fence value has
+  /// been reached, or immediately if the value is 0
+  void Free(uint32_t index, uint32_t count, uint64_t fenceValue = 0);
+
+  /// Return to the free list the ranges whose fence value is lower or equal to the completed value
+  void Reclaim(uint64_t completedFenceValue);
+
+  /// Start allocating the transient descriptors in the range of a frame, discarding its previous
+  /// allocations
+  void BeginFrame(uint32_t frameIndex);
+
+  /// Allocate a contiguous range of transient descriptors valid until the frame slot is reused,
+  /// and return the index of the first one. Throws std::logic_error if the frame range is full
+  uint32_t AllocateTransient(uint32_t count = 1);
+
+  /// CPU handle of a descriptor, to create a view
+  D3D12_CPU_DESCRIPTOR_HANDLE GetCpuHandle(uint32_t index) const;
+  /// GPU handle of a descriptor, to reference a table starting at that descriptor
+  D3D12_GPU_DESCRIPTOR_HANDLE GetGpuHandle(uint32_t index) const;
+
+  ID3D12DescriptorHeap* GetHeap() const { return m_heap; }
+  /// Number of persistent descriptors which are neither allocated nor waiting for their fence
+  uint32_t GetFreeCount() const;
+
+private:
+  /// Insert a range in the free list, merging it with its neighbors
+  void InsertFreeRange(uint32_t index, uint32_t count);
+
+  void Release();
+
+  ID3D12DescriptorHeap* m_heap = nullptr;
+  uint32_t m_descriptorSize = 0;
+  D3D12_CPU_DESCRIPTOR_HANDLE m_cpuStart = {};
+  D3D12_GPU_DESCRIPTOR_HANDLE m_gpuStart = {};
+
+  uint32_t m_persistentCount = 0;
+  /// Free persistent ranges, as the count of descriptors indexed by the first one
+  std::map<uint32_t, uint32_t> m_freeRanges;
+
+  /// Range freed while it may still be used by the GPU, in increasing order of fence values
+  struct PendingFree
+  {
+    uint64_t fenceValue;
+    uint32_t index;
+    uint32_t count;
+  };
+  std::deque<PendingFree> m_pendingFrees;
+
+  uint32_t m_transientCountPerFrame = 0;
+  uint32_t m_frameCount = 0;
+  /// First descriptor of the transient range of the current frame, and the number allocated
+  uint32_t m_transientStart = 0;
+  uint32_t m_transientUsed = 0;
+};
+} // namespace nv_helpers_dx12
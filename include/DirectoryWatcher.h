@@ -0,0 +1,84 @@
+/*
+The directory watcher reports the files modified in a directory and its subdirectories, to reload
+assets such as shaders while the application is running. The notifications are received on a
+background thread from the FileSystem watch of Platform.h, and collected until the application
+polls them, typically once per frame.
+
+Saving a file usually triggers several notifications in a row, and some editors write a temporary
+file before renaming it. The modified files are hence only reported once no new notification has
+been received for a short delay, so that a single save is reported once, after the file has been
+completely written.
+
+Example:
+
+nv_helpers_dx12::DirectoryWatcher watcher;
+watcher.Start(L"assets/shaders");
+...
+// Once per frame
+std::vector<std::wstring> modifiedFiles;
+if (watcher.PollModifiedFiles(modifiedFiles))
+{
+  // Reload the assets depending on modifiedFiles
+}
+
+*/
+
+#pragma once
+
+#include "Platform.h"
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace nv_helpers_dx12
+{
+
+/// Background watcher of the files modified in a directory
+class DirectoryWatcher
+{
+public:
+  DirectoryWatcher() = default;
+  ~DirectoryWatcher();
+
+  DirectoryWatcher(const DirectoryWatcher&) = delete;
+  DirectoryWatcher& operator=(const DirectoryWatcher&) = delete;
+
+  /// Start watching a directory and its subdirectories. Throws std::logic_error if the directory
+  /// cannot be opened
+  void Start(const std::wstring& directory);
+
+  /// Stop watching, and wait for the background thread to exit
+  void Stop();
+
+  /// Move the absolute paths of the files modified since the last call into modifiedFiles, each
+  /// file being reported once. When too many changes happen at once to be tracked individually,
+  /// the path of the watched directory itself is reported. Returns false if no file was modified,
+  /// or if the last modification is more recent than the settling delay
+  bool PollModifiedFiles(std::vector<std::wstring>& modifiedFiles);
+
+  /// Absolute path of the watched directory, ending with a separator. This is the path reported
+  /// by PollModifiedFiles when the modified files are unknown
+  const std::wstring& GetDirectory() const { return m_path; }
+
+  /// Set the delay without notifications after which the modified files are reported
+  void SetSettlingDelay(uint32_t milliseconds) { m_settlingDelay = milliseconds; }
+
+private:
+  /// Wait for notifications until Stop is called
+  void Run();
+
+  std::wstring m_path;
+  FileSystem::DirectoryWatch* m_watch = nullptr;
+  std::thread m_thread;
+
+  /// Protects the modified files and the time of the last notification
+  std::mutex m_mutex;
+  std::vector<std::wstring> m_modifiedFiles;
+  std::chrono::steady_clock::time_point m_lastNotificationTime;
+  uint32_t m_settlingDelay = 100;
+};
+} // namespace nv_helpers_dx12
@@ -0,0 +1,119 @@
+/*
+The frame context ring lets the CPU record a frame while the GPU is still executing the previous
+ones. Each of the N slots of the ring holds the fence value signaled at the end of the last frame
+which used it. Starting a frame moves to the next slot, and only waits if the GPU has not yet
+completed the frame which last used that slot, that is the frame submitted N frames earlier.
+
+Any CPU-written resource used by a frame, such as the shader binding table or the per-frame upload
+buffers, can then be indexed by GetFrameIndex: the GPU is done with it when the frame starts. The
+command lists and their allocators are recycled the same way by the CommandListPool, using
+GetCompletedFenceValue.
+
+Objects which may still be referenced by the frames in flight, such as a pipeline replaced during
+a shader reload, are passed to DeferRelease. Their reference is released once the GPU has
+completed the frame currently being recorded.
+
+Example:
+
+nv_helpers_dx12::FrameContextRing frameRing;
+frameRing.Initialize(m_device.Get(), m_commandQueue.Get(), 2);
+
+// Each frame
+frameRing.BeginFrame();
+commandListPool.Reclaim(frameRing.GetCompletedFenceValue());
+// Record and submit the frame, using the resources indexed by frameRing.GetFrameIndex()
+...
+m_swapchain->Present(1, 0);
+commandListPool.FinishFrame(frameRing.GetFrameFenceValue());
+frameRing.EndFrame();
+
+// Before destroying the resources
+frameRing.WaitForIdle();
+
+*/
+
+#pragma once
+
+#include "d3d12.h"
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace nv_helpers_dx12
+{
+
+/// Ring of per-frame fence values, for several frames in flight
+class FrameContextRing
+{
+public:
+  FrameContextRing() = default;
+  ~FrameContextRing();
+
+  FrameContextRing(const FrameContextRing&) = delete;
+  FrameContextRing& operator=(const FrameContextRing&) = delete;
+
+  /// Create the fence signaled at the end of the frames. Throws std::logic_error if the objects
+  /// cannot be created
+  void Initialize(ID3D12Device* device,      /// Device used to create the fence
+                  ID3D12CommandQueue* queue, /// Queue on which the frames are submitted
+                  uint32_t frameCount        /// Maximum number of frames in flight
+  );
+
+  /// Start recording a frame in the next slot of the ring. Waits if the GPU has not completed the
+  /// frame which last used the slot, and releases the objects whose frames are complete
+  void BeginFrame();
+
+  /// Signal the end of the current frame on the queue, once its command lists have been submitted
+  void EndFrame();
+
+  /// Release an object once the GPU has completed the frame being recorded, or the next frame if
+  /// called between frames. The reference held by the caller is transferred to the ring
+  void DeferRelease(IUnknown* object);
+
+  /// Wait until the GPU has completed all the work submitted to the queue, and release all the
+  /// deferred objects
+  void WaitForIdle();
+
+  /// Index of the slot of the current frame, in [0, GetFrameCount())
+  uint32_t GetFrameIndex() const
+  {
+    return static_cast<uint32_t>(m_frameNumber % m_frameFenceValues.size());
+  }
+  /// Maximum number of frames in flight
+  uint32_t GetFrameCount() const { return static_cast<uint32_t>(m_frameFenceValues.size()); }
+  /// Fence value signaled at the end of the current frame, used to tag the resources it uses
+  uint64_t GetFrameFenceValue() const { return m_nextFenceValue; }
+  /// Last fence value reached by the GPU. The resources tagged with a lower or equal value are no
+  /// longer in use
+  uint64_t GetCompletedFenceValue() const { return m_fence->GetCompletedValue(); }
+  /// Fence signaled at the end of the frames, for other queues to wait on them
+  ID3D12Fence* GetFence() const { return m_fence; }
+  /// Number of times BeginFrame had to wait for the GPU
+  uint32_t GetStallCount() const { return m_stallCount; }
+
+private:
+  /// Block until the fence has reached the value
+  void WaitForFenceValue(uint64_t value);
+
+  /// Release the deferred objects whose fence value has been reached
+  void ReleaseCompleted();
+
+  void Release();
+
+  ID3D12CommandQueue* m_queue = nullptr;
+  ID3D12Fence* m_fence = nullptr;
+  HANDLE m_fenceEvent = nullptr;
+  /// Fence value signaled by the last frame which used each slot
+  std::vector<uint64_t> m_frameFenceValues;
+
+  /// Number of frames ended since the initialization
+  uint64_t m_frameNumber = 0;
+  /// Value signaled at the end of the current frame
+  uint64_t m_nextFenceValue = 1;
+  uint32_t m_stallCount = 0;
+
+  /// Objects to release, with the fence value after which the GPU no longer uses them
+  std::vector<std::pair<uint64_t, IUnknown*>> m_deferredReleases;
+};
+} // namespace nv_helpers_dx12
@@ -0,0 +1,101 @@
+/*
+The frame writer saves rendered frames to disk on a background thread, so that the render loop
+never waits for the file system. The frames are queued by Write and saved in order as binary PPM
+images, named after their frame number. The queue is bounded: when the disk cannot keep up, Write
+blocks until a frame has been saved, instead of accumulating frames in memory.
+
+An error raised while saving a frame stops the writer, and is rethrown on the render thread by the
+next call to Write or Finish.
+
+Example:
+
+nv_helpers_dx12::FrameWriter writer;
+writer.Start(L"frames");
+
+// For each rendered frame
+nv_helpers_dx12::FrameImage frame;
+frame.frameNumber = n;
+frame.width = width;
+frame.height = height;
+frame.pixels = ...; // RGBA8, tightly packed rows
+writer.Write(std::move(frame));
+
+// Once all the frames have been rendered, waits for them to be saved
+writer.Finish();
+
+*/
+
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace nv_helpers_dx12
+{
+
+/// Rendered frame read back from the GPU
+struct FrameImage
+{
+  uint64_t frameNumber = 0;
+  uint32_t width = 0;
+  uint32_t height = 0;
+  /// RGBA8 pixels, rows tightly packed from top to bottom
+  std::vector<uint8_t> pixels;
+};
+
+/// Background writer of the rendered frames
+class FrameWriter
+{
+public:
+  FrameWriter() = default;
+  ~FrameWriter();
+
+  FrameWriter(const FrameWriter&) = delete;
+  FrameWriter& operator=(const FrameWriter&) = delete;
+
+  /// Create the output directory if needed, and start the writer thread. Throws std::logic_error
+  /// if the directory cannot be created
+  void Start(const std::wstring& directory, /// Directory in which the frames are saved
+             uint32_t maxQueuedFrames = 4   /// Number of frames queued before Write blocks
+  );
+
+  /// Queue a frame to be saved, waiting if the queue is full. Rethrows the error which stopped the
+  /// writer, if any
+  void Write(FrameImage&& frame);
+
+  /// Wait until all the queued frames have been saved, and stop the writer thread. Rethrows the
+  /// error which stopped the writer, if any
+  void Finish();
+
+  /// Number of frames saved since Start
+  uint64_t GetWrittenFrameCount() const;
+
+private:
+  /// Save the queued frames until Finish is called
+  void Run();
+  /// Save a frame as a binary PPM image. Throws std::logic_error on failure
+  void SaveFrame(const FrameImage& frame) const;
+  /// Stop the writer thread without rethrowing its error
+  void Stop();
+
+  std::filesystem::path m_directory;
+  uint32_t m_maxQueuedFrames = 4;
+  std::thread m_thread;
+
+  /// Protects the queue and the state of the writer
+  mutable std::mutex m_mutex;
+  /// Signaled when a frame is queued or saved, or when the writer stops
+  std::condition_variable m_queueCondition;
+  std::deque<FrameImage> m_queue;
+  bool m_stopping = false;
+  std::exception_ptr m_error;
+  uint64_t m_writtenFrameCount = 0;
+};
+} // namespace nv_helpers_dx12
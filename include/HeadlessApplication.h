@@ -0,0 +1,17 @@
+#pragma once
+
+#include <vector>
+
+#include "DXPipeline.h"
+
+// Offline counterpart of Win32Application: renders a fixed number of frames
+// without creating a window, and writes them to disk
+class HeadlessApplication
+{
+public:
+	static int Run(DXPipeline *pPipeline);
+
+private:
+	static std::vector<CameraPose> LoadCameraPath(const std::wstring &fileName);
+	static CameraPose SampleCameraPath(const std::vector<CameraPose> &keyframes, uint32_t frame, uint32_t frameCount);
+};
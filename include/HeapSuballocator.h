@@ -0,0 +1,143 @@
+/*
+The heap suballocator carves many small allocations out of a few large memory pages, instead of
+allocating each of them separately. Each page is managed by a buddy allocator: the page is split
+into blocks whose sizes are powers of two, each block being either free or split into two halves
+("buddies"). An allocation takes the smallest free block large enough for its size and alignment,
+splitting larger blocks as needed, and freeing it merges it back with its buddy whenever the buddy
+is also free. Blocks are naturally aligned on their size, so any power-of-two alignment up to the
+block size comes for free. Allocation and release are logarithmic in the page size, and the
+fragmentation is bounded by the rounding of each size to a power of two.
+
+The suballocator only manages offsets: the memory of the pages is provided by a backend deriving
+from HeapSuballocator, which creates and destroys the pages on demand. PlacedResourceAllocator
+uses ID3D12Heap pages to create placed resources, and HostHeapSuballocator uses host memory with
+the exact same logic, so that the allocation logic can be exercised without a device.
+
+Example:
+
+nv_helpers_dx12::HostHeapSuballocator heap(16 * 1024 * 1024, 256);
+nv_helpers_dx12::HeapSuballocator::Allocation allocation = heap.Allocate(1000, 256);
+void* data = heap.GetAddress(allocation);
+...
+heap.Free(allocation);
+
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <set>
+#include <unordered_map>
+#include <vector>
+
+namespace nv_helpers_dx12
+{
+
+/// Buddy allocator of the offsets within a power-of-two range
+class BuddyAllocator
+{
+public:
+  static constexpr uint64_t kInvalidOffset = ~0ull;
+
+  /// The capacity and the minimum block size must be powers of two, with the capacity larger than
+  /// the block size. Throws std::logic_error otherwise
+  BuddyAllocator(uint64_t capacity, uint64_t minBlockSize);
+
+  /// Allocate a block of at least the given size, aligned on a power of two. Returns
+  /// kInvalidOffset if no free block is large enough
+  uint64_t Allocate(uint64_t size, uint64_t alignment);
+
+  /// Free a block returned by Allocate. Throws std::logic_error if the offset was not allocated
+  void Free(uint64_t offset);
+
+  /// Size of the block which would be allocated for the size and alignment
+  uint64_t GetBlockSize(uint64_t size, uint64_t alignment) const;
+
+  uint64_t GetCapacity() const { return m_capacity; }
+  /// Sum of the sizes of the allocated blocks
+  uint64_t GetAllocatedSize() const { return m_allocatedSize; }
+  bool IsEmpty() const { return m_allocatedSize == 0; }
+
+private:
+  /// Size of the blocks of a level, level 0 being the whole range
+  uint64_t GetLevelSize(uint32_t level) const { return m_capacity >> level; }
+
+  uint64_t m_capacity;
+  uint64_t m_minBlockSize;
+  uint64_t m_allocatedSize = 0;
+
+  /// Offsets of the free blocks of each level
+  std::vector<std::set<uint64_t>> m_freeBlocks;
+  /// Level of each allocated block, indexed by its offset
+  std::unordered_map<uint64_t, uint32_t> m_allocatedLevels;
+};
+
+/// Suballocator of pages of memory provided by a backend
+class HeapSuballocator
+{
+public:
+  static constexpr uint32_t kInvalidPage = ~0u;
+
+  /// Location of an allocation within the pages
+  struct Allocation
+  {
+    uint32_t page = kInvalidPage; /// Index of the page
+    uint64_t offset = 0;          /// Offset of the allocation within the page
+    uint64_t size = 0;            /// Size of the block reserved for the allocation
+  };
+
+  /// The page size and the minimum block size must be powers of two
+  HeapSuballocator(uint64_t pageSize, uint64_t minBlockSize);
+  virtual ~HeapSuballocator() = default;
+
+  HeapSuballocator(const HeapSuballocator&) = delete;
+  HeapSuballocator& operator=(const HeapSuballocator&) = delete;
+
+  /// Allocate memory in the first page with a large enough free block, creating a new page if
+  /// none has one. Throws std::logic_error if the size or the alignment exceed the page size
+  Allocation Allocate(uint64_t size, uint64_t alignment);
+
+  /// Free an allocation. Empty pages are kept until ReleaseEmptyPages is called
+  void Free(const Allocation& allocation);
+
+  /// Destroy the pages which do not contain any allocation
+  void ReleaseEmptyPages();
+
+  uint64_t GetPageSize() const { return m_pageSize; }
+  /// Number of pages currently created by the backend
+  uint32_t GetPageCount() const;
+  /// Sum of the sizes of the blocks allocated in all the pages
+  uint64_t GetAllocatedSize() const;
+
+protected:
+  /// Create the memory of a page of GetPageSize() bytes
+  virtual void CreatePage(uint32_t page) = 0;
+  /// Destroy the memory of a page
+  virtual void DestroyPage(uint32_t page) = 0;
+
+private:
+  uint64_t m_pageSize;
+  uint64_t m_minBlockSize;
+  /// Allocator of each page, null for the pages which have been destroyed
+  std::vector<std::unique_ptr<BuddyAllocator>> m_pages;
+};
+
+/// Suballocator of host memory, to use the allocation logic of the GPU heaps on the CPU
+class HostHeapSuballocator : public HeapSuballocator
+{
+public:
+  using HeapSuballocator::HeapSuballocator;
+  ~HostHeapSuballocator() override;
+
+  /// Address of an allocation
+  void* GetAddress(const Allocation& allocation) const;
+
+protected:
+  void CreatePage(uint32_t page) override;
+  void DestroyPage(uint32_t page) override;
+
+private:
+  std::vector<void*> m_memory;
+};
+} // namespace nv_helpers_dx12
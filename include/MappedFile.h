@@ -0,0 +1,108 @@
+/*
+Read-only memory mapping of a file, used by the loaders of the on-disk caches and asset formats.
+Mapping the file avoids copying its contents into an intermediate buffer: the pages are brought
+in by the OS on first access, and the returned pointer can be handed directly to the consumer
+(e.g. memcpy'd into an upload heap).
+
+WriteFileAtomically writes a complete file under a temporary name and renames it into place, so
+that concurrent readers, or a crash during the write, can never observe a partially written file.
+AtomicFileWriter does the same for files written sequentially in several pieces, so that large
+files do not need to be assembled in memory first.
+
+The files are mapped, written and renamed through the FileSystem services of Platform.h, which
+use the native API of each platform.
+
+Example:
+
+nv_helpers_dx12::MappedFile file;
+if (file.Open(L"cache/0123456789abcdef.blas"))
+{
+  const uint8_t* data = file.GetData();
+  uint64_t size = file.GetSize();
+  ...
+}
+
+*/
+
+#pragma once
+
+#include "Platform.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+namespace nv_helpers_dx12
+{
+
+/// Read-only view of a whole file mapped in memory
+class MappedFile
+{
+public:
+  MappedFile() = default;
+  ~MappedFile();
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  /// Map the file in memory. Returns false if the file does not exist or cannot be mapped, in
+  /// which case the object stays closed
+  bool Open(const std::wstring& fileName);
+
+  /// Unmap the file and close the underlying handles
+  void Close();
+
+  /// Pointer to the first byte of the file, or nullptr if no file is mapped
+  const uint8_t* GetData() const { return m_mapping.data; }
+
+  /// Size of the mapped file in bytes
+  uint64_t GetSize() const { return m_mapping.size; }
+
+  bool IsOpen() const { return m_mapping.data != nullptr; }
+
+private:
+  FileSystem::FileMapping m_mapping;
+};
+
+/// Sequential writer of a file, created under a temporary name in the same directory and renamed
+/// into place by Commit. The temporary file is deleted if the writer is destroyed before Commit
+class AtomicFileWriter
+{
+public:
+  AtomicFileWriter() = default;
+  ~AtomicFileWriter();
+
+  AtomicFileWriter(const AtomicFileWriter&) = delete;
+  AtomicFileWriter& operator=(const AtomicFileWriter&) = delete;
+
+  /// Create the temporary file. Returns false on failure
+  bool Open(const std::wstring& fileName);
+
+  /// Append size bytes to the file. Returns false on failure, in which case the file cannot be
+  /// committed anymore
+  bool Write(const void* data, uint64_t size);
+
+  /// Close the file and rename it to the name given to Open, replacing any existing file. Returns
+  /// false on failure, in which case the temporary file is deleted
+  bool Commit();
+
+  /// Close and delete the temporary file
+  void Abort();
+
+private:
+  std::FILE* m_file = nullptr;
+  /// Set when a write failed, so that the file is not committed
+  bool m_failed = false;
+  std::wstring m_fileName;
+  std::wstring m_tempName;
+};
+
+/// Write size bytes from data into fileName, replacing any existing file. The data is first written
+/// to a temporary file in the same directory, which is then renamed. Returns false on failure
+bool WriteFileAtomically(const std::wstring& fileName, const void* data, uint64_t size);
+
+/// Convert a path relative to the current directory into an absolute path, so that paths obtained
+/// from different sources can be compared. Returns the input path on failure
+std::wstring GetAbsolutePath(const std::wstring& path);
+
+} // namespace nv_helpers_dx12
@@ -0,0 +1,85 @@
+/*
+The mesh importer loads triangle meshes from Wavefront OBJ and binary PLY files. The file is
+memory-mapped and parsed in place, without reading it through a stream: it is split into chunks,
+which are parsed in parallel in two passes. The first pass counts the vertices and triangles of
+each chunk, from which the output arrays are allocated once and the position of each chunk in
+those arrays is derived. The second pass parses the chunks again and writes the vertices directly
+into their final location, in the vertex layout used by the application, and the triangle indices
+in the format expected by BottomLevelASGenerator::AddVertexBuffer.
+
+OBJ files are split on line boundaries. Only the vertex positions, optional vertex colors
+("v x y z r g b") and faces are imported, other statements are ignored. Polygons are triangulated
+as fans, and negative (relative) indices are supported. Binary PLY files, either little or big
+endian, are split on element boundaries, and the x, y, z and optional red, green, blue, alpha
+vertex properties are imported along with the vertex_indices face lists.
+
+The vertex type used by the template version must have a position member of 3 floats and a color
+member of 4 floats, such as DX12HelloTriangle::Vertex. Vertices without color are white.
+
+Example:
+
+std::vector<Vertex> vertices;
+std::vector<UINT> indices;
+nv_helpers_dx12::ImportMesh(GetAssetFullPath(L"scan.ply"), vertices, indices);
+
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace nv_helpers_dx12
+{
+
+/// Location of the imported attributes within a vertex
+struct MeshVertexLayout
+{
+  uint32_t stride;         /// Size of a vertex in bytes
+  uint32_t positionOffset; /// Offset of the position, stored as 3 floats
+  int32_t colorOffset;     /// Offset of the color, stored as 4 floats, or -1 if not imported
+};
+
+/// Callback allocating the output vertex array once the number of vertices is known. The returned
+/// memory must hold vertexCount vertices of the layout stride
+using MeshVertexAllocator = std::function<void*(size_t vertexCount)>;
+
+/// Import an OBJ or PLY file, depending on its extension. The vertices are written into the memory
+/// returned by allocateVertices, and the indices replace the contents of the index array. Throws
+/// std::logic_error if the file cannot be opened or is malformed. A thread count of 0 uses all the
+/// hardware threads
+void ImportMesh(const std::wstring& fileName, const MeshVertexLayout& layout,
+                const MeshVertexAllocator& allocateVertices, std::vector<uint32_t>& indices,
+                uint32_t threadCount = 0);
+
+/// Import an OBJ file already loaded or mapped in memory
+void ImportObj(const uint8_t* data, size_t size, const MeshVertexLayout& layout,
+               const MeshVertexAllocator& allocateVertices, std::vector<uint32_t>& indices,
+               uint32_t threadCount = 0);
+
+/// Import a binary PLY file already loaded or mapped in memory
+void ImportPly(const uint8_t* data, size_t size, const MeshVertexLayout& layout,
+               const MeshVertexAllocator& allocateVertices, std::vector<uint32_t>& indices,
+               uint32_t threadCount = 0);
+
+/// Import an OBJ or PLY file into an array of vertices having position and color members
+template <class Vertex>
+void ImportMesh(const std::wstring& fileName, std::vector<Vertex>& vertices,
+                std::vector<uint32_t>& indices, uint32_t threadCount = 0)
+{
+  MeshVertexLayout layout = {static_cast<uint32_t>(sizeof(Vertex)),
+                             static_cast<uint32_t>(offsetof(Vertex, position)),
+                             static_cast<int32_t>(offsetof(Vertex, color))};
+  ImportMesh(
+      fileName, layout,
+      [&vertices](size_t vertexCount) {
+        vertices.resize(vertexCount);
+        return static_cast<void*>(vertices.data());
+      },
+      indices, threadCount);
+}
+
+} // namespace nv_helpers_dx12
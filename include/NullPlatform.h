@@ -0,0 +1,26 @@
+#pragma once
+
+#include <utility>
+
+#include "Platform.h"
+
+// Platform of the offline rendering: no window and no input. The clock only
+// advances when told to, so that the frames rendered offline do not depend on
+// how long they took to render
+class NullPlatform : public Platform
+{
+public:
+	explicit NullPlatform(std::wstring executableDirectory) : m_executableDirectory(std::move(executableDirectory)) {}
+
+	std::wstring GetExecutableDirectory() const override { return m_executableDirectory; }
+	void SetWindowTitle(const std::wstring &title) override {}
+	void *GetNativeWindow() const override { return nullptr; }
+	double GetTime() const override { return m_time; }
+
+	// Move the clock forward, typically by the duration of a frame
+	void AdvanceTime(double seconds) { m_time += seconds; }
+
+private:
+	std::wstring m_executableDirectory;
+	double m_time = 0.0;
+};
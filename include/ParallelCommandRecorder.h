@@ -0,0 +1,375 @@
+/*
+The parallel command recorder splits the recording of a frame into passes, each recorded into its
+own command list on a worker thread, for instance one pass for the bottom-level refits, one for the
+top-level build and one for the dispatch and the copy to the back buffer. Recording is then no
+longer limited by a single thread, which matters when thousands of dynamic BLAS refits have to be
+recorded every frame.
+
+The command lists are recorded in any order, but always submitted in the order the passes were
+added, since the barriers captured by each pass are resolved in that order. The recorded lists
+are submitted in batches from the calling thread, while the workers keep recording the next
+passes. The workers are created once and kept for the following frames, and a frame with only a
+few passes is recorded on the calling thread, where waking the workers would cost more than
+recording the passes.
+
+The recorder does not depend on the graphics API. The command lists are provided, closed and
+submitted by a CommandListBackend, so that any backend with its own command list type follows the
+same recording path. CommandListPool is the D3D12 backend. When a pass throws, the command lists
+of the passes which were not submitted are returned to the backend, and the error is rethrown.
+
+The passes only record commands. Everything which has to happen in submission order, such as
+resolving the resource states with a ResourceStateTracker or allocating from a shared allocator,
+is done while adding the passes, and the pass captures the result.
+
+Example:
+
+nv_helpers_dx12::ParallelCommandRecorder<ID3D12GraphicsCommandList4> recorder;
+std::vector<D3D12_RESOURCE_BARRIER> barriers;
+stateTracker.Transition(output, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+stateTracker.Flush(barriers);
+
+recorder.AddPass([&](ID3D12GraphicsCommandList4* commandList) {
+  commandList->ResourceBarrier(static_cast<UINT>(barriers.size()), barriers.data());
+  commandList->DispatchRays(&desc);
+});
+recorder.AddPass([&](ID3D12GraphicsCommandList4* commandList) { ... });
+
+// Records the passes on worker threads, and submits them through the pool
+recorder.Execute(commandListPool);
+recorder.Clear();
+
+*/
+
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace nv_helpers_dx12
+{
+
+/// Provider of the command lists recorded by the passes, and submission of the recorded lists
+template <class CommandList>
+class CommandListBackend
+{
+public:
+  virtual ~CommandListBackend() = default;
+
+  /// Get a command list ready to be recorded. Called concurrently by the worker threads
+  virtual CommandList* BeginCommandList() = 0;
+  /// Close a recorded command list. Called concurrently by the worker threads
+  virtual void EndCommandList(CommandList* commandList) = 0;
+  /// Submit recorded command lists, which execute in the given order after all the lists
+  /// submitted before. Only called by the thread running ParallelCommandRecorder::Execute
+  virtual void Submit(CommandList* const* commandLists, uint32_t count) = 0;
+  /// Take back a command list which will not be submitted, whether it was ended or not, after a
+  /// pass has thrown. Must not throw. Called concurrently by the worker threads
+  virtual void AbortCommandList(CommandList* commandList) = 0;
+};
+
+/// Recorder of passes on persistent worker threads, submitted in the order they were added
+template <class CommandList>
+class ParallelCommandRecorder
+{
+public:
+  using RecordFunction = std::function<void(CommandList*)>;
+
+  /// Below this number of passes, the passes are recorded on the calling thread
+  static constexpr uint32_t kMinParallelPassCount = 8;
+
+  ParallelCommandRecorder() = default;
+  ~ParallelCommandRecorder() { StopWorkers(); }
+
+  ParallelCommandRecorder(const ParallelCommandRecorder&) = delete;
+  ParallelCommandRecorder& operator=(const ParallelCommandRecorder&) = delete;
+
+  /// Add a pass, submitted after all the passes added before it. Returns its index
+  uint32_t AddPass(RecordFunction record);
+
+  /// Record all the passes on up to threadCount worker threads, 0 using one thread per core, and
+  /// submit them through the backend in the order they were added. Returns once all the passes
+  /// have been submitted. An exception thrown by a pass is rethrown on the calling thread, the
+  /// remaining passes being neither recorded nor submitted
+  void Execute(CommandListBackend<CommandList>& backend, uint32_t threadCount = 0);
+
+  /// Remove all the passes, typically once the frame has been submitted
+  void Clear() { m_passes.clear(); }
+
+  uint32_t GetPassCount() const { return static_cast<uint32_t>(m_passes.size()); }
+
+private:
+  struct Pass
+  {
+    RecordFunction record;
+    CommandList* commandList = nullptr;
+    bool recorded = false;
+  };
+
+  /// Record the passes on the calling thread, and submit them in a single batch
+  void ExecuteInline(CommandListBackend<CommandList>& backend);
+  /// Record a pass into a command list of the backend, returning the list to the backend if the
+  /// pass throws
+  static CommandList* RecordPass(CommandListBackend<CommandList>& backend, Pass& pass);
+  /// Take the passes of the current Execute call and record them, until StopWorkers is called
+  void RunWorker();
+  /// Create the worker threads, or recreate them if their number changed
+  void StartWorkers(uint32_t workerCount);
+  void StopWorkers();
+
+  std::vector<Pass> m_passes;
+
+  std::vector<std::thread> m_workers;
+  /// Protects the state shared with the workers below
+  std::mutex m_mutex;
+  /// Signaled when passes are available to the workers, or when they have to stop
+  std::condition_variable m_workCondition;
+  /// Signaled when a worker has recorded a pass
+  std::condition_variable m_recordedCondition;
+  /// Backend of the current Execute call, null between calls
+  CommandListBackend<CommandList>* m_backend = nullptr;
+  /// Index of the next pass to record, and number of passes of the current Execute call
+  size_t m_nextPass = 0;
+  size_t m_executedPassCount = 0;
+  /// Number of workers recording a pass
+  uint32_t m_busyWorkerCount = 0;
+  std::exception_ptr m_error;
+  bool m_stopping = false;
+};
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+template <class CommandList>
+uint32_t ParallelCommandRecorder<CommandList>::AddPass(RecordFunction record)
+{
+  Pass pass;
+  pass.record = std::move(record);
+  m_passes.push_back(std::move(pass));
+  return static_cast<uint32_t>(m_passes.size() - 1);
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// The workers take the passes in the order they were added, so that the first passes to submit are
+// recorded first. The calling thread submits, in a single batch, the recorded passes following the
+// last submitted one, and waits for the workers in between
+template <class CommandList>
+void ParallelCommandRecorder<CommandList>::Execute(CommandListBackend<CommandList>& backend,
+                                                   uint32_t threadCount)
+{
+  const size_t passCount = m_passes.size();
+  if (threadCount == 0)
+  {
+    threadCount = std::thread::hardware_concurrency();
+  }
+  if (passCount < kMinParallelPassCount || threadCount <= 1)
+  {
+    ExecuteInline(backend);
+    return;
+  }
+  StartWorkers(threadCount);
+
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_backend = &backend;
+    m_nextPass = 0;
+    m_executedPassCount = passCount;
+    m_error = nullptr;
+  }
+  m_workCondition.notify_all();
+
+  size_t submittedCount = 0;
+  std::vector<CommandList*> batch;
+  std::unique_lock<std::mutex> lock(m_mutex);
+  while (submittedCount < passCount && !m_error)
+  {
+    batch.clear();
+    for (size_t i = submittedCount; i < passCount && m_passes[i].recorded; i++)
+    {
+      batch.push_back(m_passes[i].commandList);
+    }
+    if (batch.empty())
+    {
+      m_recordedCondition.wait(lock);
+      continue;
+    }
+    lock.unlock();
+    try
+    {
+      backend.Submit(batch.data(), static_cast<uint32_t>(batch.size()));
+      submittedCount += batch.size();
+    }
+    catch (...)
+    {
+      lock.lock();
+      m_error = m_error ? m_error : std::current_exception();
+      m_nextPass = passCount;
+      break;
+    }
+    lock.lock();
+  }
+
+  // The workers may still be recording passes after an error, and no longer access the passes
+  // once they are all idle
+  m_recordedCondition.wait(lock, [&]() { return m_busyWorkerCount == 0; });
+  std::exception_ptr error = m_error;
+  m_backend = nullptr;
+  m_executedPassCount = 0;
+  m_error = nullptr;
+  lock.unlock();
+
+  if (error)
+  {
+    for (size_t i = submittedCount; i < passCount; i++)
+    {
+      if (m_passes[i].recorded)
+      {
+        backend.AbortCommandList(m_passes[i].commandList);
+        m_passes[i].recorded = false;
+      }
+    }
+    std::rethrow_exception(error);
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Record the passes in order on the calling thread. A single submission keeps the cost of the
+// small frames to the recording itself
+template <class CommandList>
+void ParallelCommandRecorder<CommandList>::ExecuteInline(CommandListBackend<CommandList>& backend)
+{
+  std::vector<CommandList*> commandLists;
+  commandLists.reserve(m_passes.size());
+  try
+  {
+    for (Pass& pass : m_passes)
+    {
+      commandLists.push_back(RecordPass(backend, pass));
+    }
+    if (!commandLists.empty())
+    {
+      backend.Submit(commandLists.data(), static_cast<uint32_t>(commandLists.size()));
+    }
+  }
+  catch (...)
+  {
+    for (CommandList* commandList : commandLists)
+    {
+      backend.AbortCommandList(commandList);
+    }
+    throw;
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+template <class CommandList>
+CommandList* ParallelCommandRecorder<CommandList>::RecordPass(
+    CommandListBackend<CommandList>& backend, Pass& pass)
+{
+  CommandList* commandList = backend.BeginCommandList();
+  try
+  {
+    pass.record(commandList);
+    backend.EndCommandList(commandList);
+  }
+  catch (...)
+  {
+    backend.AbortCommandList(commandList);
+    throw;
+  }
+  return commandList;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// A worker only takes a pass while an Execute call is running, and the first error stops the
+// distribution of the remaining passes
+template <class CommandList>
+void ParallelCommandRecorder<CommandList>::RunWorker()
+{
+  std::unique_lock<std::mutex> lock(m_mutex);
+  while (true)
+  {
+    m_workCondition.wait(lock,
+                         [this]() { return m_stopping || m_nextPass < m_executedPassCount; });
+    if (m_stopping)
+    {
+      return;
+    }
+    Pass& pass = m_passes[m_nextPass++];
+    CommandListBackend<CommandList>& backend = *m_backend;
+    m_busyWorkerCount++;
+    lock.unlock();
+
+    CommandList* commandList = nullptr;
+    std::exception_ptr error;
+    try
+    {
+      commandList = RecordPass(backend, pass);
+    }
+    catch (...)
+    {
+      error = std::current_exception();
+    }
+
+    lock.lock();
+    if (error)
+    {
+      m_error = m_error ? m_error : error;
+      m_nextPass = m_executedPassCount;
+    }
+    else
+    {
+      pass.commandList = commandList;
+      pass.recorded = true;
+    }
+    m_busyWorkerCount--;
+    m_recordedCondition.notify_one();
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+template <class CommandList>
+void ParallelCommandRecorder<CommandList>::StartWorkers(uint32_t workerCount)
+{
+  if (m_workers.size() == workerCount)
+  {
+    return;
+  }
+  StopWorkers();
+  for (uint32_t i = 0; i < workerCount; i++)
+  {
+    m_workers.emplace_back(&ParallelCommandRecorder::RunWorker, this);
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+template <class CommandList>
+void ParallelCommandRecorder<CommandList>::StopWorkers()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stopping = true;
+  }
+  m_workCondition.notify_all();
+  for (std::thread& worker : m_workers)
+  {
+    worker.join();
+  }
+  m_workers.clear();
+  m_stopping = false;
+}
+
+} // namespace nv_helpers_dx12
@@ -0,0 +1,138 @@
+/*
+The placed resource allocator creates buffers as placed resources within a few large ID3D12Heap,
+instead of one committed resource each. Creating a committed resource makes the driver allocate
+and map memory for every buffer, each of them being at least 64 KB: with thousands of bottom-level
+acceleration structures, their scratch buffers and the instance descriptors, this adds up to
+thousands of kernel calls at load time and a lot of wasted memory. Placed resources only bind a
+range of an existing heap.
+
+The heaps are grouped by heap type and by alignment class, each group being a HeapSuballocator
+whose pages are heaps of the same size. The ranges are managed by a buddy allocator, see
+HeapSuballocator.h. Buffers larger than a heap are created as committed resources.
+
+The placement alignment of buffers is 64 KB, and the buddy allocator rounds the ranges up to a
+power of two: placing buffers saves the kernel calls of the committed resources, but not the
+memory of small buffers, which would need to share a single buffer.
+
+A buffer is returned to the allocator with Free, along with the fence value after which the GPU no
+longer uses it. Its reference is released and its range reused by Reclaim, once that value has
+been reached, like the UploadRingAllocator. Buffers which are not freed stay allocated until the
+allocator is destroyed.
+
+Example:
+
+nv_helpers_dx12::PlacedResourceAllocator allocator;
+allocator.Initialize(m_device.Get());
+
+// The returned buffer holds a reference owned by the caller
+ComPtr<ID3D12Resource> scratch;
+scratch.Attach(allocator.CreateBuffer(scratchSizeInBytes,
+                                      D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS,
+                                      D3D12_RESOURCE_STATE_COMMON, D3D12_HEAP_TYPE_DEFAULT));
+...
+// The scratch buffer is no longer needed once the frame has completed
+allocator.Free(scratch.Detach(), frameRing.GetFrameFenceValue());
+
+// Each frame, reuse the ranges of the buffers whose frames have completed
+allocator.Reclaim(frameRing.GetCompletedFenceValue());
+
+*/
+
+#pragma once
+
+#include "d3d12.h"
+#include "HeapSuballocator.h"
+
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace nv_helpers_dx12
+{
+
+/// Allocator of buffers placed in large heaps
+class PlacedResourceAllocator
+{
+public:
+  PlacedResourceAllocator() = default;
+  ~PlacedResourceAllocator();
+
+  PlacedResourceAllocator(const PlacedResourceAllocator&) = delete;
+  PlacedResourceAllocator& operator=(const PlacedResourceAllocator&) = delete;
+
+  /// Set the device and the size of the heaps, which must be a power of two
+  void Initialize(ID3D12Device* device, uint64_t heapSize = 64ull * 1024 * 1024);
+
+  /// Create a buffer in a heap of the given type. The returned buffer holds a reference owned by
+  /// the caller. Throws std::logic_error if the heap or the buffer cannot be created
+  ID3D12Resource* CreateBuffer(uint64_t size, D3D12_RESOURCE_FLAGS flags,
+                               D3D12_RESOURCE_STATES initState, D3D12_HEAP_TYPE heapType);
+
+  /// Release a buffer once the GPU has reached the fence value. The reference held by the caller
+  /// is transferred to the allocator. Buffers which were not created by the allocator, such as
+  /// committed buffers, are accepted and only released
+  void Free(ID3D12Resource* buffer, uint64_t fenceValue);
+
+  /// Release the freed buffers whose fence value is lower or equal to the completed value, reuse
+  /// their ranges, and release the heaps left empty
+  void Reclaim(uint64_t completedFenceValue);
+
+  /// Number of heaps created, over all the heap types and alignment classes
+  uint32_t GetHeapCount() const;
+  /// Number of buffers placed in the heaps, including the freed ones not reclaimed yet
+  uint32_t GetPlacedBufferCount() const { return static_cast<uint32_t>(m_buffers.size()); }
+
+private:
+  /// Suballocator whose pages are heaps of a given type
+  class HeapPool : public HeapSuballocator
+  {
+  public:
+    HeapPool(ID3D12Device* device, D3D12_HEAP_TYPE heapType, uint64_t heapSize,
+             uint64_t alignment);
+    ~HeapPool() override;
+
+    ID3D12Heap* GetHeap(uint32_t page) const { return m_heaps[page]; }
+
+  protected:
+    void CreatePage(uint32_t page) override;
+    void DestroyPage(uint32_t page) override;
+
+  private:
+    ID3D12Device* m_device;
+    D3D12_HEAP_TYPE m_heapType;
+    uint64_t m_alignment;
+    std::vector<ID3D12Heap*> m_heaps;
+  };
+
+  /// Heap range occupied by a placed buffer
+  struct PlacedBuffer
+  {
+    HeapPool* pool;
+    HeapSuballocator::Allocation allocation;
+  };
+
+  /// Buffer freed by the caller, and the fence value after which the GPU no longer uses it
+  struct FreedBuffer
+  {
+    ID3D12Resource* resource;
+    uint64_t fenceValue;
+  };
+
+  /// Get the pool of heaps of a type and alignment class, creating it if needed
+  HeapPool& GetPool(D3D12_HEAP_TYPE heapType, uint64_t alignment);
+
+  void Release();
+
+  ID3D12Device* m_device = nullptr;
+  uint64_t m_heapSize = 0;
+  std::map<std::pair<D3D12_HEAP_TYPE, uint64_t>, std::unique_ptr<HeapPool>> m_pools;
+  /// Ranges of the placed buffers, by buffer
+  std::unordered_map<ID3D12Resource*, PlacedBuffer> m_buffers;
+  /// Freed buffers, in increasing order of fence values
+  std::deque<FreedBuffer> m_freedBuffers;
+};
+} // namespace nv_helpers_dx12
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Key codes of the input events. Letters and digits use their upper-case
+// ASCII code, as the Win32 virtual keys do
+namespace Key
+{
+	constexpr uint8_t Escape = 0x1B;
+	constexpr uint8_t Space = 0x20;
+	constexpr uint8_t A = 'A';
+	constexpr uint8_t D = 'D';
+	constexpr uint8_t M = 'M';
+	constexpr uint8_t S = 'S';
+	constexpr uint8_t W = 'W';
+}
+
+// Mouse buttons held during a mouse event, combined as flags
+namespace MouseButton
+{
+	constexpr uint32_t Left = 1;
+	constexpr uint32_t Right = 2;
+	constexpr uint32_t Middle = 4;
+}
+
+// Services of the operating system used by the pipeline: the file system, the
+// window, and a high-resolution clock. The input events are translated by the
+// application into the key codes and mouse buttons above before reaching the
+// pipeline. Win32Platform backs the windowed application, NullPlatform the
+// offline rendering, and PosixPlatform the tools running on Linux
+class Platform
+{
+public:
+	virtual ~Platform() = default;
+
+	// Directory containing the executable, ending with a path separator. The
+	// assets are looked up from there
+	virtual std::wstring GetExecutableDirectory() const = 0;
+
+	// Set the title of the window, if any
+	virtual void SetWindowTitle(const std::wstring &title) = 0;
+	// Native handle of the window, such as the HWND on Windows, or nullptr if
+	// there is no window
+	virtual void *GetNativeWindow() const = 0;
+
+	// Time in seconds since an arbitrary origin, from a monotonic
+	// high-resolution clock
+	virtual double GetTime() const = 0;
+};
+
+// Services of the file system, used by the pipeline and the helpers on every
+// platform, as the offline rendering reads and writes the same files as the
+// windowed application. They are implemented with the native API in
+// Win32Platform.cpp and PosixPlatform.cpp. The paths may use '/' on all the
+// platforms. On POSIX systems the wide strings hold UTF-32, and the file names
+// are UTF-8 whatever the locale
+namespace FileSystem
+{
+	// Read-only view of a whole file mapped in memory
+	struct FileMapping
+	{
+		const uint8_t *data = nullptr;
+		uint64_t size = 0;
+		// Native object backing the mapping, if the platform needs one
+		void *handle = nullptr;
+	};
+
+	// Map a whole file in memory. Returns false if the file does not exist, is
+	// empty or cannot be mapped, in which case the mapping stays empty
+	bool MapFile(const std::wstring &fileName, FileMapping &mapping);
+	// Unmap the file and reset the mapping
+	void UnmapFile(FileMapping &mapping);
+
+	// Open a file with the modes of fopen, or return nullptr on failure
+	std::FILE *OpenFile(const std::wstring &fileName, const char *mode);
+	// Rename a file, replacing any existing file of the new name in one step
+	bool RenameFile(const std::wstring &fileName, const std::wstring &newFileName);
+	bool RemoveFile(const std::wstring &fileName);
+	// Absolute path without "." or ".." components, the path being relative to
+	// the current directory. The path is not required to exist. Returns the
+	// input path on failure
+	std::wstring GetAbsolutePath(const std::wstring &path);
+	// Create a directory and its missing parents. Returns true if the directory
+	// exists afterwards
+	bool CreateDirectories(const std::wstring &directory);
+
+	// Watch of the files modified in a directory and its subdirectories
+	struct DirectoryWatch;
+	// Start watching a directory, or return nullptr on failure
+	DirectoryWatch *OpenDirectoryWatch(const std::wstring &directory);
+	// Block until files are modified, and append their paths relative to the
+	// watched directory to modifiedFiles. overflow is set when the changes were
+	// too many to be tracked individually. Returns false once the watch is
+	// cancelled, or on failure
+	bool WaitForDirectoryChanges(DirectoryWatch *watch, std::vector<std::wstring> &modifiedFiles, bool &overflow);
+	// Wake up WaitForDirectoryChanges for good, from any thread
+	void CancelDirectoryWatch(DirectoryWatch *watch);
+	// Stop watching, once no thread waits for the changes anymore
+	void CloseDirectoryWatch(DirectoryWatch *watch);
+}
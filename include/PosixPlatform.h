@@ -0,0 +1,19 @@
+#pragma once
+
+#include "Platform.h"
+
+// Platform of the tools running on Linux and other POSIX systems. There is no
+// window, the title is only kept for the logs
+class PosixPlatform : public Platform
+{
+public:
+	std::wstring GetExecutableDirectory() const override;
+	void SetWindowTitle(const std::wstring &title) override { m_title = title; }
+	void *GetNativeWindow() const override { return nullptr; }
+	double GetTime() const override;
+
+	const std::wstring &GetWindowTitle() const { return m_title; }
+
+private:
+	std::wstring m_title;
+};
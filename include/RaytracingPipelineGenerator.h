@@ -57,6 +57,28 @@ pipeline.SetMaxRecursionDepth(1);
 
 rtStateObject = pipeline.Generate();
 
+Pipeline creation time grows with the number of shaders. To avoid compiling everything again when
+a material is added, the hit groups of each material can be compiled once as a collection, using a
+separate generator with the same payload, attribute and recursion settings. A collection is
+self-contained: the hit group, its shaders and their root signature associations all have to be
+defined in the same collection.
+
+nv_helpers_dx12::RayTracingPipelineGenerator material(m_device.Get());
+material.AddLibrary(m_hitLibrary.Get(), {L"ClosestHit"});
+material.AddHitGroup(L"HitGroup", L"ClosestHit");
+material.AddRootSignatureAssociation(m_hitSignature.Get(), {L"HitGroup"});
+material.SetMaxPayloadSize(4 * sizeof(float));
+materialCollection = material.GenerateCollection();
+
+pipeline.AddCollection(materialCollection.Get());
+rtStateObject = pipeline.Generate();
+
+When the pipeline and its collections are generated after SetAllowStateObjectAdditions(true), on
+devices supporting raytracing tier 1.1, materials streamed in later can be appended without
+recreating the pipeline: a generator holding only the new collections or hit groups creates the
+extended state object using AddToStateObject(rtStateObject.Get()). The existing state object
+remains valid, so it can be released once the frames using it have completed.
+
 */
 
 #pragma once
@@ -67,6 +89,7 @@ rtStateObject = pipeline.Generate();
 
 #include <string>
 #include <vector>
+#include <wrl/client.h>
 
 namespace nv_helpers_dx12
 {
@@ -119,9 +142,29 @@ public:
   /// algorithms must be flattened to a loop in the ray generation program for best performance.
   void SetMaxRecursionDepth(UINT maxDepth);
 
+  /// Link a collection created by GenerateCollection into the pipeline. Its shaders are not
+  /// compiled again. By default all the symbols of the collection are exported to the pipeline,
+  /// otherwise only the listed ones are.
+  void AddCollection(ID3D12StateObject* collection,
+                     const std::vector<std::wstring>& symbolExports = {});
+
+  /// Allow the generated state objects to be extended later by AddToStateObject. This requires
+  /// raytracing tier 1.1, and must be set identically on a pipeline and on its collections.
+  void SetAllowStateObjectAdditions(bool allow);
+
   /// Compiles the raytracing state object
   ID3D12StateObject* Generate();
 
+  /// Compiles the libraries, hit groups and associations into a collection, to be linked into
+  /// pipelines using AddCollection
+  ID3D12StateObject* GenerateCollection();
+
+  /// Create a new state object containing the existing one plus the libraries, hit groups and
+  /// collections of this generator. Only the additions are compiled, and the existing state object
+  /// is left untouched. The existing state object must have been generated with additions allowed.
+  /// Throws std::logic_error if the device does not support additions
+  ID3D12StateObject* AddToStateObject(ID3D12StateObject* existing);
+
 private:
   /// Storage for DXIL libraries and their exported symbols
   struct Library
@@ -137,6 +180,20 @@ private:
     D3D12_DXIL_LIBRARY_DESC m_libDesc;
   };
 
+  /// Storage for existing collections and the symbols they export to the pipeline
+  struct Collection
+  {
+    Collection(ID3D12StateObject* collection, const std::vector<std::wstring>& exportedSymbols);
+
+    Collection(const Collection& source);
+
+    ID3D12StateObject* m_collection;
+    const std::vector<std::wstring> m_exportedSymbols;
+
+    std::vector<D3D12_EXPORT_DESC> m_exports;
+    D3D12_EXISTING_COLLECTION_DESC m_desc = {};
+  };
+
   /// Storage for the hit groups, binding the hit group name with the underlying intersection, any
   /// hit and closest hit symbols
   struct HitGroup
@@ -172,11 +229,16 @@ private:
   /// we systematically create both
   void CreateDummyRootSignatures();
 
+  /// Build the subobjects and create a state object of the given type, or add them to an existing
+  /// state object if not null
+  ID3D12StateObject* CreateStateObject(D3D12_STATE_OBJECT_TYPE type, ID3D12StateObject* existing);
+
   /// Build a list containing the export symbols for the ray generation shaders, miss shaders, and
   /// hit group names
   void BuildShaderExportList(std::vector<std::wstring>& exportedSymbols);
 
   std::vector<Library> m_libraries = {};
+  std::vector<Collection> m_collections = {};
   std::vector<HitGroup> m_hitGroups = {};
   std::vector<RootSignatureAssociation> m_rootSignatureAssociations = {};
 
@@ -186,10 +248,12 @@ private:
   UINT m_maxAttributeSizeInBytes = 2 * sizeof(float);
   /// Maximum recursion depth, initialized to 1 to at least allow tracing primary rays
   UINT m_maxRecursionDepth = 1;
+  bool m_allowStateObjectAdditions = false;
 
   ID3D12Device5* m_device;
-  ID3D12RootSignature* m_dummyLocalRootSignature;
-  ID3D12RootSignature* m_dummyGlobalRootSignature;
+  /// Empty root signatures shared through the RootSignatureCache, holding a reference each
+  Microsoft::WRL::ComPtr<ID3D12RootSignature> m_dummyLocalRootSignature;
+  Microsoft::WRL::ComPtr<ID3D12RootSignature> m_dummyGlobalRootSignature;
 
   
 };
@@ -0,0 +1,101 @@
+/*
+The resource state tracker records the current state of each resource used by the application, so
+that the code using a resource only states the state it needs, instead of writing the before and
+after states of each transition by hand. The barriers are not recorded right away: they are
+queued, and Flush emits all the pending ones in a single ResourceBarrier call before the next use
+of the resources. Batching the barriers lets the GPU resolve all of them at once, instead of
+draining its work at each of them.
+
+While queued, the barriers are simplified:
+- Successive transitions of the same resource are merged into a single one, and removed if the
+  resource returns to its state.
+- A transition to a read state already included in the current combined read state is skipped.
+- UAV barriers on the same resource are only queued once. Several UAV barriers are emitted as a
+  single barrier on all the unordered accesses, so that independent writes, such as the builds of
+  the bottom-level acceleration structures, are all waited upon at once, only before the first
+  command reading them.
+
+The tracked state is the state at the end of the commands recorded so far, over all the command
+lists using the tracker, which must be executed in the order they were recorded. The transitions
+apply to all the subresources. The tracker is not thread-safe: when recording on several threads,
+the barriers are flushed into lists on one thread, and recorded by the passes of the
+ParallelCommandRecorder.
+
+Example:
+
+nv_helpers_dx12::ResourceStateTracker stateTracker;
+stateTracker.SetState(m_outputResource.Get(), D3D12_RESOURCE_STATE_COPY_SOURCE);
+stateTracker.SetState(m_renderTargets[n].Get(), D3D12_RESOURCE_STATE_PRESENT);
+
+// Each frame
+stateTracker.Transition(m_outputResource.Get(), D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+stateTracker.Flush(m_commandList.Get());
+m_commandList->DispatchRays(&desc);
+
+stateTracker.Transition(m_outputResource.Get(), D3D12_RESOURCE_STATE_COPY_SOURCE);
+stateTracker.Transition(m_renderTargets[m_frameIndex].Get(), D3D12_RESOURCE_STATE_COPY_DEST);
+stateTracker.Flush(m_commandList.Get());
+m_commandList->CopyResource(m_renderTargets[m_frameIndex].Get(), m_outputResource.Get());
+
+*/
+
+#pragma once
+
+#include "d3d12.h"
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace nv_helpers_dx12
+{
+
+/// Tracker of the resource states, emitting the required barriers in batches
+class ResourceStateTracker
+{
+public:
+  /// Start tracking a resource, or override its tracked state, typically with the state in which
+  /// it was created
+  void SetState(ID3D12Resource* resource, D3D12_RESOURCE_STATES state);
+
+  /// Tracked state of a resource, including the pending transitions. Throws std::logic_error if
+  /// the resource is not tracked
+  D3D12_RESOURCE_STATES GetState(ID3D12Resource* resource) const;
+
+  /// Stop tracking a resource, before it is released
+  void Forget(ID3D12Resource* resource);
+
+  /// Queue the transition of a resource to a state, if it is not already in that state. Throws
+  /// std::logic_error if the resource is not tracked
+  void Transition(ID3D12Resource* resource, D3D12_RESOURCE_STATES state);
+
+  /// Queue a UAV barrier, waiting for the unordered accesses to a resource to complete before the
+  /// next commands access it. A null resource waits for all the unordered accesses
+  void UAVBarrier(ID3D12Resource* resource = nullptr);
+
+  /// Record all the pending barriers on the command list in a single call
+  void Flush(ID3D12GraphicsCommandList* commandList);
+  /// Append all the pending barriers to a list, to be recorded later. This lets the states be
+  /// resolved in submission order on one thread while the command lists are recorded on others,
+  /// each list recording the barriers flushed for it, as long as the lists are executed in the
+  /// order of the flushes
+  void Flush(std::vector<D3D12_RESOURCE_BARRIER>& barriers);
+
+  /// Number of barriers which would be recorded by the next flush
+  uint32_t GetPendingBarrierCount() const;
+
+private:
+  /// State of the resources after the commands recorded so far and the pending barriers
+  std::unordered_map<ID3D12Resource*, D3D12_RESOURCE_STATES> m_states;
+
+  /// Transitions waiting for the next flush, at most one per resource
+  std::vector<D3D12_RESOURCE_BARRIER> m_pendingTransitions;
+  /// Resources of the UAV barriers waiting for the next flush
+  std::vector<ID3D12Resource*> m_pendingUAVBarriers;
+  /// True if a UAV barrier on all the unordered accesses is pending
+  bool m_pendingGlobalUAVBarrier = false;
+
+  /// Barriers of the last flush, kept to avoid reallocating them
+  std::vector<D3D12_RESOURCE_BARRIER> m_barriers;
+};
+} // namespace nv_helpers_dx12
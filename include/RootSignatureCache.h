@@ -0,0 +1,126 @@
+/*
+The root signature cache avoids serializing and creating the same root signature over and over.
+Root signatures are keyed on a canonical hash of their description: the flags, the parameters with
+their ranges, and the static samplers. Only the values are hashed, never the pointers of the
+description, so two independently built descriptions of the same signature share the same entry.
+Pipeline rebuilds during shader iteration, as well as pipeline variants using the same signatures,
+then get the existing root signature object instead of paying the serialization again.
+
+Version 1.1 descriptions are serialized with version 1.1 on devices supporting it, and converted
+to version 1.0 otherwise. The highest version supported by the device is part of the key.
+
+The cache is process-wide, and safe to use from several threads. Serialized root signatures do
+not depend on the device, so they can also be persisted on disk: once a directory is set, each
+serialized blob is written to a file named after its key, and a later run creates the root
+signature directly from that file without calling D3D12SerializeRootSignature.
+
+RootSignatureGenerator::Generate and RayTracingPipelineGenerator go through the cache, so using
+them is enough to benefit from it.
+
+Example:
+
+nv_helpers_dx12::RootSignatureCache::Get().SetDirectory(GetAssetFullPath(L"cache"));
+
+D3D12_ROOT_SIGNATURE_DESC rootDesc = {};
+rootDesc.Flags = D3D12_ROOT_SIGNATURE_FLAG_LOCAL_ROOT_SIGNATURE;
+// The returned signature holds a reference owned by the caller
+ID3D12RootSignature* rootSignature =
+    nv_helpers_dx12::RootSignatureCache::Get().GetOrCreate(m_device.Get(), rootDesc);
+
+*/
+
+#pragma once
+
+#include "d3d12.h"
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace nv_helpers_dx12
+{
+
+/// Process-wide cache of serialized and created root signatures
+class RootSignatureCache
+{
+public:
+  /// Get the cache shared by the whole process
+  static RootSignatureCache& Get();
+
+  RootSignatureCache() = default;
+  ~RootSignatureCache();
+
+  RootSignatureCache(const RootSignatureCache&) = delete;
+  RootSignatureCache& operator=(const RootSignatureCache&) = delete;
+
+  /// Set the directory in which the serialized root signatures are stored. The directory is
+  /// created if it does not exist. Nothing is read from or written to disk as long as no directory
+  /// is set
+  void SetDirectory(const std::wstring& directory);
+
+  /// Compute the canonical hash of a root signature description, serialized with at most the given
+  /// root signature version
+  static uint64_t ComputeKey(const D3D12_VERSIONED_ROOT_SIGNATURE_DESC& desc,
+                             D3D_ROOT_SIGNATURE_VERSION maxVersion);
+
+  /// Return the root signature matching the description, serializing and creating it only if it
+  /// is not already in the cache. The returned pointer holds a reference owned by the caller.
+  /// Throws std::logic_error if the signature cannot be serialized or created
+  ID3D12RootSignature* GetOrCreate(ID3D12Device* device,
+                                   const D3D12_VERSIONED_ROOT_SIGNATURE_DESC& desc);
+
+  /// Return the root signature matching a version 1.0 description
+  ID3D12RootSignature* GetOrCreate(ID3D12Device* device, const D3D12_ROOT_SIGNATURE_DESC& desc);
+
+  /// Release all the cached root signatures. The files on disk are kept
+  void Clear();
+
+  /// Number of calls which returned an existing root signature
+  uint32_t GetHitCount() const { return m_hitCount; }
+  /// Number of calls which had to create the root signature, whether the serialized blob was
+  /// loaded from disk or not
+  uint32_t GetMissCount() const { return m_missCount; }
+  /// Number of root signatures actually serialized
+  uint32_t GetSerializeCount() const { return m_serializeCount; }
+
+private:
+  /// Header at the beginning of each cache file
+  struct FileHeader
+  {
+    uint32_t magic;    /// Always kFileMagic
+    uint32_t version;  /// Always kFileVersion, bumped whenever the layout changes
+    uint64_t key;      /// Key of the stored root signature, checked against the file name
+    uint64_t blobSize; /// Size of the serialized root signature, which follows the header
+  };
+
+  static constexpr uint32_t kFileMagic = 0x53525844; // "DXRS"
+  static constexpr uint32_t kFileVersion = 1;
+
+  /// Serialized root signature, and the root signature created from it on the last device used
+  struct Entry
+  {
+    std::vector<uint8_t> blob;
+    ID3D12Device* device = nullptr;
+    ID3D12RootSignature* rootSignature = nullptr;
+  };
+
+  /// Fill the blob of an entry, from disk if available, and by serializing the description
+  /// otherwise
+  void LoadOrSerialize(uint64_t key, const D3D12_VERSIONED_ROOT_SIGNATURE_DESC& desc,
+                       D3D_ROOT_SIGNATURE_VERSION maxVersion, Entry& entry);
+
+  std::wstring GetFileName(uint64_t key) const;
+
+  std::mutex m_mutex;
+  std::wstring m_directory;
+  std::unordered_map<uint64_t, Entry> m_entries;
+
+  /// Updated under the lock, but read without it
+  std::atomic<uint32_t> m_hitCount = {0};
+  std::atomic<uint32_t> m_missCount = {0};
+  std::atomic<uint32_t> m_serializeCount = {0};
+};
+} // namespace nv_helpers_dx12
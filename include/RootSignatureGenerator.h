@@ -48,12 +48,34 @@ rsc.AddRangeParameter({{0,1,0, D3D12_DESCRIPTOR_RANGE_TYPE_UAV, 0},
 {0,1,0, D3D12_DESCRIPTOR_RANGE_TYPE_CBV, 2}});
 return rsc.Generate(m_device.Get(), true);
 
+The root signatures are generated with version 1.1 when the device supports it, and converted to
+version 1.0 otherwise. Ranges and root descriptors added without flags keep the version 1.0
+semantics, where both the descriptors and the data they reference are volatile. The version 1.1
+flags can be given explicitly to let the driver promote descriptors and skip copies, along with
+static samplers which do not use any slot of the root signature:
+
+nv_helpers_dx12::RootSignatureGenerator rsc;
+// The SRV and the buffer it references do not change once the table is set
+rsc.AddHeapRangesParameter({{D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 0, 0,
+                             D3D12_DESCRIPTOR_RANGE_FLAG_DATA_STATIC, 0}});
+rsc.AddRootParameter(D3D12_ROOT_PARAMETER_TYPE_CBV, 0, 0, 1,
+                     D3D12_ROOT_DESCRIPTOR_FLAG_DATA_STATIC);
+rsc.AddStaticSampler(CD3DX12_STATIC_SAMPLER_DESC(0, D3D12_FILTER_MIN_MAG_MIP_LINEAR));
+OutputDebugStringA(rsc.GetCostReport().c_str());
+return rsc.Generate(m_device.Get(), true);
+
+A root signature is limited to 64 DWORDs: each descriptor table costs 1 DWORD, each root
+descriptor 2 DWORDs, and each root constant 1 DWORD. GetCost and GetCostReport give the cost of the
+parameters added so far, to help keeping the most frequently changed values in root constants
+while staying within the limit. Generate throws if the limit is exceeded.
+
 */
 
 #pragma once
 
 #include "d3d12.h"
 
+#include <string>
 #include <tuple>
 #include <vector>
 
@@ -63,9 +85,17 @@ namespace nv_helpers_dx12
 class RootSignatureGenerator
 {
 public:
-  /// Add a set of heap range descriptors as a parameter of the root signature.
+  /// Maximum size of a root signature, in DWORDs
+  static const UINT kMaxCost = 64;
+
+  /// Add a set of heap range descriptors as a parameter of the root signature. The descriptors and
+  /// data they reference are considered volatile, as in root signature version 1.0
   void AddHeapRangesParameter(const std::vector<D3D12_DESCRIPTOR_RANGE>& ranges);
 
+  /// Add a set of heap range descriptors as a parameter of the root signature, with their root
+  /// signature version 1.1 flags indicating whether the descriptors and data are static or volatile
+  void AddHeapRangesParameter(const std::vector<D3D12_DESCRIPTOR_RANGE1>& ranges);
+
   /// Add a set of heap ranges as a parameter of the root signature. Each range
   /// is defined as follows:
   /// - UINT BaseShaderRegister: the first register index in the range, e.g. the
@@ -97,19 +127,36 @@ public:
   /// instead of a buffer). The shaderRegister and registerSpace indicate how to access the
   /// parameter in the HLSL code, e.g a SRV with shaderRegister==1 and registerSpace==0 is
   /// accessible via register(t1, space0).
-  /// In case of a root constant, the last parameter indicates how many successive 32-bit constants
-  /// will be bound.
-  void AddRootParameter(D3D12_ROOT_PARAMETER_TYPE type, UINT shaderRegister = 0,
-                        UINT registerSpace = 0, UINT numRootConstants = 1);
-
-  /// Create the root signature from the set of parameters, in the order of the addition calls
+  /// In case of a root constant, numRootConstants indicates how many successive 32-bit constants
+  /// will be bound. For root descriptors, the flags indicate whether the data they reference is
+  /// static or volatile, and default to volatile as in root signature version 1.0
+  void AddRootParameter(
+      D3D12_ROOT_PARAMETER_TYPE type, UINT shaderRegister = 0, UINT registerSpace = 0,
+      UINT numRootConstants = 1,
+      D3D12_ROOT_DESCRIPTOR_FLAGS flags = D3D12_ROOT_DESCRIPTOR_FLAG_DATA_VOLATILE);
+
+  /// Add a sampler embedded in the root signature, which does not use any root signature space
+  void AddStaticSampler(const D3D12_STATIC_SAMPLER_DESC& sampler);
+
+  /// Get the size in DWORDs of the parameters added so far
+  UINT GetCost() const;
+
+  /// Get a human-readable breakdown of the size of the root signature, with the cost of each
+  /// parameter and the total against the 64-DWORD limit
+  std::string GetCostReport() const;
+
+  /// Create the root signature from the set of parameters, in the order of the addition calls.
+  /// Identical root signatures are shared through the RootSignatureCache, and the returned pointer
+  /// holds a reference owned by the caller
   ID3D12RootSignature* Generate(ID3D12Device* device, bool isLocal);
 
 private:
   /// Heap range descriptors
-  std::vector<std::vector<D3D12_DESCRIPTOR_RANGE>> m_ranges;
+  std::vector<std::vector<D3D12_DESCRIPTOR_RANGE1>> m_ranges;
   /// Root parameter descriptors
-  std::vector<D3D12_ROOT_PARAMETER> m_parameters;
+  std::vector<D3D12_ROOT_PARAMETER1> m_parameters;
+  /// Samplers embedded in the root signature
+  std::vector<D3D12_STATIC_SAMPLER_DESC> m_staticSamplers;
 
   /// For each entry of m_parameter, indicate the index of the range array in m_ranges, and ~0u if
   /// the parameter is not a heap range descriptor
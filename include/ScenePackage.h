@@ -0,0 +1,187 @@
+/*
+The scene package is a binary container holding a whole scene in a form directly usable by the
+renderer: vertex buffers in the application vertex layout, 32-bit index buffers, instance
+transforms, material constants and optionally the serialized bottom-level hierarchies of the
+meshes. Source assets are converted once with ScenePackageWriter, and loading a package then
+involves no parsing at all: the file is memory-mapped, and the accessors return pointers into the
+mapping, which can be copied straight into upload buffers.
+
+The file starts with a header, followed by a table of sections. Each section holds one array (the
+mesh descriptors, the vertices of a mesh, the instances...) and starts on a 4096-byte boundary, so
+that sections are page-aligned in the mapping. This also satisfies the alignment of the serialized
+acceleration structures, and of any element type stored in the sections.
+
+Example:
+
+// Conversion
+nv_helpers_dx12::ScenePackageWriter writer;
+uint32_t mesh = writer.AddMesh(vertices.data(), vertices.size(), sizeof(Vertex), indices.data(),
+                               indices.size());
+uint32_t material = writer.AddMaterial(colors);
+writer.AddInstance(mesh, material, transform);
+writer.Write(L"scene.dxsp");
+
+// Loading
+nv_helpers_dx12::ScenePackage package;
+if (package.Open(GetAssetFullPath(L"scene.dxsp")))
+{
+  for (uint32_t i = 0; i < package.GetMeshCount(); i++)
+  {
+    nv_helpers_dx12::ScenePackage::MeshView mesh = package.GetMesh(i);
+    memcpy(mappedVertexBuffer, mesh.vertices, mesh.vertexCount * mesh.vertexStride);
+    ...
+  }
+}
+
+*/
+
+#pragma once
+
+#include "MappedFile.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace nv_helpers_dx12
+{
+
+/// Read-only view of a scene package mapped in memory
+class ScenePackage
+{
+public:
+  /// Description of a mesh, stored in the mesh table
+  struct MeshDesc
+  {
+    uint32_t vertexCount;
+    uint32_t vertexStride; /// Size of a vertex in bytes
+    uint32_t indexCount;   /// Number of 32-bit indices, 0 for non-indexed meshes
+    uint32_t reserved;
+  };
+
+  /// Instance of a mesh, matching an entry of the TLAS
+  struct InstanceDesc
+  {
+    uint32_t meshIndex;
+    uint32_t materialIndex;
+    uint32_t reserved[2];
+    float transform[4][4]; /// Row-major transform, same layout as DirectX::XMFLOAT4X4
+  };
+
+  /// Material constants, matching the Colors constant buffer of the hit shaders
+  struct MaterialDesc
+  {
+    float colors[4][4];
+  };
+
+  /// Pointers to the data of a mesh within the mapping
+  struct MeshView
+  {
+    const void* vertices;
+    uint32_t vertexCount;
+    uint32_t vertexStride;
+    const uint32_t* indices; /// nullptr for non-indexed meshes
+    uint32_t indexCount;
+    const void* bvh; /// Serialized bottom-level AS, or nullptr if the package does not have one
+    uint64_t bvhSize;
+  };
+
+  ScenePackage() = default;
+  ScenePackage(const ScenePackage&) = delete;
+  ScenePackage& operator=(const ScenePackage&) = delete;
+
+  /// Map a package and validate its layout. Returns false if the file cannot be opened, and throws
+  /// std::logic_error if it is not a valid package
+  bool Open(const std::wstring& fileName);
+
+  /// Unmap the package. All the pointers returned by the accessors become invalid
+  void Close();
+
+  uint32_t GetMeshCount() const { return static_cast<uint32_t>(m_meshes.size()); }
+  MeshView GetMesh(uint32_t index) const { return m_meshes[index]; }
+
+  uint32_t GetInstanceCount() const { return m_instanceCount; }
+  const InstanceDesc* GetInstances() const { return m_instances; }
+
+  uint32_t GetMaterialCount() const { return m_materialCount; }
+  const MaterialDesc* GetMaterials() const { return m_materials; }
+
+private:
+  friend class ScenePackageWriter;
+
+  enum class SectionType : uint32_t
+  {
+    Meshes = 1,    /// Array of MeshDesc
+    Vertices = 2,  /// Vertices of the mesh given by the section index
+    Indices = 3,   /// Indices of the mesh given by the section index
+    Bvh = 4,       /// Serialized bottom-level AS of the mesh given by the section index
+    Instances = 5, /// Array of InstanceDesc
+    Materials = 6  /// Array of MaterialDesc
+  };
+
+  struct FileHeader
+  {
+    uint32_t magic;        /// Always kFileMagic
+    uint32_t version;      /// Always kFileVersion, bumped whenever the layout changes
+    uint32_t sectionCount; /// Number of entries in the section table
+    uint32_t reserved;
+    uint64_t sectionTableOffset; /// Offset of the section table from the start of the file
+  };
+
+  struct SectionHeader
+  {
+    SectionType type;
+    uint32_t index;  /// Mesh index for the per-mesh sections, 0 otherwise
+    uint64_t offset; /// Offset of the section from the start of the file
+    uint64_t size;   /// Size of the section in bytes
+  };
+
+  static constexpr uint32_t kFileMagic = 0x50535844; // "DXSP"
+  static constexpr uint32_t kFileVersion = 1;
+  static constexpr uint64_t kSectionAlignment = 4096;
+
+  MappedFile m_file;
+  std::vector<MeshView> m_meshes;
+  const InstanceDesc* m_instances = nullptr;
+  uint32_t m_instanceCount = 0;
+  const MaterialDesc* m_materials = nullptr;
+  uint32_t m_materialCount = 0;
+};
+
+/// Helper class assembling a scene package. The data passed to the writer is referenced, not
+/// copied, and must be kept alive until Write is called
+class ScenePackageWriter
+{
+public:
+  /// Add a mesh and return its index. The index array can be nullptr for non-indexed meshes
+  uint32_t AddMesh(const void* vertices, size_t vertexCount, uint32_t vertexStride,
+                   const uint32_t* indices, size_t indexCount);
+
+  /// Attach the serialized bottom-level AS of a mesh, as obtained from
+  /// AccelerationStructureCache::ReadSerialized
+  void SetMeshBvh(uint32_t meshIndex, const void* bvh, uint64_t bvhSize);
+
+  /// Add a material and return its index
+  uint32_t AddMaterial(const ScenePackage::MaterialDesc& material);
+
+  /// Add an instance of a mesh, with a row-major transform
+  void AddInstance(uint32_t meshIndex, uint32_t materialIndex, const float transform[4][4]);
+
+  /// Write the package, replacing any existing file. Returns false on failure
+  bool Write(const std::wstring& fileName) const;
+
+private:
+  struct PendingMesh
+  {
+    ScenePackage::MeshDesc desc;
+    const void* vertices;
+    const uint32_t* indices;
+    const void* bvh = nullptr;
+    uint64_t bvhSize = 0;
+  };
+
+  std::vector<PendingMesh> m_meshes;
+  std::vector<ScenePackage::MaterialDesc> m_materials;
+  std::vector<ScenePackage::InstanceDesc> m_instances;
+};
+} // namespace nv_helpers_dx12
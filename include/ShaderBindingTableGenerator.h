@@ -47,8 +47,7 @@ m_sbtHelper.AddHitGroup(L"ShadowHitGroup", {});
 
 
 // Create the SBT on the upload heap
-uint32_t sbtSize = 0;
-m_sbtHelper.ComputeSBTSize(GetRTDevice(), &sbtSize);
+uint32_t sbtSize = m_sbtHelper.ComputeSBTSize();
 m_sbtStorage = nv_helpers_dx12::CreateBuffer(m_device.Get(), sbtSize,
 D3D12_RESOURCE_FLAG_NONE, D3D12_RESOURCE_STATE_GENERIC_READ,
 nv_helpers_dx12::kUploadHeapProps);
@@ -56,6 +55,56 @@ nv_helpers_dx12::kUploadHeapProps);
 m_sbtHelper.Generate(m_sbtStorage.Get(), m_rtStateObjectProps.Get());
 
 
+//--------------------------------------------------------------------
+Records can be modified after the SBT has been generated, without regenerating it
+//--------------------------------------------------------------------
+
+The Add* methods return a handle on the record. UpdateRecordData replaces the root arguments of a
+record, and Patch only rewrites the records modified since the last call for the same buffer. With
+several SBT buffers used in turn (e.g. one per frame in flight), each buffer keeps its own list of
+pending modifications, so that a buffer still in use by the GPU is never written:
+
+m_sbtHelper.SetBufferCount(frameCount);
+auto record = m_sbtHelper.AddHitGroup(L"HitGroup", {(void*)(m_constantBuffers[i]->GetGPUVirtualAddress())});
+...
+m_sbtHelper.UpdateRecordData(record, {(void*)(m_otherConstantBuffer->GetGPUVirtualAddress())});
+m_sbtHelper.Patch(m_sbtStorage[m_frameIndex].Get(), m_rtStateObjectProps.Get(), m_frameIndex);
+
+
+//--------------------------------------------------------------------
+Root arguments can also be embedded inline in the records, with their actual types
+//--------------------------------------------------------------------
+
+Besides the list of 8-byte pointers or values, the root arguments of a record can be described with
+ShaderRecordArguments, following the order of the parameters of the local root signature. Root
+constants are stored inline, aligned on 4 bytes, and descriptors and descriptor tables are aligned
+on 8 bytes. For instance, with a local root signature made of 16 root constants:
+
+XMFLOAT4 colors[4] = {...};
+m_sbtHelper.AddHitGroupRecord(L"HitGroup",
+                              nv_helpers_dx12::ShaderRecordArguments().AddRootConstants(colors));
+
+
+//--------------------------------------------------------------------
+Hit groups can be laid out per geometry and ray type
+//--------------------------------------------------------------------
+
+DXR fetches the hit group record at index InstanceContributionToHitGroupIndex +
+RayContributionToHitGroupIndex + MultiplierForGeometryContributionToHitGroupIndex * GeometryIndex.
+With a ray type count set on the generator, AddHitGroupInstance reserves one record per geometry and
+ray type, and returns the contribution of the instance to pass to TopLevelASGenerator::AddInstance.
+TraceRay is then called with the ray type as ray contribution and the ray type count as multiplier:
+
+m_sbtHelper.SetRayTypeCount(2); // Primary and shadow rays
+UINT contribution = m_sbtHelper.AddHitGroupInstance(geometryCount);
+for (UINT g = 0; g < geometryCount; g++)
+{
+  m_sbtHelper.SetHitGroup(contribution, g, 0, L"HitGroup", {materialPointers[g]});
+  m_sbtHelper.SetHitGroup(contribution, g, 1, L"ShadowHitGroup", {});
+}
+m_topLevelASGenerator.AddInstance(blas, transform, instanceId, contribution);
+
+
 //--------------------------------------------------------------------
 Then setting the descriptor for the dispatch rays become way easier
 //--------------------------------------------------------------------
@@ -83,11 +132,11 @@ shaders, which is
 // the size of a SBT entry
 uint32_t missSectionSizeInBytes = m_sbtHelper.GetMissSectionSize();
 desc.MissShaderTable.StartAddress =
-m_sbtStorage->GetGPUVirtualAddress() + rayGenerationSectionSizeInBytes;
+m_sbtStorage->GetGPUVirtualAddress() + m_sbtHelper.GetMissSectionOffset();
 desc.MissShaderTable.SizeInBytes = missSectionSizeInBytes;
 desc.MissShaderTable.StrideInBytes = m_sbtHelper.GetMissEntrySize();
 
-// The hit groups section start after the miss shaders. In this sample we have 4
+// The hit groups section start after the miss shaders, on the next 64-byte boundary. In this sample we have 4
 hit groups: 2
 // for the triangles (1 used when hitting the geometry from a camera ray, 1 when
 hitting the
@@ -97,8 +146,8 @@ stride between the
 // #Pascal: experiment with different sizes for the SBT entries
 uint32_t hitGroupsSectionSize = m_sbtHelper.GetHitGroupSectionSize();
 desc.HitGroupTable.StartAddress =
-m_sbtStorage->GetGPUVirtualAddress() + rayGenerationSectionSizeInBytes +
-missSectionSizeInBytes; desc.HitGroupTable.SizeInBytes = hitGroupsSectionSize;
+m_sbtStorage->GetGPUVirtualAddress() + m_sbtHelper.GetHitGroupSectionOffset();
+desc.HitGroupTable.SizeInBytes = hitGroupsSectionSize;
 desc.HitGroupTable.StrideInBytes = m_sbtHelper.GetHitGroupEntrySize();
 
 
@@ -109,39 +158,195 @@ desc.HitGroupTable.StrideInBytes = m_sbtHelper.GetHitGroupEntrySize();
 
 #include "d3d12.h"
 
+#include <functional>
+#include <unordered_map>
 #include <vector>
 #include <string>
+#include <string_view>
 
 namespace nv_helpers_dx12
 {
+/// Typed root arguments of a shader record, laid out following the local root signature of the
+/// program: each call appends the argument of the next root parameter with the alignment it
+/// requires. The arguments are stored inline, up to the largest size allowed by DXR, so that
+/// building them never allocates
+class ShaderRecordArguments
+{
+public:
+  /// Append root constants, aligned on 4 bytes. The size must be a multiple of 4 bytes
+  ShaderRecordArguments& AddRootConstants(const void* data, uint32_t sizeInBytes);
+
+  /// Append a value as root constants
+  template <class T>
+  ShaderRecordArguments& AddRootConstants(const T& value)
+  {
+    static_assert(sizeof(T) % 4 == 0, "Root constants are made of 32-bit values");
+    return AddRootConstants(&value, static_cast<uint32_t>(sizeof(T)));
+  }
+
+  /// Append the address of a root CBV, SRV or UAV, aligned on 8 bytes
+  ShaderRecordArguments& AddRootDescriptor(D3D12_GPU_VIRTUAL_ADDRESS address);
+
+  /// Append the handle of a descriptor table, aligned on 8 bytes
+  ShaderRecordArguments& AddDescriptorTable(D3D12_GPU_DESCRIPTOR_HANDLE handle);
+
+  const uint8_t* GetData() const { return m_data; }
+  uint32_t GetSize() const { return m_size; }
+
+  /// Largest root arguments of a shader record, which has to fit in the maximum record stride
+  /// along with its shader identifier
+  static constexpr uint32_t kMaxSize =
+      D3D12_RAYTRACING_MAX_SHADER_RECORD_STRIDE - D3D12_SHADER_IDENTIFIER_SIZE_IN_BYTES;
+
+private:
+  /// Append size bytes after padding the arguments to the given alignment. Throws
+  /// std::logic_error if the arguments would exceed kMaxSize
+  void Append(const void* data, uint32_t size, uint32_t alignment);
+
+  uint8_t m_data[kMaxSize];
+  uint32_t m_size = 0;
+};
+
 /// Helper class to create and maintain a Shader Binding Table
 class ShaderBindingTableGenerator
 {
 public:
+  /// Number of sections of the SBT: ray generation, miss and hit groups, in that order
+  static constexpr uint32_t kSectionCount = 3;
+
+  /// Stable handle on a record of the SBT, used to update its root arguments
+  struct RecordHandle
+  {
+    uint32_t section; /// Index of the section: 0 for ray generation, 1 for miss, 2 for hit groups
+    uint32_t index;   /// Index of the record within its section
+  };
+
+  /// Compact description of a section, from which its layout is derived
+  struct SectionDesc
+  {
+    uint32_t recordCount;
+    uint32_t maxArgumentSize; /// Largest root arguments of the records of the section, in bytes
+  };
+
+  /// Offsets and strides of the sections within the SBT, in bytes
+  struct Layout
+  {
+    uint32_t entrySize[kSectionCount];
+    uint32_t sectionOffset[kSectionCount];
+    uint32_t sectionSize[kSectionCount];
+    uint32_t totalSize;
+  };
+
+  /// Compute the layout of an SBT from the description of its sections. This does not require a
+  /// device nor any allocation, and can be used to size the SBT buffers ahead of time. Each section
+  /// starts on a 64-byte boundary, as required for the tables passed to DispatchRays
+  static Layout ComputeLayout(const SectionDesc sections[kSectionCount]);
+
   /// Add a ray generation program by name, with its list of data pointers or values according to
   /// the layout of its root signature
-  void AddRayGenerationProgram(const std::wstring& entryPoint, const std::vector<void*>& inputData);
+  RecordHandle AddRayGenerationProgram(std::wstring_view entryPoint,
+                                       const std::vector<void*>& inputData);
 
   /// Add a miss program by name, with its list of data pointers or values according to
   /// the layout of its root signature
-  void AddMissProgram(const std::wstring& entryPoint, const std::vector<void*>& inputData);
+  RecordHandle AddMissProgram(std::wstring_view entryPoint, const std::vector<void*>& inputData);
 
   /// Add a hit group by name, with its list of data pointers or values according to
   /// the layout of its root signature
-  void AddHitGroup(const std::wstring& entryPoint, const std::vector<void*>& inputData);
+  RecordHandle AddHitGroup(std::wstring_view entryPoint, const std::vector<void*>& inputData);
+
+  /// Add a ray generation program by name, with its typed root arguments
+  RecordHandle AddRayGenerationRecord(std::wstring_view entryPoint,
+                                      const ShaderRecordArguments& arguments);
+
+  /// Add a miss program by name, with its typed root arguments
+  RecordHandle AddMissRecord(std::wstring_view entryPoint, const ShaderRecordArguments& arguments);
+
+  /// Add a hit group by name, with its typed root arguments
+  RecordHandle AddHitGroupRecord(std::wstring_view entryPoint,
+                                 const ShaderRecordArguments& arguments);
+
+  /// Set the number of ray types traced in the scene, for instance 2 for primary and shadow rays.
+  /// Each geometry of an instance then has one hit group record per ray type. Defaults to 1, and
+  /// must be set before adding instances
+  void SetRayTypeCount(uint32_t rayTypeCount);
+  uint32_t GetRayTypeCount() const { return m_rayTypeCount; }
+
+  /// Reserve the hit group records of an instance made of geometryCount geometries, one per
+  /// geometry and ray type, and return the index of the first one. This index is the
+  /// InstanceContributionToHitGroupIndex of the instance in the top-level AS. The records are null
+  /// hit groups until they are set
+  uint32_t AddHitGroupInstance(uint32_t geometryCount);
+
+  /// Set the hit group invoked when a ray of the given type hits a geometry of an instance, with
+  /// its list of data pointers or values according to the layout of its root signature. Throws
+  /// std::logic_error if the instance contribution was not returned by AddHitGroupInstance, or if
+  /// the geometry index is not below the geometry count it was reserved with
+  RecordHandle SetHitGroup(uint32_t instanceContribution, uint32_t geometryIndex, uint32_t rayType,
+                           std::wstring_view entryPoint, const std::vector<void*>& inputData);
+
+  /// Set the hit group invoked when a ray of the given type hits a geometry of an instance, with
+  /// its typed root arguments
+  RecordHandle SetHitGroupRecord(uint32_t instanceContribution, uint32_t geometryIndex,
+                                 uint32_t rayType, std::wstring_view entryPoint,
+                                 const ShaderRecordArguments& arguments);
+
+  /// Get the index of the hit group record of a geometry for a ray type. This is the index computed
+  /// by DXR when TraceRay is called with RayContributionToHitGroupIndex set to the ray type and
+  /// MultiplierForGeometryContributionToHitGroupIndex set to the ray type count:
+  /// instanceContribution + rayType + geometryIndex * rayTypeCount
+  uint32_t GetHitGroupIndex(uint32_t instanceContribution, uint32_t geometryIndex,
+                            uint32_t rayType) const;
+
+  /// Replace the data pointers or values of a record. Once the SBT size has been computed, the new
+  /// data cannot be larger than the entry size of the section. The record is marked as modified
+  /// for all the SBT buffers, and will be rewritten by the next call to Patch on each of them
+  void UpdateRecordData(RecordHandle record, const std::vector<void*>& inputData);
+
+  /// Replace the typed root arguments of a record, with the same constraints as above
+  void UpdateRecordArguments(RecordHandle record, const ShaderRecordArguments& arguments);
+
+  /// Set the number of SBT buffers used in turn, each of them tracking its own list of modified
+  /// records. Defaults to 1, and cannot be larger than 32
+  void SetBufferCount(uint32_t bufferCount);
 
   /// Compute the size of the SBT based on the set of programs and hit groups it contains
   uint32_t ComputeSBTSize();
 
+  /// Get the layout computed by the last call to ComputeSBTSize
+  const Layout& GetLayout() const { return m_layout; }
+
   /// Build the SBT and store it into sbtBuffer, which has to be pre-allocated on the upload heap.
   /// Access to the raytracing pipeline object is required to fetch program identifiers using their
-  /// names
+  /// names. All the pending modifications of that buffer are discarded, since all the records are
+  /// written. Large tables are filled in parallel, directly into the mapped buffer
   void Generate(ID3D12Resource* sbtBuffer,
-                ID3D12StateObjectProperties* raytracingPipeline);
-
-  /// Reset the sets of programs and hit groups
+                ID3D12StateObjectProperties* raytracingPipeline,
+                uint32_t bufferIndex = 0 /// Index of the buffer, if several buffers are used
+  );
+
+  /// Rewrite only the records of sbtBuffer modified since it was last generated or patched. Only
+  /// the range of modified records is flushed when unmapping the buffer. Nothing is mapped if no
+  /// record has been modified. The buffer must not be in use by the GPU
+  void Patch(ID3D12Resource* sbtBuffer,
+             ID3D12StateObjectProperties* raytracingPipeline,
+             uint32_t bufferIndex = 0 /// Index of the buffer, if several buffers are used
+  );
+
+  /// Reset the sets of programs and hit groups. All the record handles become invalid
   void Reset();
 
+  /// Discard the shader identifiers fetched from the raytracing pipeline. The identifiers are
+  /// resolved once per program name and reused by all subsequent calls to Generate and Patch with
+  /// the same pipeline, so this must be called whenever the pipeline is recreated, as the new
+  /// pipeline object may have the same address
+  void InvalidateShaderIdentifiers();
+
+  /// Mark all the records as modified for all the SBT buffers, so that the next call to Patch on
+  /// each buffer rewrites the whole table. Combined with InvalidateShaderIdentifiers, this updates
+  /// the buffers for a new pipeline one at a time, as each of them stops being used by the GPU
+  void MarkAllRecordsModified();
+
   /// The following getters are used to simplify the call to DispatchRays where the offsets of the
   /// shader programs must be exactly following the SBT layout
 
@@ -153,48 +358,121 @@ public:
   /// Get the size in bytes of the SBT section dedicated to miss programs
   UINT GetMissSectionSize() const;
   /// Get the size in bytes of one miss program entry in the SBT
-  UINT GetMissEntrySize();
+  UINT GetMissEntrySize() const;
+  /// Get the offset in bytes of the SBT section dedicated to miss programs
+  UINT GetMissSectionOffset() const;
 
   /// Get the size in bytes of the SBT section dedicated to hit groups
   UINT GetHitGroupSectionSize() const;
   /// Get the size in bytes of hit group entry in the SBT
   UINT GetHitGroupEntrySize() const;
+  /// Get the offset in bytes of the SBT section dedicated to hit groups
+  UINT GetHitGroupSectionOffset() const;
 
 private:
-  /// Wrapper for SBT entries, each consisting of the name of the program and a list of values,
-  /// which can be either pointers or raw 32-bit constants
+  /// Wrapper for SBT entries, each consisting of the name of the program and its root arguments,
+  /// which are stored in the argument arena of the generator
   struct SBTEntry
   {
-    SBTEntry(std::wstring entryPoint, std::vector<void*> inputData);
+    SBTEntry(uint32_t exportId, uint32_t argumentOffset, uint32_t argumentSize);
+
+    /// Index of the program name in the export table, or kNullExport for a null hit group
+    uint32_t m_exportId;
+    /// Location of the root arguments in the argument arena
+    uint32_t m_argumentOffset;
+    uint32_t m_argumentSize;
+    /// One bit per SBT buffer, set if the record has been modified since the buffer was written
+    uint32_t m_dirtyMask = 0;
+  };
+
+  /// Export index of the records reserved by AddHitGroupInstance and not set yet, which are
+  /// written with a null shader identifier
+  static constexpr uint32_t kNullExport = UINT32_MAX;
+
+  /// Set the program and root arguments of a reserved hit group record
+  RecordHandle SetInstanceEntry(uint32_t instanceContribution, uint32_t geometryIndex,
+                                uint32_t rayType, std::wstring_view entryPoint,
+                                const void* arguments, uint32_t argumentSize);
 
-    const std::wstring m_entryPoint;
-    const std::vector<void*> m_inputData;
+  /// Copy the shader identifier of an entry followed by its resource pointers and/or root
+  /// constants in outputData
+  void CopyShaderRecord(uint8_t* outputData, const SBTEntry& shader) const;
+
+  /// Add an entry to a section, copying its root arguments into the argument arena
+  RecordHandle AddEntry(uint32_t section, std::wstring_view entryPoint, const void* arguments,
+                        uint32_t argumentSize);
+
+  /// Replace the root arguments of a record
+  void UpdateEntry(RecordHandle record, const void* arguments, uint32_t argumentSize);
+
+  /// Return the index of a program name in the export table, adding it if needed. Looking up a
+  /// known name does not allocate
+  uint32_t InternExport(std::wstring_view entryPoint);
+
+  /// Hash of the export names, transparent so that the table can be searched with a string view
+  struct ExportNameHash
+  {
+    using is_transparent = void;
+    size_t operator()(std::wstring_view name) const
+    {
+      return std::hash<std::wstring_view>()(name);
+    }
   };
 
-  /// For each entry, copy the shader identifier followed by its resource pointers and/or root
-  /// constants in outputData, with a stride in bytes of entrySize, and returns the size in bytes
-  /// actually written to outputData.
-  uint32_t CopyShaderData(ID3D12StateObjectProperties* raytracingPipeline,
-                          uint8_t* outputData, const std::vector<SBTEntry>& shaders,
-                          uint32_t entrySize);
+  /// Fetch the shader identifiers of the exports which have not been resolved yet for this
+  /// pipeline
+  void ResolveShaderIdentifiers(ID3D12StateObjectProperties* raytracingPipeline);
 
-  /// Compute the size of the SBT entries for a set of entries, which is determined by the maximum
-  /// number of parameters of their root signature
-  uint32_t GetEntrySize(const std::vector<SBTEntry>& entries);
+  /// Get the entries of a section, along with their entry size and the offset of the section
+  /// within the SBT
+  std::vector<SBTEntry>& GetSection(uint32_t section, uint32_t* entrySize, uint32_t* offset);
+
+  /// For each entry, copy the shader identifier followed by its resource pointers and/or root
+  /// constants in outputData, with a stride in bytes of entrySize
+  void CopyShaderData(uint8_t* outputData, const SBTEntry* shaders, uint32_t shaderCount,
+                      uint32_t entrySize) const;
 
   std::vector<SBTEntry> m_rayGen;
   std::vector<SBTEntry> m_miss;
   std::vector<SBTEntry> m_hitGroup;
 
-  /// For each category, the size of an entry in the SBT depends on the maximum number of resources
-  /// used by the shaders in that category.The helper computes those values automatically in
-  /// GetEntrySize()
-  uint32_t m_rayGenEntrySize;
-  uint32_t m_missEntrySize;
-  uint32_t m_hitGroupEntrySize;
+  /// Root arguments of all the entries, stored contiguously to avoid one allocation per entry
+  std::vector<uint8_t> m_argumentArena;
+
+  /// Export table: each distinct program name is stored once, and referenced by index in the
+  /// entries
+  std::unordered_map<std::wstring, uint32_t, ExportNameHash, std::equal_to<>> m_exportIds;
+  std::vector<std::wstring> m_exportNames;
+
+  /// Shader identifiers of the exports, in the order of the export table, and the pipeline they
+  /// were fetched from. Only the first m_resolvedExportCount identifiers are valid
+  std::vector<uint8_t> m_shaderIdentifiers;
+  uint32_t m_resolvedExportCount = 0;
+  ID3D12StateObjectProperties* m_identifierSource = nullptr;
+
+  /// For each SBT buffer, the records modified since the buffer was last written
+  std::vector<std::vector<RecordHandle>> m_dirtyRecords = std::vector<std::vector<RecordHandle>>(1);
+
+  /// Number of hit group records per geometry of an instance
+  uint32_t m_rayTypeCount = 1;
+
+  /// Instances reserved by AddHitGroupInstance, in increasing order of their first record, so that
+  /// the geometry index passed to SetHitGroup can be checked against the reserved count
+  struct ReservedInstance
+  {
+    uint32_t instanceContribution;
+    uint32_t geometryCount;
+  };
+  std::vector<ReservedInstance> m_reservedInstances;
+
+  /// For each category, the size of an entry in the SBT depends on the maximum size of the root
+  /// arguments used by the shaders in that category. Those sizes are maintained as records are
+  /// added or updated, and the layout is derived from them in ComputeSBTSize()
+  uint32_t m_maxArgumentSize[kSectionCount] = {};
+  Layout m_layout = {};
 
-  /// The program names are translated into program identifiers.The size in bytes of an identifier
-  /// is provided by the device and is the same for all categories.
-  UINT m_progIdSize;
+  /// The program names are translated into program identifiers. The size in bytes of an identifier
+  /// is the same for all categories.
+  UINT m_progIdSize = D3D12_SHADER_IDENTIFIER_SIZE_IN_BYTES;
 };
 } // namespace nv_helpers_dx12
@@ -0,0 +1,154 @@
+/*
+The shader cache stores the DXIL libraries compiled by DXC on disk, so that warm starts load them
+directly instead of compiling the HLSL again. Each library is keyed on a hash of its source file,
+the target profile and the compiler arguments. The files included by the source (e.g. Common.hlsl)
+are recorded during compilation along with the hash of their contents, and stored next to the
+compiled library: a cached library is only used if all its included files are unchanged. A lookup
+then only reads and hashes the source and its includes, without invoking the compiler.
+
+Libraries can be compiled concurrently: each thread uses its own DXC compiler instance, since the
+instances cannot be shared between threads. CompileLibraryAsync starts the compilation on another
+thread and returns a future, so that independent libraries are compiled in parallel while the
+caller prepares the rest of the pipeline.
+
+Compilation errors are reported by throwing std::logic_error, whose message contains the compiler
+output.
+
+The cache is keyed on the inputs of the compiler, not on its version: the cache directory has to
+be cleared when updating DXC.
+
+Example:
+
+nv_helpers_dx12::ShaderCache::Get().SetDirectory(GetAssetFullPath(L"cache"));
+
+// The returned library holds a reference owned by the caller
+IDxcBlob* library = nv_helpers_dx12::ShaderCache::Get().CompileLibrary(L"shaders/Hit.hlsl");
+
+// Compile in the background, and wait for the library only when adding it to the pipeline
+std::future<IDxcBlob*> missLibrary =
+    nv_helpers_dx12::ShaderCache::Get().CompileLibraryAsync(L"shaders/Miss.hlsl");
+...
+pipeline.AddLibrary(missLibrary.get(), {L"Miss"});
+
+*/
+
+#pragma once
+
+// The Windows SDK version of dxcapi.h relies on the COM declarations of windows.h, which the DXC
+// release for other platforms provides itself
+#if defined(_WIN32)
+#include <windows.h>
+#endif
+#include <dxcapi.h>
+
+#include <atomic>
+#include <cstdint>
+#include <future>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace nv_helpers_dx12
+{
+
+/// Process-wide on-disk cache of compiled DXIL libraries
+class ShaderCache
+{
+public:
+  /// Get the cache shared by the whole process
+  static ShaderCache& Get();
+
+  ShaderCache() = default;
+
+  ShaderCache(const ShaderCache&) = delete;
+  ShaderCache& operator=(const ShaderCache&) = delete;
+
+  /// Set the directory in which the compiled libraries are stored. The directory is created if it
+  /// does not exist. Libraries are always compiled as long as no directory is set
+  void SetDirectory(const std::wstring& directory);
+
+  /// Compile a HLSL file into a DXIL library, or load it from the cache if the file, its includes,
+  /// the profile and the arguments did not change. The returned blob holds a reference owned by the
+  /// caller. Throws std::logic_error if the file cannot be read or compiled. This can be called
+  /// from several threads at once
+  IDxcBlob* CompileLibrary(const std::wstring& fileName,
+                           const std::wstring& targetProfile = L"lib_6_3",
+                           const std::vector<std::wstring>& arguments = {});
+
+  /// Run CompileLibrary on another thread. Compilation errors are rethrown by the get() method of
+  /// the returned future
+  std::future<IDxcBlob*> CompileLibraryAsync(const std::wstring& fileName,
+                                             const std::wstring& targetProfile = L"lib_6_3",
+                                             const std::vector<std::wstring>& arguments = {});
+
+  /// Absolute paths of the source file of a library and of all the files it includes, as of the
+  /// last time the library was compiled or loaded. This is used to find the libraries affected by
+  /// a modified file, such as a common include
+  std::vector<std::wstring> GetDependencies(const std::wstring& fileName);
+
+  /// Number of libraries loaded from the cache
+  uint32_t GetHitCount() const { return m_hitCount; }
+  /// Number of libraries compiled by DXC
+  uint32_t GetMissCount() const { return m_missCount; }
+
+private:
+  /// Header at the beginning of each cache file
+  struct FileHeader
+  {
+    uint32_t magic;           /// Always kFileMagic
+    uint32_t version;         /// Always kFileVersion, bumped whenever the layout changes
+    uint64_t key;             /// Key of the stored library, checked against the file name
+    uint32_t dependencyCount; /// Number of included files, whose descriptors follow the header
+    uint32_t reserved;
+    uint64_t blobOffset; /// Offset of the DXIL library from the start of the file
+    uint64_t blobSize;   /// Size of the DXIL library
+  };
+
+  /// Included file, followed in the cache file by its name of nameLength characters
+  struct Dependency
+  {
+    uint64_t contentHash; /// Hash of the contents of the file when the library was compiled
+    uint32_t nameLength;
+    uint32_t reserved;
+  };
+
+  /// Name and content hash of a file included by a library
+  struct IncludedFile
+  {
+    std::wstring name;
+    uint64_t contentHash;
+  };
+
+  /// Include handler recording the files loaded during a compilation
+  class IncludeRecorder;
+
+  static constexpr uint32_t kFileMagic = 0x43535844; // "DXSC"
+  static constexpr uint32_t kFileVersion = 1;
+
+  /// Load the library stored in the cache file if all its included files are unchanged, and fill
+  /// the list of included files. Returns nullptr otherwise
+  static IDxcBlob* Load(const std::wstring& fileName, uint64_t key, IDxcLibrary* library,
+                        std::vector<IncludedFile>& includedFiles);
+
+  /// Record the dependencies of a library, returned by GetDependencies
+  void SetDependencies(const std::wstring& fileName,
+                       const std::vector<IncludedFile>& includedFiles);
+
+  /// Write a compiled library and the list of its included files
+  static void Store(const std::wstring& fileName, uint64_t key, IDxcBlob* library,
+                    const std::vector<IncludedFile>& includedFiles);
+
+  /// Name of the cache file of a library, or an empty string if no directory is set
+  std::wstring GetFileName(uint64_t key);
+
+  /// Protects the directory, which may be set while libraries are being compiled, and the
+  /// dependencies
+  std::mutex m_mutex;
+  std::wstring m_directory;
+  std::unordered_map<std::wstring, std::vector<std::wstring>> m_dependencies;
+
+  std::atomic<uint32_t> m_hitCount = {0};
+  std::atomic<uint32_t> m_missCount = {0};
+};
+} // namespace nv_helpers_dx12
@@ -77,6 +77,8 @@ return buffers;
 namespace nv_helpers_dx12
 {
 
+class ResourceStateTracker;
+
 /// Helper class to generate top-level acceleration structures for raytracing
 class TopLevelASGenerator
 {
@@ -94,8 +96,10 @@ public:
               UINT instanceID,   /// Instance ID, which can be used in the shaders to
                                  /// identify this specific instance
               UINT hitGroupIndex /// Hit group index, corresponding the the index of the
-                                 /// hit group in the Shader Binding Table that will be
-                                 /// invocated upon hitting the geometry
+                                 /// first hit group record of the instance in the Shader
+                                 /// Binding Table (InstanceContributionToHitGroupIndex), as
+                                 /// returned by ShaderBindingTableGenerator::AddHitGroupInstance.
+                                 /// The geometry index and ray type are added by DXR
   );
 
   /// Compute the size of the scratch space required to build the acceleration
@@ -127,8 +131,11 @@ public:
       ID3D12Resource* descriptorsBuffer, /// Auxiliary result buffer containing the instance
                                          /// descriptors, has to be in upload heap
       bool updateOnly = false, /// If true, simply refit the existing acceleration structure
-      ID3D12Resource* previousResult = nullptr /// Optional previous acceleration structure, used
-                                               /// if an iterative update is requested
+      ID3D12Resource* previousResult = nullptr, /// Optional previous acceleration structure, used
+                                                /// if an iterative update is requested
+      ResourceStateTracker* stateTracker = nullptr /// Optional tracker whose pending barriers are
+                                                   /// flushed before the build, and in which to
+                                                   /// queue the UAV barrier on the result
   );
 
 private:
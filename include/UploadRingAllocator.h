@@ -0,0 +1,110 @@
+/*
+The upload ring allocator hands out short-lived suballocations of a single upload buffer, typically
+the constants written by the CPU for one frame. The buffer is mapped once for its whole lifetime,
+and each allocation returns both the CPU address to write to and the GPU virtual address to bind,
+for instance as a root constant buffer view. No resource is created nor mapped per allocation.
+
+Allocations are made linearly, wrapping around at the end of the buffer. An allocation never
+straddles the end of the buffer: the remaining space is skipped instead. Once the allocations of
+a frame have been recorded, FinishFrame tags them with the fence value signaled at the end of that
+frame. Reclaim then frees the allocations of all the frames whose fence value has been reached, so
+the CPU never overwrites data which the GPU may still read.
+
+The capacity needs to cover the allocations of all the frames in flight. Allocate throws
+std::logic_error when the ring is full, that is when the GPU has not yet completed the frames
+using the oldest allocations.
+
+Example:
+
+nv_helpers_dx12::UploadRingAllocator uploadRing;
+uploadRing.Initialize(m_device.Get(), 64 * 1024);
+
+// Each frame, once the frame context has been acquired
+uploadRing.Reclaim(frameRing.GetCompletedFenceValue());
+nv_helpers_dx12::UploadRingAllocator::Allocation camera = uploadRing.AllocateConstants(matrices);
+m_commandList->SetGraphicsRootConstantBufferView(0, camera.gpuAddress);
+...
+uploadRing.FinishFrame(frameRing.GetFrameFenceValue());
+frameRing.EndFrame();
+
+*/
+
+#pragma once
+
+#include "d3d12.h"
+
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <utility>
+
+namespace nv_helpers_dx12
+{
+
+/// Linear allocator of transient data in a persistently mapped upload buffer
+class UploadRingAllocator
+{
+public:
+  /// Suballocation of the upload buffer
+  struct Allocation
+  {
+    void* cpuAddress = nullptr;                /// Address to write the data to
+    D3D12_GPU_VIRTUAL_ADDRESS gpuAddress = 0;  /// Address of the data for the GPU
+    ID3D12Resource* resource = nullptr;        /// Upload buffer containing the data
+    uint64_t offset = 0;                       /// Offset of the data in the upload buffer
+  };
+
+  UploadRingAllocator() = default;
+  ~UploadRingAllocator();
+
+  UploadRingAllocator(const UploadRingAllocator&) = delete;
+  UploadRingAllocator& operator=(const UploadRingAllocator&) = delete;
+
+  /// Create and map the upload buffer. The capacity is rounded up to 64 KB, the granularity of
+  /// the buffer allocations. Throws std::logic_error if the buffer cannot be created
+  void Initialize(ID3D12Device* device, uint64_t capacity);
+
+  /// Allocate data valid until the end of the current frame. The alignment must be a power of two,
+  /// and defaults to the alignment of constant buffers. Throws std::logic_error if the ring is
+  /// full
+  Allocation Allocate(uint64_t size,
+                      uint64_t alignment = D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT);
+
+  /// Allocate a constant buffer and copy the value into it
+  template <typename T>
+  Allocation AllocateConstants(const T& value)
+  {
+    Allocation allocation = Allocate(sizeof(T));
+    memcpy(allocation.cpuAddress, &value, sizeof(T));
+    return allocation;
+  }
+
+  /// Tag the allocations made since the previous call with the fence value signaled once the GPU
+  /// no longer uses them
+  void FinishFrame(uint64_t fenceValue);
+
+  /// Free the allocations of the frames whose fence value is lower or equal to the completed value
+  void Reclaim(uint64_t completedFenceValue);
+
+  /// Size of the upload buffer
+  uint64_t GetCapacity() const { return m_capacity; }
+  /// Number of bytes allocated and not yet reclaimed, including the alignment and wrap padding
+  uint64_t GetUsedSize() const { return m_head - m_tail; }
+
+private:
+  void Release();
+
+  ID3D12Resource* m_buffer = nullptr;
+  uint8_t* m_cpuAddress = nullptr;
+  D3D12_GPU_VIRTUAL_ADDRESS m_gpuAddress = 0;
+  uint64_t m_capacity = 0;
+
+  /// Positions of the next allocation and of the oldest allocation still in use. They only ever
+  /// increase, their offset in the buffer is the position modulo the capacity
+  uint64_t m_head = 0;
+  uint64_t m_tail = 0;
+
+  /// Fence value of each finished frame still in flight, and the head position at its end
+  std::deque<std::pair<uint64_t, uint64_t>> m_frames;
+};
+} // namespace nv_helpers_dx12
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <windows.h>
+
+#include "Platform.h"
+
+// Platform of the windowed application on Windows
+class Win32Platform : public Platform
+{
+public:
+	Win32Platform();
+
+	std::wstring GetExecutableDirectory() const override;
+	void SetWindowTitle(const std::wstring &title) override;
+	void *GetNativeWindow() const override { return m_hwnd; }
+	double GetTime() const override;
+
+	// Window created by the application, nullptr until then
+	void SetWindow(HWND hwnd) { m_hwnd = hwnd; }
+
+	// Translate the parameters of the Win32 input messages
+	static uint8_t TranslateKey(WPARAM wParam);
+	static uint32_t TranslateMouseButtons(WPARAM wParam);
+
+private:
+	HWND m_hwnd = nullptr;
+	// Ticks per second of the performance counter
+	LARGE_INTEGER m_frequency;
+};
@@ -0,0 +1,420 @@
+/*
+The acceleration structure cache stores built bottom-level hierarchies on disk, so that subsequent
+runs can skip the builds entirely. See AccelerationStructureCache.h for the file layout.
+*/
+
+#include "AccelerationStructureCache.h"
+#include "ContentHash.h"
+#include "MappedFile.h"
+#include "d3dx12.h"
+
+#include <stdexcept>
+#include <wrl/client.h>
+
+// Helper to compute aligned buffer sizes
+#ifndef ROUND_UP
+#define ROUND_UP(v, powerOf2Alignment) (((v) + (powerOf2Alignment)-1) & ~((powerOf2Alignment)-1))
+#endif
+
+namespace nv_helpers_dx12
+{
+
+using Microsoft::WRL::ComPtr;
+
+namespace
+{
+//--------------------------------------------------------------------------------------------------
+//
+// Allocate a buffer used by the cache for staging, serialization or readback
+ComPtr<ID3D12Resource> CreateCacheBuffer(ID3D12Device* device, uint64_t size,
+                                         D3D12_HEAP_TYPE heapType, D3D12_RESOURCE_FLAGS flags,
+                                         D3D12_RESOURCE_STATES initState)
+{
+  CD3DX12_HEAP_PROPERTIES heapProps(heapType);
+  CD3DX12_RESOURCE_DESC bufDesc = CD3DX12_RESOURCE_DESC::Buffer(size, flags);
+
+  ComPtr<ID3D12Resource> pBuffer;
+  HRESULT hr = device->CreateCommittedResource(&heapProps, D3D12_HEAP_FLAG_NONE, &bufDesc,
+                                               initState, nullptr, IID_PPV_ARGS(&pBuffer));
+  if (FAILED(hr))
+  {
+    throw std::logic_error("Could not allocate an acceleration structure cache buffer");
+  }
+  return pBuffer;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Execute a command list on the queue and block until the GPU is done with it
+void ExecuteAndWait(ID3D12Device* device, ID3D12CommandQueue* queue,
+                    ID3D12GraphicsCommandList4* commandList)
+{
+  if (FAILED(commandList->Close()))
+  {
+    throw std::logic_error("Could not close the acceleration structure cache command list");
+  }
+  ID3D12CommandList* ppCommandLists[] = {commandList};
+  queue->ExecuteCommandLists(1, ppCommandLists);
+
+  ComPtr<ID3D12Fence> fence;
+  if (FAILED(device->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&fence))))
+  {
+    throw std::logic_error("Could not create the acceleration structure cache fence");
+  }
+  HANDLE fenceEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+  if (fenceEvent == nullptr)
+  {
+    throw std::logic_error("Could not create the acceleration structure cache fence event");
+  }
+  queue->Signal(fence.Get(), 1);
+  if (fence->GetCompletedValue() < 1)
+  {
+    fence->SetEventOnCompletion(1, fenceEvent);
+    WaitForSingleObject(fenceEvent, INFINITE);
+  }
+  CloseHandle(fenceEvent);
+}
+} // namespace
+
+//--------------------------------------------------------------------------------------------------
+//
+// Set the directory in which the serialized hierarchies are stored. The directory is created if
+// it does not exist. The cache is disabled as long as no directory is set
+void AccelerationStructureCache::SetDirectory(const std::wstring& directory)
+{
+  m_directory = directory;
+  if (!m_directory.empty() && m_directory.back() != L'\\' && m_directory.back() != L'/')
+  {
+    m_directory += L'/';
+  }
+  // Failing to create the directory only disables the storage of new entries
+  FileSystem::CreateDirectories(m_directory);
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Compute the cache key of a geometry, from its vertex and optional index data and formats, and the
+// flags used for the build. The formats are part of the key since the same bytes describe
+// different triangles in another format. For bottom-level hierarchies made of several geometries,
+// the key of the previous geometry is passed as seed to chain them
+uint64_t AccelerationStructureCache::ComputeKey(
+    const void* vertexData, uint64_t vertexDataSize, UINT vertexStride, DXGI_FORMAT vertexFormat,
+    const void* indexData, uint64_t indexDataSize, DXGI_FORMAT indexFormat,
+    D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAGS flags, uint64_t seed /*= 0*/)
+{
+  // The file version is part of the key, so that stale files are never even opened after a
+  // format change
+  uint64_t key = HashValue(seed, HashValue(kFileVersion));
+  key = HashValue(flags, key);
+  key = HashValue(vertexStride, key);
+  key = HashValue(vertexFormat, key);
+  key = HashValue(vertexDataSize, key);
+  key = HashBytes(vertexData, static_cast<size_t>(vertexDataSize), key);
+  key = HashValue(indexFormat, key);
+  key = HashValue(indexDataSize, key);
+  if (indexData)
+  {
+    key = HashBytes(indexData, static_cast<size_t>(indexDataSize), key);
+  }
+  return key;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Look up a hierarchy in the cache. If a compatible one is found, the result buffer is allocated
+// and its deserialization is enqueued on the command list. The staging buffer holding the
+// serialized data must be kept alive until the command list has been executed, similarly to a
+// scratch buffer. Returns false on a cache miss
+bool AccelerationStructureCache::Load(ID3D12Device5* device,
+                                      ID3D12GraphicsCommandList4* commandList, uint64_t key,
+                                      ID3D12Resource** resultBuffer,
+                                      ID3D12Resource** stagingBuffer)
+{
+  if (m_directory.empty())
+  {
+    return false;
+  }
+
+  MappedFile file;
+  if (!file.Open(GetFileName(key)))
+  {
+    m_missCount++;
+    return false;
+  }
+
+  // Validate the file header. Any mismatch is treated as a miss, the file will simply be
+  // overwritten by the next store
+  const FileHeader* header = reinterpret_cast<const FileHeader*>(file.GetData());
+  // The blob bounds are checked by subtraction, as a corrupted offset and size could wrap around
+  if (file.GetSize() < sizeof(FileHeader) || header->magic != kFileMagic ||
+      header->version != kFileVersion || header->key != key ||
+      header->blobSize < sizeof(D3D12_SERIALIZED_RAYTRACING_ACCELERATION_STRUCTURE_HEADER) ||
+      header->blobOffset > file.GetSize() ||
+      file.GetSize() - header->blobOffset < header->blobSize)
+  {
+    m_missCount++;
+    return false;
+  }
+
+  if (!Deserialize(device, commandList, file.GetData() + header->blobOffset, header->blobSize,
+                   resultBuffer, stagingBuffer))
+  {
+    m_missCount++;
+    return false;
+  }
+  m_hitCount++;
+  return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Copy the serialized blob of a cached hierarchy, for instance to embed it into a scene package.
+// Returns false if the hierarchy is not in the cache
+bool AccelerationStructureCache::ReadSerialized(uint64_t key, std::vector<uint8_t>& blob) const
+{
+  MappedFile file;
+  if (m_directory.empty() || !file.Open(GetFileName(key)))
+  {
+    return false;
+  }
+
+  const FileHeader* header = reinterpret_cast<const FileHeader*>(file.GetData());
+  if (file.GetSize() < sizeof(FileHeader) || header->magic != kFileMagic ||
+      header->version != kFileVersion || header->key != key ||
+      header->blobOffset > file.GetSize() ||
+      file.GetSize() - header->blobOffset < header->blobSize)
+  {
+    return false;
+  }
+  const uint8_t* data = file.GetData() + header->blobOffset;
+  blob.assign(data, data + header->blobSize);
+  return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Enqueue the deserialization of a hierarchy serialized by CopyRaytracingAccelerationStructure.
+// The result buffer is allocated, and the staging buffer holding a copy of the serialized data
+// must be kept alive until the command list has been executed. Returns false if the blob was
+// produced by a driver incompatible with the device
+bool AccelerationStructureCache::Deserialize(ID3D12Device5* device,
+                                             ID3D12GraphicsCommandList4* commandList,
+                                             const void* serializedData, uint64_t blobSize,
+                                             ID3D12Resource** resultBuffer,
+                                             ID3D12Resource** stagingBuffer)
+{
+  if (blobSize < sizeof(D3D12_SERIALIZED_RAYTRACING_ACCELERATION_STRUCTURE_HEADER))
+  {
+    return false;
+  }
+  const uint8_t* blob = static_cast<const uint8_t*>(serializedData);
+
+  // The serialized blob starts with a header identifying the driver which produced it. The blob
+  // can only be deserialized if the current driver reports it as compatible
+  const D3D12_SERIALIZED_RAYTRACING_ACCELERATION_STRUCTURE_HEADER* blobHeader =
+      reinterpret_cast<const D3D12_SERIALIZED_RAYTRACING_ACCELERATION_STRUCTURE_HEADER*>(blob);
+  if (device->CheckDriverMatchingIdentifier(
+          D3D12_SERIALIZED_DATA_RAYTRACING_ACCELERATION_STRUCTURE,
+          &blobHeader->DriverMatchingIdentifier) !=
+      D3D12_DRIVER_MATCHING_IDENTIFIER_COMPATIBLE_WITH_DEVICE)
+  {
+    return false;
+  }
+
+  // Copy the blob into an upload buffer, from which the GPU deserializes it
+  ComPtr<ID3D12Resource> staging =
+      CreateCacheBuffer(device, blobSize, D3D12_HEAP_TYPE_UPLOAD, D3D12_RESOURCE_FLAG_NONE,
+                        D3D12_RESOURCE_STATE_GENERIC_READ);
+  uint8_t* pData;
+  CD3DX12_RANGE readRange(0, 0);
+  if (FAILED(staging->Map(0, &readRange, reinterpret_cast<void**>(&pData))))
+  {
+    throw std::logic_error("Could not map the acceleration structure staging buffer");
+  }
+  memcpy(pData, blob, static_cast<size_t>(blobSize));
+  staging->Unmap(0, nullptr);
+
+  // Buffer sizes need to be 256-byte-aligned
+  ComPtr<ID3D12Resource> result = CreateCacheBuffer(
+      device,
+      ROUND_UP(blobHeader->DeserializedSizeInBytes, D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT),
+      D3D12_HEAP_TYPE_DEFAULT, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS,
+      D3D12_RESOURCE_STATE_RAYTRACING_ACCELERATION_STRUCTURE);
+
+  commandList->CopyRaytracingAccelerationStructure(
+      result->GetGPUVirtualAddress(), staging->GetGPUVirtualAddress(),
+      D3D12_RAYTRACING_ACCELERATION_STRUCTURE_COPY_MODE_DESERIALIZE);
+
+  // Same as after a regular build, the top-level hierarchy may be built right afterwards
+  D3D12_RESOURCE_BARRIER uavBarrier;
+  uavBarrier.Type = D3D12_RESOURCE_BARRIER_TYPE_UAV;
+  uavBarrier.UAV.pResource = result.Get();
+  uavBarrier.Flags = D3D12_RESOURCE_BARRIER_FLAG_NONE;
+  commandList->ResourceBarrier(1, &uavBarrier);
+
+  *resultBuffer = result.Detach();
+  *stagingBuffer = staging.Detach();
+  return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Register a hierarchy built after a cache miss, so that it gets stored by the next call to
+// StorePending
+void AccelerationStructureCache::AddPendingStore(uint64_t key, ID3D12Resource* resultBuffer)
+{
+  if (m_directory.empty())
+  {
+    return;
+  }
+  m_pendingStores.push_back({key, resultBuffer});
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Serialize all the pending hierarchies and write them to disk. The builds of those hierarchies
+// must have completed on the GPU. The serialization is executed on the given queue, and this
+// call blocks until the files are written
+void AccelerationStructureCache::StorePending(ID3D12Device5* device, ID3D12CommandQueue* queue)
+{
+  if (m_pendingStores.empty())
+  {
+    return;
+  }
+
+  const UINT storeCount = static_cast<UINT>(m_pendingStores.size());
+
+  // The objects are reference-counted so that they are released on the error paths as well
+  ComPtr<ID3D12CommandAllocator> allocator;
+  ComPtr<ID3D12GraphicsCommandList4> commandList;
+  if (FAILED(device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT,
+                                            IID_PPV_ARGS(&allocator))) ||
+      FAILED(device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, allocator.Get(), nullptr,
+                                       IID_PPV_ARGS(&commandList))))
+  {
+    throw std::logic_error("Could not create the acceleration structure cache command list");
+  }
+
+  // The size of the serialized data is only known by the GPU, so a first pass queries it for all
+  // the pending hierarchies at once. The post-build information of each source is written
+  // consecutively in the destination buffer
+  const uint64_t infoSize =
+      sizeof(D3D12_RAYTRACING_ACCELERATION_STRUCTURE_POSTBUILD_INFO_SERIALIZATION_DESC) *
+      storeCount;
+  ComPtr<ID3D12Resource> infoBuffer =
+      CreateCacheBuffer(device, infoSize, D3D12_HEAP_TYPE_DEFAULT,
+                        D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS,
+                        D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+  ComPtr<ID3D12Resource> infoReadback =
+      CreateCacheBuffer(device, infoSize, D3D12_HEAP_TYPE_READBACK, D3D12_RESOURCE_FLAG_NONE,
+                        D3D12_RESOURCE_STATE_COPY_DEST);
+
+  std::vector<D3D12_GPU_VIRTUAL_ADDRESS> sources(storeCount);
+  for (UINT i = 0; i < storeCount; i++)
+  {
+    sources[i] = m_pendingStores[i].resultBuffer->GetGPUVirtualAddress();
+  }
+
+  D3D12_RAYTRACING_ACCELERATION_STRUCTURE_POSTBUILD_INFO_DESC infoDesc = {};
+  infoDesc.DestBuffer = infoBuffer->GetGPUVirtualAddress();
+  infoDesc.InfoType = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_POSTBUILD_INFO_SERIALIZATION;
+  commandList->EmitRaytracingAccelerationStructurePostbuildInfo(&infoDesc, storeCount,
+                                                                sources.data());
+
+  CD3DX12_RESOURCE_BARRIER transition = CD3DX12_RESOURCE_BARRIER::Transition(
+      infoBuffer.Get(), D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_COPY_SOURCE);
+  commandList->ResourceBarrier(1, &transition);
+  commandList->CopyResource(infoReadback.Get(), infoBuffer.Get());
+  ExecuteAndWait(device, queue, commandList.Get());
+
+  // Lay out all the serialized blobs in a single buffer, each one 256-byte-aligned
+  std::vector<uint64_t> blobSizes(storeCount);
+  std::vector<uint64_t> blobOffsets(storeCount);
+  uint64_t serializedSize = 0;
+  {
+    D3D12_RAYTRACING_ACCELERATION_STRUCTURE_POSTBUILD_INFO_SERIALIZATION_DESC* info;
+    CD3DX12_RANGE readRange(0, static_cast<SIZE_T>(infoSize));
+    if (FAILED(infoReadback->Map(0, &readRange, reinterpret_cast<void**>(&info))))
+    {
+      throw std::logic_error("Could not map the acceleration structure post-build information");
+    }
+    for (UINT i = 0; i < storeCount; i++)
+    {
+      blobSizes[i] = info[i].SerializedSizeInBytes;
+      blobOffsets[i] = serializedSize;
+      serializedSize +=
+          ROUND_UP(blobSizes[i], D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BYTE_ALIGNMENT);
+    }
+    CD3DX12_RANGE writeRange(0, 0);
+    infoReadback->Unmap(0, &writeRange);
+  }
+
+  // Second pass: serialize each hierarchy and read the results back
+  ComPtr<ID3D12Resource> serializedBuffer =
+      CreateCacheBuffer(device, serializedSize, D3D12_HEAP_TYPE_DEFAULT,
+                        D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS,
+                        D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+  ComPtr<ID3D12Resource> serializedReadback =
+      CreateCacheBuffer(device, serializedSize, D3D12_HEAP_TYPE_READBACK, D3D12_RESOURCE_FLAG_NONE,
+                        D3D12_RESOURCE_STATE_COPY_DEST);
+
+  allocator->Reset();
+  commandList->Reset(allocator.Get(), nullptr);
+  for (UINT i = 0; i < storeCount; i++)
+  {
+    commandList->CopyRaytracingAccelerationStructure(
+        serializedBuffer->GetGPUVirtualAddress() + blobOffsets[i], sources[i],
+        D3D12_RAYTRACING_ACCELERATION_STRUCTURE_COPY_MODE_SERIALIZE);
+  }
+  transition = CD3DX12_RESOURCE_BARRIER::Transition(
+      serializedBuffer.Get(), D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
+      D3D12_RESOURCE_STATE_COPY_SOURCE);
+  commandList->ResourceBarrier(1, &transition);
+  commandList->CopyResource(serializedReadback.Get(), serializedBuffer.Get());
+  ExecuteAndWait(device, queue, commandList.Get());
+
+  // Write one file per hierarchy: header, padding, then the blob aligned on 256 bytes
+  {
+    uint8_t* serialized;
+    CD3DX12_RANGE readRange(0, static_cast<SIZE_T>(serializedSize));
+    if (FAILED(serializedReadback->Map(0, &readRange, reinterpret_cast<void**>(&serialized))))
+    {
+      throw std::logic_error("Could not map the serialized acceleration structures");
+    }
+
+    const uint64_t blobOffset =
+        ROUND_UP(sizeof(FileHeader), D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BYTE_ALIGNMENT);
+    std::vector<uint8_t> fileData;
+    for (UINT i = 0; i < storeCount; i++)
+    {
+      fileData.assign(static_cast<size_t>(blobOffset + blobSizes[i]), 0);
+
+      FileHeader header = {};
+      header.magic = kFileMagic;
+      header.version = kFileVersion;
+      header.key = m_pendingStores[i].key;
+      header.blobOffset = blobOffset;
+      header.blobSize = blobSizes[i];
+      memcpy(fileData.data(), &header, sizeof(header));
+      memcpy(fileData.data() + blobOffset, serialized + blobOffsets[i],
+             static_cast<size_t>(blobSizes[i]));
+
+      // A failed write only means the hierarchy will be rebuilt next time
+      WriteFileAtomically(GetFileName(m_pendingStores[i].key), fileData.data(), fileData.size());
+    }
+
+    CD3DX12_RANGE writeRange(0, 0);
+    serializedReadback->Unmap(0, &writeRange);
+  }
+
+  m_pendingStores.clear();
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Name of the file storing the hierarchy identified by key
+std::wstring AccelerationStructureCache::GetFileName(uint64_t key) const
+{
+  return m_directory + HashToString(key) + L".blas";
+}
+} // namespace nv_helpers_dx12
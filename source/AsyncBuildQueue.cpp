@@ -0,0 +1,209 @@
+/*
+The async build queue submits the acceleration structure builds on a dedicated compute queue,
+synchronized with the other queues on the GPU. See AsyncBuildQueue.h for an overview.
+*/
+
+#include "AsyncBuildQueue.h"
+
+#include <stdexcept>
+
+namespace nv_helpers_dx12
+{
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+AsyncBuildQueue::~AsyncBuildQueue()
+{
+  Release();
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Create the compute queue, the fence, and the command allocators. The command list is created
+// closed, and reset by Begin
+void AsyncBuildQueue::Initialize(ID3D12Device* device, uint32_t allocatorCount)
+{
+  if (allocatorCount == 0)
+  {
+    throw std::logic_error("The async build queue needs at least one command allocator");
+  }
+  Release();
+
+  D3D12_COMMAND_QUEUE_DESC queueDesc = {};
+  queueDesc.Type = D3D12_COMMAND_LIST_TYPE_COMPUTE;
+  queueDesc.Flags = D3D12_COMMAND_QUEUE_FLAG_NONE;
+  if (FAILED(device->CreateCommandQueue(&queueDesc, IID_PPV_ARGS(&m_queue))))
+  {
+    throw std::logic_error("Could not create the async build queue");
+  }
+  if (FAILED(device->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&m_fence))))
+  {
+    throw std::logic_error("Could not create the async build fence");
+  }
+  m_fenceEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+  if (m_fenceEvent == nullptr)
+  {
+    throw std::logic_error("Could not create the async build fence event");
+  }
+
+  m_submissions.resize(allocatorCount);
+  for (Submission& submission : m_submissions)
+  {
+    if (FAILED(device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_COMPUTE,
+                                              IID_PPV_ARGS(&submission.allocator))))
+    {
+      throw std::logic_error("Could not create the async build command allocator");
+    }
+  }
+  if (FAILED(device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_COMPUTE,
+                                       m_submissions[0].allocator, nullptr,
+                                       IID_PPV_ARGS(&m_commandList))) ||
+      FAILED(m_commandList->Close()))
+  {
+    throw std::logic_error("Could not create the async build command list");
+  }
+  m_currentSubmission = allocatorCount - 1;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Start recording builds with the next allocator of the ring. The allocator was last used as many
+// submissions earlier as there are allocators, and that submission is usually complete already
+ID3D12GraphicsCommandList4* AsyncBuildQueue::Begin()
+{
+  if (m_recording)
+  {
+    throw std::logic_error("The previous builds have not been submitted");
+  }
+  m_currentSubmission = (m_currentSubmission + 1) % static_cast<uint32_t>(m_submissions.size());
+  Submission& submission = m_submissions[m_currentSubmission];
+  if (m_fence->GetCompletedValue() < submission.fenceValue)
+  {
+    m_stallCount++;
+    WaitForFenceValue(submission.fenceValue);
+  }
+
+  if (FAILED(submission.allocator->Reset()) ||
+      FAILED(m_commandList->Reset(submission.allocator, nullptr)))
+  {
+    throw std::logic_error("Could not reset the async build command list");
+  }
+  m_recording = true;
+  return m_commandList;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Close the command list, submit it, and signal the fence value of the submission
+uint64_t AsyncBuildQueue::Submit()
+{
+  if (!m_recording)
+  {
+    throw std::logic_error("Submitting builds without calling Begin");
+  }
+  m_recording = false;
+  if (FAILED(m_commandList->Close()))
+  {
+    throw std::logic_error("Could not close the async build command list");
+  }
+  ID3D12CommandList* ppCommandLists[] = {m_commandList};
+  m_queue->ExecuteCommandLists(1, ppCommandLists);
+  if (FAILED(m_queue->Signal(m_fence, m_nextFenceValue)))
+  {
+    throw std::logic_error("Could not signal the async build fence");
+  }
+  m_submissions[m_currentSubmission].fenceValue = m_nextFenceValue;
+  return m_nextFenceValue++;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// The wait is enqueued on the compute queue, and only delays the work submitted after it
+void AsyncBuildQueue::WaitOnGpu(ID3D12Fence* fence, uint64_t fenceValue)
+{
+  if (FAILED(m_queue->Wait(fence, fenceValue)))
+  {
+    throw std::logic_error("Could not wait for a fence on the async build queue");
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// The wait is enqueued on the other queue, and only delays the work submitted after it
+void AsyncBuildQueue::MakeQueueWait(ID3D12CommandQueue* queue, uint64_t fenceValue) const
+{
+  if (FAILED(queue->Wait(m_fence, fenceValue)))
+  {
+    throw std::logic_error("Could not wait for the async build fence");
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// The last submission signaled the highest fence value, and the queue executes them in order
+void AsyncBuildQueue::WaitForIdle()
+{
+  if (m_fence == nullptr)
+  {
+    return;
+  }
+  WaitForFenceValue(m_nextFenceValue - 1);
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Block until the fence has reached the value
+void AsyncBuildQueue::WaitForFenceValue(uint64_t value)
+{
+  if (m_fence->GetCompletedValue() >= value)
+  {
+    return;
+  }
+  if (FAILED(m_fence->SetEventOnCompletion(value, m_fenceEvent)))
+  {
+    throw std::logic_error("Could not wait for the async build fence");
+  }
+  WaitForSingleObject(m_fenceEvent, INFINITE);
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Release all the objects. The GPU must be idle
+void AsyncBuildQueue::Release()
+{
+  if (m_commandList)
+  {
+    m_commandList->Release();
+    m_commandList = nullptr;
+  }
+  for (Submission& submission : m_submissions)
+  {
+    if (submission.allocator)
+    {
+      submission.allocator->Release();
+    }
+  }
+  m_submissions.clear();
+  if (m_fenceEvent)
+  {
+    CloseHandle(m_fenceEvent);
+    m_fenceEvent = nullptr;
+  }
+  if (m_fence)
+  {
+    m_fence->Release();
+    m_fence = nullptr;
+  }
+  if (m_queue)
+  {
+    m_queue->Release();
+    m_queue = nullptr;
+  }
+  m_currentSubmission = 0;
+  m_recording = false;
+  m_nextFenceValue = 1;
+  m_stallCount = 0;
+}
+
+} // namespace nv_helpers_dx12
@@ -30,6 +30,7 @@ Contacts for feedback:
 */
 
 #include "BottomLevelASGenerator.h"
+#include "ResourceStateTracker.h"
 #include <stdexcept>
 
 // Helper to compute aligned buffer sizes
@@ -184,9 +185,11 @@ void BottomLevelASGenerator::Generate(
         *resultBuffer, // Result buffer storing the acceleration structure
     bool updateOnly,   // If true, simply refit the existing
                        // acceleration structure
-    ID3D12Resource *previousResult // Optional previous acceleration
-                                   // structure, used if an iterative update
-                                   // is requested
+    ID3D12Resource *previousResult, // Optional previous acceleration
+                                    // structure, used if an iterative update
+                                    // is requested
+    ResourceStateTracker *stateTracker // Optional tracker in which to queue
+                                       // the UAV barrier on the result
 ) {
 
   D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAGS flags = m_flags;
@@ -237,7 +240,13 @@ void BottomLevelASGenerator::Generate(
   // Wait for the builder to complete by setting a barrier on the resulting
   // buffer. This is particularly important as the construction of the top-level
   // hierarchy may be called right afterwards, before executing the command
-  // list.
+  // list. With a state tracker the barrier is only queued, so that the
+  // independent builds enqueued next can overlap with this one. All the queued
+  // barriers are then recorded at once, before the top-level build.
+  if (stateTracker) {
+    stateTracker->UAVBarrier(resultBuffer);
+    return;
+  }
   D3D12_RESOURCE_BARRIER uavBarrier;
   uavBarrier.Type = D3D12_RESOURCE_BARRIER_TYPE_UAV;
   uavBarrier.UAV.pResource = resultBuffer;
@@ -0,0 +1,284 @@
+/*
+The chunked builder creates the bottom-level hierarchies of meshes which are too large to be
+uploaded at once. See ChunkedBottomLevelASBuilder.h for an overview.
+*/
+
+#include "ChunkedBottomLevelASBuilder.h"
+#include "BottomLevelASGenerator.h"
+#include "d3dx12.h"
+
+#include <cstring>
+#include <stdexcept>
+
+namespace nv_helpers_dx12
+{
+
+using Microsoft::WRL::ComPtr;
+
+namespace
+{
+//--------------------------------------------------------------------------------------------------
+//
+// Allocate a buffer used by the chunked builder
+ComPtr<ID3D12Resource> CreateChunkBuffer(ID3D12Device* device, uint64_t size,
+                                         D3D12_HEAP_TYPE heapType, D3D12_RESOURCE_FLAGS flags,
+                                         D3D12_RESOURCE_STATES initState)
+{
+  CD3DX12_HEAP_PROPERTIES heapProps(heapType);
+  CD3DX12_RESOURCE_DESC bufDesc = CD3DX12_RESOURCE_DESC::Buffer(size, flags);
+
+  ComPtr<ID3D12Resource> pBuffer;
+  HRESULT hr = device->CreateCommittedResource(&heapProps, D3D12_HEAP_FLAG_NONE, &bufDesc,
+                                               initState, nullptr, IID_PPV_ARGS(&pBuffer));
+  if (FAILED(hr))
+  {
+    throw std::logic_error("Could not allocate a chunked acceleration structure buffer");
+  }
+  return pBuffer;
+}
+} // namespace
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+IndexedMeshChunkSource::IndexedMeshChunkSource(const void* vertices, UINT vertexStride,
+                                               uint32_t vertexCount, const UINT* indices,
+                                               uint32_t indexCount)
+    : m_vertices(static_cast<const uint8_t*>(vertices)), m_vertexStride(vertexStride),
+      m_vertexCount(vertexCount), m_indices(indices),
+      m_indexCount(indices ? indexCount : vertexCount)
+{
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Copy the next range of triangles, stopping at the first triangle which would not fit in either
+// the vertex or the index array
+bool IndexedMeshChunkSource::NextChunk(uint32_t maxVertices, uint32_t maxIndices, void* vertices,
+                                       UINT* indices, uint32_t* vertexCount, uint32_t* indexCount)
+{
+  if (maxVertices < 3 || maxIndices < 3)
+  {
+    throw std::logic_error("A geometry chunk must hold at least one triangle");
+  }
+
+  uint8_t* dstVertices = static_cast<uint8_t*>(vertices);
+  uint32_t localVertexCount = 0;
+  uint32_t localIndexCount = 0;
+  m_remap.clear();
+
+  while (m_cursor + 3 <= m_indexCount && localIndexCount + 3 <= maxIndices)
+  {
+    // Count the vertices of the triangle which are not yet in the chunk, and keep the triangle
+    // for the next chunk if they do not fit
+    UINT triangle[3];
+    uint32_t newVertices = 0;
+    for (uint32_t i = 0; i < 3; i++)
+    {
+      triangle[i] = m_indices ? m_indices[m_cursor + i] : m_cursor + i;
+      if (triangle[i] >= m_vertexCount)
+      {
+        throw std::logic_error("Vertex index out of range in the geometry chunk source");
+      }
+      if (m_remap.find(triangle[i]) == m_remap.end())
+      {
+        newVertices++;
+      }
+    }
+    if (localVertexCount + newVertices > maxVertices)
+    {
+      break;
+    }
+
+    for (uint32_t i = 0; i < 3; i++)
+    {
+      auto inserted = m_remap.emplace(triangle[i], localVertexCount);
+      if (inserted.second)
+      {
+        memcpy(dstVertices + static_cast<size_t>(localVertexCount) * m_vertexStride,
+               m_vertices + static_cast<size_t>(triangle[i]) * m_vertexStride, m_vertexStride);
+        localVertexCount++;
+      }
+      indices[localIndexCount++] = inserted.first->second;
+    }
+    m_cursor += 3;
+  }
+
+  *vertexCount = localVertexCount;
+  *indexCount = localIndexCount;
+  return localIndexCount > 0;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Allocate the upload buffers of the slots, which stay mapped for the lifetime of the builder, as
+// well as the command lists and the fence used to track their reuse. If this throws, the objects
+// created so far are released along with the members, no GPU work having been submitted yet
+ChunkedBottomLevelASBuilder::ChunkedBottomLevelASBuilder(ID3D12Device5* device,
+                                                         ID3D12CommandQueue* queue,
+                                                         UINT vertexStride,
+                                                         uint32_t maxVerticesPerChunk,
+                                                         uint32_t maxTrianglesPerChunk)
+    : m_device(device), m_queue(queue), m_vertexStride(vertexStride),
+      m_maxVertices(maxVerticesPerChunk), m_maxIndices(3 * maxTrianglesPerChunk)
+{
+  if (m_vertexStride < 3 * sizeof(float) || m_maxVertices < 3 || m_maxIndices < 3)
+  {
+    throw std::logic_error("Invalid chunk size for the chunked acceleration structure builder");
+  }
+
+  D3D12_COMMAND_LIST_TYPE listType = m_queue->GetDesc().Type;
+  for (Slot& slot : m_slots)
+  {
+    slot.vertexBuffer = CreateChunkBuffer(
+        m_device, static_cast<uint64_t>(m_maxVertices) * m_vertexStride, D3D12_HEAP_TYPE_UPLOAD,
+        D3D12_RESOURCE_FLAG_NONE, D3D12_RESOURCE_STATE_GENERIC_READ);
+    slot.indexBuffer = CreateChunkBuffer(m_device, static_cast<uint64_t>(m_maxIndices) * sizeof(UINT),
+                                         D3D12_HEAP_TYPE_UPLOAD, D3D12_RESOURCE_FLAG_NONE,
+                                         D3D12_RESOURCE_STATE_GENERIC_READ);
+
+    // The CPU never reads from the upload buffers
+    D3D12_RANGE readRange = {0, 0};
+    void* pData = nullptr;
+    if (FAILED(slot.vertexBuffer->Map(0, &readRange, &pData)))
+    {
+      throw std::logic_error("Could not map a chunk vertex buffer");
+    }
+    slot.mappedVertices = static_cast<uint8_t*>(pData);
+    if (FAILED(slot.indexBuffer->Map(0, &readRange, &pData)))
+    {
+      throw std::logic_error("Could not map a chunk index buffer");
+    }
+    slot.mappedIndices = static_cast<UINT*>(pData);
+
+    if (FAILED(m_device->CreateCommandAllocator(listType, IID_PPV_ARGS(&slot.allocator))) ||
+        FAILED(m_device->CreateCommandList(0, listType, slot.allocator.Get(), nullptr,
+                                           IID_PPV_ARGS(&slot.commandList))))
+    {
+      throw std::logic_error("Could not create the chunked builder command list");
+    }
+    slot.commandList->Close();
+  }
+
+  if (FAILED(m_device->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&m_fence))))
+  {
+    throw std::logic_error("Could not create the chunked builder fence");
+  }
+  m_fenceEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+  if (m_fenceEvent == nullptr)
+  {
+    throw std::logic_error("Could not create the chunked builder fence event");
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Wait for the pending builds before the buffers they use are released along with the members
+ChunkedBottomLevelASBuilder::~ChunkedBottomLevelASBuilder()
+{
+  WaitForFence(m_lastFenceValue);
+  CloseHandle(m_fenceEvent);
+  for (Slot& slot : m_slots)
+  {
+    slot.vertexBuffer->Unmap(0, nullptr);
+    slot.indexBuffer->Unmap(0, nullptr);
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Pull all the chunks of the source and build their bottom-level hierarchies. Each chunk is written
+// into the upload buffers of the next slot, once the GPU is done with the previous chunk of that
+// slot, so that the generation of a chunk overlaps with the build of the previous one. If a chunk
+// throws, the pending builds are waited for before the hierarchies they write to are released
+std::vector<ComPtr<ID3D12Resource>> ChunkedBottomLevelASBuilder::Build(GeometryChunkSource& source,
+                                                                       bool allowUpdate)
+{
+  std::vector<ComPtr<ID3D12Resource>> results;
+
+  try
+  {
+    BuildChunks(source, allowUpdate, results);
+  }
+  catch (...)
+  {
+    WaitForFence(m_lastFenceValue);
+    throw;
+  }
+
+  WaitForFence(m_lastFenceValue);
+  return results;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Build the chunks of the source, adding each hierarchy to the results as soon as it is created
+void ChunkedBottomLevelASBuilder::BuildChunks(GeometryChunkSource& source, bool allowUpdate,
+                                              std::vector<ComPtr<ID3D12Resource>>& results)
+{
+  for (uint32_t chunkIndex = 0;; chunkIndex++)
+  {
+    Slot& slot = m_slots[chunkIndex % kSlotCount];
+    WaitForFence(slot.fenceValue);
+
+    uint32_t vertexCount = 0;
+    uint32_t indexCount = 0;
+    if (!source.NextChunk(m_maxVertices, m_maxIndices, slot.mappedVertices, slot.mappedIndices,
+                          &vertexCount, &indexCount))
+    {
+      break;
+    }
+
+    BottomLevelASGenerator bottomLevelAS;
+    bottomLevelAS.AddVertexBuffer(slot.vertexBuffer.Get(), 0, vertexCount, m_vertexStride,
+                                  slot.indexBuffer.Get(), 0, indexCount, nullptr, 0);
+
+    UINT64 scratchSizeInBytes = 0;
+    UINT64 resultSizeInBytes = 0;
+    bottomLevelAS.ComputeASBufferSizes(m_device, allowUpdate, &scratchSizeInBytes,
+                                       &resultSizeInBytes);
+
+    // The scratch buffer of the slot only grows, and is not used by any pending build at this
+    // point since the slot fence has been reached
+    if (scratchSizeInBytes > slot.scratchSizeInBytes)
+    {
+      slot.scratchBuffer = CreateChunkBuffer(m_device, scratchSizeInBytes,
+                                             D3D12_HEAP_TYPE_DEFAULT,
+                                             D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS,
+                                             D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+      slot.scratchSizeInBytes = scratchSizeInBytes;
+    }
+
+    results.push_back(CreateChunkBuffer(m_device, resultSizeInBytes, D3D12_HEAP_TYPE_DEFAULT,
+                                        D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS,
+                                        D3D12_RESOURCE_STATE_RAYTRACING_ACCELERATION_STRUCTURE));
+
+    slot.allocator->Reset();
+    slot.commandList->Reset(slot.allocator.Get(), nullptr);
+    bottomLevelAS.Generate(slot.commandList.Get(), slot.scratchBuffer.Get(),
+                           results.back().Get());
+    if (FAILED(slot.commandList->Close()))
+    {
+      throw std::logic_error("Could not close the chunked builder command list");
+    }
+
+    ID3D12CommandList* ppCommandLists[] = {slot.commandList.Get()};
+    m_queue->ExecuteCommandLists(1, ppCommandLists);
+    slot.fenceValue = ++m_lastFenceValue;
+    m_queue->Signal(m_fence.Get(), slot.fenceValue);
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Block until the GPU has reached the fence value
+void ChunkedBottomLevelASBuilder::WaitForFence(UINT64 value)
+{
+  if (m_fence->GetCompletedValue() < value)
+  {
+    m_fence->SetEventOnCompletion(value, m_fenceEvent);
+    WaitForSingleObject(m_fenceEvent, INFINITE);
+  }
+}
+
+} // namespace nv_helpers_dx12
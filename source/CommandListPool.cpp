@@ -0,0 +1,195 @@
+/*
+The command list pool hands out command lists with their own allocators, recycled once the GPU has
+completed their frame. See CommandListPool.h for an overview.
+*/
+
+#include "CommandListPool.h"
+
+#include <stdexcept>
+
+namespace nv_helpers_dx12
+{
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+CommandListPool::~CommandListPool()
+{
+  Release();
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+void CommandListPool::Initialize(ID3D12Device* device, ID3D12CommandQueue* queue,
+                                 D3D12_COMMAND_LIST_TYPE type)
+{
+  Release();
+  m_device = device;
+  m_queue = queue;
+  m_type = type;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Get an available command list, or create one. The allocator is reset along with the list, as
+// nothing recorded with it is still executing
+ID3D12GraphicsCommandList4* CommandListPool::BeginCommandList()
+{
+  Entry entry;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_available.empty())
+    {
+      entry = m_available.back();
+      m_available.pop_back();
+    }
+  }
+
+  if (entry.commandList == nullptr)
+  {
+    if (FAILED(m_device->CreateCommandAllocator(m_type, IID_PPV_ARGS(&entry.allocator))))
+    {
+      throw std::logic_error("Could not create a pooled command allocator");
+    }
+    if (FAILED(m_device->CreateCommandList(0, m_type, entry.allocator, nullptr,
+                                           IID_PPV_ARGS(&entry.commandList))))
+    {
+      entry.allocator->Release();
+      throw std::logic_error("Could not create a pooled command list");
+    }
+  }
+  else if (FAILED(entry.allocator->Reset()) ||
+           FAILED(entry.commandList->Reset(entry.allocator, nullptr)))
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_available.push_back(entry);
+    throw std::logic_error("Could not reset a pooled command list");
+  }
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_recording[entry.commandList] = entry;
+  return entry.commandList;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+void CommandListPool::EndCommandList(ID3D12GraphicsCommandList4* commandList)
+{
+  if (FAILED(commandList->Close()))
+  {
+    throw std::logic_error("Could not close a pooled command list");
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Execute the command lists, which stay out of the pool until their frame has completed
+void CommandListPool::Submit(ID3D12GraphicsCommandList4* const* commandLists, uint32_t count)
+{
+  std::vector<ID3D12CommandList*> lists(commandLists, commandLists + count);
+  m_queue->ExecuteCommandLists(count, lists.data());
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+  for (uint32_t i = 0; i < count; i++)
+  {
+    auto it = m_recording.find(commandLists[i]);
+    if (it == m_recording.end())
+    {
+      throw std::logic_error("Submitting a command list which does not belong to the pool");
+    }
+    m_submitted.push_back(it->second);
+    m_recording.erase(it);
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// The list may still be open if its pass threw while recording. It is closed either way, as
+// BeginCommandList resets it, and Close fails harmlessly on a list which is already closed. None
+// of its commands has been executed, so it is available right away
+void CommandListPool::AbortCommandList(ID3D12GraphicsCommandList4* commandList)
+{
+  commandList->Close();
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+  auto it = m_recording.find(commandList);
+  if (it != m_recording.end())
+  {
+    m_available.push_back(it->second);
+    m_recording.erase(it);
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+void CommandListPool::FinishFrame(uint64_t fenceValue)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  for (Entry& entry : m_submitted)
+  {
+    entry.fenceValue = fenceValue;
+    m_inFlight.push_back(entry);
+  }
+  m_submitted.clear();
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// The frames complete in order, so the completed entries are at the front of the list
+void CommandListPool::Reclaim(uint64_t completedFenceValue)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  while (!m_inFlight.empty() && m_inFlight.front().fenceValue <= completedFenceValue)
+  {
+    m_available.push_back(m_inFlight.front());
+    m_inFlight.pop_front();
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+uint32_t CommandListPool::GetCommandListCount() const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return static_cast<uint32_t>(m_available.size() + m_recording.size() + m_submitted.size() +
+                               m_inFlight.size());
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Release all the command lists and allocators. The GPU must be idle
+void CommandListPool::Release()
+{
+  auto releaseEntry = [](Entry& entry) {
+    entry.commandList->Release();
+    entry.allocator->Release();
+  };
+  for (Entry& entry : m_available)
+  {
+    releaseEntry(entry);
+  }
+  for (auto& recording : m_recording)
+  {
+    releaseEntry(recording.second);
+  }
+  for (Entry& entry : m_submitted)
+  {
+    releaseEntry(entry);
+  }
+  for (Entry& entry : m_inFlight)
+  {
+    releaseEntry(entry);
+  }
+  m_available.clear();
+  m_recording.clear();
+  m_submitted.clear();
+  m_inFlight.clear();
+  m_device = nullptr;
+  m_queue = nullptr;
+}
+
+} // namespace nv_helpers_dx12
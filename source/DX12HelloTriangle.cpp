@@ -8,8 +8,10 @@
 #include "BottomLevelASGenerator.h"
 #include "RaytracingPipelineGenerator.h"
 #include "RootSignatureGenerator.h"
+#include "RootSignatureCache.h"
+#include "ShaderCache.h"
+#include <chrono>
 #include "gtc/type_ptr.hpp"
-#include "Windowsx.h"
 
 DX12HelloTriangle::DX12HelloTriangle(uint32_t viewportWidth, uint32_t viewportHeight, std::wstring name) : DXPipeline(viewportWidth, viewportHeight, name),
 																										   m_frameIndex(0),
@@ -25,13 +27,11 @@ void DX12HelloTriangle::OnInit()
 
 	CheckRaytracingSupport();
 	CreateAccelerationStructures();
-	ThrowIfFailed(m_commandList->Close());
 
 	CreateRaytracingPipeline();
-	CreatePerInstanceConstantBuffers();
+	InitInstanceColors();
 	CreateGlobalConstantBuffer();
 	CreateRaytracingOutputBuffer();
-	CreateCameraBuffer();
 	InitCamera();
 
 
@@ -41,30 +41,42 @@ void DX12HelloTriangle::OnInit()
 
 void DX12HelloTriangle::OnUpdate()
 {
-	UpdateCameraBuffer();
+	UpdateShaderReload();
+	UpdateTopLevelAS();
 }
 
 void DX12HelloTriangle::OnRender()
 {
+	// Records the passes of the frame and submits them
 	PopulateCommandList();
 
-	// Execute command list
-	ID3D12CommandList *ppCommandLists[] = {m_commandList.Get()};
-	m_commandQueue->ExecuteCommandLists(_countof(ppCommandLists), ppCommandLists);
-
-	// Present the frame
-	ThrowIfFailed(m_swapchain->Present(1, 0));
-
-	WaitForPreviousFrame();
+	// Present the frame. The offline rendering has no swapchain, the frame is
+	// read back by PopCapturedFrame once the GPU has completed it
+	if (!IsHeadless())
+		ThrowIfFailed(m_swapchain->Present(1, 0));
+
+	// The constants allocated by this frame are reclaimed once it completes.
+	// The next frame is recorded while the GPU executes this one, it only waits
+	// when the CPU gets frameCount frames ahead
+	m_uploadRing.FinishFrame(m_frameRing.GetFrameFenceValue());
+	m_commandListPool.FinishFrame(m_frameRing.GetFrameFenceValue());
+	m_frameRing.EndFrame();
+	m_frameIndex = IsHeadless() ? (m_frameIndex + 1) % frameCount : m_swapchain->GetCurrentBackBufferIndex();
 }
 
 void DX12HelloTriangle::OnDestroy()
 {
+	// Stop the shader hot reload before the objects it uses are destroyed
+	m_shaderWatcher.Stop();
+	if (m_pipelineReload.valid())
+		m_pipelineReload.wait();
+
 	// Ensure that the GPU is no longer referencing resources that are about to be
 	// cleaned up by the destructor.
-	WaitForPreviousFrame();
+	WaitForGpu();
 
-	CloseHandle(m_fenceEvent);
+	// The cache is a singleton, its root signatures would otherwise outlive the device
+	nv_helpers_dx12::RootSignatureCache::Get().Clear();
 }
 
 void DX12HelloTriangle::InitPipelineObjects()
@@ -104,6 +116,9 @@ void DX12HelloTriangle::InitPipelineObjects()
 		ThrowIfFailed(D3D12CreateDevice(hardwareAdapter.Get(), D3D_FEATURE_LEVEL_12_1, IID_PPV_ARGS(&m_device)));
 	}
 
+	// Heaps in which the buffers are placed
+	m_resourceAllocator.Initialize(m_device.Get());
+
 	// Command queue
 	D3D12_COMMAND_QUEUE_DESC queueDescription = {};
 	queueDescription.Flags = D3D12_COMMAND_QUEUE_FLAG_NONE;
@@ -111,27 +126,44 @@ void DX12HelloTriangle::InitPipelineObjects()
 
 	ThrowIfFailed(m_device->CreateCommandQueue(&queueDescription, IID_PPV_ARGS(&m_commandQueue)));
 
-	// Swapchain
-	DXGI_SWAP_CHAIN_DESC1 swapchainDescription = {};
-	swapchainDescription.BufferCount = frameCount;
-	swapchainDescription.Width = m_width;
-	swapchainDescription.Height = m_height;
-	swapchainDescription.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
-	swapchainDescription.BufferUsage = DXGI_USAGE_RENDER_TARGET_OUTPUT;
-	swapchainDescription.SwapEffect = DXGI_SWAP_EFFECT_FLIP_DISCARD;
-	swapchainDescription.SampleDesc.Count = 1;
-
-	ComPtr<IDXGISwapChain1> swapchain;
-	ThrowIfFailed(factory->CreateSwapChainForHwnd(
-		m_commandQueue.Get(),
-		Win32Application::GetHwnd(),
-		&swapchainDescription,
-		nullptr, // full screen desc
-		nullptr, // restrict to output
-		&swapchain));
-
-	ThrowIfFailed(swapchain.As(&m_swapchain));
-	m_frameIndex = m_swapchain->GetCurrentBackBufferIndex();
+	// Command allocators and fence values of the frames in flight
+	m_frameRing.Initialize(m_device.Get(), m_commandQueue.Get(), frameCount);
+	// Per-frame constants of all the frames in flight
+	m_uploadRing.Initialize(m_device.Get(), uploadRingSize);
+	// Command lists of the frame passes, each with its own allocator
+	m_commandListPool.Initialize(m_device.Get(), m_commandQueue.Get());
+	// Compute queue for the AS builds, with one allocator per TLAS version
+	m_buildQueue.Initialize(m_device.Get(), tlasVersionCount);
+
+	// Swapchain. The offline rendering has no window, and renders into
+	// textures instead
+	if (IsHeadless())
+	{
+		m_frameIndex = 0;
+	}
+	else
+	{
+		DXGI_SWAP_CHAIN_DESC1 swapchainDescription = {};
+		swapchainDescription.BufferCount = frameCount;
+		swapchainDescription.Width = m_width;
+		swapchainDescription.Height = m_height;
+		swapchainDescription.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+		swapchainDescription.BufferUsage = DXGI_USAGE_RENDER_TARGET_OUTPUT;
+		swapchainDescription.SwapEffect = DXGI_SWAP_EFFECT_FLIP_DISCARD;
+		swapchainDescription.SampleDesc.Count = 1;
+
+		ComPtr<IDXGISwapChain1> swapchain;
+		ThrowIfFailed(factory->CreateSwapChainForHwnd(
+			m_commandQueue.Get(),
+			static_cast<HWND>(GetPlatform()->GetNativeWindow()),
+			&swapchainDescription,
+			nullptr, // full screen desc
+			nullptr, // restrict to output
+			&swapchain));
+
+		ThrowIfFailed(swapchain.As(&m_swapchain));
+		m_frameIndex = m_swapchain->GetCurrentBackBufferIndex();
+	}
 
 	// Descriptor heaps
 	D3D12_DESCRIPTOR_HEAP_DESC heapDescription = {};
@@ -147,21 +179,86 @@ void DX12HelloTriangle::InitPipelineObjects()
 	// RTV for each frame
 	for (uint32_t n = 0; n < frameCount; n++)
 	{
-		ThrowIfFailed(m_swapchain->GetBuffer(n, IID_PPV_ARGS(&m_renderTargets[n])));
+		if (IsHeadless())
+		{
+			CD3DX12_HEAP_PROPERTIES heapProperties(D3D12_HEAP_TYPE_DEFAULT);
+			CD3DX12_RESOURCE_DESC textureDesc = CD3DX12_RESOURCE_DESC::Tex2D(
+				DXGI_FORMAT_R8G8B8A8_UNORM, m_width, m_height, 1, 1, 1, 0, D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET);
+			ThrowIfFailed(m_device->CreateCommittedResource(
+				&heapProperties,
+				D3D12_HEAP_FLAG_NONE,
+				&textureDesc,
+				D3D12_RESOURCE_STATE_PRESENT,
+				nullptr,
+				IID_PPV_ARGS(&m_renderTargets[n])));
+		}
+		else
+		{
+			ThrowIfFailed(m_swapchain->GetBuffer(n, IID_PPV_ARGS(&m_renderTargets[n])));
+		}
 		m_device->CreateRenderTargetView(m_renderTargets[n].Get(), nullptr, descriptorHandle);
+		m_stateTracker.SetState(m_renderTargets[n].Get(), D3D12_RESOURCE_STATE_PRESENT);
 		descriptorHandle.Offset(1, m_rtvDescriptorSize);
 	}
 
-	ThrowIfFailed(m_device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&m_commandAllocator)));
+	// The offline frames are copied to the readback buffer of their slot of
+	// the ring, which is not overwritten before the GPU has completed them
+	if (IsHeadless())
+	{
+		D3D12_RESOURCE_DESC textureDesc = m_renderTargets[0]->GetDesc();
+		UINT64 readbackSize = 0;
+		m_device->GetCopyableFootprints(&textureDesc, 0, 1, 0, &m_readbackFootprint, nullptr, nullptr, &readbackSize);
+
+		CD3DX12_HEAP_PROPERTIES heapProperties(D3D12_HEAP_TYPE_READBACK);
+		CD3DX12_RESOURCE_DESC bufferDesc = CD3DX12_RESOURCE_DESC::Buffer(readbackSize);
+		for (uint32_t n = 0; n < frameCount; n++)
+		{
+			ThrowIfFailed(m_device->CreateCommittedResource(
+				&heapProperties,
+				D3D12_HEAP_FLAG_NONE,
+				&bufferDesc,
+				D3D12_RESOURCE_STATE_COPY_DEST,
+				nullptr,
+				IID_PPV_ARGS(&m_readbackBuffers[n])));
+		}
+	}
+}
+
+// Helper function for acquiring the first available hardware adapter that supports Direct3D 12.
+// If no such adapter can be found, *ppAdapter will be set to nullptr.
+_Use_decl_annotations_ void DX12HelloTriangle::GetHardwareAdapter(IDXGIFactory2 *pFactory, IDXGIAdapter1 **ppAdapter)
+{
+	ComPtr<IDXGIAdapter1> adapter;
+	*ppAdapter = nullptr;
+
+	for (UINT adapterIndex = 0; DXGI_ERROR_NOT_FOUND != pFactory->EnumAdapters1(adapterIndex, &adapter); ++adapterIndex)
+	{
+		DXGI_ADAPTER_DESC1 desc;
+		adapter->GetDesc1(&desc);
+
+		if (desc.Flags & DXGI_ADAPTER_FLAG_SOFTWARE)
+		{
+			// Don't select the Basic Render Driver adapter.
+			// If you want a software adapter, pass in "/warp" on the command line.
+			continue;
+		}
+
+		// Check to see if the adapter supports Direct3D 12, but don't create the
+		// actual device yet.
+		if (SUCCEEDED(D3D12CreateDevice(adapter.Get(), D3D_FEATURE_LEVEL_11_0, _uuidof(ID3D12Device), nullptr)))
+		{
+			break;
+		}
+	}
+
+	*ppAdapter = adapter.Detach();
 }
 
 void DX12HelloTriangle::LoadAssets()
 {
-	// Camera constant buffer
+	// Camera constant buffer, bound directly from the upload ring
 	CD3DX12_ROOT_PARAMETER constantParameter;
-	CD3DX12_DESCRIPTOR_RANGE range;
-	range.Init(D3D12_DESCRIPTOR_RANGE_TYPE_CBV, 1, 0);
-	constantParameter.InitAsDescriptorTable(1, &range, D3D12_SHADER_VISIBILITY_ALL);
+	constantParameter.InitAsConstantBufferView(0, 0, D3D12_SHADER_VISIBILITY_ALL);
 
 	// Root signature
 	CD3DX12_ROOT_SIGNATURE_DESC rootSignatureDescription;
@@ -210,14 +307,6 @@ void DX12HelloTriangle::LoadAssets()
 	psoDesc.SampleDesc.Count = 1;
 	ThrowIfFailed(m_device->CreateGraphicsPipelineState(&psoDesc, IID_PPV_ARGS(&m_pipelineState)));
 
-	// Create command list
-	ThrowIfFailed(m_device->CreateCommandList(
-		0,
-		D3D12_COMMAND_LIST_TYPE_DIRECT,
-		m_commandAllocator.Get(),
-		m_pipelineState.Get(),
-		IID_PPV_ARGS(&m_commandList)));
-
 	// Create vertex buffer
 	{
 		Vertex triangleVertices[] =
@@ -254,92 +343,92 @@ void DX12HelloTriangle::LoadAssets()
 
 	CreatePlaneBV();
 
-	// Create synchronization objects and wait until assets have been uploaded to the GPU.
-	ThrowIfFailed(m_device->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&m_fence)));
-	m_fenceValue = 1;
-
-	// Create an event handle to use for frame synchronization
-	m_fenceEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
-	if (m_fenceEvent == nullptr)
-	{
-		ThrowIfFailed(HRESULT_FROM_WIN32(GetLastError()));
-	}
-
-	// Wait for the command list to execute
-	WaitForPreviousFrame();
+	// Wait until assets have been uploaded to the GPU
+	WaitForGpu();
 }
 
 void DX12HelloTriangle::PopulateCommandList()
 {
-	// Technically fences should be used here
-	// to determine GPU execution progress
-	ThrowIfFailed(m_commandAllocator->Reset());
-
-	// However, when using ExecuteCommandList(),
-	// command list can be reset at any time and must
-	// be before re-recording
-	ThrowIfFailed(m_commandList->Reset(m_commandAllocator.Get(), m_pipelineState.Get()));
-
-	// Set necessary state
-	m_commandList->SetGraphicsRootSignature(m_rootSignature.Get());
-	m_commandList->RSSetViewports(1, &m_viewport);
-	m_commandList->RSSetScissorRects(1, &m_scissorRect);
-
-	// Indicates that the back buffer will be used as a render target
-	CD3DX12_RESOURCE_BARRIER barrier = CD3DX12_RESOURCE_BARRIER::Transition(
-		m_renderTargets[m_frameIndex].Get(),
-		D3D12_RESOURCE_STATE_PRESENT,
-		D3D12_RESOURCE_STATE_RENDER_TARGET);
-
-	m_commandList->ResourceBarrier(1, &barrier);
+	// Only waits for the GPU to complete the frame which last used the slot,
+	// the commands are recorded with the allocators of m_commandListPool
+	m_frameRing.BeginFrame();
+	m_uploadRing.Reclaim(m_frameRing.GetCompletedFenceValue());
+	m_commandListPool.Reclaim(m_frameRing.GetCompletedFenceValue());
+	// The frame which last used the readback buffer of the slot is complete
+	ReadCompletedCaptures();
+	// Reuse the heap ranges of the buffers freed by the completed frames, such
+	// as the scratch buffers of the AS builds
+	m_resourceAllocator.Reclaim(m_frameRing.GetCompletedFenceValue());
+	m_descriptorAllocator.BeginFrame(m_frameRing.GetFrameIndex());
+	m_descriptorAllocator.Reclaim(m_frameRing.GetCompletedFenceValue());
+	// The TLAS version traced by this frame is not overwritten before it completes
+	m_tlasVersionFenceValues[m_tlasVersion] = m_frameRing.GetFrameFenceValue();
 
-	CD3DX12_CPU_DESCRIPTOR_HANDLE rtvHandle(
-		m_rtvHeap->GetCPUDescriptorHandleForHeapStart(),
-		m_frameIndex,
-		m_rtvDescriptorSize);
+	UpdateCameraBuffer();
 
-	m_commandList->OMSetRenderTargets(1, &rtvHandle, FALSE, nullptr);
+	ID3D12Resource *renderTarget = m_renderTargets[m_frameIndex].Get();
 
-	// Record commands
+	// The frame is split into passes: the scene, the copy of the RT output,
+	// the offline capture and the present barrier. Everything depending on the
+	// submission order, the resource states and the SBT update, is resolved
+	// here, and the passes only record the barriers flushed for them and their
+	// commands, possibly on worker threads
+	std::vector<D3D12_RESOURCE_BARRIER> sceneBarriers;
 	if (m_raster)
 	{
-		std::vector<ID3D12DescriptorHeap *> heaps = {m_constHeap.Get()};
-		m_commandList->SetDescriptorHeaps(static_cast<UINT>(heaps.size()), heaps.data());
-
-		m_commandList->SetGraphicsRootDescriptorTable(0, m_constHeap->GetGPUDescriptorHandleForHeapStart());
-
-		const float clearCoat[] = {0.f, 0.2f, 0.4f, 1.0f};
-		m_commandList->ClearRenderTargetView(rtvHandle, clearCoat, 0, nullptr);
-		m_commandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-		m_commandList->IASetVertexBuffers(0, 1, &m_vertexBufferView);
-		m_commandList->DrawInstanced(3, 3, 0, 0);
-
-		m_commandList->IASetVertexBuffers(0, 1, &m_planeBufferView);
-		m_commandList->DrawInstanced(6, 1, 0, 0);
+		// Indicates that the back buffer will be used as a render target
+		m_stateTracker.Transition(renderTarget, D3D12_RESOURCE_STATE_RENDER_TARGET);
+		m_stateTracker.Flush(sceneBarriers);
+
+		CD3DX12_CPU_DESCRIPTOR_HANDLE rtvHandle(
+			m_rtvHeap->GetCPUDescriptorHandleForHeapStart(),
+			m_frameIndex,
+			m_rtvDescriptorSize);
+
+		m_frameRecorder.AddPass([&, rtvHandle](ID3D12GraphicsCommandList4 *commandList) {
+			commandList->ResourceBarrier(static_cast<UINT>(sceneBarriers.size()), sceneBarriers.data());
+
+			// Set necessary state
+			commandList->SetPipelineState(m_pipelineState.Get());
+			commandList->SetGraphicsRootSignature(m_rootSignature.Get());
+			commandList->RSSetViewports(1, &m_viewport);
+			commandList->RSSetScissorRects(1, &m_scissorRect);
+			commandList->OMSetRenderTargets(1, &rtvHandle, FALSE, nullptr);
+			commandList->SetGraphicsRootConstantBufferView(0, m_cameraAddress);
+
+			const float clearCoat[] = {0.f, 0.2f, 0.4f, 1.0f};
+			commandList->ClearRenderTargetView(rtvHandle, clearCoat, 0, nullptr);
+			commandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+			commandList->IASetVertexBuffers(0, 1, &m_vertexBufferView);
+			commandList->DrawInstanced(3, 3, 0, 0);
+
+			commandList->IASetVertexBuffers(0, 1, &m_planeBufferView);
+			commandList->DrawInstanced(6, 1, 0, 0);
+		});
 	}
 	else
 	{
-		// Set desctiptor heaps
-		std::vector<ID3D12DescriptorHeap *> heaps = {m_srvUavHeap.Get()};
-		m_commandList->SetDescriptorHeaps(static_cast<UINT>(heaps.size()), heaps.data());
-		CD3DX12_RESOURCE_BARRIER transition = CD3DX12_RESOURCE_BARRIER::Transition(
-			m_outputResource.Get(), D3D12_RESOURCE_STATE_COPY_SOURCE,
-			D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+		m_stateTracker.Transition(m_outputResource.Get(), D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+		m_stateTracker.Flush(sceneBarriers);
 
-		m_commandList->ResourceBarrier(1, &transition);
+		// Bring the SBT of this frame slot up to date with the records modified since it was
+		// last used. The GPU is done with that copy of the SBT since the slot was reused
+		const uint32_t sbtIndex = m_frameRing.GetFrameIndex();
+		ID3D12Resource *sbtStorage = m_sbtStorage[sbtIndex].Get();
+		m_sbtHelper.Patch(sbtStorage, m_rtStateObjectProps.Get(), sbtIndex);
 
 		D3D12_DISPATCH_RAYS_DESC desc = {};
 		uint32_t rayGenSectionSize = m_sbtHelper.GetRayGenSectionSize();
-		desc.RayGenerationShaderRecord.StartAddress = m_sbtStorage->GetGPUVirtualAddress();
+		desc.RayGenerationShaderRecord.StartAddress = sbtStorage->GetGPUVirtualAddress();
 		desc.RayGenerationShaderRecord.SizeInBytes = rayGenSectionSize;
 
 		uint32_t missSectionSize = m_sbtHelper.GetMissSectionSize();
-		desc.MissShaderTable.StartAddress = m_sbtStorage->GetGPUVirtualAddress() + rayGenSectionSize;
+		desc.MissShaderTable.StartAddress = sbtStorage->GetGPUVirtualAddress() + m_sbtHelper.GetMissSectionOffset();
 		desc.MissShaderTable.SizeInBytes = missSectionSize;
 		desc.MissShaderTable.StrideInBytes = m_sbtHelper.GetMissEntrySize();
 
 		uint32_t hitGroupSectionSize = m_sbtHelper.GetHitGroupSectionSize();
-		desc.HitGroupTable.StartAddress = m_sbtStorage->GetGPUVirtualAddress() + rayGenSectionSize + missSectionSize;
+		desc.HitGroupTable.StartAddress = sbtStorage->GetGPUVirtualAddress() + m_sbtHelper.GetHitGroupSectionOffset();
 		desc.HitGroupTable.SizeInBytes = hitGroupSectionSize;
 		desc.HitGroupTable.StrideInBytes = m_sbtHelper.GetHitGroupEntrySize();
 
@@ -347,70 +436,131 @@ void DX12HelloTriangle::PopulateCommandList()
 		desc.Height = m_viewport.Height;
 		desc.Depth = 1;
 
-		m_commandList->SetPipelineState1(m_rtStateObject.Get());
-		m_commandList->DispatchRays(&desc);
+		m_frameRecorder.AddPass([&, desc](ID3D12GraphicsCommandList4 *commandList) {
+			// Set desctiptor heaps
+			std::vector<ID3D12DescriptorHeap *> heaps = {m_descriptorAllocator.GetHeap()};
+			commandList->SetDescriptorHeaps(static_cast<UINT>(heaps.size()), heaps.data());
+			commandList->ResourceBarrier(static_cast<UINT>(sceneBarriers.size()), sceneBarriers.data());
 
-		// Change RT output texture state to copy source
-		transition = CD3DX12_RESOURCE_BARRIER::Transition(
-			m_outputResource.Get(),
-			D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
-			D3D12_RESOURCE_STATE_COPY_SOURCE);
+			commandList->SetPipelineState1(m_rtStateObject.Get());
+			commandList->DispatchRays(&desc);
+		});
+	}
 
-		m_commandList->ResourceBarrier(1, &transition);
+	std::vector<D3D12_RESOURCE_BARRIER> copyBarriers;
+	if (!m_raster)
+	{
+		// The RT output is copied to the back buffer, which goes directly from
+		// present to copy destination as nothing is rendered into it
+		m_stateTracker.Transition(m_outputResource.Get(), D3D12_RESOURCE_STATE_COPY_SOURCE);
+		m_stateTracker.Transition(renderTarget, D3D12_RESOURCE_STATE_COPY_DEST);
+		m_stateTracker.Flush(copyBarriers);
+
+		m_frameRecorder.AddPass([&](ID3D12GraphicsCommandList4 *commandList) {
+			commandList->ResourceBarrier(static_cast<UINT>(copyBarriers.size()), copyBarriers.data());
+
+			// Copy RT output to render target
+			commandList->CopyResource(renderTarget, m_outputResource.Get());
+		});
+	}
 
-		// Change render target state to cody destination
-		transition = CD3DX12_RESOURCE_BARRIER::Transition(
-			m_renderTargets[m_frameIndex].Get(),
-			D3D12_RESOURCE_STATE_RENDER_TARGET,
-			D3D12_RESOURCE_STATE_COPY_DEST);
+	// The offline frames are copied to the readback buffer of the slot
+	std::vector<D3D12_RESOURCE_BARRIER> captureBarriers;
+	if (IsHeadless())
+	{
+		m_stateTracker.Transition(renderTarget, D3D12_RESOURCE_STATE_COPY_SOURCE);
+		m_stateTracker.Flush(captureBarriers);
 
-		m_commandList->ResourceBarrier(1, &transition);
+		ID3D12Resource *readbackBuffer = m_readbackBuffers[m_frameRing.GetFrameIndex()].Get();
+		m_frameRecorder.AddPass([&, readbackBuffer](ID3D12GraphicsCommandList4 *commandList) {
+			commandList->ResourceBarrier(static_cast<UINT>(captureBarriers.size()), captureBarriers.data());
 
-		// Copy RT output to render target
-		m_commandList->CopyResource(
-			m_renderTargets[m_frameIndex].Get(),
-			m_outputResource.Get());
+			CD3DX12_TEXTURE_COPY_LOCATION destination(readbackBuffer, m_readbackFootprint);
+			CD3DX12_TEXTURE_COPY_LOCATION source(renderTarget, 0);
+			commandList->CopyTextureRegion(&destination, 0, 0, 0, &source, nullptr);
+		});
+	}
 
-		// Change render target state back
-		transition = CD3DX12_RESOURCE_BARRIER::Transition(
-			m_renderTargets[m_frameIndex].Get(),
-			D3D12_RESOURCE_STATE_COPY_DEST,
-			D3D12_RESOURCE_STATE_RENDER_TARGET);
+	// Indicates that the back buffer will be used to present. Each pass is
+	// submitted after the previous one, whose barriers were flushed before
+	std::vector<D3D12_RESOURCE_BARRIER> presentBarriers;
+	m_stateTracker.Transition(renderTarget, D3D12_RESOURCE_STATE_PRESENT);
+	m_stateTracker.Flush(presentBarriers);
 
-		m_commandList->ResourceBarrier(1, &transition);
-	}
+	m_frameRecorder.AddPass([&](ID3D12GraphicsCommandList4 *commandList) {
+		commandList->ResourceBarrier(static_cast<UINT>(presentBarriers.size()), presentBarriers.data());
+	});
 
-	// Indicates that the back buffer will be used to present
-	barrier = CD3DX12_RESOURCE_BARRIER::Transition(
-		m_renderTargets[m_frameIndex].Get(),
-		D3D12_RESOURCE_STATE_RENDER_TARGET,
-		D3D12_RESOURCE_STATE_PRESENT);
+	m_frameRecorder.Execute(m_commandListPool);
+	m_frameRecorder.Clear();
 
-	m_commandList->ResourceBarrier(1, &barrier);
+	if (IsHeadless())
+		m_pendingCaptures.push_back({m_frameRing.GetFrameIndex(), m_frameRing.GetFrameFenceValue(), m_capturedFrameCount++});
+}
 
-	ThrowIfFailed(m_commandList->Close());
+void DX12HelloTriangle::WaitForGpu()
+{
+	// Only used when all the submitted work has to be complete, during
+	// initialization and before destroying the resources. Frames only wait
+	// for their own slot of the ring
+	m_buildQueue.WaitForIdle();
+	m_frameRing.WaitForIdle();
+	if (!IsHeadless())
+		m_frameIndex = m_swapchain->GetCurrentBackBufferIndex();
 }
 
-void DX12HelloTriangle::WaitForPreviousFrame()
+void DX12HelloTriangle::SetCameraPose(const CameraPose &pose)
 {
-	// WAITING FOR THE FRAME TO COMPLETE BEFORE CONTINUING IS NOT BEST PRACTICE.
-	// This is code implemented as such for simplicity. The D3D12HelloFrameBuffering
-	// sample illustrates how to use fences for efficient resource usage and to
-	// maximize GPU utilization.
+	m_cameraEye = {pose.eye[0], pose.eye[1], pose.eye[2]};
+	m_cameraDir = glm::normalize(glm::vec3(pose.direction[0], pose.direction[1], pose.direction[2]));
+}
 
-	// Signal and increment the fence value.
-	const UINT64 fence = m_fenceValue;
-	ThrowIfFailed(m_commandQueue->Signal(m_fence.Get(), fence));
-	m_fenceValue++;
+bool DX12HelloTriangle::PopCapturedFrame(nv_helpers_dx12::FrameImage &frame, bool wait)
+{
+	ReadCompletedCaptures();
 
-	// Wait until the previous frame is finished.
-	if (m_fence->GetCompletedValue() < fence)
+	// Only waits for the GPU once the last frames have been submitted
+	if (wait && m_capturedFrames.empty() && !m_pendingCaptures.empty())
 	{
-		ThrowIfFailed(m_fence->SetEventOnCompletion(fence, m_fenceEvent));
-		WaitForSingleObject(m_fenceEvent, INFINITE);
+		WaitForGpu();
+		ReadCompletedCaptures();
 	}
 
-	m_frameIndex = m_swapchain->GetCurrentBackBufferIndex();
+	if (m_capturedFrames.empty())
+		return false;
+	frame = std::move(m_capturedFrames.front());
+	m_capturedFrames.pop_front();
+	return true;
+}
+
+void DX12HelloTriangle::ReadCompletedCaptures()
+{
+	// The captures complete in the order of their frames. The rows of the
+	// readback buffer are aligned, and copied into tightly packed rows
+	const uint64_t completedFenceValue = m_frameRing.GetCompletedFenceValue();
+	while (!m_pendingCaptures.empty() && m_pendingCaptures.front().fenceValue <= completedFenceValue)
+	{
+		const PendingCapture &capture = m_pendingCaptures.front();
+		nv_helpers_dx12::FrameImage frame;
+		frame.frameNumber = capture.frameNumber;
+		frame.width = m_width;
+		frame.height = m_height;
+		const size_t rowSize = static_cast<size_t>(m_width) * 4;
+		frame.pixels.resize(rowSize * m_height);
+
+		const size_t rowPitch = m_readbackFootprint.Footprint.RowPitch;
+		ID3D12Resource *readbackBuffer = m_readbackBuffers[capture.slot].Get();
+		CD3DX12_RANGE readRange(m_readbackFootprint.Offset, m_readbackFootprint.Offset + rowPitch * m_height);
+		UINT8 *pData;
+		ThrowIfFailed(readbackBuffer->Map(0, &readRange, reinterpret_cast<void **>(&pData)));
+		for (uint32_t y = 0; y < m_height; y++)
+			memcpy(frame.pixels.data() + y * rowSize, pData + m_readbackFootprint.Offset + y * rowPitch, rowSize);
+		CD3DX12_RANGE writeRange(0, 0); // Nothing was written by the CPU
+		readbackBuffer->Unmap(0, &writeRange);
+
+		m_capturedFrames.push_back(std::move(frame));
+		m_pendingCaptures.pop_front();
+	}
 }
 
 void DX12HelloTriangle::CheckRaytracingSupport()
@@ -424,31 +574,6 @@ void DX12HelloTriangle::CheckRaytracingSupport()
 		throw std::runtime_error("Raytracing is not supported on this device");
 }
 
-void DX12HelloTriangle::CreateCameraBuffer()
-{
-	uint32_t numMatrices = 4; // view, perspective, viewInv, perspectiveInv
-	m_cameraBufferSize = numMatrices * sizeof(XMMATRIX);
-
-	// Create constant buffer for all matrices
-	m_cameraBuffer = nv_helpers_dx12::CreateBuffer(
-		m_device.Get(), m_cameraBufferSize, D3D12_RESOURCE_FLAG_NONE,
-		D3D12_RESOURCE_STATE_GENERIC_READ, nv_helpers_dx12::kUploadHeapProps);
-
-	// Create descriptor heap that will be used for the rasterization
-	m_constHeap = nv_helpers_dx12::CreateDescriptorHeap(
-		m_device.Get(), 1, D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, true);
-
-	// Describe and create the constant buffer view
-	D3D12_CONSTANT_BUFFER_VIEW_DESC cbvDesc = {};
-	cbvDesc.BufferLocation = m_cameraBuffer->GetGPUVirtualAddress();
-	cbvDesc.SizeInBytes = m_cameraBufferSize;
-
-	D3D12_CPU_DESCRIPTOR_HANDLE srvHandle =
-		m_constHeap->GetCPUDescriptorHandleForHeapStart();
-
-	m_device->CreateConstantBufferView(&cbvDesc, srvHandle);
-}
-
 void DX12HelloTriangle::UpdateCameraBuffer()
 {
 	std::vector<XMMATRIX> matrices(4);
@@ -466,10 +591,15 @@ void DX12HelloTriangle::UpdateCameraBuffer()
 	matrices[2] = XMMatrixInverse(&det, matrices[0]);
 	matrices[3] = XMMatrixInverse(&det, matrices[1]);
 
-	uint8_t *pData;
-	ThrowIfFailed(m_cameraBuffer->Map(0, nullptr, (void **)&pData));
-	memcpy(pData, matrices.data(), m_cameraBufferSize);
-	m_cameraBuffer->Unmap(0, nullptr);
+	// The matrices are written in memory which the frames in flight do not use,
+	// and bound directly as a root constant buffer view
+	nv_helpers_dx12::UploadRingAllocator::Allocation allocation =
+		m_uploadRing.Allocate(matrices.size() * sizeof(XMMATRIX));
+	memcpy(allocation.cpuAddress, matrices.data(), matrices.size() * sizeof(XMMATRIX));
+	m_cameraAddress = allocation.gpuAddress;
+
+	// The ray generation record references the camera of the frame
+	m_sbtHelper.UpdateRecordArguments(m_rayGenRecord, GetRayGenArguments());
 }
 
 void DX12HelloTriangle::CreatePlaneBV()
@@ -528,10 +658,9 @@ void DX12HelloTriangle::CreateGlobalConstantBuffer()
 		XMVECTOR{0.7f, 0.0f, 0.4f, 1.0f},
 	};
 
-	m_globalConstBuffer = nv_helpers_dx12::CreateBuffer(
-		m_device.Get(), sizeof(bufferData), D3D12_RESOURCE_FLAG_NONE,
-		D3D12_RESOURCE_STATE_GENERIC_READ, nv_helpers_dx12::kUploadHeapProps
-	);
+	m_globalConstBuffer.Attach(m_resourceAllocator.CreateBuffer(
+		sizeof(bufferData), D3D12_RESOURCE_FLAG_NONE,
+		D3D12_RESOURCE_STATE_GENERIC_READ, D3D12_HEAP_TYPE_UPLOAD));
 
 	UINT8* pData;
 	CD3DX12_RANGE readRange(0, 0); // We do not intend to read from this resource on the CPU.
@@ -540,49 +669,28 @@ void DX12HelloTriangle::CreateGlobalConstantBuffer()
 	m_globalConstBuffer->Unmap(0, nullptr);
 }
 
-void DX12HelloTriangle::CreatePerInstanceConstantBuffers()
+void DX12HelloTriangle::InitInstanceColors()
 {
-	XMVECTOR bufferData[] = {
+	// Colors of the triangle instances, stored inline in their hit group records as root constants
+	m_instanceColors = {
 		// A
-		XMVECTOR{1.0f, 0.0f, 0.0f, 1.0f},
-		XMVECTOR{0.7f, 0.4f, 0.0f, 1.0f},
-		XMVECTOR{0.4f, 0.7f, 0.0f, 1.0f},
-		XMVECTOR{0.0f, 0.0f, 0.0f, 1.0f},
+		{XMFLOAT4{1.0f, 0.0f, 0.0f, 1.0f},
+		 XMFLOAT4{0.7f, 0.4f, 0.0f, 1.0f},
+		 XMFLOAT4{0.4f, 0.7f, 0.0f, 1.0f},
+		 XMFLOAT4{0.0f, 0.0f, 0.0f, 1.0f}},
 
 		// B
-		XMVECTOR{0.0f, 1.0f, 0.0f, 1.0f},
-		XMVECTOR{0.0f, 0.7f, 0.4f, 1.0f},
-		XMVECTOR{0.0f, 0.4f, 0.7f, 1.0f},
-		XMVECTOR{0.0f, 0.0f, 0.0f, 1.0f},
+		{XMFLOAT4{0.0f, 1.0f, 0.0f, 1.0f},
+		 XMFLOAT4{0.0f, 0.7f, 0.4f, 1.0f},
+		 XMFLOAT4{0.0f, 0.4f, 0.7f, 1.0f},
+		 XMFLOAT4{0.0f, 0.0f, 0.0f, 1.0f}},
 
 		// C
-		XMVECTOR{0.0f, 0.0f, 1.0f, 1.0f},
-		XMVECTOR{0.4f, 0.0f, 0.7f, 1.0f},
-		XMVECTOR{0.7f, 0.0f, 0.4f, 1.0f},
-		XMVECTOR{0.0f, 0.0f, 0.0f, 1.0f},
+		{XMFLOAT4{0.0f, 0.0f, 1.0f, 1.0f},
+		 XMFLOAT4{0.4f, 0.0f, 0.7f, 1.0f},
+		 XMFLOAT4{0.7f, 0.0f, 0.4f, 1.0f},
+		 XMFLOAT4{0.0f, 0.0f, 0.0f, 1.0f}},
 	};
-
-	m_perInstanceConstBuffers.resize(3);
-	uint32_t i = 0;
-	for (auto& cb : m_perInstanceConstBuffers)
-	{
-		const uint32_t bufferSize = sizeof(XMVECTOR) * 4;
-		cb = nv_helpers_dx12::CreateBuffer(
-			m_device.Get(),
-			bufferSize,
-			D3D12_RESOURCE_FLAG_NONE,
-			D3D12_RESOURCE_STATE_GENERIC_READ,
-			nv_helpers_dx12::kUploadHeapProps
-		);
-
-		UINT8* pData;
-		CD3DX12_RANGE readRange(0, 0); // We do not intend to read from this resource on the CPU.
-		ThrowIfFailed(
-			cb->Map(0, &readRange, reinterpret_cast<void**>(&pData)));
-		memcpy(pData, &bufferData[i * 4], sizeof(bufferData));
-		cb->Unmap(0, nullptr);
-		++i;
-	}
 }
 
 void DX12HelloTriangle::InitCamera()
@@ -597,29 +705,31 @@ void DX12HelloTriangle::InitCamera()
 
 void DX12HelloTriangle::OnKeyUp(uint8_t key)
 {
-	if (key == VK_SPACE)
+	if (key == Key::Space)
 		m_raster = !m_raster;
+	if (key == Key::M)
+		m_animateInstances = !m_animateInstances;
 }
 
 void DX12HelloTriangle::OnKeyDown(uint8_t key)
 {
 	glm::vec3 cameraUp = glm::vec3(0.0f, 1.0f, 0.0f);
-	if (key == 0x57) // w
+	if (key == Key::W)
 		m_cameraEye += m_cameraDir * 0.1f;
-	if (key == 0x53) // s
+	if (key == Key::S)
 		m_cameraEye -= m_cameraDir * 0.1f;
-	if (key == 0x44) // d
+	if (key == Key::D)
 		m_cameraEye += glm::normalize(glm::cross(m_cameraDir, cameraUp)) * 0.1f;
-	if (key == 0x41) // a
+	if (key == Key::A)
 		m_cameraEye -= glm::normalize(glm::cross(m_cameraDir, cameraUp)) * 0.1f;
 }
 
-void DX12HelloTriangle::OnMouseMove(uint8_t wParam, uint32_t lParam)
+void DX12HelloTriangle::OnMouseMove(int32_t x, int32_t y, uint32_t buttons)
 {
-	float xoffset = GET_X_LPARAM(lParam) - m_mousePosX;
-	float yoffset = m_mousePosY - GET_Y_LPARAM(lParam);
-	m_mousePosX = GET_X_LPARAM(lParam);
-	m_mousePosY = GET_Y_LPARAM(lParam);
+	float xoffset = x - m_mousePosX;
+	float yoffset = m_mousePosY - y;
+	m_mousePosX = static_cast<float>(x);
+	m_mousePosY = static_cast<float>(y);
 
 	const float sensitivity = 0.1f;
 	xoffset *= sensitivity;
@@ -639,7 +749,7 @@ void DX12HelloTriangle::OnMouseMove(uint8_t wParam, uint32_t lParam)
 	m_cameraDir = glm::normalize(m_cameraDir);
 }
 
-AccelerationStructureBuffers DX12HelloTriangle::CreateBottomLevelAS(std::vector<std::pair<ComPtr<ID3D12Resource>, uint32_t>> vVertexBuffers)
+AccelerationStructureBuffers DX12HelloTriangle::CreateBottomLevelAS(ID3D12GraphicsCommandList4 *commandList, std::vector<std::pair<ComPtr<ID3D12Resource>, uint32_t>> vVertexBuffers)
 {
 	nv_helpers_dx12::BottomLevelASGenerator bottomLevelAS;
 
@@ -656,72 +766,150 @@ AccelerationStructureBuffers DX12HelloTriangle::CreateBottomLevelAS(std::vector<
 
 	bottomLevelAS.ComputeASBufferSizes(m_device.Get(), false, &scratchSizeInBytes, &resultSizeInBytes);
 
+	// The key of the cached AS is computed from the vertex data, in the format used by
+	// the generator, and the flags it builds with. The geometry of this sample lives in
+	// the upload heap, so it can be read back directly
+	uint64_t cacheKey = 0;
+	for (const auto &buffer : vVertexBuffers)
+	{
+		const uint64_t vertexDataSize = static_cast<uint64_t>(buffer.second) * sizeof(Vertex);
+		UINT8 *pVertexData;
+		CD3DX12_RANGE readRange(0, static_cast<SIZE_T>(vertexDataSize));
+		ThrowIfFailed(buffer.first->Map(0, &readRange, reinterpret_cast<void **>(&pVertexData)));
+		cacheKey = nv_helpers_dx12::AccelerationStructureCache::ComputeKey(
+			pVertexData, vertexDataSize, sizeof(Vertex), DXGI_FORMAT_R32G32B32_FLOAT, nullptr, 0,
+			DXGI_FORMAT_UNKNOWN, bottomLevelAS.GetBuildFlags(), cacheKey);
+		CD3DX12_RANGE writeRange(0, 0);
+		buffer.first->Unmap(0, &writeRange);
+	}
+
+	// On a hit the staging buffer takes the place of the scratch buffer, both need to be
+	// kept alive until the command list has been executed
 	AccelerationStructureBuffers buffers;
-	buffers.pScratch = nv_helpers_dx12::CreateBuffer(
-		m_device.Get(), scratchSizeInBytes,
+	if (m_asCache.Load(m_device.Get(), commandList, cacheKey, &buffers.pResult, &buffers.pScratch))
+		return buffers;
+
+	// The AS buffers are placed in shared heaps rather than committed one by one
+	buffers.pScratch.Attach(m_resourceAllocator.CreateBuffer(
+		scratchSizeInBytes,
 		D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS,
 		D3D12_RESOURCE_STATE_COMMON,
-		nv_helpers_dx12::kDefaultHeapProps);
+		D3D12_HEAP_TYPE_DEFAULT));
 
-	buffers.pResult = nv_helpers_dx12::CreateBuffer(
-		m_device.Get(), resultSizeInBytes,
+	buffers.pResult.Attach(m_resourceAllocator.CreateBuffer(
+		resultSizeInBytes,
 		D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS,
 		D3D12_RESOURCE_STATE_RAYTRACING_ACCELERATION_STRUCTURE,
-		nv_helpers_dx12::kDefaultHeapProps);
+		D3D12_HEAP_TYPE_DEFAULT));
 
+	// The bottom-level builds are independent, their UAV barriers are queued
+	// in the state tracker and recorded at once before the top-level build
 	bottomLevelAS.Generate(
-		m_commandList.Get(),
+		commandList,
 		buffers.pScratch.Get(),
 		buffers.pResult.Get(),
-		false, nullptr);
+		false, nullptr, &m_buildStateTracker);
+
+	m_asCache.AddPendingStore(cacheKey, buffers.pResult.Get());
 
 	return buffers;
 }
 
-void DX12HelloTriangle::CreateTopLevelAS(const std::vector<std::pair<ComPtr<ID3D12Resource>, DirectX::XMMATRIX>> &instances)
+void DX12HelloTriangle::CreateTopLevelAS(ID3D12GraphicsCommandList4 *commandList, const std::vector<std::pair<ComPtr<ID3D12Resource>, DirectX::XMMATRIX>> &instances,
+										 const std::vector<uint32_t> &instanceContributions)
 {
+	// The hit group offset of each instance is the one returned when its
+	// records were reserved in the SBT
 	for (int i = 0; i < instances.size(); i++)
 	{
 		m_topLevelASGenerator.AddInstance(
 			instances[i].first.Get(),
 			instances[i].second,
 			static_cast<uint32_t>(i),
-			static_cast<uint32_t>(i));
+			instanceContributions[i]);
 	}
 
 	uint64_t scratchSize, resultSize, instanceDescsSize = {0};
 
 	m_topLevelASGenerator.ComputeASBufferSizes(m_device.Get(), true, &scratchSize, &resultSize, &instanceDescsSize);
 
-	m_topLevelASBuffers.pScratch = nv_helpers_dx12::CreateBuffer(
-		m_device.Get(), scratchSize,
-		D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS,
-		D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
-		nv_helpers_dx12::kDefaultHeapProps);
+	// Each version has its own buffers. The instance descriptors are written
+	// by the CPU, and would otherwise be overwritten while a refit reads them
+	for (AccelerationStructureBuffers &buffers : m_topLevelASBuffers)
+	{
+		buffers.pScratch.Attach(m_resourceAllocator.CreateBuffer(
+			scratchSize,
+			D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS,
+			D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
+			D3D12_HEAP_TYPE_DEFAULT));
 
-	m_topLevelASBuffers.pResult = nv_helpers_dx12::CreateBuffer(
-		m_device.Get(), resultSize,
-		D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS,
-		D3D12_RESOURCE_STATE_RAYTRACING_ACCELERATION_STRUCTURE,
-		nv_helpers_dx12::kDefaultHeapProps);
+		buffers.pResult.Attach(m_resourceAllocator.CreateBuffer(
+			resultSize,
+			D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS,
+			D3D12_RESOURCE_STATE_RAYTRACING_ACCELERATION_STRUCTURE,
+			D3D12_HEAP_TYPE_DEFAULT));
 
-	m_topLevelASBuffers.pInstanceDesc = nv_helpers_dx12::CreateBuffer(
-		m_device.Get(), instanceDescsSize,
-		D3D12_RESOURCE_FLAG_NONE,
-		D3D12_RESOURCE_STATE_GENERIC_READ,
-		nv_helpers_dx12::kUploadHeapProps);
+		buffers.pInstanceDesc.Attach(m_resourceAllocator.CreateBuffer(
+			instanceDescsSize,
+			D3D12_RESOURCE_FLAG_NONE,
+			D3D12_RESOURCE_STATE_GENERIC_READ,
+			D3D12_HEAP_TYPE_UPLOAD));
+	}
 
+	// Only the first version is built, the others are written by the refits
+	m_tlasVersion = 0;
 	m_topLevelASGenerator.Generate(
-		m_commandList.Get(),
-		m_topLevelASBuffers.pScratch.Get(),
-		m_topLevelASBuffers.pResult.Get(),
-		m_topLevelASBuffers.pInstanceDesc.Get());
+		commandList,
+		m_topLevelASBuffers[0].pScratch.Get(),
+		m_topLevelASBuffers[0].pResult.Get(),
+		m_topLevelASBuffers[0].pInstanceDesc.Get(),
+		false, nullptr, &m_buildStateTracker);
+}
+
+void DX12HelloTriangle::UpdateTopLevelAS()
+{
+	if (!m_animateInstances)
+		return;
+
+	// Spin the side triangles around their vertical axis. The TLAS generator
+	// reads the transforms from m_instances
+	m_animationAngle += animationSpeed * GetFrameTime();
+	m_instances[1].second = XMMatrixRotationY(m_animationAngle) * XMMatrixTranslation(-1.f, 0.f, 0.f);
+	m_instances[2].second = XMMatrixRotationY(-m_animationAngle) * XMMatrixTranslation(1.f, 0.f, 0.f);
+
+	// Refit into the next version of the TLAS from the current one, which the
+	// frames in flight keep tracing meanwhile
+	const uint32_t version = (m_tlasVersion + 1) % tlasVersionCount;
+	AccelerationStructureBuffers &buffers = m_topLevelASBuffers[version];
+
+	// The build queue has one allocator per version, so Begin waits for the
+	// refit which last read the instance descriptors of this version. The GPU
+	// waits for the last frame tracing this version before overwriting it
+	ID3D12GraphicsCommandList4 *buildList = m_buildQueue.Begin();
+	m_buildQueue.WaitOnGpu(m_frameRing.GetFence(), m_tlasVersionFenceValues[version]);
+	m_topLevelASGenerator.Generate(
+		buildList,
+		buffers.pScratch.Get(),
+		buffers.pResult.Get(),
+		buffers.pInstanceDesc.Get(),
+		true, m_topLevelASBuffers[m_tlasVersion].pResult.Get(), &m_buildStateTracker);
+	m_buildStateTracker.Flush(buildList);
+
+	// The next frames wait for the refit on the GPU, the CPU carries on
+	m_buildQueue.MakeQueueWait(m_commandQueue.Get(), m_buildQueue.Submit());
+	m_tlasVersion = version;
 }
 
 void DX12HelloTriangle::CreateAccelerationStructures()
 {
-	AccelerationStructureBuffers blasTriangle = CreateBottomLevelAS({{m_vertexBuffer.Get(), 3}});
-	AccelerationStructureBuffers blasPlane = CreateBottomLevelAS({{m_planeBuffer.Get(), 6}});
+	m_asCache.SetDirectory(GetAssetFullPath(L"cache"));
+
+	// The builds are recorded on the compute queue, the frames wait for them
+	// on the GPU instead of blocking the CPU
+	ID3D12GraphicsCommandList4 *buildList = m_buildQueue.Begin();
+
+	AccelerationStructureBuffers blasTriangle = CreateBottomLevelAS(buildList, {{m_vertexBuffer.Get(), 3}});
+	AccelerationStructureBuffers blasPlane = CreateBottomLevelAS(buildList, {{m_planeBuffer.Get(), 6}});
 
 
 	m_instances = {
@@ -731,21 +919,20 @@ void DX12HelloTriangle::CreateAccelerationStructures()
 		{blasPlane.pResult, XMMatrixTranslation(0.f, 0.f, 0.f)},
 	};
 
-	CreateTopLevelAS(m_instances);
+	ReserveHitGroupRecords();
+	CreateTopLevelAS(buildList, m_instances, m_instanceContributions);
 
-	// Flush the command list and wait for it to finish
-	m_commandList->Close();
-	ID3D12CommandList *ppCommandLists[] = {m_commandList.Get()};
-	m_commandQueue->ExecuteCommandLists(1, ppCommandLists);
-	m_fenceValue++;
-	m_commandQueue->Signal(m_fence.Get(), m_fenceValue);
+	m_buildStateTracker.Flush(buildList);
+	m_buildQueue.MakeQueueWait(m_commandQueue.Get(), m_buildQueue.Submit());
 
-	m_fence->SetEventOnCompletion(m_fenceValue, m_fenceEvent);
-	WaitForSingleObject(m_fenceEvent, INFINITE);
+	// The scratch buffers are freed once the direct queue, which waits for the
+	// builds, has completed the next frame
+	m_resourceAllocator.Free(blasTriangle.pScratch.Detach(), m_frameRing.GetFrameFenceValue());
+	m_resourceAllocator.Free(blasPlane.pScratch.Detach(), m_frameRing.GetFrameFenceValue());
 
-	// Once the command list is finished executing, reset it to be reused for rendering
-	ThrowIfFailed(
-		m_commandList->Reset(m_commandAllocator.Get(), m_pipelineState.Get()));
+	// Store the builds which were not found in the cache. The serialization is
+	// submitted on the direct queue after the wait, and blocks until written
+	m_asCache.StorePending(m_device.Get(), m_commandQueue.Get());
 
 	// Store AS buffers
 	m_bottomLevelAS = blasTriangle.pResult;
@@ -754,27 +941,28 @@ void DX12HelloTriangle::CreateAccelerationStructures()
 ComPtr<ID3D12RootSignature> DX12HelloTriangle::CreateGenSignature()
 {
 	nv_helpers_dx12::RootSignatureGenerator rsc;
-	rsc.AddHeapRangesParameter({{
-									0,								 // u0
-									1,								 // 1 descriptor
-									0,								 // use implicit register space 0
-									D3D12_DESCRIPTOR_RANGE_TYPE_UAV, // UAV representing the output buffer
-									0								 // heap slot where the UAV defined
-								},
-								{
-									0,								 // t0
-									1,								 // 1 descriptor
-									0,								 // use implicit register space 0
-									D3D12_DESCRIPTOR_RANGE_TYPE_SRV, // Top-level acceleration structure
-									1								 // heap slot
-								},
-								{
-									0,								 // b0
-									1,								 // 1 descriptor
-									0,								 // use implicit register space 0
-									D3D12_DESCRIPTOR_RANGE_TYPE_CBV, // Camera constant buffer view
-									2								 // heap slot
-								}});
+	// The descriptors of the heap never change once written, and only the output buffer is written
+	// by the shaders
+	rsc.AddHeapRangesParameter(std::vector<D3D12_DESCRIPTOR_RANGE1>{
+		{
+			D3D12_DESCRIPTOR_RANGE_TYPE_UAV, // UAV representing the output buffer
+			1, // 1 descriptor
+			0, // u0
+			0, // use implicit register space 0
+			D3D12_DESCRIPTOR_RANGE_FLAG_DATA_VOLATILE, // written by the ray generation shader
+			0 // heap slot where the UAV defined
+		},
+		{
+			D3D12_DESCRIPTOR_RANGE_TYPE_SRV, // Top-level acceleration structure
+			1, // 1 descriptor
+			0, // t0
+			0, // use implicit register space 0
+			D3D12_DESCRIPTOR_RANGE_FLAG_DATA_STATIC_WHILE_SET_AT_EXECUTE, // built before the dispatch
+			1 // heap slot
+		}});
+	// Camera constants of the frame, allocated in the upload ring
+	rsc.AddRootParameter(D3D12_ROOT_PARAMETER_TYPE_CBV, 0, 0, 1,
+		D3D12_ROOT_DESCRIPTOR_FLAG_DATA_STATIC_WHILE_SET_AT_EXECUTE);
 
 	return rsc.Generate(m_device.Get(), true);
 }
@@ -793,28 +981,14 @@ ComPtr<ID3D12RootSignature> DX12HelloTriangle::CreateHitSignature()
 {
 	nv_helpers_dx12::RootSignatureGenerator rsc;
 	//rsc.AddRootParameter(D3D12_ROOT_PARAMETER_TYPE_SRV);
-	rsc.AddRootParameter(D3D12_ROOT_PARAMETER_TYPE_CBV, 0);
+	// Instance colors, as 16 root constants inline in the hit group records
+	rsc.AddRootParameter(D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS, 0, 0, static_cast<UINT>(sizeof(InstanceColors) / 4));
 	return rsc.Generate(m_device.Get(), true);
 }
 
-void DX12HelloTriangle::CreateRaytracingPipeline()
+ComPtr<ID3D12StateObject> DX12HelloTriangle::CreateHitGroupCollection(IDxcBlob* hitLibrary, const std::wstring& hitGroup, const std::wstring& closestHit)
 {
-	nv_helpers_dx12::RayTracingPipelineGenerator pipeline(m_device.Get());
-
-	// Compile and add libraries
-	m_rayGenLibrary = nv_helpers_dx12::CompileShaderLibrary(L"assets/shaders/RayGen.hlsl");
-	m_missLibrary = nv_helpers_dx12::CompileShaderLibrary(L"assets/shaders/Miss.hlsl");
-	m_hitLibrary = nv_helpers_dx12::CompileShaderLibrary(L"assets/shaders/Hit.hlsl");
-
-	// Semantic is given in HLSL
-	pipeline.AddLibrary(m_rayGenLibrary.Get(), {L"RayGen"});
-	pipeline.AddLibrary(m_missLibrary.Get(), {L"Miss"});
-	pipeline.AddLibrary(m_hitLibrary.Get(), {L"ClosestHit", L"PlaneClosestHit"});
-
-	// Create root signatures, to define shader external inputs
-	m_rayGenSignature = CreateGenSignature();
-	m_missSignature = CreateMissSignature();
-	m_hitSignature = CreateHitSignature();
+	nv_helpers_dx12::RayTracingPipelineGenerator collection(m_device.Get());
 
 	// 3 different shaders can be invoked to obtain intersection:
 	// Intersection - called when hitting bb of non-triangylar geometry,
@@ -827,20 +1001,53 @@ void DX12HelloTriangle::CreateRaytracingPipeline()
 	// empty any-hit shader is also defined by default, so for now
 	// hit group contains only the closest hit shader. Shaders are
 	// referred to by name.
+	collection.AddLibrary(hitLibrary, {closestHit});
+	collection.AddHitGroup(hitGroup, closestHit);
+
+	// The hit shaders are only referred to as hit groups, meaning that the
+	// underlying intersection, any-hit and closest-hit shaders share the same
+	// root signature.
+	collection.AddRootSignatureAssociation(m_hitSignature.Get(), {hitGroup});
+
+	// The collection settings must match the ones of the pipeline
+	collection.SetMaxPayloadSize(4 * sizeof(float)); // RGB + distance
+	collection.SetMaxAttributeSize(2 * sizeof(float)); // barycentric coords
+	collection.SetMaxRecursionDepth(1);
+
+	ComPtr<ID3D12StateObject> hitGroupCollection;
+	hitGroupCollection.Attach(collection.GenerateCollection());
+	return hitGroupCollection;
+}
 
-	// Hit group for the triangles, with a shader simply interpolating vertex
-	// colors
-	pipeline.AddHitGroup(L"HitGroup", L"ClosestHit");
-	pipeline.AddHitGroup(L"PlaneHitGroup", L"PlaneClosestHit");
+std::vector<ComPtr<ID3D12StateObject>> DX12HelloTriangle::CreateHitGroupCollections(IDxcBlob* hitLibrary)
+{
+	// Each material hit group is compiled as its own collection, so that adding
+	// a material only compiles its own shaders before linking the pipeline
+	std::vector<ComPtr<ID3D12StateObject>> hitGroupCollections;
+	hitGroupCollections.push_back(CreateHitGroupCollection(hitLibrary, L"HitGroup", L"ClosestHit"));
+	hitGroupCollections.push_back(CreateHitGroupCollection(hitLibrary, L"PlaneHitGroup", L"PlaneClosestHit"));
+	return hitGroupCollections;
+}
+
+ComPtr<ID3D12StateObject> DX12HelloTriangle::LinkRaytracingPipeline(IDxcBlob* rayGenLibrary, IDxcBlob* missLibrary,
+	const std::vector<ComPtr<ID3D12StateObject>>& hitGroupCollections)
+{
+	nv_helpers_dx12::RayTracingPipelineGenerator pipeline(m_device.Get());
+
+	// Semantic is given in HLSL
+	pipeline.AddLibrary(rayGenLibrary, {L"RayGen"});
+	pipeline.AddLibrary(missLibrary, {L"Miss"});
+	for (const auto& collection : hitGroupCollections)
+	{
+		pipeline.AddCollection(collection.Get());
+	}
 
 	// The following section associates the root signature to each shader.
 	// Some shaders share the same root signature (eg. Miss and ShadowMiss).
-	// The hit shaders are now only referred to as hit groups, meaning that
-	// the underlying intersection, any-hit and closest-hit shaders share the
-	// same root signature.
+	// The hit groups are associated with their root signature within their
+	// collections.
 	pipeline.AddRootSignatureAssociation(m_rayGenSignature.Get(), {L"RayGen"});
 	pipeline.AddRootSignatureAssociation(m_missSignature.Get(), {L"Miss"});
-	pipeline.AddRootSignatureAssociation(m_hitSignature.Get(), {L"HitGroup", L"PlaneHitGroup"});
 
 	// The payload size defines the maximum size of the data carried by the rays,
 	// e.g. the data exchanged between the shaders (HitInfo).
@@ -852,9 +1059,146 @@ void DX12HelloTriangle::CreateRaytracingPipeline()
 	// Set requcursion depth - for now only trace primary rays
 	pipeline.SetMaxRecursionDepth(1);
 
-	m_rtStateObject = pipeline.Generate();
+	ComPtr<ID3D12StateObject> stateObject;
+	stateObject.Attach(pipeline.Generate());
+	return stateObject;
+}
 
+void DX12HelloTriangle::CreateRaytracingPipeline()
+{
+	// Root signatures serialized and libraries compiled by previous runs are
+	// reused from disk
+	nv_helpers_dx12::RootSignatureCache::Get().SetDirectory(GetAssetFullPath(L"cache"));
+	nv_helpers_dx12::ShaderCache::Get().SetDirectory(GetAssetFullPath(L"cache"));
+
+	// Compile the libraries in parallel. Each library is waited for only when
+	// it is needed to assemble the pipeline
+	nv_helpers_dx12::ShaderCache& shaderCache = nv_helpers_dx12::ShaderCache::Get();
+	PendingLibrary rayGenLibrary(shaderCache.CompileLibraryAsync(GetAssetFullPath(rayGenShaderFile)));
+	PendingLibrary missLibrary(shaderCache.CompileLibraryAsync(GetAssetFullPath(missShaderFile)));
+	PendingLibrary hitLibrary(shaderCache.CompileLibraryAsync(GetAssetFullPath(hitShaderFile)));
+
+	// Create root signatures, to define shader external inputs
+	m_rayGenSignature = CreateGenSignature();
+	m_missSignature = CreateMissSignature();
+	m_hitSignature = CreateHitSignature();
+
+	m_hitLibrary = hitLibrary.Take();
+	m_hitGroupCollections = CreateHitGroupCollections(m_hitLibrary.Get());
+	m_rayGenLibrary = rayGenLibrary.Take();
+	m_missLibrary = missLibrary.Take();
+
+	m_rtStateObject = LinkRaytracingPipeline(m_rayGenLibrary.Get(), m_missLibrary.Get(), m_hitGroupCollections);
 	ThrowIfFailed(m_rtStateObject->QueryInterface(IID_PPV_ARGS(&m_rtStateObjectProps)));
+
+	// Watch the shaders to reload them when they are modified
+	m_shaderWatcher.Start(GetAssetFullPath(L"assets/shaders"));
+}
+
+void DX12HelloTriangle::StartShaderReload(const std::vector<std::wstring>& modifiedFiles)
+{
+	// The watched directory itself is reported when the modified files are
+	// unknown, in which case all the libraries are compiled again
+	bool allModified = false;
+	for (const std::wstring& modifiedFile : modifiedFiles)
+	{
+		if (_wcsicmp(modifiedFile.c_str(), m_shaderWatcher.GetDirectory().c_str()) == 0)
+			allModified = true;
+	}
+
+	// Otherwise a library is affected if its source or one of its includes was
+	// modified. Both paths are absolute, and the file system ignores case
+	auto isAffected = [this, &modifiedFiles, allModified](LPCWSTR shaderFile) {
+		if (allModified)
+			return true;
+		for (const std::wstring& dependency : nv_helpers_dx12::ShaderCache::Get().GetDependencies(GetAssetFullPath(shaderFile)))
+		{
+			for (const std::wstring& modifiedFile : modifiedFiles)
+			{
+				if (_wcsicmp(dependency.c_str(), modifiedFile.c_str()) == 0)
+					return true;
+			}
+		}
+		return false;
+	};
+	bool rayGenModified = isAffected(rayGenShaderFile);
+	bool missModified = isAffected(missShaderFile);
+	bool hitModified = isAffected(hitShaderFile);
+	if (!rayGenModified && !missModified && !hitModified)
+		return;
+
+	// Only the modified libraries are compiled again, and the hit group
+	// collections are kept if the hit library is unchanged. The current
+	// objects are copied, so that the background thread never accesses the
+	// ones in use for rendering
+	PipelineReload reload;
+	reload.rayGenLibrary = m_rayGenLibrary;
+	reload.missLibrary = m_missLibrary;
+	reload.hitLibrary = m_hitLibrary;
+	reload.hitGroupCollections = m_hitGroupCollections;
+
+	m_pipelineReload = std::async(std::launch::async, [this, reload, rayGenModified, missModified, hitModified]() mutable {
+		nv_helpers_dx12::ShaderCache& shaderCache = nv_helpers_dx12::ShaderCache::Get();
+		PendingLibrary rayGenLibrary(rayGenModified ? shaderCache.CompileLibraryAsync(GetAssetFullPath(rayGenShaderFile)) : std::future<IDxcBlob*>());
+		PendingLibrary missLibrary(missModified ? shaderCache.CompileLibraryAsync(GetAssetFullPath(missShaderFile)) : std::future<IDxcBlob*>());
+		if (hitModified)
+		{
+			reload.hitLibrary.Attach(shaderCache.CompileLibrary(GetAssetFullPath(hitShaderFile)));
+			reload.hitGroupCollections = CreateHitGroupCollections(reload.hitLibrary.Get());
+		}
+		if (rayGenModified)
+			reload.rayGenLibrary = rayGenLibrary.Take();
+		if (missModified)
+			reload.missLibrary = missLibrary.Take();
+
+		reload.stateObject = LinkRaytracingPipeline(reload.rayGenLibrary.Get(), reload.missLibrary.Get(), reload.hitGroupCollections);
+		return reload;
+	});
+}
+
+void DX12HelloTriangle::UpdateShaderReload()
+{
+	if (!m_pipelineReload.valid())
+	{
+		std::vector<std::wstring> modifiedFiles;
+		if (m_shaderWatcher.PollModifiedFiles(modifiedFiles))
+			StartShaderReload(modifiedFiles);
+		return;
+	}
+	if (m_pipelineReload.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+		return;
+
+	PipelineReload reload;
+	try
+	{
+		reload = m_pipelineReload.get();
+	}
+	catch (const std::exception &e)
+	{
+		// Keep rendering with the current pipeline until the shaders are fixed
+		OutputDebugStringA(e.what());
+		OutputDebugStringA("\n");
+		return;
+	}
+
+	// The previous frames may still be executing with the previous pipeline: its
+	// state object and collections are released once they have completed
+	m_frameRing.DeferRelease(m_rtStateObject.Detach());
+	for (ComPtr<ID3D12StateObject> &collection : m_hitGroupCollections)
+		m_frameRing.DeferRelease(collection.Detach());
+
+	m_rayGenLibrary = reload.rayGenLibrary;
+	m_missLibrary = reload.missLibrary;
+	m_hitLibrary = reload.hitLibrary;
+	m_hitGroupCollections = reload.hitGroupCollections;
+	m_rtStateObject = reload.stateObject;
+	m_rtStateObjectProps.Reset();
+	ThrowIfFailed(m_rtStateObject->QueryInterface(IID_PPV_ARGS(&m_rtStateObjectProps)));
+
+	// The shader identifiers differ in the new pipeline: each SBT buffer is
+	// entirely rewritten the next time it is used
+	m_sbtHelper.InvalidateShaderIdentifiers();
+	m_sbtHelper.MarkAllRecordsModified();
 }
 
 void DX12HelloTriangle::CreateRaytracingOutputBuffer()
@@ -879,53 +1223,69 @@ void DX12HelloTriangle::CreateRaytracingOutputBuffer()
 		D3D12_RESOURCE_STATE_COPY_SOURCE,
 		nullptr,
 		IID_PPV_ARGS(&m_outputResource)));
+	m_stateTracker.SetState(m_outputResource.Get(), D3D12_RESOURCE_STATE_COPY_SOURCE);
 }
 
 void DX12HelloTriangle::CreateShaderResourceHeap()
 {
-	// Create a SRV/UAV/CBV descriptor heap. We need 2 entries - 1 UAV for the
-	// raytracing output and 1 SRV for the TLAS
-	m_srvUavHeap = nv_helpers_dx12::CreateDescriptorHeap(
-		m_device.Get(), 3, D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, true);
-
-	D3D12_CPU_DESCRIPTOR_HANDLE srvHandle =
-		m_srvUavHeap->GetCPUDescriptorHandleForHeapStart();
-
-	D3D12_UNORDERED_ACCESS_VIEW_DESC uavDesc = {};
-	uavDesc.ViewDimension = D3D12_UAV_DIMENSION_TEXTURE2D;
-	m_device->CreateUnorderedAccessView(m_outputResource.Get(), nullptr, &uavDesc,
-										srvHandle);
-
-	srvHandle.ptr += m_device->GetDescriptorHandleIncrementSize(
-		D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+	// Create the shader-visible SRV/UAV/CBV descriptor heap, shared by all the
+	// resources of the scene and never rebuilt
+	m_descriptorAllocator.Initialize(
+		m_device.Get(), D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, persistentDescriptorCount,
+		transientDescriptorCount, frameCount, true);
+
+	// The ray generation table is made of 2 contiguous entries - 1 UAV for the
+	// raytracing output and 1 SRV for the TLAS. There is one table per TLAS
+	// version
+	m_rayGenDescriptors = m_descriptorAllocator.Allocate(2 * tlasVersionCount);
+
+	for (uint32_t i = 0; i < tlasVersionCount; i++)
+	{
+		const uint32_t table = m_rayGenDescriptors + 2 * i;
 
-	D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc;
-	srvDesc.Format = DXGI_FORMAT_UNKNOWN;
-	srvDesc.ViewDimension = D3D12_SRV_DIMENSION_RAYTRACING_ACCELERATION_STRUCTURE;
-	srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-	srvDesc.RaytracingAccelerationStructure.Location = m_topLevelASBuffers.pResult->GetGPUVirtualAddress();
+		D3D12_UNORDERED_ACCESS_VIEW_DESC uavDesc = {};
+		uavDesc.ViewDimension = D3D12_UAV_DIMENSION_TEXTURE2D;
+		m_device->CreateUnorderedAccessView(m_outputResource.Get(), nullptr, &uavDesc,
+											m_descriptorAllocator.GetCpuHandle(table));
 
-	m_device->CreateShaderResourceView(nullptr, &srvDesc, srvHandle);
+		D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc;
+		srvDesc.Format = DXGI_FORMAT_UNKNOWN;
+		srvDesc.ViewDimension = D3D12_SRV_DIMENSION_RAYTRACING_ACCELERATION_STRUCTURE;
+		srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+		srvDesc.RaytracingAccelerationStructure.Location = m_topLevelASBuffers[i].pResult->GetGPUVirtualAddress();
 
-	// Add constant buffer for the camera
-	srvHandle.ptr += m_device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+		m_device->CreateShaderResourceView(nullptr, &srvDesc, m_descriptorAllocator.GetCpuHandle(table + 1));
+	}
+}
 
-	D3D12_CONSTANT_BUFFER_VIEW_DESC cbvDesc = {};
-	cbvDesc.BufferLocation = m_cameraBuffer->GetGPUVirtualAddress();
-	cbvDesc.SizeInBytes = m_cameraBufferSize;
-	m_device->CreateConstantBufferView(&cbvDesc, srvHandle);
+nv_helpers_dx12::ShaderRecordArguments DX12HelloTriangle::GetRayGenArguments() const
+{
+	// Descriptors of the output UAV and the SRV of the current TLAS version,
+	// referenced by their index in the heap, followed by the camera constants
+	// of the current frame
+	return nv_helpers_dx12::ShaderRecordArguments()
+		.AddDescriptorTable(m_descriptorAllocator.GetGpuHandle(m_rayGenDescriptors + 2 * m_tlasVersion))
+		.AddRootDescriptor(m_cameraAddress);
 }
 
-void DX12HelloTriangle::CreateShaderBindingTable()
+void DX12HelloTriangle::ReserveHitGroupRecords()
 {
 	m_sbtHelper.Reset();
+	// One SBT per frame in flight, so that records can be patched while the other one is in use
+	m_sbtHelper.SetBufferCount(frameCount);
+	m_sbtHelper.SetRayTypeCount(rayTypeCount);
+
+	// Each instance has a single geometry. The records are reserved before the
+	// TLAS is built, which needs their offsets, and set once the pipeline exists
+	m_instanceContributions.clear();
+	for (size_t i = 0; i < m_instances.size(); i++)
+		m_instanceContributions.push_back(m_sbtHelper.AddHitGroupInstance(1));
+}
 
-	D3D12_GPU_DESCRIPTOR_HANDLE srvUavHeapHandle =
-		m_srvUavHeap->GetGPUDescriptorHandleForHeapStart();
-
-	auto heapPointer = reinterpret_cast<void *>(srvUavHeapHandle.ptr);
-
-	m_sbtHelper.AddRayGenerationProgram(L"RayGen", std::vector<void *>{heapPointer});
+void DX12HelloTriangle::CreateShaderBindingTable()
+{
+	// The camera address is updated before each dispatch
+	m_rayGenRecord = m_sbtHelper.AddRayGenerationRecord(L"RayGen", GetRayGenArguments());
 	m_sbtHelper.AddMissProgram(L"Miss", {});
 
 	// Example on how to add vertex buffer and global const buffer
@@ -933,24 +1293,28 @@ void DX12HelloTriangle::CreateShaderBindingTable()
 	// auto globalConstBufferPointer = reinterpret_cast<void*>(m_globalConstBuffer->GetGPUVirtualAddress());
 	// m_sbtHelper.AddHitGroup(L"HitGroup", std::vector<void *>{vertexBufferPointer, globalConstBufferPointer});
 
-	// Triangle per instance const buffer 
-	for (uint32_t i = 0; i < m_perInstanceConstBuffers.size(); ++i)
+	// Triangle per instance colors, in the records reserved by ReserveHitGroupRecords
+	m_hitGroupRecords.clear();
+	for (size_t i = 0; i < m_instanceColors.size(); i++)
 	{
-		auto pointer = reinterpret_cast<void*>(m_perInstanceConstBuffers[i]->GetGPUVirtualAddress());
-		m_sbtHelper.AddHitGroup(L"HitGroup", std::vector<void*>{pointer});
+		m_hitGroupRecords.push_back(m_sbtHelper.SetHitGroupRecord(
+			m_instanceContributions[i], 0, 0, L"HitGroup", nv_helpers_dx12::ShaderRecordArguments().AddRootConstants(m_instanceColors[i])));
 	}
 
-	// Plane const buffer 
-	auto pointer = reinterpret_cast<void*>(m_perInstanceConstBuffers[0]->GetGPUVirtualAddress());
-	m_sbtHelper.AddHitGroup(L"PlaneHitGroup", std::vector<void*>{pointer});
+	// The plane is the last instance, and shares the hit root signature, its colors are unused
+	m_hitGroupRecords.push_back(m_sbtHelper.SetHitGroupRecord(
+		m_instanceContributions.back(), 0, 0, L"PlaneHitGroup", nv_helpers_dx12::ShaderRecordArguments().AddRootConstants(m_instanceColors[0])));
 
 	uint32_t sbtSize = m_sbtHelper.ComputeSBTSize();
 
-	m_sbtStorage = nv_helpers_dx12::CreateBuffer(
-		m_device.Get(), sbtSize, D3D12_RESOURCE_FLAG_NONE, D3D12_RESOURCE_STATE_GENERIC_READ, nv_helpers_dx12::kUploadHeapProps);
+	for (uint32_t i = 0; i < frameCount; ++i)
+	{
+		m_sbtStorage[i].Attach(m_resourceAllocator.CreateBuffer(
+			sbtSize, D3D12_RESOURCE_FLAG_NONE, D3D12_RESOURCE_STATE_GENERIC_READ, D3D12_HEAP_TYPE_UPLOAD));
 
-	if (!m_sbtStorage)
-		throw std::logic_error("Could not allocate shader binding table");
+		if (!m_sbtStorage[i])
+			throw std::logic_error("Could not allocate shader binding table");
 
-	m_sbtHelper.Generate(m_sbtStorage.Get(), m_rtStateObjectProps.Get());
+		m_sbtHelper.Generate(m_sbtStorage[i].Get(), m_rtStateObjectProps.Get(), i);
+	}
 }
@@ -1,16 +1,13 @@
-#include "stdafx.h"
 #include "DXPipeline.h"
 
-using namespace Microsoft::WRL;
+#include <cwchar>
+#include <cwctype>
 
 DXPipeline::DXPipeline(uint32_t viewportWidth, uint32_t viewportHeight, std::wstring name) : m_width(viewportWidth),
 																							 m_height(viewportHeight),
 																							 m_title(name),
 																							 m_useWarpDevice(false)
 {
-	WCHAR assetsPath[512];
-	GetAssetsPath(assetsPath, _countof(assetsPath));
-	m_assetsPath = assetsPath;
 	m_aspectRatio = static_cast<float>(viewportWidth) / static_cast<float>(viewportHeight);
 }
 
@@ -24,63 +21,94 @@ void DXPipeline::OnKeyUp(uint8_t key)
 {
 }
 
-void DXPipeline::OnMouseMove(uint8_t wParam, uint32_t lParam)
+void DXPipeline::OnMouseMove(int32_t x, int32_t y, uint32_t buttons)
 {
 }
 
-// Helper fuction for resolving the full path of assets.
-std::wstring DXPipeline::GetAssetFullPath(LPCWSTR assetName)
+// The assets are looked up next to the executable
+void DXPipeline::SetPlatform(Platform *platform)
 {
-	return m_assetsPath + assetName;
+	m_platform = platform;
+	m_assetsPath = platform->GetExecutableDirectory();
+	m_frameClockStarted = false;
 }
 
-// Helper function for acquiring the first available hardware adapter that supports Direct3D 12.
-// If no such adapter can be found, *ppAdapter will be set to nullptr.
-_Use_decl_annotations_ void DXPipeline::GetHardwareAdapter(IDXGIFactory2 *pFactory, IDXGIAdapter1 **ppAdapter)
+// The frame time is measured between the starts of successive frames, so that
+// the updates advance with the wall clock, or with the clock of the offline
+// rendering. The first frame does not account for the initialization
+void DXPipeline::RenderFrame()
 {
-	ComPtr<IDXGIAdapter1> adapter;
-	*ppAdapter = nullptr;
+	const double frameStart = m_platform->GetTime();
+	m_frameTime = m_frameClockStarted ? static_cast<float>(frameStart - m_lastFrameStart) : 0.f;
+	m_lastFrameStart = frameStart;
+	m_frameClockStarted = true;
 
-	for (UINT adapterIndex = 0; DXGI_ERROR_NOT_FOUND != pFactory->EnumAdapters1(adapterIndex, &adapter); ++adapterIndex)
-	{
-		DXGI_ADAPTER_DESC1 desc;
-		adapter->GetDesc1(&desc);
+	OnUpdate();
+	OnRender();
+}
 
-		if (desc.Flags & DXGI_ADAPTER_FLAG_SOFTWARE)
-		{
-			// Don't select the Basic Render Driver adapter.
-			// If you want a software adapter, pass in "/warp" on the command line.
-			continue;
-		}
+void DXPipeline::SetCameraPose(const CameraPose &pose)
+{
+}
 
-		// Check to see if the adapter supports Direct3D 12, but don't create the
-		// actual device yet.
-		if (SUCCEEDED(D3D12CreateDevice(adapter.Get(), D3D_FEATURE_LEVEL_11_0, _uuidof(ID3D12Device), nullptr)))
-		{
-			break;
-		}
-	}
+bool DXPipeline::PopCapturedFrame(nv_helpers_dx12::FrameImage &frame, bool wait)
+{
+	return false;
+}
 
-	*ppAdapter = adapter.Detach();
+// Helper fuction for resolving the full path of assets.
+std::wstring DXPipeline::GetAssetFullPath(const std::wstring &assetName)
+{
+	return m_assetsPath + assetName;
 }
 
 // Helper function for setting the window's title text.
-void DXPipeline::SetCustomWindowText(LPCWSTR text)
+void DXPipeline::SetCustomWindowText(const std::wstring &text)
 {
-	std::wstring windowText = m_title + L": " + text;
-	SetWindowText(Win32Application::GetHwnd(), windowText.c_str());
+	m_platform->SetWindowTitle(m_title + L": " + text);
+}
+
+// Case-insensitive comparison of a command line argument with an option
+static bool IsOption(const wchar_t *argument, const wchar_t *option)
+{
+	for (; *argument && *option; ++argument, ++option)
+	{
+		if (std::towlower(*argument) != std::towlower(*option))
+			return false;
+	}
+	return *argument == *option;
 }
 
 // Helper function for parsing any supplied command line args.
-_Use_decl_annotations_ void DXPipeline::ParseCommandLineArgs(WCHAR *argv[], int argc)
+void DXPipeline::ParseCommandLineArgs(const wchar_t *const argv[], int argc)
 {
 	for (int i = 1; i < argc; ++i)
 	{
-		if (_wcsnicmp(argv[i], L"-warp", wcslen(argv[i])) == 0 ||
-			_wcsnicmp(argv[i], L"/warp", wcslen(argv[i])) == 0)
+		if (IsOption(argv[i], L"-warp") || IsOption(argv[i], L"/warp"))
 		{
 			// m_useWarpDevice = true;
 			m_title = m_title + L" (WARP)";
 		}
+		else if (IsOption(argv[i], L"-headless"))
+		{
+			m_headless.enabled = true;
+		}
+		else if (IsOption(argv[i], L"-frames") && i + 1 < argc)
+		{
+			m_headless.frameCount = static_cast<uint32_t>(std::wcstoul(argv[++i], nullptr, 10));
+		}
+		else if (IsOption(argv[i], L"-camerapath") && i + 1 < argc)
+		{
+			m_headless.cameraPathFile = argv[++i];
+		}
+		else if (IsOption(argv[i], L"-output") && i + 1 < argc)
+		{
+			m_headless.outputDirectory = argv[++i];
+		}
+		else if (IsOption(argv[i], L"-fps") && i + 1 < argc)
+		{
+			const float frameRate = std::wcstof(argv[++i], nullptr);
+			m_headless.frameRate = frameRate > 0.f ? frameRate : m_headless.frameRate;
+		}
 	}
 }
@@ -0,0 +1,236 @@
+/*
+The descriptor allocator manages a single large descriptor heap with persistent and per-frame
+descriptors. See DescriptorAllocator.h for an overview.
+*/
+
+#include "DescriptorAllocator.h"
+
+#include <iterator>
+#include <stdexcept>
+
+namespace nv_helpers_dx12
+{
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+DescriptorAllocator::~DescriptorAllocator()
+{
+  Release();
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Create the descriptor heap. The persistent region starts as a single free range, and the
+// transient ranges of the frames follow it
+void DescriptorAllocator::Initialize(ID3D12Device* device, D3D12_DESCRIPTOR_HEAP_TYPE type,
+                                     uint32_t persistentCount, uint32_t transientCountPerFrame,
+                                     uint32_t frameCount, bool shaderVisible)
+{
+  Release();
+
+  D3D12_DESCRIPTOR_HEAP_DESC desc = {};
+  desc.NumDescriptors = persistentCount + transientCountPerFrame * frameCount;
+  desc.Type = type;
+  desc.Flags =
+      shaderVisible ? D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE : D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
+  if (FAILED(device->CreateDescriptorHeap(&desc, IID_PPV_ARGS(&m_heap))))
+  {
+    throw std::logic_error("Could not create the descriptor heap");
+  }
+  m_descriptorSize = device->GetDescriptorHandleIncrementSize(type);
+  m_cpuStart = m_heap->GetCPUDescriptorHandleForHeapStart();
+  if (shaderVisible)
+  {
+    m_gpuStart = m_heap->GetGPUDescriptorHandleForHeapStart();
+  }
+
+  m_persistentCount = persistentCount;
+  if (persistentCount > 0)
+  {
+    m_freeRanges[0] = persistentCount;
+  }
+  m_transientCountPerFrame = transientCountPerFrame;
+  m_frameCount = frameCount;
+  m_transientStart = persistentCount;
+  m_transientUsed = 0;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Allocate a contiguous range of persistent descriptors in the first free range large enough.
+// The allocation is taken from the beginning of the free range, which keeps the remaining part
+// indexed at its end
+uint32_t DescriptorAllocator::Allocate(uint32_t count)
+{
+  if (count == 0)
+  {
+    throw std::logic_error("Allocating an empty range of descriptors");
+  }
+  for (auto it = m_freeRanges.begin(); it != m_freeRanges.end(); ++it)
+  {
+    if (it->second < count)
+    {
+      continue;
+    }
+    const uint32_t index = it->first;
+    const uint32_t remaining = it->second - count;
+    m_freeRanges.erase(it);
+    if (remaining > 0)
+    {
+      m_freeRanges[index + count] = remaining;
+    }
+    return index;
+  }
+  throw std::logic_error("No free range of persistent descriptors is large enough");
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Free a range of persistent descriptors, right away or once the fence value has been reached. The
+// frames complete in order, so a range freed with a lower fence value than the last one is kept
+// until that value is reached. This delays its reuse, but never makes it early
+void DescriptorAllocator::Free(uint32_t index, uint32_t count, uint64_t fenceValue)
+{
+  if (count == 0 || index + count > m_persistentCount)
+  {
+    throw std::logic_error("Freeing descriptors outside of the persistent region");
+  }
+  if (fenceValue == 0)
+  {
+    InsertFreeRange(index, count);
+  }
+  else
+  {
+    if (!m_pendingFrees.empty() && m_pendingFrees.back().fenceValue > fenceValue)
+    {
+      fenceValue = m_pendingFrees.back().fenceValue;
+    }
+    m_pendingFrees.push_back({fenceValue, index, count});
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Return the completed ranges to the free list. Free keeps the fence values of the pending ranges
+// non-decreasing, so the completed ones are at the front of the list
+void DescriptorAllocator::Reclaim(uint64_t completedFenceValue)
+{
+  while (!m_pendingFrees.empty() && m_pendingFrees.front().fenceValue <= completedFenceValue)
+  {
+    InsertFreeRange(m_pendingFrees.front().index, m_pendingFrees.front().count);
+    m_pendingFrees.pop_front();
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Start allocating the transient descriptors in the range of a frame
+void DescriptorAllocator::BeginFrame(uint32_t frameIndex)
+{
+  if (frameIndex >= m_frameCount)
+  {
+    throw std::logic_error("Frame index out of range of the transient descriptors");
+  }
+  m_transientStart = m_persistentCount + frameIndex * m_transientCountPerFrame;
+  m_transientUsed = 0;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Allocate a contiguous range of transient descriptors in the range of the current frame
+uint32_t DescriptorAllocator::AllocateTransient(uint32_t count)
+{
+  if (m_transientUsed + count > m_transientCountPerFrame)
+  {
+    throw std::logic_error("The transient descriptors of the frame are exhausted");
+  }
+  const uint32_t index = m_transientStart + m_transientUsed;
+  m_transientUsed += count;
+  return index;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+D3D12_CPU_DESCRIPTOR_HANDLE DescriptorAllocator::GetCpuHandle(uint32_t index) const
+{
+  D3D12_CPU_DESCRIPTOR_HANDLE handle = m_cpuStart;
+  handle.ptr += static_cast<SIZE_T>(index) * m_descriptorSize;
+  return handle;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+D3D12_GPU_DESCRIPTOR_HANDLE DescriptorAllocator::GetGpuHandle(uint32_t index) const
+{
+  D3D12_GPU_DESCRIPTOR_HANDLE handle = m_gpuStart;
+  handle.ptr += static_cast<UINT64>(index) * m_descriptorSize;
+  return handle;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+uint32_t DescriptorAllocator::GetFreeCount() const
+{
+  uint32_t count = 0;
+  for (const auto& range : m_freeRanges)
+  {
+    count += range.second;
+  }
+  return count;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Insert a range in the free list, merging it with the preceding and following free ranges when
+// they are adjacent
+void DescriptorAllocator::InsertFreeRange(uint32_t index, uint32_t count)
+{
+  auto next = m_freeRanges.lower_bound(index);
+  if (next != m_freeRanges.end() && next->first < index + count)
+  {
+    throw std::logic_error("Freeing descriptors which are already free");
+  }
+  if (next != m_freeRanges.begin())
+  {
+    auto previous = std::prev(next);
+    if (previous->first + previous->second > index)
+    {
+      throw std::logic_error("Freeing descriptors which are already free");
+    }
+    if (previous->first + previous->second == index)
+    {
+      index = previous->first;
+      count += previous->second;
+      m_freeRanges.erase(previous);
+    }
+  }
+  if (next != m_freeRanges.end() && next->first == index + count)
+  {
+    count += next->second;
+    m_freeRanges.erase(next);
+  }
+  m_freeRanges[index] = count;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+void DescriptorAllocator::Release()
+{
+  if (m_heap)
+  {
+    m_heap->Release();
+    m_heap = nullptr;
+  }
+  m_freeRanges.clear();
+  m_pendingFrees.clear();
+  m_persistentCount = 0;
+  m_transientCountPerFrame = 0;
+  m_frameCount = 0;
+}
+
+} // namespace nv_helpers_dx12
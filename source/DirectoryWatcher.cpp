@@ -0,0 +1,107 @@
+/*
+The directory watcher reports the files modified in a directory and its subdirectories. See
+DirectoryWatcher.h for an overview.
+*/
+
+#include "DirectoryWatcher.h"
+#include "MappedFile.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <stdexcept>
+
+namespace nv_helpers_dx12
+{
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+DirectoryWatcher::~DirectoryWatcher()
+{
+  Stop();
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Start watching a directory and its subdirectories. The paths of the modified files are reported
+// with the separator of the platform, as GetAbsolutePath returns it
+void DirectoryWatcher::Start(const std::wstring& directory)
+{
+  Stop();
+
+  m_path = GetAbsolutePath(directory);
+  if (!m_path.empty() && m_path.back() != L'\\' && m_path.back() != L'/')
+  {
+    m_path += std::filesystem::path::preferred_separator;
+  }
+
+  m_watch = FileSystem::OpenDirectoryWatch(m_path);
+  if (m_watch == nullptr)
+  {
+    throw std::logic_error("Cannot watch the directory");
+  }
+  m_thread = std::thread(&DirectoryWatcher::Run, this);
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Stop watching, and wait for the background thread to exit
+void DirectoryWatcher::Stop()
+{
+  if (m_thread.joinable())
+  {
+    FileSystem::CancelDirectoryWatch(m_watch);
+    m_thread.join();
+  }
+  FileSystem::CloseDirectoryWatch(m_watch);
+  m_watch = nullptr;
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_modifiedFiles.clear();
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Move the absolute paths of the files modified since the last call into modifiedFiles, once no
+// notification has been received for the settling delay
+bool DirectoryWatcher::PollModifiedFiles(std::vector<std::wstring>& modifiedFiles)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if (m_modifiedFiles.empty() || std::chrono::steady_clock::now() - m_lastNotificationTime <
+                                     std::chrono::milliseconds(m_settlingDelay))
+  {
+    return false;
+  }
+  std::sort(m_modifiedFiles.begin(), m_modifiedFiles.end());
+  m_modifiedFiles.erase(std::unique(m_modifiedFiles.begin(), m_modifiedFiles.end()),
+                        m_modifiedFiles.end());
+  modifiedFiles = std::move(m_modifiedFiles);
+  m_modifiedFiles.clear();
+  return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Wait for notifications until Stop is called. The watch reports the file names relative to the
+// watched directory
+void DirectoryWatcher::Run()
+{
+  std::vector<std::wstring> changedFiles;
+  bool overflow = false;
+  while (FileSystem::WaitForDirectoryChanges(m_watch, changedFiles, overflow))
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_lastNotificationTime = std::chrono::steady_clock::now();
+    if (overflow)
+    {
+      // The notifications overflowed, and the modified files are unknown
+      m_modifiedFiles.push_back(m_path);
+    }
+    for (const std::wstring& changedFile : changedFiles)
+    {
+      m_modifiedFiles.push_back(m_path + changedFile);
+    }
+    changedFiles.clear();
+  }
+}
+
+} // namespace nv_helpers_dx12
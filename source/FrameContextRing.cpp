@@ -0,0 +1,173 @@
+/*
+The frame context ring lets the CPU record a frame while the GPU is still executing the previous
+ones. See FrameContextRing.h for an overview.
+*/
+
+#include "FrameContextRing.h"
+
+#include <stdexcept>
+
+namespace nv_helpers_dx12
+{
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+FrameContextRing::~FrameContextRing()
+{
+  Release();
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Create the fence signaled at the end of the frames
+void FrameContextRing::Initialize(ID3D12Device* device, ID3D12CommandQueue* queue,
+                                  uint32_t frameCount)
+{
+  if (frameCount == 0)
+  {
+    throw std::logic_error("The frame context ring needs at least one frame");
+  }
+  Release();
+
+  m_queue = queue;
+  m_queue->AddRef();
+  if (FAILED(device->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&m_fence))))
+  {
+    throw std::logic_error("Could not create the frame context fence");
+  }
+  m_fenceEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+  if (m_fenceEvent == nullptr)
+  {
+    throw std::logic_error("Could not create the frame context fence event");
+  }
+  m_frameFenceValues.assign(frameCount, 0);
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Start recording a frame in the next slot of the ring. The slot was last used by the frame
+// submitted GetFrameCount() frames earlier, which is usually complete already: the CPU only waits
+// when it is more than GetFrameCount() frames ahead of the GPU
+void FrameContextRing::BeginFrame()
+{
+  const uint64_t frameFenceValue = m_frameFenceValues[GetFrameIndex()];
+  if (m_fence->GetCompletedValue() < frameFenceValue)
+  {
+    m_stallCount++;
+    WaitForFenceValue(frameFenceValue);
+  }
+  ReleaseCompleted();
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Signal the end of the current frame on the queue. The slot of the frame can be reused once the
+// GPU reaches that value
+void FrameContextRing::EndFrame()
+{
+  if (FAILED(m_queue->Signal(m_fence, m_nextFenceValue)))
+  {
+    throw std::logic_error("Could not signal the frame context fence");
+  }
+  m_frameFenceValues[GetFrameIndex()] = m_nextFenceValue;
+  m_nextFenceValue++;
+  m_frameNumber++;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Release an object once the GPU has completed the frame being recorded. That frame signals the
+// next fence value, which is also the value signaled by the next frame when called between frames
+void FrameContextRing::DeferRelease(IUnknown* object)
+{
+  if (object)
+  {
+    m_deferredReleases.push_back({m_nextFenceValue, object});
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Wait until the GPU has completed all the work submitted to the queue. A dedicated fence value is
+// signaled, so that work submitted outside of frames is also waited upon
+void FrameContextRing::WaitForIdle()
+{
+  if (m_fence == nullptr)
+  {
+    return;
+  }
+  if (FAILED(m_queue->Signal(m_fence, m_nextFenceValue)))
+  {
+    throw std::logic_error("Could not signal the frame context fence");
+  }
+  WaitForFenceValue(m_nextFenceValue);
+  m_nextFenceValue++;
+  ReleaseCompleted();
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Block until the fence has reached the value
+void FrameContextRing::WaitForFenceValue(uint64_t value)
+{
+  if (m_fence->GetCompletedValue() >= value)
+  {
+    return;
+  }
+  if (FAILED(m_fence->SetEventOnCompletion(value, m_fenceEvent)))
+  {
+    throw std::logic_error("Could not wait for the frame context fence");
+  }
+  WaitForSingleObject(m_fenceEvent, INFINITE);
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Release the deferred objects whose fence value has been reached. The objects are deferred in
+// increasing order of fence values, so the completed ones are at the beginning of the list
+void FrameContextRing::ReleaseCompleted()
+{
+  const uint64_t completedValue = m_fence->GetCompletedValue();
+  size_t releaseCount = 0;
+  while (releaseCount < m_deferredReleases.size() &&
+         m_deferredReleases[releaseCount].first <= completedValue)
+  {
+    m_deferredReleases[releaseCount].second->Release();
+    releaseCount++;
+  }
+  m_deferredReleases.erase(m_deferredReleases.begin(), m_deferredReleases.begin() + releaseCount);
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Release all the objects. The GPU must be idle
+void FrameContextRing::Release()
+{
+  for (auto& deferred : m_deferredReleases)
+  {
+    deferred.second->Release();
+  }
+  m_deferredReleases.clear();
+  m_frameFenceValues.clear();
+  if (m_fenceEvent)
+  {
+    CloseHandle(m_fenceEvent);
+    m_fenceEvent = nullptr;
+  }
+  if (m_fence)
+  {
+    m_fence->Release();
+    m_fence = nullptr;
+  }
+  if (m_queue)
+  {
+    m_queue->Release();
+    m_queue = nullptr;
+  }
+  m_frameNumber = 0;
+  m_nextFenceValue = 1;
+  m_stallCount = 0;
+}
+
+} // namespace nv_helpers_dx12
@@ -0,0 +1,186 @@
+/*
+The frame writer saves the rendered frames as images on a background thread. See FrameWriter.h for
+an overview.
+*/
+
+#include "FrameWriter.h"
+
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+#include <system_error>
+
+namespace nv_helpers_dx12
+{
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+FrameWriter::~FrameWriter()
+{
+  Stop();
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Create the output directory, and start the writer thread
+void FrameWriter::Start(const std::wstring& directory, uint32_t maxQueuedFrames)
+{
+  Stop();
+
+  std::error_code error;
+  m_directory = directory;
+  std::filesystem::create_directories(m_directory, error);
+  if (error)
+  {
+    throw std::logic_error("Cannot create the frame output directory");
+  }
+
+  m_maxQueuedFrames = maxQueuedFrames == 0 ? 1 : maxQueuedFrames;
+  m_queue.clear();
+  m_error = nullptr;
+  m_writtenFrameCount = 0;
+  m_thread = std::thread(&FrameWriter::Run, this);
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Queue a frame. Blocking when the queue is full bounds the memory used by the frames waiting to
+// be saved
+void FrameWriter::Write(FrameImage&& frame)
+{
+  std::unique_lock<std::mutex> lock(m_mutex);
+  if (!m_thread.joinable())
+  {
+    throw std::logic_error("The frame writer has not been started");
+  }
+  m_queueCondition.wait(lock, [this]() { return m_error || m_queue.size() < m_maxQueuedFrames; });
+  if (m_error)
+  {
+    std::rethrow_exception(m_error);
+  }
+  m_queue.push_back(std::move(frame));
+  lock.unlock();
+  m_queueCondition.notify_all();
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// The writer thread saves the remaining frames before exiting
+void FrameWriter::Finish()
+{
+  Stop();
+  std::exception_ptr error = m_error;
+  m_error = nullptr;
+  if (error)
+  {
+    std::rethrow_exception(error);
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+uint64_t FrameWriter::GetWrittenFrameCount() const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_writtenFrameCount;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Save the queued frames in order. A frame is removed from the queue before being saved, so that
+// the render thread can queue the next one meanwhile
+void FrameWriter::Run()
+{
+  for (;;)
+  {
+    FrameImage frame;
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_queueCondition.wait(lock, [this]() { return m_stopping || !m_queue.empty(); });
+      if (m_queue.empty())
+      {
+        return;
+      }
+      frame = std::move(m_queue.front());
+      m_queue.pop_front();
+    }
+    m_queueCondition.notify_all();
+
+    try
+    {
+      SaveFrame(frame);
+    }
+    catch (...)
+    {
+      // The frames queued after a failure are dropped, and the render thread is woken up to
+      // receive the error
+      {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_error = std::current_exception();
+        m_queue.clear();
+      }
+      m_queueCondition.notify_all();
+      return;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_writtenFrameCount++;
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Binary PPM only stores RGB, the alpha channel is dropped
+void FrameWriter::SaveFrame(const FrameImage& frame) const
+{
+  if (frame.pixels.size() != static_cast<size_t>(frame.width) * frame.height * 4)
+  {
+    throw std::logic_error("The frame pixels do not match its size");
+  }
+
+  char fileName[32];
+  snprintf(fileName, sizeof(fileName), "frame_%06llu.ppm",
+           static_cast<unsigned long long>(frame.frameNumber));
+  std::ofstream file(m_directory / fileName, std::ios::binary);
+  file << "P6\n" << frame.width << " " << frame.height << "\n255\n";
+
+  std::vector<char> row(static_cast<size_t>(frame.width) * 3);
+  for (uint32_t y = 0; y < frame.height; y++)
+  {
+    const uint8_t* pixel = frame.pixels.data() + static_cast<size_t>(y) * frame.width * 4;
+    for (uint32_t x = 0; x < frame.width; x++)
+    {
+      row[3 * x + 0] = static_cast<char>(pixel[4 * x + 0]);
+      row[3 * x + 1] = static_cast<char>(pixel[4 * x + 1]);
+      row[3 * x + 2] = static_cast<char>(pixel[4 * x + 2]);
+    }
+    file.write(row.data(), static_cast<std::streamsize>(row.size()));
+  }
+
+  if (!file)
+  {
+    throw std::logic_error("Cannot write a frame image");
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Stop the writer thread once it has saved the queued frames
+void FrameWriter::Stop()
+{
+  if (!m_thread.joinable())
+  {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stopping = true;
+  }
+  m_queueCondition.notify_all();
+  m_thread.join();
+  m_stopping = false;
+}
+
+} // namespace nv_helpers_dx12
@@ -0,0 +1,112 @@
+#include "stdafx.h"
+#include "HeadlessApplication.h"
+#include "NullPlatform.h"
+#if defined(_WIN32)
+#include "Win32Platform.h"
+#else
+#include "PosixPlatform.h"
+#endif
+
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+int HeadlessApplication::Run(DXPipeline *pPipeline)
+{
+	const HeadlessSettings &settings = pPipeline->GetHeadlessSettings();
+
+	std::vector<CameraPose> cameraPath;
+	if (!settings.cameraPathFile.empty())
+		cameraPath = LoadCameraPath(settings.cameraPathFile);
+
+	uint32_t frameCount = settings.frameCount;
+	if (frameCount == 0)
+		frameCount = cameraPath.empty() ? 1 : static_cast<uint32_t>(cameraPath.size());
+
+	// The frames are saved on a background thread, the render loop only waits
+	// for the disk when several frames are already queued
+	nv_helpers_dx12::FrameWriter writer;
+	writer.Start(settings.outputDirectory);
+
+	// No window nor input. The assets are still found next to the executable,
+	// and the clock advances by one frame duration per frame
+#if defined(_WIN32)
+	Win32Platform nativePlatform;
+#else
+	PosixPlatform nativePlatform;
+#endif
+	NullPlatform platform(nativePlatform.GetExecutableDirectory());
+	pPipeline->SetPlatform(&platform);
+	const double frameDuration = 1.0 / settings.frameRate;
+
+	pPipeline->OnInit();
+
+	// Render the frames back to back. The frames read back are written as soon
+	// as the GPU has completed them, while the next ones are rendered
+	nv_helpers_dx12::FrameImage frame;
+	for (uint32_t n = 0; n < frameCount; n++)
+	{
+		if (!cameraPath.empty())
+			pPipeline->SetCameraPose(SampleCameraPath(cameraPath, n, frameCount));
+
+		pPipeline->RenderFrame();
+		platform.AdvanceTime(frameDuration);
+
+		while (pPipeline->PopCapturedFrame(frame, false))
+			writer.Write(std::move(frame));
+	}
+	while (pPipeline->PopCapturedFrame(frame, true))
+		writer.Write(std::move(frame));
+
+	pPipeline->OnDestroy();
+	writer.Finish();
+	return 0;
+}
+
+// Read the camera keyframes, one per line. Empty lines and lines starting
+// with # are skipped
+std::vector<CameraPose> HeadlessApplication::LoadCameraPath(const std::wstring &fileName)
+{
+	std::ifstream file(std::filesystem::path(fileName));
+	if (!file)
+		throw std::logic_error("Cannot open the camera path");
+
+	std::vector<CameraPose> keyframes;
+	std::string line;
+	while (std::getline(file, line))
+	{
+		if (line.empty() || line[0] == '#')
+			continue;
+
+		CameraPose pose;
+		std::istringstream values(line);
+		if (!(values >> pose.eye[0] >> pose.eye[1] >> pose.eye[2] >>
+			  pose.direction[0] >> pose.direction[1] >> pose.direction[2]))
+			throw std::logic_error("Invalid camera path keyframe");
+		keyframes.push_back(pose);
+	}
+	if (keyframes.empty())
+		throw std::logic_error("The camera path has no keyframe");
+	return keyframes;
+}
+
+// The keyframes are spread evenly over the frames, and the camera is
+// interpolated linearly between them
+CameraPose HeadlessApplication::SampleCameraPath(const std::vector<CameraPose> &keyframes, uint32_t frame, uint32_t frameCount)
+{
+	if (keyframes.size() == 1 || frameCount == 1)
+		return keyframes[0];
+
+	const float position = static_cast<float>(frame) * (keyframes.size() - 1) / (frameCount - 1);
+	const size_t key = static_cast<size_t>(position) < keyframes.size() - 1 ? static_cast<size_t>(position) : keyframes.size() - 2;
+	const float t = position - key;
+
+	CameraPose pose;
+	for (int i = 0; i < 3; i++)
+	{
+		pose.eye[i] = keyframes[key].eye[i] + t * (keyframes[key + 1].eye[i] - keyframes[key].eye[i]);
+		pose.direction[i] = keyframes[key].direction[i] + t * (keyframes[key + 1].direction[i] - keyframes[key].direction[i]);
+	}
+	return pose;
+}
@@ -0,0 +1,287 @@
+/*
+The heap suballocator carves many small allocations out of a few large memory pages, each page
+being managed by a buddy allocator. See HeapSuballocator.h for an overview.
+*/
+
+#include "HeapSuballocator.h"
+
+#include <new>
+#include <stdexcept>
+
+namespace nv_helpers_dx12
+{
+
+namespace
+{
+bool IsPowerOfTwo(uint64_t value)
+{
+  return value != 0 && (value & (value - 1)) == 0;
+}
+} // namespace
+
+//--------------------------------------------------------------------------------------------------
+//
+// The whole range starts as a single free block of level 0. Each level halves the block size,
+// down to the minimum block size
+BuddyAllocator::BuddyAllocator(uint64_t capacity, uint64_t minBlockSize)
+    : m_capacity(capacity), m_minBlockSize(minBlockSize)
+{
+  if (!IsPowerOfTwo(capacity) || !IsPowerOfTwo(minBlockSize) || minBlockSize > capacity)
+  {
+    throw std::logic_error("The buddy allocator capacity and block size must be powers of two");
+  }
+  uint32_t levelCount = 1;
+  while ((capacity >> (levelCount - 1)) > minBlockSize)
+  {
+    levelCount++;
+  }
+  m_freeBlocks.resize(levelCount);
+  m_freeBlocks[0].insert(0);
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Size of the block which would be allocated: the size rounded up to a power of two, at least the
+// alignment and the minimum block size
+uint64_t BuddyAllocator::GetBlockSize(uint64_t size, uint64_t alignment) const
+{
+  uint64_t blockSize = m_minBlockSize;
+  while (blockSize < size || blockSize < alignment)
+  {
+    blockSize <<= 1;
+  }
+  return blockSize;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Take the smallest free block of a size at least equal to the requested block size, and split
+// it until it has the requested size. The unused halves become free blocks of the lower levels
+uint64_t BuddyAllocator::Allocate(uint64_t size, uint64_t alignment)
+{
+  if (size == 0 || !IsPowerOfTwo(alignment))
+  {
+    throw std::logic_error("Invalid buddy allocation size or alignment");
+  }
+  const uint64_t blockSize = GetBlockSize(size, alignment);
+  if (blockSize > m_capacity)
+  {
+    return kInvalidOffset;
+  }
+  uint32_t targetLevel = 0;
+  while (GetLevelSize(targetLevel) > blockSize)
+  {
+    targetLevel++;
+  }
+
+  // Smallest level with a free block large enough
+  uint32_t level = targetLevel + 1;
+  while (level > 0 && m_freeBlocks[level - 1].empty())
+  {
+    level--;
+  }
+  if (level == 0)
+  {
+    return kInvalidOffset;
+  }
+  level--;
+
+  // Take the lowest free offset to keep the allocations packed at the beginning of the range
+  uint64_t offset = *m_freeBlocks[level].begin();
+  m_freeBlocks[level].erase(m_freeBlocks[level].begin());
+  while (level < targetLevel)
+  {
+    level++;
+    m_freeBlocks[level].insert(offset + GetLevelSize(level));
+  }
+
+  m_allocatedLevels[offset] = targetLevel;
+  m_allocatedSize += blockSize;
+  return offset;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Free a block, and merge it with its buddy as long as the buddy is free as well. The buddy of a
+// block differs from it only by the bit of the block size in their offsets
+void BuddyAllocator::Free(uint64_t offset)
+{
+  auto it = m_allocatedLevels.find(offset);
+  if (it == m_allocatedLevels.end())
+  {
+    throw std::logic_error("Freeing a block which was not allocated by the buddy allocator");
+  }
+  uint32_t level = it->second;
+  m_allocatedLevels.erase(it);
+  m_allocatedSize -= GetLevelSize(level);
+
+  while (level > 0)
+  {
+    const uint64_t buddy = offset ^ GetLevelSize(level);
+    auto buddyIt = m_freeBlocks[level].find(buddy);
+    if (buddyIt == m_freeBlocks[level].end())
+    {
+      break;
+    }
+    m_freeBlocks[level].erase(buddyIt);
+    offset = offset < buddy ? offset : buddy;
+    level--;
+  }
+  m_freeBlocks[level].insert(offset);
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+HeapSuballocator::HeapSuballocator(uint64_t pageSize, uint64_t minBlockSize)
+    : m_pageSize(pageSize), m_minBlockSize(minBlockSize)
+{
+  if (!IsPowerOfTwo(pageSize) || !IsPowerOfTwo(minBlockSize) || minBlockSize > pageSize)
+  {
+    throw std::logic_error("The heap page size and block size must be powers of two");
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Allocate memory in the first page with a large enough free block. Filling the first pages first
+// leaves the last ones empty as often as possible, so that they can be released
+HeapSuballocator::Allocation HeapSuballocator::Allocate(uint64_t size, uint64_t alignment)
+{
+  if (size > m_pageSize || alignment > m_pageSize)
+  {
+    throw std::logic_error("Heap allocation larger than the page size");
+  }
+
+  Allocation allocation;
+  uint32_t freePage = kInvalidPage;
+  for (uint32_t page = 0; page < static_cast<uint32_t>(m_pages.size()); page++)
+  {
+    if (!m_pages[page])
+    {
+      freePage = freePage == kInvalidPage ? page : freePage;
+      continue;
+    }
+    uint64_t offset = m_pages[page]->Allocate(size, alignment);
+    if (offset != BuddyAllocator::kInvalidOffset)
+    {
+      allocation.page = page;
+      allocation.offset = offset;
+      allocation.size = m_pages[page]->GetBlockSize(size, alignment);
+      return allocation;
+    }
+  }
+
+  // No page has a large enough block, create a new one in the first unused slot
+  if (freePage == kInvalidPage)
+  {
+    freePage = static_cast<uint32_t>(m_pages.size());
+    m_pages.emplace_back();
+  }
+  CreatePage(freePage);
+  m_pages[freePage] = std::make_unique<BuddyAllocator>(m_pageSize, m_minBlockSize);
+
+  allocation.page = freePage;
+  allocation.offset = m_pages[freePage]->Allocate(size, alignment);
+  allocation.size = m_pages[freePage]->GetBlockSize(size, alignment);
+  return allocation;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+void HeapSuballocator::Free(const Allocation& allocation)
+{
+  if (allocation.page >= m_pages.size() || !m_pages[allocation.page])
+  {
+    throw std::logic_error("Freeing an allocation from an invalid heap page");
+  }
+  m_pages[allocation.page]->Free(allocation.offset);
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Destroy the pages which do not contain any allocation. Their slots are reused by the next pages
+void HeapSuballocator::ReleaseEmptyPages()
+{
+  for (uint32_t page = 0; page < static_cast<uint32_t>(m_pages.size()); page++)
+  {
+    if (m_pages[page] && m_pages[page]->IsEmpty())
+    {
+      DestroyPage(page);
+      m_pages[page].reset();
+    }
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+uint32_t HeapSuballocator::GetPageCount() const
+{
+  uint32_t count = 0;
+  for (const auto& page : m_pages)
+  {
+    count += page ? 1 : 0;
+  }
+  return count;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+uint64_t HeapSuballocator::GetAllocatedSize() const
+{
+  uint64_t size = 0;
+  for (const auto& page : m_pages)
+  {
+    size += page ? page->GetAllocatedSize() : 0;
+  }
+  return size;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+HostHeapSuballocator::~HostHeapSuballocator()
+{
+  for (uint32_t page = 0; page < static_cast<uint32_t>(m_memory.size()); page++)
+  {
+    DestroyPage(page);
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+void* HostHeapSuballocator::GetAddress(const Allocation& allocation) const
+{
+  return static_cast<uint8_t*>(m_memory[allocation.page]) + allocation.offset;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// The pages are aligned on their size, so that the alignment of the offsets within a page is also
+// the alignment of the addresses
+void HostHeapSuballocator::CreatePage(uint32_t page)
+{
+  if (page >= m_memory.size())
+  {
+    m_memory.resize(page + 1, nullptr);
+  }
+  m_memory[page] = ::operator new(GetPageSize(), std::align_val_t(GetPageSize()));
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+void HostHeapSuballocator::DestroyPage(uint32_t page)
+{
+  if (m_memory[page])
+  {
+    ::operator delete(m_memory[page], std::align_val_t(GetPageSize()));
+    m_memory[page] = nullptr;
+  }
+}
+
+} // namespace nv_helpers_dx12
@@ -0,0 +1,132 @@
+/*
+Read-only memory mapping of a file, used by the loaders of the on-disk caches and asset formats.
+*/
+
+#include "MappedFile.h"
+
+#include <functional>
+#include <thread>
+
+namespace nv_helpers_dx12
+{
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+MappedFile::~MappedFile()
+{
+  Close();
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Map the file in memory. Returns false if the file does not exist or cannot be mapped, in
+// which case the object stays closed. Empty files cannot be mapped, and are never valid inputs
+// for the callers
+bool MappedFile::Open(const std::wstring& fileName)
+{
+  return FileSystem::MapFile(fileName, m_mapping);
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Unmap the file and close the underlying handles
+void MappedFile::Close()
+{
+  FileSystem::UnmapFile(m_mapping);
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+AtomicFileWriter::~AtomicFileWriter()
+{
+  Abort();
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// The temporary name is unique per thread, so that several threads can store the same file
+// concurrently: the last rename wins
+bool AtomicFileWriter::Open(const std::wstring& fileName)
+{
+  Abort();
+  m_fileName = fileName;
+  m_tempName = m_fileName + L"." +
+               std::to_wstring(std::hash<std::thread::id>()(std::this_thread::get_id())) + L".tmp";
+
+  m_file = FileSystem::OpenFile(m_tempName, "wb");
+  m_failed = false;
+  return m_file != nullptr;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Large blocks are written in several calls, so that their size always fits in a size_t
+bool AtomicFileWriter::Write(const void* data, uint64_t size)
+{
+  const uint8_t* bytes = static_cast<const uint8_t*>(data);
+  uint64_t remaining = size;
+  while (m_file && !m_failed && remaining > 0)
+  {
+    size_t toWrite = static_cast<size_t>(remaining < 0x40000000ull ? remaining : 0x40000000ull);
+    m_failed = std::fwrite(bytes, 1, toWrite, m_file) != toWrite;
+    bytes += toWrite;
+    remaining -= toWrite;
+  }
+  return m_file && !m_failed;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+bool AtomicFileWriter::Commit()
+{
+  if (m_file == nullptr)
+  {
+    return false;
+  }
+  const bool closed = std::fclose(m_file) == 0;
+  m_file = nullptr;
+  if (m_failed || !closed || !FileSystem::RenameFile(m_tempName, m_fileName))
+  {
+    FileSystem::RemoveFile(m_tempName);
+    return false;
+  }
+  return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+void AtomicFileWriter::Abort()
+{
+  if (m_file)
+  {
+    std::fclose(m_file);
+    m_file = nullptr;
+    FileSystem::RemoveFile(m_tempName);
+  }
+  m_failed = false;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Write size bytes from data into fileName, replacing any existing file. The data is first written
+// to a temporary file in the same directory, which is then renamed. Returns false on failure
+bool WriteFileAtomically(const std::wstring& fileName, const void* data, uint64_t size)
+{
+  AtomicFileWriter writer;
+  return writer.Open(fileName) && writer.Write(data, size) && writer.Commit();
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Convert a path relative to the current directory into an absolute path, without any "." or ".."
+// component. The path is not required to exist
+std::wstring GetAbsolutePath(const std::wstring& path)
+{
+  return FileSystem::GetAbsolutePath(path);
+}
+
+} // namespace nv_helpers_dx12
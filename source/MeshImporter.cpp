@@ -0,0 +1,898 @@
+/*
+The mesh importer loads triangle meshes from OBJ and binary PLY files. See MeshImporter.h for an
+overview of the parsing scheme.
+*/
+
+#include "MeshImporter.h"
+#include "MappedFile.h"
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <cstring>
+#include <cwctype>
+#include <future>
+#include <stdexcept>
+#include <thread>
+
+namespace nv_helpers_dx12
+{
+
+namespace
+{
+/// Target number of chunks per thread, so that chunks of uneven cost still balance well
+const uint32_t kChunksPerThread = 4;
+
+/// Number of faces per block of a PLY face element. The face lists have a variable size, so the
+/// start of each block is recorded during the counting pass
+const uint64_t kPlyFaceBlockSize = 1 << 16;
+
+//--------------------------------------------------------------------------------------------------
+//
+// Resolve the number of threads to use
+uint32_t GetThreadCount(uint32_t threadCount)
+{
+  if (threadCount == 0)
+  {
+    threadCount = std::thread::hardware_concurrency();
+  }
+  return threadCount == 0 ? 1 : threadCount;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Call task(i) for each i in [0, count), distributing the indices over threadCount threads.
+// Exceptions thrown by the tasks are rethrown on the calling thread
+template <class Task>
+void ParallelFor(size_t count, uint32_t threadCount, const Task& task)
+{
+  std::atomic<size_t> next = 0;
+  auto worker = [&]() {
+    for (size_t i = next++; i < count; i = next++)
+    {
+      task(i);
+    }
+  };
+
+  size_t workerCount = threadCount < count ? threadCount : count;
+  std::vector<std::future<void>> workers;
+  for (size_t i = 1; i < workerCount; i++)
+  {
+    workers.push_back(std::async(std::launch::async, worker));
+  }
+  worker();
+  for (auto& w : workers)
+  {
+    w.get();
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Write the position and color of a vertex into the output array
+inline void WriteVertex(uint8_t* vertices, const MeshVertexLayout& layout, size_t index,
+                        const float position[3], const float color[4])
+{
+  uint8_t* vertex = vertices + index * layout.stride;
+  memcpy(vertex + layout.positionOffset, position, 3 * sizeof(float));
+  if (layout.colorOffset >= 0)
+  {
+    memcpy(vertex + layout.colorOffset, color, 4 * sizeof(float));
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+// OBJ
+//--------------------------------------------------------------------------------------------------
+
+/// Range of complete lines of an OBJ file, along with its location in the output arrays
+struct ObjChunk
+{
+  const char* begin;
+  const char* end;
+  size_t vertexCount = 0;   /// Number of vertices defined in the chunk
+  size_t triangleCount = 0; /// Number of triangles after triangulation of the faces
+  size_t firstVertex = 0;   /// Number of vertices defined before the chunk
+  size_t firstTriangle = 0; /// Number of triangles defined before the chunk
+};
+
+inline bool IsBlank(char c)
+{
+  return c == ' ' || c == '\t' || c == '\r';
+}
+
+inline const char* SkipBlanks(const char* p, const char* end)
+{
+  while (p < end && IsBlank(*p))
+  {
+    ++p;
+  }
+  return p;
+}
+
+inline const char* SkipToken(const char* p, const char* end)
+{
+  while (p < end && !IsBlank(*p))
+  {
+    ++p;
+  }
+  return p;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Split the file into about chunkCount ranges, each ending right after a line feed
+std::vector<ObjChunk> SplitLines(const char* data, size_t size, size_t chunkCount)
+{
+  std::vector<ObjChunk> chunks;
+  const char* end = data + size;
+  const char* begin = data;
+  for (size_t i = 1; i <= chunkCount && begin < end; i++)
+  {
+    const char* split = end;
+    if (i < chunkCount)
+    {
+      const char* target = data + size * i / chunkCount;
+      if (target < begin)
+      {
+        continue;
+      }
+      const char* lineFeed = static_cast<const char*>(memchr(target, '\n', end - target));
+      split = lineFeed ? lineFeed + 1 : end;
+    }
+    chunks.push_back({begin, split});
+    begin = split;
+  }
+  return chunks;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Call onLine(keyword, arguments, lineEnd) for each non-empty line of the chunk. The keyword is
+// the first token of the line. Comments are stripped here, so that the counting and the filling
+// passes see exactly the same tokens
+template <class LineCallback>
+void ForEachObjLine(const ObjChunk& chunk, const LineCallback& onLine)
+{
+  const char* p = chunk.begin;
+  while (p < chunk.end)
+  {
+    const char* lineFeed = static_cast<const char*>(memchr(p, '\n', chunk.end - p));
+    const char* lineEnd = lineFeed ? lineFeed : chunk.end;
+    const char* comment = static_cast<const char*>(memchr(p, '#', lineEnd - p));
+    if (comment)
+    {
+      lineEnd = comment;
+    }
+
+    const char* keyword = SkipBlanks(p, lineEnd);
+    const char* keywordEnd = SkipToken(keyword, lineEnd);
+    if (keywordEnd - keyword == 1)
+    {
+      onLine(*keyword, keywordEnd, lineEnd);
+    }
+    p = lineFeed ? lineFeed + 1 : chunk.end;
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Parse a float at p, skipping leading blanks. Returns the end of the number, or nullptr if there
+// is no number
+const char* ParseFloat(const char* p, const char* end, float& value)
+{
+  p = SkipBlanks(p, end);
+  if (p < end && *p == '+')
+  {
+    ++p;
+  }
+  std::from_chars_result result = std::from_chars(p, end, value);
+  return result.ec == std::errc() ? result.ptr : nullptr;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Count the vertices and triangles of a chunk
+void CountObjChunk(ObjChunk& chunk)
+{
+  ForEachObjLine(chunk, [&chunk](char keyword, const char* p, const char* lineEnd) {
+    if (keyword == 'v')
+    {
+      chunk.vertexCount++;
+    }
+    else if (keyword == 'f')
+    {
+      size_t cornerCount = 0;
+      for (p = SkipBlanks(p, lineEnd); p < lineEnd; p = SkipBlanks(SkipToken(p, lineEnd), lineEnd))
+      {
+        cornerCount++;
+      }
+      chunk.triangleCount += cornerCount >= 3 ? cornerCount - 2 : 0;
+    }
+  });
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Parse the vertices and faces of a chunk into their final location
+void FillObjChunk(const ObjChunk& chunk, size_t totalVertexCount, const MeshVertexLayout& layout,
+                  uint8_t* vertices, uint32_t* indices)
+{
+  size_t vertexIndex = chunk.firstVertex;
+  uint32_t* triangleIndices = indices + 3 * chunk.firstTriangle;
+
+  ForEachObjLine(chunk, [&](char keyword, const char* p, const char* lineEnd) {
+    if (keyword == 'v')
+    {
+      float position[3];
+      float color[4] = {1.f, 1.f, 1.f, 1.f};
+      for (int i = 0; i < 3; i++)
+      {
+        p = p ? ParseFloat(p, lineEnd, position[i]) : nullptr;
+      }
+      if (!p)
+      {
+        throw std::logic_error("Invalid vertex position in OBJ file");
+      }
+      // Optional vertex color extension, all 3 components have to be present
+      float rgb[3];
+      const char* q = p;
+      for (int i = 0; i < 3 && q; i++)
+      {
+        q = ParseFloat(q, lineEnd, rgb[i]);
+      }
+      if (q)
+      {
+        memcpy(color, rgb, sizeof(rgb));
+      }
+      WriteVertex(vertices, layout, vertexIndex++, position, color);
+    }
+    else if (keyword == 'f')
+    {
+      // Triangulate the polygon as a fan around its first corner
+      uint32_t first = 0;
+      uint32_t previous = 0;
+      uint32_t cornerCount = 0;
+      for (p = SkipBlanks(p, lineEnd); p < lineEnd; p = SkipBlanks(SkipToken(p, lineEnd), lineEnd))
+      {
+        // Corners are v, v/vt, v/vt/vn or v//vn: only the position index is used
+        int64_t index = 0;
+        std::from_chars_result result = std::from_chars(p, lineEnd, index);
+        if (result.ec != std::errc() || index == 0)
+        {
+          throw std::logic_error("Invalid face index in OBJ file");
+        }
+        // Negative indices are relative to the last vertex defined before the face
+        int64_t resolved = index > 0 ? index - 1 : static_cast<int64_t>(vertexIndex) + index;
+        if (resolved < 0 || resolved >= static_cast<int64_t>(totalVertexCount))
+        {
+          throw std::logic_error("Out of range face index in OBJ file");
+        }
+
+        uint32_t corner = static_cast<uint32_t>(resolved);
+        if (cornerCount == 0)
+        {
+          first = corner;
+        }
+        else if (cornerCount >= 2)
+        {
+          *triangleIndices++ = first;
+          *triangleIndices++ = previous;
+          *triangleIndices++ = corner;
+        }
+        previous = corner;
+        cornerCount++;
+      }
+    }
+  });
+}
+
+//--------------------------------------------------------------------------------------------------
+// PLY
+//--------------------------------------------------------------------------------------------------
+
+enum class PlyType
+{
+  Int8,
+  UInt8,
+  Int16,
+  UInt16,
+  Int32,
+  UInt32,
+  Float32,
+  Float64
+};
+
+struct PlyProperty
+{
+  std::string name;
+  PlyType type;      /// Type of the value, or of the list items
+  bool isList;
+  PlyType countType; /// Type of the item count of a list
+};
+
+struct PlyElement
+{
+  std::string name;
+  uint64_t count;
+  std::vector<PlyProperty> properties;
+  uint64_t offset = 0; /// Offset of the first element from the start of the file
+};
+
+/// Range of faces of a PLY face element, along with its location in the index array
+struct PlyFaceBlock
+{
+  uint64_t offset;        /// Offset of the first face of the block from the start of the file
+  uint64_t faceCount;
+  uint64_t firstTriangle; /// Number of triangles defined before the block
+};
+
+//--------------------------------------------------------------------------------------------------
+//
+// Parse a PLY type name
+PlyType ParsePlyType(const std::string& name)
+{
+  if (name == "char" || name == "int8")
+    return PlyType::Int8;
+  if (name == "uchar" || name == "uint8")
+    return PlyType::UInt8;
+  if (name == "short" || name == "int16")
+    return PlyType::Int16;
+  if (name == "ushort" || name == "uint16")
+    return PlyType::UInt16;
+  if (name == "int" || name == "int32")
+    return PlyType::Int32;
+  if (name == "uint" || name == "uint32")
+    return PlyType::UInt32;
+  if (name == "float" || name == "float32")
+    return PlyType::Float32;
+  if (name == "double" || name == "float64")
+    return PlyType::Float64;
+  throw std::logic_error("Unknown property type in PLY file: " + name);
+}
+
+inline uint32_t GetPlyTypeSize(PlyType type)
+{
+  switch (type)
+  {
+  case PlyType::Int8:
+  case PlyType::UInt8:
+    return 1;
+  case PlyType::Int16:
+  case PlyType::UInt16:
+    return 2;
+  case PlyType::Int32:
+  case PlyType::UInt32:
+  case PlyType::Float32:
+    return 4;
+  default:
+    return 8;
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Read a value of the given type, converting it to double
+inline double ReadPlyValue(const uint8_t* p, PlyType type, bool bigEndian)
+{
+  uint8_t bytes[8];
+  uint32_t size = GetPlyTypeSize(type);
+  if (bigEndian)
+  {
+    std::reverse_copy(p, p + size, bytes);
+  }
+  else
+  {
+    memcpy(bytes, p, size);
+  }
+
+  switch (type)
+  {
+  case PlyType::Int8:
+    return static_cast<int8_t>(bytes[0]);
+  case PlyType::UInt8:
+    return bytes[0];
+  case PlyType::Int16:
+  {
+    int16_t v;
+    memcpy(&v, bytes, sizeof(v));
+    return v;
+  }
+  case PlyType::UInt16:
+  {
+    uint16_t v;
+    memcpy(&v, bytes, sizeof(v));
+    return v;
+  }
+  case PlyType::Int32:
+  {
+    int32_t v;
+    memcpy(&v, bytes, sizeof(v));
+    return v;
+  }
+  case PlyType::UInt32:
+  {
+    uint32_t v;
+    memcpy(&v, bytes, sizeof(v));
+    return v;
+  }
+  case PlyType::Float32:
+  {
+    float v;
+    memcpy(&v, bytes, sizeof(v));
+    return v;
+  }
+  default:
+  {
+    double v;
+    memcpy(&v, bytes, sizeof(v));
+    return v;
+  }
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Read the item count of a list property. Counts are normally integers, but the type is not
+// enforced by the format: negative, NaN and out of range values are rejected before the
+// conversion, which would be undefined. A list cannot have more items than the file has bytes
+inline uint64_t ReadPlyCount(const uint8_t* p, PlyType type, bool bigEndian, uint64_t fileSize)
+{
+  double value = ReadPlyValue(p, type, bigEndian);
+  if (!(value >= 0.0) || value > static_cast<double>(fileSize))
+  {
+    throw std::logic_error("Invalid list count in PLY file");
+  }
+  return static_cast<uint64_t>(value);
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Read a color component, normalizing integer types to [0, 1]
+inline float ReadPlyColor(const uint8_t* p, PlyType type, bool bigEndian)
+{
+  double value = ReadPlyValue(p, type, bigEndian);
+  if (type == PlyType::UInt8)
+  {
+    value /= 255.0;
+  }
+  else if (type == PlyType::UInt16)
+  {
+    value /= 65535.0;
+  }
+  return static_cast<float>(value);
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Size of a PLY element record, or 0 if the element contains lists and has a variable size
+uint64_t GetPlyFixedSize(const PlyElement& element)
+{
+  uint64_t size = 0;
+  for (const PlyProperty& property : element.properties)
+  {
+    if (property.isList)
+    {
+      return 0;
+    }
+    size += GetPlyTypeSize(property.type);
+  }
+  return size;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Walk over the records of a variable-size element starting at offset, and return the offset
+// following the last record. If a face list property is given, the number of triangles of the
+// faces is accumulated into triangleCount and the element is split into blocks
+uint64_t WalkPlyElement(const uint8_t* data, uint64_t size, const PlyElement& element,
+                        bool bigEndian, const PlyProperty* faceList, uint64_t* triangleCount,
+                        std::vector<PlyFaceBlock>* blocks)
+{
+  uint64_t offset = element.offset;
+  for (uint64_t i = 0; i < element.count; i++)
+  {
+    if (blocks && i % kPlyFaceBlockSize == 0)
+    {
+      uint64_t faceCount = element.count - i < kPlyFaceBlockSize ? element.count - i
+                                                                  : kPlyFaceBlockSize;
+      blocks->push_back({offset, faceCount, *triangleCount});
+    }
+    for (const PlyProperty& property : element.properties)
+    {
+      if (!property.isList)
+      {
+        offset += GetPlyTypeSize(property.type);
+        continue;
+      }
+      uint32_t countSize = GetPlyTypeSize(property.countType);
+      if (offset + countSize > size)
+      {
+        throw std::logic_error("Truncated PLY file");
+      }
+      uint64_t itemCount = ReadPlyCount(data + offset, property.countType, bigEndian, size);
+      offset += countSize + itemCount * GetPlyTypeSize(property.type);
+      if (&property == faceList && itemCount >= 3)
+      {
+        *triangleCount += itemCount - 2;
+      }
+    }
+    if (offset > size)
+    {
+      throw std::logic_error("Truncated PLY file");
+    }
+  }
+  return offset;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Parse the header of a PLY file. Returns the offset of the element data
+uint64_t ParsePlyHeader(const uint8_t* data, size_t size, std::vector<PlyElement>& elements,
+                        bool& bigEndian)
+{
+  const char* text = reinterpret_cast<const char*>(data);
+  const char* end = text + size;
+  const char* p = text;
+  bool isFirstLine = true;
+  bool hasFormat = false;
+
+  while (p < end)
+  {
+    const char* lineFeed = static_cast<const char*>(memchr(p, '\n', end - p));
+    if (!lineFeed)
+    {
+      break;
+    }
+
+    // Split the line into tokens
+    std::vector<std::string> tokens;
+    for (const char* q = SkipBlanks(p, lineFeed); q < lineFeed;)
+    {
+      const char* tokenEnd = SkipToken(q, lineFeed);
+      tokens.emplace_back(q, tokenEnd);
+      q = SkipBlanks(tokenEnd, lineFeed);
+    }
+    p = lineFeed + 1;
+
+    if (isFirstLine)
+    {
+      if (tokens.size() != 1 || tokens[0] != "ply")
+      {
+        throw std::logic_error("Missing PLY signature");
+      }
+      isFirstLine = false;
+      continue;
+    }
+    if (tokens.empty() || tokens[0] == "comment" || tokens[0] == "obj_info")
+    {
+      continue;
+    }
+
+    if (tokens[0] == "end_header")
+    {
+      if (!hasFormat)
+      {
+        throw std::logic_error("Missing format in PLY header");
+      }
+      return static_cast<uint64_t>(p - text);
+    }
+    else if (tokens[0] == "format" && tokens.size() >= 2)
+    {
+      if (tokens[1] == "binary_little_endian")
+      {
+        bigEndian = false;
+      }
+      else if (tokens[1] == "binary_big_endian")
+      {
+        bigEndian = true;
+      }
+      else
+      {
+        throw std::logic_error("Only binary PLY files are supported");
+      }
+      hasFormat = true;
+    }
+    else if (tokens[0] == "element" && tokens.size() == 3)
+    {
+      PlyElement element;
+      element.name = tokens[1];
+      element.count = std::stoull(tokens[2]);
+      elements.push_back(element);
+    }
+    else if (tokens[0] == "property" && !elements.empty())
+    {
+      PlyProperty property;
+      if (tokens.size() == 5 && tokens[1] == "list")
+      {
+        property.isList = true;
+        property.countType = ParsePlyType(tokens[2]);
+        property.type = ParsePlyType(tokens[3]);
+        property.name = tokens[4];
+      }
+      else if (tokens.size() == 3)
+      {
+        property.isList = false;
+        property.countType = PlyType::UInt8;
+        property.type = ParsePlyType(tokens[1]);
+        property.name = tokens[2];
+      }
+      else
+      {
+        throw std::logic_error("Invalid property in PLY header");
+      }
+      elements.back().properties.push_back(property);
+    }
+    else
+    {
+      throw std::logic_error("Invalid statement in PLY header");
+    }
+  }
+  throw std::logic_error("Missing end of PLY header");
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Find a property by name, returning nullptr if the element does not have it
+const PlyProperty* FindPlyProperty(const PlyElement& element,
+                                   std::initializer_list<const char*> names, uint32_t* offset)
+{
+  uint32_t propertyOffset = 0;
+  for (const PlyProperty& property : element.properties)
+  {
+    for (const char* name : names)
+    {
+      if (property.name == name)
+      {
+        if (offset)
+        {
+          *offset = propertyOffset;
+        }
+        return &property;
+      }
+    }
+    propertyOffset += property.isList ? 0 : GetPlyTypeSize(property.type);
+  }
+  return nullptr;
+}
+} // namespace
+
+//--------------------------------------------------------------------------------------------------
+//
+// Import an OBJ or PLY file, depending on its extension
+void ImportMesh(const std::wstring& fileName, const MeshVertexLayout& layout,
+                const MeshVertexAllocator& allocateVertices, std::vector<uint32_t>& indices,
+                uint32_t threadCount)
+{
+  size_t dot = fileName.find_last_of(L'.');
+  std::wstring extension = dot == std::wstring::npos ? L"" : fileName.substr(dot + 1);
+  for (wchar_t& c : extension)
+  {
+    c = static_cast<wchar_t>(towlower(c));
+  }
+  if (extension != L"obj" && extension != L"ply")
+  {
+    throw std::logic_error("Unsupported mesh file extension");
+  }
+
+  MappedFile file;
+  if (!file.Open(fileName))
+  {
+    throw std::logic_error("Could not open the mesh file");
+  }
+
+  if (extension == L"obj")
+  {
+    ImportObj(file.GetData(), static_cast<size_t>(file.GetSize()), layout, allocateVertices,
+              indices, threadCount);
+  }
+  else
+  {
+    ImportPly(file.GetData(), static_cast<size_t>(file.GetSize()), layout, allocateVertices,
+              indices, threadCount);
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Import an OBJ file already loaded or mapped in memory. The chunks are counted in parallel, the
+// output is allocated, and the chunks are parsed in parallel again into their final location
+void ImportObj(const uint8_t* data, size_t size, const MeshVertexLayout& layout,
+               const MeshVertexAllocator& allocateVertices, std::vector<uint32_t>& indices,
+               uint32_t threadCount)
+{
+  threadCount = GetThreadCount(threadCount);
+  std::vector<ObjChunk> chunks =
+      SplitLines(reinterpret_cast<const char*>(data), size, threadCount * kChunksPerThread);
+
+  ParallelFor(chunks.size(), threadCount, [&chunks](size_t i) { CountObjChunk(chunks[i]); });
+
+  size_t vertexCount = 0;
+  size_t triangleCount = 0;
+  for (ObjChunk& chunk : chunks)
+  {
+    chunk.firstVertex = vertexCount;
+    chunk.firstTriangle = triangleCount;
+    vertexCount += chunk.vertexCount;
+    triangleCount += chunk.triangleCount;
+  }
+  if (vertexCount > UINT32_MAX)
+  {
+    throw std::logic_error("Too many vertices in OBJ file for 32-bit indices");
+  }
+
+  uint8_t* vertices = static_cast<uint8_t*>(allocateVertices(vertexCount));
+  indices.resize(3 * triangleCount);
+
+  ParallelFor(chunks.size(), threadCount, [&](size_t i) {
+    FillObjChunk(chunks[i], vertexCount, layout, vertices, indices.data());
+  });
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Import a binary PLY file already loaded or mapped in memory. The vertex records have a fixed
+// size, so they are split in blocks directly. The face records have a variable size, so a
+// sequential pass over them records the start of each block of faces, which are then parsed in
+// parallel
+void ImportPly(const uint8_t* data, size_t size, const MeshVertexLayout& layout,
+               const MeshVertexAllocator& allocateVertices, std::vector<uint32_t>& indices,
+               uint32_t threadCount)
+{
+  threadCount = GetThreadCount(threadCount);
+
+  std::vector<PlyElement> elements;
+  bool bigEndian = false;
+  uint64_t offset = ParsePlyHeader(data, size, elements, bigEndian);
+
+  const PlyElement* vertexElement = nullptr;
+  const PlyElement* faceElement = nullptr;
+  const PlyProperty* faceList = nullptr;
+  uint64_t triangleCount = 0;
+  std::vector<PlyFaceBlock> faceBlocks;
+
+  // Locate the elements, which are stored one after the other
+  for (PlyElement& element : elements)
+  {
+    element.offset = offset;
+    uint64_t fixedSize = GetPlyFixedSize(element);
+    if (element.name == "vertex")
+    {
+      if (fixedSize == 0)
+      {
+        throw std::logic_error("PLY vertices cannot contain lists");
+      }
+      vertexElement = &element;
+    }
+
+    if (element.name == "face")
+    {
+      faceElement = &element;
+      faceList = FindPlyProperty(element, {"vertex_indices", "vertex_index"}, nullptr);
+      if (!faceList || !faceList->isList)
+      {
+        throw std::logic_error("Missing vertex_indices list in PLY faces");
+      }
+      offset = WalkPlyElement(data, size, element, bigEndian, faceList, &triangleCount,
+                              &faceBlocks);
+    }
+    else if (fixedSize > 0)
+    {
+      offset += element.count * fixedSize;
+    }
+    else
+    {
+      offset = WalkPlyElement(data, size, element, bigEndian, nullptr, nullptr, nullptr);
+    }
+    if (offset > size)
+    {
+      throw std::logic_error("Truncated PLY file");
+    }
+  }
+  if (!vertexElement)
+  {
+    throw std::logic_error("Missing vertex element in PLY file");
+  }
+  if (vertexElement->count > UINT32_MAX)
+  {
+    throw std::logic_error("Too many vertices in PLY file for 32-bit indices");
+  }
+
+  // Vertex properties
+  uint32_t positionOffsets[3];
+  const PlyProperty* position[3] = {FindPlyProperty(*vertexElement, {"x"}, &positionOffsets[0]),
+                                    FindPlyProperty(*vertexElement, {"y"}, &positionOffsets[1]),
+                                    FindPlyProperty(*vertexElement, {"z"}, &positionOffsets[2])};
+  if (!position[0] || !position[1] || !position[2])
+  {
+    throw std::logic_error("Missing vertex position in PLY file");
+  }
+  uint32_t colorOffsets[4] = {};
+  const PlyProperty* color[4] = {
+      FindPlyProperty(*vertexElement, {"red", "r", "diffuse_red"}, &colorOffsets[0]),
+      FindPlyProperty(*vertexElement, {"green", "g", "diffuse_green"}, &colorOffsets[1]),
+      FindPlyProperty(*vertexElement, {"blue", "b", "diffuse_blue"}, &colorOffsets[2]),
+      FindPlyProperty(*vertexElement, {"alpha", "a", "diffuse_alpha"}, &colorOffsets[3])};
+
+  size_t vertexCount = static_cast<size_t>(vertexElement->count);
+  uint64_t vertexSize = GetPlyFixedSize(*vertexElement);
+  uint8_t* vertices = static_cast<uint8_t*>(allocateVertices(vertexCount));
+  indices.resize(static_cast<size_t>(3 * triangleCount));
+
+  // Parse the vertices in blocks of fixed size
+  size_t vertexBlockCount = threadCount * kChunksPerThread;
+  size_t verticesPerBlock = (vertexCount + vertexBlockCount - 1) / vertexBlockCount;
+  ParallelFor(vertexBlockCount, threadCount, [&](size_t block) {
+    size_t begin = block * verticesPerBlock;
+    size_t end = begin + verticesPerBlock < vertexCount ? begin + verticesPerBlock : vertexCount;
+    for (size_t i = begin; i < end; i++)
+    {
+      const uint8_t* record = data + vertexElement->offset + i * vertexSize;
+      float p[3];
+      float c[4] = {1.f, 1.f, 1.f, 1.f};
+      for (int j = 0; j < 3; j++)
+      {
+        p[j] = static_cast<float>(
+            ReadPlyValue(record + positionOffsets[j], position[j]->type, bigEndian));
+      }
+      for (int j = 0; j < 4; j++)
+      {
+        if (color[j])
+        {
+          c[j] = ReadPlyColor(record + colorOffsets[j], color[j]->type, bigEndian);
+        }
+      }
+      WriteVertex(vertices, layout, i, p, c);
+    }
+  });
+
+  // Parse the faces block by block, triangulating them as fans
+  ParallelFor(faceBlocks.size(), threadCount, [&](size_t block) {
+    const PlyFaceBlock& faceBlock = faceBlocks[block];
+    uint64_t faceOffset = faceBlock.offset;
+    uint32_t* triangleIndices = indices.data() + 3 * faceBlock.firstTriangle;
+
+    for (uint64_t i = 0; i < faceBlock.faceCount; i++)
+    {
+      for (const PlyProperty& property : faceElement->properties)
+      {
+        if (!property.isList)
+        {
+          faceOffset += GetPlyTypeSize(property.type);
+          continue;
+        }
+        uint64_t itemCount = ReadPlyCount(data + faceOffset, property.countType, bigEndian, size);
+        faceOffset += GetPlyTypeSize(property.countType);
+        uint32_t itemSize = GetPlyTypeSize(property.type);
+        if (&property == faceList)
+        {
+          uint32_t first = 0;
+          uint32_t previous = 0;
+          for (uint64_t j = 0; j < itemCount; j++)
+          {
+            double index = ReadPlyValue(data + faceOffset + j * itemSize, property.type, bigEndian);
+            if (index < 0 || index >= static_cast<double>(vertexCount))
+            {
+              throw std::logic_error("Out of range face index in PLY file");
+            }
+            uint32_t corner = static_cast<uint32_t>(index);
+            if (j == 0)
+            {
+              first = corner;
+            }
+            else if (j >= 2)
+            {
+              *triangleIndices++ = first;
+              *triangleIndices++ = previous;
+              *triangleIndices++ = corner;
+            }
+            previous = corner;
+          }
+        }
+        faceOffset += itemCount * itemSize;
+      }
+    }
+  });
+}
+
+} // namespace nv_helpers_dx12
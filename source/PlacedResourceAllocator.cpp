@@ -0,0 +1,210 @@
+/*
+The placed resource allocator creates buffers as placed resources within a few large heaps. See
+PlacedResourceAllocator.h for an overview.
+*/
+
+#include "PlacedResourceAllocator.h"
+#include "d3dx12.h"
+
+#include <stdexcept>
+
+namespace nv_helpers_dx12
+{
+
+//--------------------------------------------------------------------------------------------------
+//
+// The blocks of the buddy allocator are the size of the alignment class, so that every buffer is
+// placed at a valid offset
+PlacedResourceAllocator::HeapPool::HeapPool(ID3D12Device* device, D3D12_HEAP_TYPE heapType,
+                                            uint64_t heapSize, uint64_t alignment)
+    : HeapSuballocator(heapSize, alignment), m_device(device), m_heapType(heapType),
+      m_alignment(alignment)
+{
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+PlacedResourceAllocator::HeapPool::~HeapPool()
+{
+  for (uint32_t page = 0; page < static_cast<uint32_t>(m_heaps.size()); page++)
+  {
+    DestroyPage(page);
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// The heaps only contain buffers, which is required on hardware with resource heap tier 1
+void PlacedResourceAllocator::HeapPool::CreatePage(uint32_t page)
+{
+  if (page >= m_heaps.size())
+  {
+    m_heaps.resize(page + 1, nullptr);
+  }
+  D3D12_HEAP_DESC heapDesc = {};
+  heapDesc.SizeInBytes = GetPageSize();
+  heapDesc.Properties = CD3DX12_HEAP_PROPERTIES(m_heapType);
+  heapDesc.Alignment = m_alignment;
+  heapDesc.Flags = D3D12_HEAP_FLAG_ALLOW_ONLY_BUFFERS;
+  if (FAILED(m_device->CreateHeap(&heapDesc, IID_PPV_ARGS(&m_heaps[page]))))
+  {
+    throw std::logic_error("Could not create a placed resource heap");
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+void PlacedResourceAllocator::HeapPool::DestroyPage(uint32_t page)
+{
+  if (m_heaps[page])
+  {
+    m_heaps[page]->Release();
+    m_heaps[page] = nullptr;
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+PlacedResourceAllocator::~PlacedResourceAllocator()
+{
+  Release();
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Set the device and the size of the heaps
+void PlacedResourceAllocator::Initialize(ID3D12Device* device, uint64_t heapSize)
+{
+  Release();
+  m_device = device;
+  m_heapSize = heapSize;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Create a buffer in a heap of the given type. The size and alignment of the buffer are provided
+// by the device, and determine its alignment class
+ID3D12Resource* PlacedResourceAllocator::CreateBuffer(uint64_t size, D3D12_RESOURCE_FLAGS flags,
+                                                      D3D12_RESOURCE_STATES initState,
+                                                      D3D12_HEAP_TYPE heapType)
+{
+  CD3DX12_RESOURCE_DESC bufDesc = CD3DX12_RESOURCE_DESC::Buffer(size, flags);
+  D3D12_RESOURCE_ALLOCATION_INFO info = m_device->GetResourceAllocationInfo(0, 1, &bufDesc);
+
+  ID3D12Resource* pBuffer = nullptr;
+  if (info.SizeInBytes > m_heapSize)
+  {
+    // Too large for the heaps, the buffer gets its own memory
+    CD3DX12_HEAP_PROPERTIES heapProps(heapType);
+    if (FAILED(m_device->CreateCommittedResource(&heapProps, D3D12_HEAP_FLAG_NONE, &bufDesc,
+                                                 initState, nullptr, IID_PPV_ARGS(&pBuffer))))
+    {
+      throw std::logic_error("Could not create a committed buffer");
+    }
+    return pBuffer;
+  }
+
+  HeapPool& pool = GetPool(heapType, info.Alignment);
+  HeapSuballocator::Allocation allocation = pool.Allocate(info.SizeInBytes, info.Alignment);
+  if (FAILED(m_device->CreatePlacedResource(pool.GetHeap(allocation.page), allocation.offset,
+                                            &bufDesc, initState, nullptr,
+                                            IID_PPV_ARGS(&pBuffer))))
+  {
+    pool.Free(allocation);
+    throw std::logic_error("Could not create a placed buffer");
+  }
+
+  m_buffers[pBuffer] = {&pool, allocation};
+  return pBuffer;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// The frames complete in order, so a buffer freed with a lower fence value than the last one is
+// kept until that value is reached. This delays its release, but never makes it early
+void PlacedResourceAllocator::Free(ID3D12Resource* buffer, uint64_t fenceValue)
+{
+  if (buffer == nullptr)
+  {
+    return;
+  }
+  if (!m_freedBuffers.empty() && m_freedBuffers.back().fenceValue > fenceValue)
+  {
+    fenceValue = m_freedBuffers.back().fenceValue;
+  }
+  m_freedBuffers.push_back({buffer, fenceValue});
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Release the buffers whose frames have completed. They are at the front of the list, and the
+// ranges of the placed ones become available for the next buffers
+void PlacedResourceAllocator::Reclaim(uint64_t completedFenceValue)
+{
+  while (!m_freedBuffers.empty() && m_freedBuffers.front().fenceValue <= completedFenceValue)
+  {
+    ID3D12Resource* resource = m_freedBuffers.front().resource;
+    m_freedBuffers.pop_front();
+    resource->Release();
+
+    auto it = m_buffers.find(resource);
+    if (it != m_buffers.end())
+    {
+      it->second.pool->Free(it->second.allocation);
+      m_buffers.erase(it);
+    }
+  }
+
+  for (auto& pool : m_pools)
+  {
+    pool.second->ReleaseEmptyPages();
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+uint32_t PlacedResourceAllocator::GetHeapCount() const
+{
+  uint32_t count = 0;
+  for (const auto& pool : m_pools)
+  {
+    count += pool.second->GetPageCount();
+  }
+  return count;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Get the pool of heaps of a type and alignment class, creating it if needed
+PlacedResourceAllocator::HeapPool& PlacedResourceAllocator::GetPool(D3D12_HEAP_TYPE heapType,
+                                                                    uint64_t alignment)
+{
+  std::unique_ptr<HeapPool>& pool = m_pools[{heapType, alignment}];
+  if (!pool)
+  {
+    pool = std::make_unique<HeapPool>(m_device, heapType, m_heapSize, alignment);
+  }
+  return *pool;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Release the freed buffers and the heaps. The GPU must be idle, and the buffers which were not
+// freed must no longer be used, as their memory is released along with the heaps
+void PlacedResourceAllocator::Release()
+{
+  for (FreedBuffer& buffer : m_freedBuffers)
+  {
+    buffer.resource->Release();
+  }
+  m_freedBuffers.clear();
+  m_buffers.clear();
+  m_pools.clear();
+  m_device = nullptr;
+}
+
+} // namespace nv_helpers_dx12
@@ -0,0 +1,300 @@
+// Only built on POSIX systems, the Windows build uses Win32Platform
+#if !defined(_WIN32)
+
+#include "PosixPlatform.h"
+
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <filesystem>
+#include <stdexcept>
+#include <unordered_map>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#if defined(__linux__)
+#include <dirent.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#endif
+
+// The paths of the pipeline are wide strings holding UTF-32, the file system
+// uses UTF-8 whatever the locale. An empty string is returned on failure
+static std::string ToNativePath(const std::wstring &path)
+{
+	try
+	{
+		return std::filesystem::path(std::u32string(path.begin(), path.end())).string();
+	}
+	catch (const std::filesystem::filesystem_error &)
+	{
+		return std::string();
+	}
+}
+
+static std::wstring FromNativePath(const std::string &path)
+{
+	try
+	{
+		std::u32string widePath = std::filesystem::path(path).u32string();
+		return std::wstring(widePath.begin(), widePath.end());
+	}
+	catch (const std::filesystem::filesystem_error &)
+	{
+		return std::wstring();
+	}
+}
+
+std::wstring PosixPlatform::GetExecutableDirectory() const
+{
+	char path[PATH_MAX];
+	ssize_t size = readlink("/proc/self/exe", path, sizeof(path));
+	if (size <= 0 || size == static_cast<ssize_t>(sizeof(path)))
+	{
+		// Method failed or path was truncated.
+		throw std::logic_error("Cannot get the path of the executable");
+	}
+
+	std::string directory(path, static_cast<size_t>(size));
+	directory.erase(directory.find_last_of('/') + 1);
+
+	std::wstring widePath = FromNativePath(directory);
+	if (widePath.empty())
+		throw std::logic_error("Cannot convert the path of the executable");
+	return widePath;
+}
+
+double PosixPlatform::GetTime() const
+{
+	timespec time;
+	clock_gettime(CLOCK_MONOTONIC, &time);
+	return static_cast<double>(time.tv_sec) + static_cast<double>(time.tv_nsec) * 1e-9;
+}
+
+// The mapping stays valid once the file descriptor is closed
+bool FileSystem::MapFile(const std::wstring &fileName, FileMapping &mapping)
+{
+	UnmapFile(mapping);
+
+	int file = open(ToNativePath(fileName).c_str(), O_RDONLY | O_CLOEXEC);
+	if (file < 0)
+		return false;
+
+	struct stat fileStatus = {};
+	if (fstat(file, &fileStatus) == 0 && fileStatus.st_size > 0)
+	{
+		void *data = mmap(nullptr, static_cast<size_t>(fileStatus.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+		if (data != MAP_FAILED)
+		{
+			mapping.data = static_cast<const uint8_t *>(data);
+			mapping.size = static_cast<uint64_t>(fileStatus.st_size);
+		}
+	}
+	close(file);
+	return mapping.data != nullptr;
+}
+
+void FileSystem::UnmapFile(FileMapping &mapping)
+{
+	if (mapping.data)
+		munmap(const_cast<uint8_t *>(mapping.data), static_cast<size_t>(mapping.size));
+	mapping = FileMapping();
+}
+
+std::FILE *FileSystem::OpenFile(const std::wstring &fileName, const char *mode)
+{
+	return fopen(ToNativePath(fileName).c_str(), mode);
+}
+
+bool FileSystem::RenameFile(const std::wstring &fileName, const std::wstring &newFileName)
+{
+	return rename(ToNativePath(fileName).c_str(), ToNativePath(newFileName).c_str()) == 0;
+}
+
+bool FileSystem::RemoveFile(const std::wstring &fileName)
+{
+	return unlink(ToNativePath(fileName).c_str()) == 0;
+}
+
+// The path is made absolute and normalized in UTF-8, without requiring it
+// to exist
+std::wstring FileSystem::GetAbsolutePath(const std::wstring &path)
+{
+	std::error_code error;
+	std::filesystem::path absolutePath = std::filesystem::absolute(ToNativePath(path), error);
+	if (path.empty() || error)
+		return path;
+	return FromNativePath(absolutePath.lexically_normal().string());
+}
+
+// The parents are created first, the existing ones being skipped
+bool FileSystem::CreateDirectories(const std::wstring &directory)
+{
+	std::string path = ToNativePath(directory);
+	while (path.size() > 1 && path.back() == '/')
+		path.pop_back();
+	if (path.empty())
+		return false;
+
+	struct stat status = {};
+	if (stat(path.c_str(), &status) == 0)
+		return S_ISDIR(status.st_mode);
+
+	const size_t parentEnd = path.find_last_of('/');
+	if (parentEnd != std::string::npos && parentEnd > 0)
+		CreateDirectories(FromNativePath(path.substr(0, parentEnd)));
+	return mkdir(path.c_str(), 0777) == 0 || errno == EEXIST;
+}
+
+#if defined(__linux__)
+
+// inotify does not watch the subdirectories, which are each added to the
+// watch, including the ones created while watching. The cancellation is
+// signaled through an eventfd polled along with the notifications
+struct FileSystem::DirectoryWatch
+{
+	int notifications = -1;
+	int stopEvent = -1;
+	// Watched directory, ending with a separator
+	std::string root;
+	// Path of each watched directory relative to the root, empty or ending
+	// with a separator, by watch descriptor
+	std::unordered_map<int, std::string> directories;
+};
+
+static void AddDirectoryWatches(FileSystem::DirectoryWatch *watch, const std::string &directory)
+{
+	const std::string path = watch->root + directory;
+	const uint32_t mask = IN_CREATE | IN_MODIFY | IN_CLOSE_WRITE | IN_MOVED_TO | IN_ONLYDIR;
+	int descriptor = inotify_add_watch(watch->notifications, path.c_str(), mask);
+	if (descriptor < 0)
+		return;
+	watch->directories[descriptor] = directory;
+
+	DIR *entries = opendir(path.c_str());
+	if (entries == nullptr)
+		return;
+	while (dirent *entry = readdir(entries))
+	{
+		const std::string name = entry->d_name;
+		if (name == "." || name == "..")
+			continue;
+		struct stat status = {};
+		if (stat((path + name).c_str(), &status) == 0 && S_ISDIR(status.st_mode))
+			AddDirectoryWatches(watch, directory + name + '/');
+	}
+	closedir(entries);
+}
+
+FileSystem::DirectoryWatch *FileSystem::OpenDirectoryWatch(const std::wstring &directory)
+{
+	DirectoryWatch *watch = new DirectoryWatch;
+	watch->root = ToNativePath(directory);
+	if (!watch->root.empty() && watch->root.back() != '/')
+		watch->root += '/';
+	watch->notifications = inotify_init1(IN_CLOEXEC);
+	watch->stopEvent = eventfd(0, EFD_CLOEXEC);
+	if (!watch->root.empty() && watch->notifications >= 0 && watch->stopEvent >= 0)
+		AddDirectoryWatches(watch, std::string());
+	if (watch->directories.empty())
+	{
+		CloseDirectoryWatch(watch);
+		return nullptr;
+	}
+	return watch;
+}
+
+// Each read returns a list of inotify_event records, whose names are relative
+// to the directory of their watch
+bool FileSystem::WaitForDirectoryChanges(DirectoryWatch *watch, std::vector<std::wstring> &modifiedFiles, bool &overflow)
+{
+	pollfd descriptors[2] = {{watch->notifications, POLLIN, 0}, {watch->stopEvent, POLLIN, 0}};
+	while (poll(descriptors, 2, -1) < 0)
+	{
+		if (errno != EINTR)
+			return false;
+	}
+	if (descriptors[1].revents != 0 || (descriptors[0].revents & POLLIN) == 0)
+		return false;
+
+	alignas(inotify_event) char buffer[16384];
+	ssize_t size = read(watch->notifications, buffer, sizeof(buffer));
+	if (size <= 0)
+		return false;
+
+	overflow = false;
+	for (const char *record = buffer; record < buffer + size;)
+	{
+		const inotify_event *event = reinterpret_cast<const inotify_event *>(record);
+		record += sizeof(inotify_event) + event->len;
+		if (event->mask & IN_Q_OVERFLOW)
+		{
+			overflow = true;
+			continue;
+		}
+		auto directory = watch->directories.find(event->wd);
+		if (directory == watch->directories.end() || event->len == 0)
+			continue;
+		const std::string fileName = directory->second + event->name;
+		if (event->mask & IN_ISDIR)
+		{
+			if (event->mask & (IN_CREATE | IN_MOVED_TO))
+				AddDirectoryWatches(watch, fileName + '/');
+			continue;
+		}
+		modifiedFiles.push_back(FromNativePath(fileName));
+	}
+	return true;
+}
+
+void FileSystem::CancelDirectoryWatch(DirectoryWatch *watch)
+{
+	const uint64_t value = 1;
+	if (write(watch->stopEvent, &value, sizeof(value)) < 0)
+		return;
+}
+
+void FileSystem::CloseDirectoryWatch(DirectoryWatch *watch)
+{
+	if (watch == nullptr)
+		return;
+	if (watch->notifications >= 0)
+		close(watch->notifications);
+	if (watch->stopEvent >= 0)
+		close(watch->stopEvent);
+	delete watch;
+}
+
+#else
+
+// Watching directories is only implemented on Linux, and fails elsewhere
+struct FileSystem::DirectoryWatch
+{
+};
+
+FileSystem::DirectoryWatch *FileSystem::OpenDirectoryWatch(const std::wstring &directory)
+{
+	return nullptr;
+}
+
+bool FileSystem::WaitForDirectoryChanges(DirectoryWatch *watch, std::vector<std::wstring> &modifiedFiles, bool &overflow)
+{
+	return false;
+}
+
+void FileSystem::CancelDirectoryWatch(DirectoryWatch *watch)
+{
+}
+
+void FileSystem::CloseDirectoryWatch(DirectoryWatch *watch)
+{
+	delete watch;
+}
+
+#endif
+
+#endif
@@ -40,6 +40,7 @@ compiling in debug mode.
 */
 
 #include "RaytracingPipelineGenerator.h"
+#include "RootSignatureCache.h"
 
 #include "dxcapi.h"
 #include <unordered_set>
@@ -132,16 +133,65 @@ void RayTracingPipelineGenerator::SetMaxRecursionDepth(UINT maxDepth)
   m_maxRecursionDepth = maxDepth;
 }
 
+//--------------------------------------------------------------------------------------------------
+//
+// Link an existing collection into the pipeline. The collection brings its own libraries, hit
+// groups and associations, which are not compiled again
+void RayTracingPipelineGenerator::AddCollection(
+    ID3D12StateObject* collection, const std::vector<std::wstring>& symbolExports /*= {}*/)
+{
+  m_collections.emplace_back(Collection(collection, symbolExports));
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Allow the generated state objects to be extended later using AddToStateObject
+void RayTracingPipelineGenerator::SetAllowStateObjectAdditions(bool allow)
+{
+  m_allowStateObjectAdditions = allow;
+}
+
 //--------------------------------------------------------------------------------------------------
 //
 // Compiles the raytracing state object
 ID3D12StateObject* RayTracingPipelineGenerator::Generate()
+{
+  return CreateStateObject(D3D12_STATE_OBJECT_TYPE_RAYTRACING_PIPELINE, nullptr);
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Compiles the libraries, hit groups and associations into a collection, which can then be linked
+// into any number of pipelines without compiling its shaders again
+ID3D12StateObject* RayTracingPipelineGenerator::GenerateCollection()
+{
+  return CreateStateObject(D3D12_STATE_OBJECT_TYPE_COLLECTION, nullptr);
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Create a new pipeline made of an existing one, extended with the libraries, hit groups and
+// collections added to this generator. Only the additions are compiled
+ID3D12StateObject* RayTracingPipelineGenerator::AddToStateObject(ID3D12StateObject* existing)
+{
+  return CreateStateObject(D3D12_STATE_OBJECT_TYPE_RAYTRACING_PIPELINE, existing);
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Build the subobjects of the state object, and create either a new state object, or an
+// extension of an existing one
+ID3D12StateObject*
+RayTracingPipelineGenerator::CreateStateObject(D3D12_STATE_OBJECT_TYPE type,
+                                               ID3D12StateObject* existing)
 {
   // The pipeline is made of a set of sub-objects, representing the DXIL libraries, hit group
   // declarations, root signature associations, plus some configuration objects
   UINT64 subobjectCount =
       m_libraries.size() +                     // DXIL libraries
+      m_collections.size() +                   // Existing collections
       m_hitGroups.size() +                     // Hit group declarations
+      1 +                                      // State object configuration
       1 +                                      // Shader configuration
       1 +                                      // Shader payload
       2 * m_rootSignatureAssociations.size() + // Root signature declaration + association
@@ -165,6 +215,16 @@ ID3D12StateObject* RayTracingPipelineGenerator::Generate()
     subobjects[currentIndex++] = libSubobject;
   }
 
+  // Add all the collections, whose shaders are already compiled
+  for (const Collection& collection : m_collections)
+  {
+    D3D12_STATE_SUBOBJECT collectionSubobject = {};
+    collectionSubobject.Type = D3D12_STATE_SUBOBJECT_TYPE_EXISTING_COLLECTION;
+    collectionSubobject.pDesc = &collection.m_desc;
+
+    subobjects[currentIndex++] = collectionSubobject;
+  }
+
   // Add all the hit group declarations
   for (const HitGroup& group : m_hitGroups)
   {
@@ -175,6 +235,21 @@ ID3D12StateObject* RayTracingPipelineGenerator::Generate()
     subobjects[currentIndex++] = hitGroup;
   }
 
+  // Pipelines which may be extended later, as well as the collections they include, have to be
+  // flagged as such
+  D3D12_STATE_OBJECT_CONFIG stateObjectConfig = {};
+  stateObjectConfig.Flags = m_allowStateObjectAdditions
+                                ? D3D12_STATE_OBJECT_FLAG_ALLOW_STATE_OBJECT_ADDITIONS
+                                : D3D12_STATE_OBJECT_FLAG_NONE;
+  if (stateObjectConfig.Flags != D3D12_STATE_OBJECT_FLAG_NONE)
+  {
+    D3D12_STATE_SUBOBJECT stateObjectConfigObject = {};
+    stateObjectConfigObject.Type = D3D12_STATE_SUBOBJECT_TYPE_STATE_OBJECT_CONFIG;
+    stateObjectConfigObject.pDesc = &stateObjectConfig;
+
+    subobjects[currentIndex++] = stateObjectConfigObject;
+  }
+
   // Add a subobject for the shader payload configuration
   D3D12_RAYTRACING_SHADER_CONFIG shaderDesc = {};
   shaderDesc.MaxPayloadSizeInBytes = m_maxPayLoadSizeInBytes;
@@ -242,7 +317,7 @@ ID3D12StateObject* RayTracingPipelineGenerator::Generate()
   // The pipeline construction always requires an empty global root signature
   D3D12_STATE_SUBOBJECT globalRootSig;
   globalRootSig.Type = D3D12_STATE_SUBOBJECT_TYPE_GLOBAL_ROOT_SIGNATURE;
-  ID3D12RootSignature* dgSig = m_dummyGlobalRootSignature;
+  ID3D12RootSignature* dgSig = m_dummyGlobalRootSignature.Get();
   globalRootSig.pDesc = &dgSig;
 
   subobjects[currentIndex++] = globalRootSig;
@@ -250,7 +325,7 @@ ID3D12StateObject* RayTracingPipelineGenerator::Generate()
   // The pipeline construction always requires an empty local root signature
   D3D12_STATE_SUBOBJECT dummyLocalRootSig;
   dummyLocalRootSig.Type = D3D12_STATE_SUBOBJECT_TYPE_LOCAL_ROOT_SIGNATURE;
-  ID3D12RootSignature* dlSig = m_dummyLocalRootSignature;
+  ID3D12RootSignature* dlSig = m_dummyLocalRootSignature.Get();
   dummyLocalRootSig.pDesc = &dlSig;
   subobjects[currentIndex++] = dummyLocalRootSig;
 
@@ -266,17 +341,35 @@ ID3D12StateObject* RayTracingPipelineGenerator::Generate()
 
   // Describe the ray tracing pipeline state object
   D3D12_STATE_OBJECT_DESC pipelineDesc = {};
-  pipelineDesc.Type = D3D12_STATE_OBJECT_TYPE_RAYTRACING_PIPELINE;
+  pipelineDesc.Type = type;
   pipelineDesc.NumSubobjects = currentIndex; // static_cast<UINT>(subobjects.size());
   pipelineDesc.pSubobjects = subobjects.data();
 
   ID3D12StateObject* rtStateObject = nullptr;
 
-  // Create the state object
-  HRESULT hr = m_device->CreateStateObject(&pipelineDesc, IID_PPV_ARGS(&rtStateObject));
+  if (existing == nullptr)
+  {
+    // Create the state object
+    HRESULT hr = m_device->CreateStateObject(&pipelineDesc, IID_PPV_ARGS(&rtStateObject));
+    if (FAILED(hr))
+    {
+      throw std::logic_error("Could not create the raytracing state object");
+    }
+    return rtStateObject;
+  }
+
+  // Incremental additions are only available starting with ID3D12Device7, on devices supporting
+  // raytracing tier 1.1
+  ID3D12Device7* device7 = nullptr;
+  if (FAILED(m_device->QueryInterface(IID_PPV_ARGS(&device7))))
+  {
+    throw std::logic_error("State object additions are not supported by the device");
+  }
+  HRESULT hr = device7->AddToStateObject(&pipelineDesc, existing, IID_PPV_ARGS(&rtStateObject));
+  device7->Release();
   if (FAILED(hr))
   {
-    throw std::logic_error("Could not create the raytracing state object");
+    throw std::logic_error("Could not add to the raytracing state object");
   }
   return rtStateObject;
 }
@@ -294,45 +387,13 @@ void RayTracingPipelineGenerator::CreateDummyRootSignatures()
   // A global root signature is the default, hence this flag
   rootDesc.Flags = D3D12_ROOT_SIGNATURE_FLAG_NONE;
 
-  HRESULT hr = 0;
-
-  ID3DBlob* serializedRootSignature;
-  ID3DBlob* error;
-
-  // Create the empty global root signature
-  hr = D3D12SerializeRootSignature(&rootDesc, D3D_ROOT_SIGNATURE_VERSION_1,
-                                   &serializedRootSignature, &error);
-  if (FAILED(hr))
-  {
-    throw std::logic_error("Could not serialize the global root signature");
-  }
-  hr = m_device->CreateRootSignature(0, serializedRootSignature->GetBufferPointer(),
-                                     serializedRootSignature->GetBufferSize(),
-                                     IID_PPV_ARGS(&m_dummyGlobalRootSignature));
-
-  serializedRootSignature->Release();
-  if (FAILED(hr))
-  {
-    throw std::logic_error("Could not create the global root signature");
-  }
+  // The empty signatures are the same for all pipelines, and are only serialized and created once
+  // per process by the root signature cache. The reference it returns is owned by the generator
+  m_dummyGlobalRootSignature.Attach(RootSignatureCache::Get().GetOrCreate(m_device, rootDesc));
 
   // Create the local root signature, reusing the same descriptor but altering the creation flag
   rootDesc.Flags = D3D12_ROOT_SIGNATURE_FLAG_LOCAL_ROOT_SIGNATURE;
-  hr = D3D12SerializeRootSignature(&rootDesc, D3D_ROOT_SIGNATURE_VERSION_1,
-                                   &serializedRootSignature, &error);
-  if (FAILED(hr))
-  {
-    throw std::logic_error("Could not serialize the local root signature");
-  }
-  hr = m_device->CreateRootSignature(0, serializedRootSignature->GetBufferPointer(),
-                                     serializedRootSignature->GetBufferSize(),
-                                     IID_PPV_ARGS(&m_dummyLocalRootSignature));
-
-  serializedRootSignature->Release();
-  if (FAILED(hr))
-  {
-    throw std::logic_error("Could not create the local root signature");
-  }
+  m_dummyLocalRootSignature.Attach(RootSignatureCache::Get().GetOrCreate(m_device, rootDesc));
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -464,6 +525,38 @@ RayTracingPipelineGenerator::Library::Library(const Library& source)
 {
 }
 
+//--------------------------------------------------------------------------------------------------
+//
+// Store an existing collection and the symbols it exports to the pipeline. An empty list of
+// symbols exports everything the collection defines
+RayTracingPipelineGenerator::Collection::Collection(
+    ID3D12StateObject* collection, const std::vector<std::wstring>& exportedSymbols)
+    : m_collection(collection), m_exportedSymbols(exportedSymbols),
+      m_exports(exportedSymbols.size())
+{
+  for (size_t i = 0; i < m_exportedSymbols.size(); i++)
+  {
+    m_exports[i] = {};
+    m_exports[i].Name = m_exportedSymbols[i].c_str();
+    m_exports[i].ExportToRename = nullptr;
+    m_exports[i].Flags = D3D12_EXPORT_FLAG_NONE;
+  }
+
+  m_desc.pExistingCollection = m_collection;
+  m_desc.NumExports = static_cast<UINT>(m_exportedSymbols.size());
+  m_desc.pExports = m_exports.empty() ? nullptr : m_exports.data();
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// This copy constructor has to be defined so that the export descriptors are set correctly. Using
+// the default constructor would copy the string pointers of the symbols into the descriptors, which
+// would cause issues when the original Collection object gets out of scope
+RayTracingPipelineGenerator::Collection::Collection(const Collection& source)
+    : Collection(source.m_collection, source.m_exportedSymbols)
+{
+}
+
 //--------------------------------------------------------------------------------------------------
 //
 // Create a hit group descriptor from the input hit group name and shader symbols
@@ -0,0 +1,182 @@
+/*
+The resource state tracker records the state of the resources, and emits the barriers required
+to use them in batches. See ResourceStateTracker.h for an overview.
+*/
+
+#include "ResourceStateTracker.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace nv_helpers_dx12
+{
+
+namespace
+{
+/// States in which a resource can only be read, which can be combined together
+const D3D12_RESOURCE_STATES kReadStates = static_cast<D3D12_RESOURCE_STATES>(
+    D3D12_RESOURCE_STATE_GENERIC_READ | D3D12_RESOURCE_STATE_DEPTH_READ |
+    D3D12_RESOURCE_STATE_RESOLVE_SOURCE);
+} // namespace
+
+//--------------------------------------------------------------------------------------------------
+//
+// Start tracking a resource, or override its tracked state. A pending transition of the resource
+// would leave it in another state, and is discarded
+void ResourceStateTracker::SetState(ID3D12Resource* resource, D3D12_RESOURCE_STATES state)
+{
+  m_pendingTransitions.erase(
+      std::remove_if(m_pendingTransitions.begin(), m_pendingTransitions.end(),
+                     [resource](const D3D12_RESOURCE_BARRIER& barrier) {
+                       return barrier.Transition.pResource == resource;
+                     }),
+      m_pendingTransitions.end());
+  m_states[resource] = state;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+D3D12_RESOURCE_STATES ResourceStateTracker::GetState(ID3D12Resource* resource) const
+{
+  auto it = m_states.find(resource);
+  if (it == m_states.end())
+  {
+    throw std::logic_error("The state of the resource is not tracked");
+  }
+  return it->second;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Stop tracking a resource, and discard its pending barriers
+void ResourceStateTracker::Forget(ID3D12Resource* resource)
+{
+  SetState(resource, D3D12_RESOURCE_STATE_COMMON);
+  m_states.erase(resource);
+  m_pendingUAVBarriers.erase(
+      std::remove(m_pendingUAVBarriers.begin(), m_pendingUAVBarriers.end(), resource),
+      m_pendingUAVBarriers.end());
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Queue the transition of a resource. If the resource already has a pending transition, no command
+// uses it between the two, so the transitions are merged into one from the state before the first
+// to the requested state
+void ResourceStateTracker::Transition(ID3D12Resource* resource, D3D12_RESOURCE_STATES state)
+{
+  auto stateIt = m_states.find(resource);
+  if (stateIt == m_states.end())
+  {
+    throw std::logic_error("Transition of a resource whose state is not tracked");
+  }
+  const D3D12_RESOURCE_STATES current = stateIt->second;
+  if (current == state)
+  {
+    return;
+  }
+  // A read state is already satisfied by a combined read state including it
+  if (current != 0 && (current & ~kReadStates) == 0 && (current & state) == state)
+  {
+    return;
+  }
+  stateIt->second = state;
+
+  for (auto it = m_pendingTransitions.begin(); it != m_pendingTransitions.end(); ++it)
+  {
+    if (it->Transition.pResource != resource)
+    {
+      continue;
+    }
+    if (it->Transition.StateBefore == state)
+    {
+      m_pendingTransitions.erase(it);
+    }
+    else
+    {
+      it->Transition.StateAfter = state;
+    }
+    return;
+  }
+
+  D3D12_RESOURCE_BARRIER barrier = {};
+  barrier.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
+  barrier.Flags = D3D12_RESOURCE_BARRIER_FLAG_NONE;
+  barrier.Transition.pResource = resource;
+  barrier.Transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
+  barrier.Transition.StateBefore = current;
+  barrier.Transition.StateAfter = state;
+  m_pendingTransitions.push_back(barrier);
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Queue a UAV barrier, unless an equivalent one is already pending
+void ResourceStateTracker::UAVBarrier(ID3D12Resource* resource)
+{
+  if (m_pendingGlobalUAVBarrier)
+  {
+    return;
+  }
+  if (resource == nullptr)
+  {
+    m_pendingGlobalUAVBarrier = true;
+    m_pendingUAVBarriers.clear();
+    return;
+  }
+  if (std::find(m_pendingUAVBarriers.begin(), m_pendingUAVBarriers.end(), resource) ==
+      m_pendingUAVBarriers.end())
+  {
+    m_pendingUAVBarriers.push_back(resource);
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Record all the pending barriers in a single call
+void ResourceStateTracker::Flush(ID3D12GraphicsCommandList* commandList)
+{
+  m_barriers.clear();
+  Flush(m_barriers);
+  if (!m_barriers.empty())
+  {
+    commandList->ResourceBarrier(static_cast<UINT>(m_barriers.size()), m_barriers.data());
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Move the pending barriers to the list, UAV barriers first. A UAV barrier on several resources is
+// emitted as a single barrier on all the unordered accesses
+void ResourceStateTracker::Flush(std::vector<D3D12_RESOURCE_BARRIER>& barriers)
+{
+  if (m_pendingGlobalUAVBarrier || m_pendingUAVBarriers.size() > 1)
+  {
+    m_pendingUAVBarriers.assign(1, nullptr);
+  }
+  for (ID3D12Resource* resource : m_pendingUAVBarriers)
+  {
+    D3D12_RESOURCE_BARRIER barrier = {};
+    barrier.Type = D3D12_RESOURCE_BARRIER_TYPE_UAV;
+    barrier.Flags = D3D12_RESOURCE_BARRIER_FLAG_NONE;
+    barrier.UAV.pResource = resource;
+    barriers.push_back(barrier);
+  }
+  barriers.insert(barriers.end(), m_pendingTransitions.begin(), m_pendingTransitions.end());
+
+  m_pendingTransitions.clear();
+  m_pendingUAVBarriers.clear();
+  m_pendingGlobalUAVBarrier = false;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+uint32_t ResourceStateTracker::GetPendingBarrierCount() const
+{
+  const bool hasUAVBarrier = m_pendingGlobalUAVBarrier || !m_pendingUAVBarriers.empty();
+  return static_cast<uint32_t>(m_pendingTransitions.size()) + (hasUAVBarrier ? 1 : 0);
+}
+
+} // namespace nv_helpers_dx12
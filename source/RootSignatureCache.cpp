@@ -0,0 +1,290 @@
+/*
+The root signature cache avoids serializing and creating the same root signature over and over.
+See RootSignatureCache.h for an overview.
+*/
+
+#include "RootSignatureCache.h"
+#include "ContentHash.h"
+#include "MappedFile.h"
+#include "d3dx12.h"
+
+#include <cstring>
+#include <stdexcept>
+
+namespace nv_helpers_dx12
+{
+
+namespace
+{
+// The flags only exist in root signature version 1.1
+uint64_t HashFlags(const D3D12_DESCRIPTOR_RANGE&, uint64_t key)
+{
+  return key;
+}
+uint64_t HashFlags(const D3D12_DESCRIPTOR_RANGE1& range, uint64_t key)
+{
+  return HashValue(range.Flags, key);
+}
+uint64_t HashFlags(const D3D12_ROOT_DESCRIPTOR&, uint64_t key)
+{
+  return key;
+}
+uint64_t HashFlags(const D3D12_ROOT_DESCRIPTOR1& descriptor, uint64_t key)
+{
+  return HashValue(descriptor.Flags, key);
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Hash a root signature description of either version. Each field is hashed by value, and the
+// arrays referenced by the description are hashed in place of their pointers
+template <class RootSignatureDesc>
+uint64_t HashDesc(const RootSignatureDesc& desc, uint64_t key)
+{
+  key = HashValue(desc.Flags, key);
+  key = HashValue(desc.NumParameters, key);
+  for (UINT i = 0; i < desc.NumParameters; i++)
+  {
+    const auto& param = desc.pParameters[i];
+    key = HashValue(param.ParameterType, key);
+    key = HashValue(param.ShaderVisibility, key);
+    switch (param.ParameterType)
+    {
+    case D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE:
+      key = HashValue(param.DescriptorTable.NumDescriptorRanges, key);
+      for (UINT j = 0; j < param.DescriptorTable.NumDescriptorRanges; j++)
+      {
+        const auto& range = param.DescriptorTable.pDescriptorRanges[j];
+        key = HashValue(range.RangeType, key);
+        key = HashValue(range.NumDescriptors, key);
+        key = HashValue(range.BaseShaderRegister, key);
+        key = HashValue(range.RegisterSpace, key);
+        key = HashValue(range.OffsetInDescriptorsFromTableStart, key);
+        key = HashFlags(range, key);
+      }
+      break;
+    case D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS:
+      key = HashValue(param.Constants.ShaderRegister, key);
+      key = HashValue(param.Constants.RegisterSpace, key);
+      key = HashValue(param.Constants.Num32BitValues, key);
+      break;
+    default:
+      key = HashValue(param.Descriptor.ShaderRegister, key);
+      key = HashValue(param.Descriptor.RegisterSpace, key);
+      key = HashFlags(param.Descriptor, key);
+      break;
+    }
+  }
+
+  // Static samplers only contain values, and can be hashed as a whole
+  key = HashValue(desc.NumStaticSamplers, key);
+  if (desc.NumStaticSamplers > 0)
+  {
+    key = HashBytes(desc.pStaticSamplers,
+                    desc.NumStaticSamplers * sizeof(D3D12_STATIC_SAMPLER_DESC), key);
+  }
+  return key;
+}
+} // namespace
+
+//--------------------------------------------------------------------------------------------------
+//
+// Get the cache shared by the whole process
+RootSignatureCache& RootSignatureCache::Get()
+{
+  static RootSignatureCache cache;
+  return cache;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+RootSignatureCache::~RootSignatureCache()
+{
+  Clear();
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Set the directory in which the serialized root signatures are stored. The directory is created
+// if it does not exist
+void RootSignatureCache::SetDirectory(const std::wstring& directory)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_directory = directory;
+  if (!m_directory.empty() && m_directory.back() != L'\\' && m_directory.back() != L'/')
+  {
+    m_directory += L'/';
+  }
+  // Failing to create the directory only disables the storage of new entries
+  FileSystem::CreateDirectories(m_directory);
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Compute the canonical hash of a root signature description, serialized with at most the given
+// root signature version
+uint64_t
+RootSignatureCache::ComputeKey(const D3D12_VERSIONED_ROOT_SIGNATURE_DESC& desc,
+                               D3D_ROOT_SIGNATURE_VERSION maxVersion)
+{
+  uint64_t key = HashValue(kFileVersion);
+  key = HashValue(maxVersion, key);
+  key = HashValue(desc.Version, key);
+  if (desc.Version == D3D_ROOT_SIGNATURE_VERSION_1_0)
+  {
+    return HashDesc(desc.Desc_1_0, key);
+  }
+  return HashDesc(desc.Desc_1_1, key);
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Return the root signature matching the description, serializing and creating it only if it is
+// not already in the cache. The root signature is created again if it was created on another
+// device, reusing the serialized blob
+ID3D12RootSignature*
+RootSignatureCache::GetOrCreate(ID3D12Device* device,
+                                const D3D12_VERSIONED_ROOT_SIGNATURE_DESC& desc)
+{
+  // Version 1.1 descriptions are converted to 1.0 when the device does not support 1.1
+  D3D12_FEATURE_DATA_ROOT_SIGNATURE featureData = {D3D_ROOT_SIGNATURE_VERSION_1_1};
+  if (FAILED(device->CheckFeatureSupport(D3D12_FEATURE_ROOT_SIGNATURE, &featureData,
+                                         sizeof(featureData))))
+  {
+    featureData.HighestVersion = D3D_ROOT_SIGNATURE_VERSION_1_0;
+  }
+  uint64_t key = ComputeKey(desc, featureData.HighestVersion);
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+  auto it = m_entries.find(key);
+  if (it != m_entries.end() && it->second.rootSignature && it->second.device == device)
+  {
+    m_hitCount++;
+    it->second.rootSignature->AddRef();
+    return it->second.rootSignature;
+  }
+
+  // A new entry is only inserted once its root signature has been created, so that a failure to
+  // serialize or create it does not leave an empty entry in the cache
+  m_missCount++;
+  Entry newEntry;
+  Entry& entry = it != m_entries.end() ? it->second : newEntry;
+  if (entry.blob.empty())
+  {
+    LoadOrSerialize(key, desc, featureData.HighestVersion, entry);
+  }
+
+  ID3D12RootSignature* pRootSig = nullptr;
+  HRESULT hr = device->CreateRootSignature(0, entry.blob.data(), entry.blob.size(),
+                                           IID_PPV_ARGS(&pRootSig));
+  if (FAILED(hr))
+  {
+    throw std::logic_error("Cannot create root signature");
+  }
+  if (entry.rootSignature)
+  {
+    entry.rootSignature->Release();
+  }
+  entry.device = device;
+  entry.rootSignature = pRootSig;
+  if (it == m_entries.end())
+  {
+    m_entries.emplace(key, std::move(newEntry));
+  }
+
+  // One reference is kept by the cache, the other one is owned by the caller
+  pRootSig->AddRef();
+  return pRootSig;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Return the root signature matching a version 1.0 description
+ID3D12RootSignature* RootSignatureCache::GetOrCreate(ID3D12Device* device,
+                                                     const D3D12_ROOT_SIGNATURE_DESC& desc)
+{
+  D3D12_VERSIONED_ROOT_SIGNATURE_DESC versionedDesc = {};
+  versionedDesc.Version = D3D_ROOT_SIGNATURE_VERSION_1_0;
+  versionedDesc.Desc_1_0 = desc;
+  return GetOrCreate(device, versionedDesc);
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Release all the cached root signatures
+void RootSignatureCache::Clear()
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  for (auto& entry : m_entries)
+  {
+    if (entry.second.rootSignature)
+    {
+      entry.second.rootSignature->Release();
+    }
+  }
+  m_entries.clear();
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Fill the blob of an entry, from disk if available, and by serializing the description
+// otherwise. Newly serialized blobs are written to disk for the next runs
+void RootSignatureCache::LoadOrSerialize(uint64_t key,
+                                         const D3D12_VERSIONED_ROOT_SIGNATURE_DESC& desc,
+                                         D3D_ROOT_SIGNATURE_VERSION maxVersion, Entry& entry)
+{
+  if (!m_directory.empty())
+  {
+    // Any mismatch in the file is treated as a miss, the file will simply be overwritten
+    MappedFile file;
+    if (file.Open(GetFileName(key)))
+    {
+      const FileHeader* header = reinterpret_cast<const FileHeader*>(file.GetData());
+      if (file.GetSize() >= sizeof(FileHeader) && header->magic == kFileMagic &&
+          header->version == kFileVersion && header->key == key && header->blobSize > 0 &&
+          header->blobSize <= file.GetSize() - sizeof(FileHeader))
+      {
+        const uint8_t* blob = file.GetData() + sizeof(FileHeader);
+        entry.blob.assign(blob, blob + header->blobSize);
+        return;
+      }
+    }
+  }
+
+  ID3DBlob* pSigBlob = nullptr;
+  ID3DBlob* pErrorBlob = nullptr;
+  HRESULT hr = D3DX12SerializeVersionedRootSignature(&desc, maxVersion, &pSigBlob, &pErrorBlob);
+  m_serializeCount++;
+  if (pErrorBlob)
+  {
+    pErrorBlob->Release();
+  }
+  if (FAILED(hr))
+  {
+    throw std::logic_error("Cannot serialize root signature");
+  }
+  const uint8_t* blob = static_cast<const uint8_t*>(pSigBlob->GetBufferPointer());
+  entry.blob.assign(blob, blob + pSigBlob->GetBufferSize());
+  pSigBlob->Release();
+
+  if (!m_directory.empty())
+  {
+    FileHeader header = {kFileMagic, kFileVersion, key, entry.blob.size()};
+    std::vector<uint8_t> fileData(sizeof(FileHeader) + entry.blob.size());
+    memcpy(fileData.data(), &header, sizeof(FileHeader));
+    memcpy(fileData.data() + sizeof(FileHeader), entry.blob.data(), entry.blob.size());
+    // A failed write only means the signature will be serialized again by the next run
+    WriteFileAtomically(GetFileName(key), fileData.data(), fileData.size());
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Name of the file storing a serialized root signature
+std::wstring RootSignatureCache::GetFileName(uint64_t key) const
+{
+  return m_directory + HashToString(key) + L".rootsig";
+}
+
+} // namespace nv_helpers_dx12
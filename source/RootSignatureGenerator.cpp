@@ -36,21 +36,51 @@ pointers will be bound.
 */
 
 #include "RootSignatureGenerator.h"
+#include "RootSignatureCache.h"
 #include <stdexcept>
+#include <string>
 
 namespace nv_helpers_dx12
 {
 
 //--------------------------------------------------------------------------------------------------
 //
-// Add a set of heap range descriptors as a parameter of the root signature.
+// Add a set of heap range descriptors as a parameter of the root signature. The descriptors and
+// data they reference are considered volatile, which matches the semantics of root signature
+// version 1.0
 void RootSignatureGenerator::AddHeapRangesParameter(
     const std::vector<D3D12_DESCRIPTOR_RANGE>& ranges)
+{
+  std::vector<D3D12_DESCRIPTOR_RANGE1> rangeStorage;
+  for (const D3D12_DESCRIPTOR_RANGE& input : ranges)
+  {
+    D3D12_DESCRIPTOR_RANGE1 r = {};
+    r.RangeType = input.RangeType;
+    r.NumDescriptors = input.NumDescriptors;
+    r.BaseShaderRegister = input.BaseShaderRegister;
+    r.RegisterSpace = input.RegisterSpace;
+    // Samplers do not reference any data, and cannot have the data volatility flag
+    r.Flags = input.RangeType == D3D12_DESCRIPTOR_RANGE_TYPE_SAMPLER
+                  ? D3D12_DESCRIPTOR_RANGE_FLAG_DESCRIPTORS_VOLATILE
+                  : D3D12_DESCRIPTOR_RANGE_FLAG_DESCRIPTORS_VOLATILE |
+                        D3D12_DESCRIPTOR_RANGE_FLAG_DATA_VOLATILE;
+    r.OffsetInDescriptorsFromTableStart = input.OffsetInDescriptorsFromTableStart;
+    rangeStorage.push_back(r);
+  }
+  AddHeapRangesParameter(rangeStorage);
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Add a set of heap range descriptors as a parameter of the root signature, with their root
+// signature version 1.1 flags
+void RootSignatureGenerator::AddHeapRangesParameter(
+    const std::vector<D3D12_DESCRIPTOR_RANGE1>& ranges)
 {
   m_ranges.push_back(ranges);
 
   // A set of ranges on the heap is a descriptor table parameter
-  D3D12_ROOT_PARAMETER param = {};
+  D3D12_ROOT_PARAMETER1 param = {};
   param.ParameterType = D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE;
   param.DescriptorTable.NumDescriptorRanges = static_cast<UINT>(ranges.size());
   // The range pointer is kept null here, and will be resolved when generating the root signature
@@ -118,14 +148,15 @@ void RootSignatureGenerator::AddHeapRangesParameter(
 // instead of a buffer). The shaderRegister and registerSpace indicate how to access the
 // parameter in the HLSL code, e.g a SRV with shaderRegister==1 and registerSpace==0 is
 // accessible via register(t1, space0).
-// In case of a root constant, the last parameter indicates how many successive 32-bit constants
-// will be bound.
-void RootSignatureGenerator::AddRootParameter(D3D12_ROOT_PARAMETER_TYPE type,
-                                              UINT shaderRegister /*= 0*/,
-                                              UINT registerSpace /*= 0*/,
-                                              UINT numRootConstants /*= 1*/)
+// In case of a root constant, numRootConstants indicates how many successive 32-bit constants
+// will be bound. For root descriptors, the flags indicate whether the referenced data is static or
+// volatile.
+void RootSignatureGenerator::AddRootParameter(
+    D3D12_ROOT_PARAMETER_TYPE type, UINT shaderRegister /*= 0*/, UINT registerSpace /*= 0*/,
+    UINT numRootConstants /*= 1*/,
+    D3D12_ROOT_DESCRIPTOR_FLAGS flags /*= D3D12_ROOT_DESCRIPTOR_FLAG_DATA_VOLATILE*/)
 {
-  D3D12_ROOT_PARAMETER param = {};
+  D3D12_ROOT_PARAMETER1 param = {};
   param.ParameterType = type;
   // The descriptor is an union, so specific values need to be set in case the parameter is a
   // constant instead of a buffer.
@@ -139,6 +170,7 @@ void RootSignatureGenerator::AddRootParameter(D3D12_ROOT_PARAMETER_TYPE type,
   {
     param.Descriptor.RegisterSpace = registerSpace;
     param.Descriptor.ShaderRegister = shaderRegister;
+    param.Descriptor.Flags = flags;
   }
 
   // We default the visibility to all shaders
@@ -151,11 +183,80 @@ void RootSignatureGenerator::AddRootParameter(D3D12_ROOT_PARAMETER_TYPE type,
   m_rangeLocations.push_back(~0u);
 }
 
+//--------------------------------------------------------------------------------------------------
+//
+// Add a sampler embedded in the root signature. Static samplers do not use any root signature
+// space, and do not need a sampler heap
+void RootSignatureGenerator::AddStaticSampler(const D3D12_STATIC_SAMPLER_DESC& sampler)
+{
+  m_staticSamplers.push_back(sampler);
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Get the size in DWORDs of the parameters added so far: a descriptor table costs 1 DWORD, a root
+// descriptor 2 DWORDs, and each root constant 1 DWORD
+UINT RootSignatureGenerator::GetCost() const
+{
+  UINT cost = 0;
+  for (const D3D12_ROOT_PARAMETER1& param : m_parameters)
+  {
+    switch (param.ParameterType)
+    {
+    case D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE:
+      cost += 1;
+      break;
+    case D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS:
+      cost += param.Constants.Num32BitValues;
+      break;
+    default:
+      cost += 2;
+      break;
+    }
+  }
+  return cost;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Get a human-readable breakdown of the size of the root signature
+std::string RootSignatureGenerator::GetCostReport() const
+{
+  std::string report = "Root signature cost:\n";
+  for (size_t i = 0; i < m_parameters.size(); i++)
+  {
+    const D3D12_ROOT_PARAMETER1& param = m_parameters[i];
+    const char* typeName = "root descriptor";
+    UINT cost = 2;
+    if (param.ParameterType == D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE)
+    {
+      typeName = "descriptor table";
+      cost = 1;
+    }
+    else if (param.ParameterType == D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS)
+    {
+      typeName = "root constants";
+      cost = param.Constants.Num32BitValues;
+    }
+    report += "  Parameter " + std::to_string(i) + " (" + typeName + "): " +
+              std::to_string(cost) + " DWORD(s)\n";
+  }
+  report += "  Static samplers: " + std::to_string(m_staticSamplers.size()) + " (free)\n";
+  report += "  Total: " + std::to_string(GetCost()) + " / " + std::to_string(kMaxCost) +
+            " DWORDs\n";
+  return report;
+}
+
 //--------------------------------------------------------------------------------------------------
 //
 // Create the root signature from the set of parameters, in the order of the addition calls
 ID3D12RootSignature* RootSignatureGenerator::Generate(ID3D12Device* device, bool isLocal)
 {
+  if (GetCost() > kMaxCost)
+  {
+    throw std::logic_error("Root signature larger than 64 DWORDs:\n" + GetCostReport());
+  }
+
   // Go through all the parameters, and set the actual addresses of the heap range descriptors based
   // on their indices in the range set array
   for (size_t i = 0; i < m_parameters.size(); i++)
@@ -166,31 +267,20 @@ ID3D12RootSignature* RootSignatureGenerator::Generate(ID3D12Device* device, bool
     }
   }
   // Specify the root signature with its set of parameters
-  D3D12_ROOT_SIGNATURE_DESC rootDesc = {};
-  rootDesc.NumParameters = static_cast<UINT>(m_parameters.size());
-  rootDesc.pParameters = m_parameters.data();
+  D3D12_VERSIONED_ROOT_SIGNATURE_DESC rootDesc = {};
+  rootDesc.Version = D3D_ROOT_SIGNATURE_VERSION_1_1;
+  rootDesc.Desc_1_1.NumParameters = static_cast<UINT>(m_parameters.size());
+  rootDesc.Desc_1_1.pParameters = m_parameters.data();
+  rootDesc.Desc_1_1.NumStaticSamplers = static_cast<UINT>(m_staticSamplers.size());
+  rootDesc.Desc_1_1.pStaticSamplers = m_staticSamplers.data();
   // Set the flags of the signature. By default root signatures are global, for example for vertex
   // and pixel shaders. For raytracing shaders the root signatures are local.
-  rootDesc.Flags =
+  rootDesc.Desc_1_1.Flags =
       isLocal ? D3D12_ROOT_SIGNATURE_FLAG_LOCAL_ROOT_SIGNATURE : D3D12_ROOT_SIGNATURE_FLAG_NONE;
 
-  // Create the root signature from its descriptor
-  ID3DBlob* pSigBlob;
-  ID3DBlob* pErrorBlob;
-  HRESULT hr = D3D12SerializeRootSignature(&rootDesc, D3D_ROOT_SIGNATURE_VERSION_1_0, &pSigBlob,
-                                           &pErrorBlob);
-  if (FAILED(hr))
-  {
-    throw std::logic_error("Cannot serialize root signature");
-  }
-  ID3D12RootSignature* pRootSig;
-  hr = device->CreateRootSignature(0, pSigBlob->GetBufferPointer(), pSigBlob->GetBufferSize(),
-                                   IID_PPV_ARGS(&pRootSig));
-  if (FAILED(hr))
-  {
-    throw std::logic_error("Cannot create root signature");
-  }
-  return pRootSig;
+  // Create the root signature from its descriptor. Identical signatures are only serialized and
+  // created once per process, and converted to version 1.0 if the device does not support 1.1
+  return RootSignatureCache::Get().GetOrCreate(device, rootDesc);
 }
 
 } // namespace nv_helpers_dx12
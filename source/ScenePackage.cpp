@@ -0,0 +1,318 @@
+/*
+The scene package is a binary container holding a whole scene in a form directly usable by the
+renderer. See ScenePackage.h for the file layout.
+*/
+
+#include "ScenePackage.h"
+
+#include <cstring>
+#include <stdexcept>
+
+// Helper to compute aligned buffer sizes
+#ifndef ROUND_UP
+#define ROUND_UP(v, powerOf2Alignment) (((v) + (powerOf2Alignment)-1) & ~((powerOf2Alignment)-1))
+#endif
+
+namespace nv_helpers_dx12
+{
+
+//--------------------------------------------------------------------------------------------------
+//
+// Map a package and validate its layout, so that the accessors can return pointers into the
+// mapping without any further check
+bool ScenePackage::Open(const std::wstring& fileName)
+{
+  Close();
+  if (!m_file.Open(fileName))
+  {
+    return false;
+  }
+
+  const uint8_t* data = m_file.GetData();
+  uint64_t size = m_file.GetSize();
+  const FileHeader* header = reinterpret_cast<const FileHeader*>(data);
+  if (size < sizeof(FileHeader) || header->magic != kFileMagic)
+  {
+    Close();
+    throw std::logic_error("Not a scene package");
+  }
+  if (header->version != kFileVersion)
+  {
+    Close();
+    throw std::logic_error("Unsupported scene package version");
+  }
+  // The bounds are checked by subtraction, as a corrupted offset and size could wrap around
+  if (header->sectionTableOffset % alignof(SectionHeader) != 0 ||
+      header->sectionTableOffset > size ||
+      (size - header->sectionTableOffset) / sizeof(SectionHeader) < header->sectionCount)
+  {
+    Close();
+    throw std::logic_error("Truncated scene package");
+  }
+
+  const SectionHeader* sections =
+      reinterpret_cast<const SectionHeader*>(data + header->sectionTableOffset);
+
+  // The mesh table is needed to interpret the per-mesh sections, so it is located first
+  const MeshDesc* meshDescs = nullptr;
+  uint32_t meshCount = 0;
+  for (uint32_t i = 0; i < header->sectionCount; i++)
+  {
+    const SectionHeader& section = sections[i];
+    if (section.offset % kSectionAlignment != 0 || section.offset > size ||
+        size - section.offset < section.size)
+    {
+      Close();
+      throw std::logic_error("Invalid section in scene package");
+    }
+    if (section.type == SectionType::Meshes)
+    {
+      meshDescs = reinterpret_cast<const MeshDesc*>(data + section.offset);
+      meshCount = static_cast<uint32_t>(section.size / sizeof(MeshDesc));
+    }
+  }
+
+  m_meshes.resize(meshCount);
+  for (uint32_t i = 0; i < meshCount; i++)
+  {
+    m_meshes[i] = {nullptr, meshDescs[i].vertexCount, meshDescs[i].vertexStride, nullptr,
+                   meshDescs[i].indexCount, nullptr, 0};
+  }
+
+  for (uint32_t i = 0; i < header->sectionCount; i++)
+  {
+    const SectionHeader& section = sections[i];
+    const uint8_t* sectionData = data + section.offset;
+    bool isValid = true;
+    switch (section.type)
+    {
+    case SectionType::Vertices:
+      isValid = section.index < meshCount &&
+                section.size >= static_cast<uint64_t>(m_meshes[section.index].vertexCount) *
+                                    m_meshes[section.index].vertexStride;
+      if (isValid)
+      {
+        m_meshes[section.index].vertices = sectionData;
+      }
+      break;
+    case SectionType::Indices:
+      isValid = section.index < meshCount &&
+                section.size >= m_meshes[section.index].indexCount * sizeof(uint32_t);
+      if (isValid)
+      {
+        m_meshes[section.index].indices = reinterpret_cast<const uint32_t*>(sectionData);
+      }
+      break;
+    case SectionType::Bvh:
+      isValid = section.index < meshCount;
+      if (isValid)
+      {
+        m_meshes[section.index].bvh = sectionData;
+        m_meshes[section.index].bvhSize = section.size;
+      }
+      break;
+    case SectionType::Instances:
+      m_instances = reinterpret_cast<const InstanceDesc*>(sectionData);
+      m_instanceCount = static_cast<uint32_t>(section.size / sizeof(InstanceDesc));
+      break;
+    case SectionType::Materials:
+      m_materials = reinterpret_cast<const MaterialDesc*>(sectionData);
+      m_materialCount = static_cast<uint32_t>(section.size / sizeof(MaterialDesc));
+      break;
+    default:
+      // Unknown sections are skipped, so that optional data can be added without a version bump
+      break;
+    }
+    if (!isValid)
+    {
+      Close();
+      throw std::logic_error("Invalid mesh section in scene package");
+    }
+  }
+
+  for (const MeshView& mesh : m_meshes)
+  {
+    if (!mesh.vertices || (mesh.indexCount > 0 && !mesh.indices))
+    {
+      Close();
+      throw std::logic_error("Missing mesh data in scene package");
+    }
+    // The indices are copied as is to the GPU, which must not read past the vertex buffer. This
+    // is the only check reading the contents of the sections
+    for (uint32_t i = 0; i < mesh.indexCount; i++)
+    {
+      if (mesh.indices[i] >= mesh.vertexCount)
+      {
+        Close();
+        throw std::logic_error("Vertex index out of range in scene package");
+      }
+    }
+  }
+  for (uint32_t i = 0; i < m_instanceCount; i++)
+  {
+    if (m_instances[i].meshIndex >= meshCount || m_instances[i].materialIndex >= m_materialCount)
+    {
+      Close();
+      throw std::logic_error("Invalid instance in scene package");
+    }
+  }
+  return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Unmap the package. All the pointers returned by the accessors become invalid
+void ScenePackage::Close()
+{
+  m_file.Close();
+  m_meshes.clear();
+  m_instances = nullptr;
+  m_instanceCount = 0;
+  m_materials = nullptr;
+  m_materialCount = 0;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Add a mesh and return its index. The index array can be nullptr for non-indexed meshes
+uint32_t ScenePackageWriter::AddMesh(const void* vertices, size_t vertexCount,
+                                     uint32_t vertexStride, const uint32_t* indices,
+                                     size_t indexCount)
+{
+  if (vertexCount > UINT32_MAX || indexCount > UINT32_MAX)
+  {
+    throw std::logic_error("Mesh too large for a scene package");
+  }
+  PendingMesh mesh = {};
+  mesh.desc.vertexCount = static_cast<uint32_t>(vertexCount);
+  mesh.desc.vertexStride = vertexStride;
+  mesh.desc.indexCount = indices ? static_cast<uint32_t>(indexCount) : 0;
+  mesh.vertices = vertices;
+  mesh.indices = indices;
+  m_meshes.push_back(mesh);
+  return static_cast<uint32_t>(m_meshes.size() - 1);
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Attach the serialized bottom-level AS of a mesh
+void ScenePackageWriter::SetMeshBvh(uint32_t meshIndex, const void* bvh, uint64_t bvhSize)
+{
+  if (meshIndex >= m_meshes.size())
+  {
+    throw std::logic_error("Invalid mesh index");
+  }
+  m_meshes[meshIndex].bvh = bvh;
+  m_meshes[meshIndex].bvhSize = bvhSize;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Add a material and return its index
+uint32_t ScenePackageWriter::AddMaterial(const ScenePackage::MaterialDesc& material)
+{
+  m_materials.push_back(material);
+  return static_cast<uint32_t>(m_materials.size() - 1);
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Add an instance of a mesh, with a row-major transform
+void ScenePackageWriter::AddInstance(uint32_t meshIndex, uint32_t materialIndex,
+                                     const float transform[4][4])
+{
+  if (meshIndex >= m_meshes.size() || materialIndex >= m_materials.size())
+  {
+    throw std::logic_error("Invalid scene package instance");
+  }
+  ScenePackage::InstanceDesc instance = {};
+  instance.meshIndex = meshIndex;
+  instance.materialIndex = materialIndex;
+  memcpy(instance.transform, transform, sizeof(instance.transform));
+  m_instances.push_back(instance);
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Lay out the sections, and stream them to the file: the meshes are written straight from the
+// memory of the caller, so the package is never assembled in memory
+bool ScenePackageWriter::Write(const std::wstring& fileName) const
+{
+  using SectionType = ScenePackage::SectionType;
+  struct SectionSource
+  {
+    const void* data;
+    uint64_t size;
+  };
+
+  std::vector<ScenePackage::SectionHeader> sections;
+  std::vector<SectionSource> sources;
+  auto addSection = [&](SectionType type, uint32_t index, const void* data, uint64_t size) {
+    sections.push_back({type, index, 0, size});
+    sources.push_back({data, size});
+  };
+
+  std::vector<ScenePackage::MeshDesc> meshDescs;
+  for (const PendingMesh& mesh : m_meshes)
+  {
+    meshDescs.push_back(mesh.desc);
+  }
+  addSection(SectionType::Meshes, 0, meshDescs.data(),
+             meshDescs.size() * sizeof(ScenePackage::MeshDesc));
+  for (uint32_t i = 0; i < m_meshes.size(); i++)
+  {
+    const PendingMesh& mesh = m_meshes[i];
+    addSection(SectionType::Vertices, i, mesh.vertices,
+               static_cast<uint64_t>(mesh.desc.vertexCount) * mesh.desc.vertexStride);
+    if (mesh.desc.indexCount > 0)
+    {
+      addSection(SectionType::Indices, i, mesh.indices,
+                 static_cast<uint64_t>(mesh.desc.indexCount) * sizeof(uint32_t));
+    }
+    if (mesh.bvh)
+    {
+      addSection(SectionType::Bvh, i, mesh.bvh, mesh.bvhSize);
+    }
+  }
+  addSection(SectionType::Instances, 0, m_instances.data(),
+             m_instances.size() * sizeof(ScenePackage::InstanceDesc));
+  addSection(SectionType::Materials, 0, m_materials.data(),
+             m_materials.size() * sizeof(ScenePackage::MaterialDesc));
+
+  // The section table follows the header, and the sections start on the next aligned offset
+  ScenePackage::FileHeader header = {};
+  header.magic = ScenePackage::kFileMagic;
+  header.version = ScenePackage::kFileVersion;
+  header.sectionCount = static_cast<uint32_t>(sections.size());
+  header.sectionTableOffset = sizeof(ScenePackage::FileHeader);
+
+  uint64_t fileSize = header.sectionTableOffset + sections.size() * sizeof(sections[0]);
+  for (ScenePackage::SectionHeader& section : sections)
+  {
+    section.offset = ROUND_UP(fileSize, ScenePackage::kSectionAlignment);
+    fileSize = section.offset + section.size;
+  }
+
+  AtomicFileWriter file;
+  if (!file.Open(fileName) || !file.Write(&header, sizeof(header)) ||
+      !file.Write(sections.data(), sections.size() * sizeof(sections[0])))
+  {
+    return false;
+  }
+
+  // The gap before each section is less than the alignment, and filled with zeros
+  static const uint8_t padding[ScenePackage::kSectionAlignment] = {};
+  uint64_t position = header.sectionTableOffset + sections.size() * sizeof(sections[0]);
+  for (size_t i = 0; i < sections.size(); i++)
+  {
+    if (!file.Write(padding, sections[i].offset - position) ||
+        !file.Write(sources[i].data, sources[i].size))
+    {
+      return false;
+    }
+    position = sections[i].offset + sections[i].size;
+  }
+  return file.Commit();
+}
+
+} // namespace nv_helpers_dx12
@@ -35,7 +35,11 @@ dispatch rays description.
 */
 
 #include "ShaderBindingTableGenerator.h"
+#include <algorithm>
+#include <atomic>
+#include <future>
 #include <stdexcept>
+#include <thread>
 
 // Helper to compute aligned buffer sizes
 #ifndef ROUND_UP
@@ -45,34 +49,249 @@ dispatch rays description.
 namespace nv_helpers_dx12
 {
 
+namespace
+{
+/// Number of records written by each task of the parallel fill of the SBT
+const uint32_t kRecordsPerFillTask = 4096;
+/// Minimum number of records per thread filling the SBT. Starting a thread costs about as much as
+/// writing thousands of records, so only very large tables are filled by several threads
+const uint32_t kMinRecordsPerFillWorker = 4 * kRecordsPerFillTask;
+} // namespace
+
+//--------------------------------------------------------------------------------------------------
+//
+// Append root constants, aligned on 4 bytes
+ShaderRecordArguments& ShaderRecordArguments::AddRootConstants(const void* data,
+                                                               uint32_t sizeInBytes)
+{
+  if (sizeInBytes % 4 != 0)
+  {
+    throw std::logic_error("Root constants are made of 32-bit values");
+  }
+  Append(data, sizeInBytes, 4);
+  return *this;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Append the address of a root CBV, SRV or UAV, aligned on 8 bytes
+ShaderRecordArguments& ShaderRecordArguments::AddRootDescriptor(D3D12_GPU_VIRTUAL_ADDRESS address)
+{
+  Append(&address, sizeof(address), 8);
+  return *this;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Append the handle of a descriptor table, aligned on 8 bytes
+ShaderRecordArguments& ShaderRecordArguments::AddDescriptorTable(D3D12_GPU_DESCRIPTOR_HANDLE handle)
+{
+  Append(&handle.ptr, sizeof(handle.ptr), 8);
+  return *this;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Append size bytes after padding the arguments to the given alignment. The arguments start right
+// after the shader identifier, whose size is a multiple of any argument alignment, so aligning the
+// offsets within the arguments is sufficient
+void ShaderRecordArguments::Append(const void* data, uint32_t size, uint32_t alignment)
+{
+  uint32_t offset = ROUND_UP(m_size, alignment);
+  if (offset > kMaxSize || kMaxSize - offset < size)
+  {
+    throw std::logic_error("Shader record arguments larger than the maximum record size");
+  }
+  memset(m_data + m_size, 0, offset - m_size);
+  memcpy(m_data + offset, data, size);
+  m_size = offset + size;
+}
+
 //--------------------------------------------------------------------------------------------------
 //
 // Add a ray generation program by name, with its list of data pointers or values according to
 // the layout of its root signature
-void ShaderBindingTableGenerator::AddRayGenerationProgram(const std::wstring& entryPoint,
-                                                          const std::vector<void*>& inputData)
+ShaderBindingTableGenerator::RecordHandle ShaderBindingTableGenerator::AddRayGenerationProgram(
+    std::wstring_view entryPoint, const std::vector<void*>& inputData)
 {
-  m_rayGen.emplace_back(SBTEntry(entryPoint, inputData));
+  return AddEntry(0, entryPoint, inputData.data(), static_cast<uint32_t>(8 * inputData.size()));
 }
 
 //--------------------------------------------------------------------------------------------------
 //
 // Add a miss program by name, with its list of data pointers or values according to
 // the layout of its root signature
-void ShaderBindingTableGenerator::AddMissProgram(const std::wstring& entryPoint,
-                                                 const std::vector<void*>& inputData)
+ShaderBindingTableGenerator::RecordHandle
+ShaderBindingTableGenerator::AddMissProgram(std::wstring_view entryPoint,
+                                            const std::vector<void*>& inputData)
 {
-  m_miss.emplace_back(SBTEntry(entryPoint, inputData));
+  return AddEntry(1, entryPoint, inputData.data(), static_cast<uint32_t>(8 * inputData.size()));
 }
 
 //--------------------------------------------------------------------------------------------------
 //
 // Add a hit group by name, with its list of data pointers or values according to
 // the layout of its root signature
-void ShaderBindingTableGenerator::AddHitGroup(const std::wstring& entryPoint,
-                                              const std::vector<void*>& inputData)
+ShaderBindingTableGenerator::RecordHandle
+ShaderBindingTableGenerator::AddHitGroup(std::wstring_view entryPoint,
+                                         const std::vector<void*>& inputData)
+{
+  return AddEntry(2, entryPoint, inputData.data(), static_cast<uint32_t>(8 * inputData.size()));
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Add a ray generation program by name, with its typed root arguments
+ShaderBindingTableGenerator::RecordHandle ShaderBindingTableGenerator::AddRayGenerationRecord(
+    std::wstring_view entryPoint, const ShaderRecordArguments& arguments)
+{
+  return AddEntry(0, entryPoint, arguments.GetData(), arguments.GetSize());
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Add a miss program by name, with its typed root arguments
+ShaderBindingTableGenerator::RecordHandle
+ShaderBindingTableGenerator::AddMissRecord(std::wstring_view entryPoint,
+                                           const ShaderRecordArguments& arguments)
+{
+  return AddEntry(1, entryPoint, arguments.GetData(), arguments.GetSize());
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Add a hit group by name, with its typed root arguments
+ShaderBindingTableGenerator::RecordHandle
+ShaderBindingTableGenerator::AddHitGroupRecord(std::wstring_view entryPoint,
+                                               const ShaderRecordArguments& arguments)
+{
+  return AddEntry(2, entryPoint, arguments.GetData(), arguments.GetSize());
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Set the number of ray types traced in the scene
+void ShaderBindingTableGenerator::SetRayTypeCount(uint32_t rayTypeCount)
+{
+  if (rayTypeCount == 0)
+  {
+    throw std::logic_error("At least one ray type is required");
+  }
+  m_rayTypeCount = rayTypeCount;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Reserve the hit group records of an instance, laid out geometry by geometry, with one record per
+// ray type for each geometry
+uint32_t ShaderBindingTableGenerator::AddHitGroupInstance(uint32_t geometryCount)
+{
+  uint32_t instanceContribution = static_cast<uint32_t>(m_hitGroup.size());
+  uint32_t recordCount = geometryCount * m_rayTypeCount;
+  // Instances without geometry reserve no record, and share their contribution with the next one
+  if (geometryCount > 0)
+  {
+    m_reservedInstances.push_back({instanceContribution, geometryCount});
+  }
+  for (uint32_t i = 0; i < recordCount; i++)
+  {
+    m_hitGroup.emplace_back(SBTEntry(kNullExport, 0, 0));
+  }
+  return instanceContribution;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Set the hit group of a geometry of an instance for one ray type, with its list of data pointers
+// or values
+ShaderBindingTableGenerator::RecordHandle ShaderBindingTableGenerator::SetHitGroup(
+    uint32_t instanceContribution, uint32_t geometryIndex, uint32_t rayType,
+    std::wstring_view entryPoint, const std::vector<void*>& inputData)
 {
-  m_hitGroup.emplace_back(SBTEntry(entryPoint, inputData));
+  return SetInstanceEntry(instanceContribution, geometryIndex, rayType, entryPoint,
+                          inputData.data(), static_cast<uint32_t>(8 * inputData.size()));
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Set the hit group of a geometry of an instance for one ray type, with its typed root arguments
+ShaderBindingTableGenerator::RecordHandle ShaderBindingTableGenerator::SetHitGroupRecord(
+    uint32_t instanceContribution, uint32_t geometryIndex, uint32_t rayType,
+    std::wstring_view entryPoint, const ShaderRecordArguments& arguments)
+{
+  return SetInstanceEntry(instanceContribution, geometryIndex, rayType, entryPoint,
+                          arguments.GetData(), arguments.GetSize());
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Get the index of the hit group record of a geometry for a ray type, following the DXR addressing
+// of the hit group table
+uint32_t ShaderBindingTableGenerator::GetHitGroupIndex(uint32_t instanceContribution,
+                                                       uint32_t geometryIndex,
+                                                       uint32_t rayType) const
+{
+  return instanceContribution + rayType + geometryIndex * m_rayTypeCount;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Replace the data pointers or values of a record
+void ShaderBindingTableGenerator::UpdateRecordData(RecordHandle record,
+                                                   const std::vector<void*>& inputData)
+{
+  UpdateEntry(record, inputData.data(), static_cast<uint32_t>(8 * inputData.size()));
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Replace the typed root arguments of a record
+void ShaderBindingTableGenerator::UpdateRecordArguments(RecordHandle record,
+                                                        const ShaderRecordArguments& arguments)
+{
+  UpdateEntry(record, arguments.GetData(), arguments.GetSize());
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Set the number of SBT buffers used in turn, each of them tracking its own list of modified
+// records
+void ShaderBindingTableGenerator::SetBufferCount(uint32_t bufferCount)
+{
+  if (bufferCount == 0 || bufferCount > 32)
+  {
+    throw std::logic_error("The number of shader binding table buffers must be within [1, 32]");
+  }
+  m_dirtyRecords.resize(bufferCount);
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Compute the layout of an SBT from its sections, in the order ray generation, miss, hit groups.
+// This only depends on the number of records and the size of their root arguments, and neither
+// requires a device nor allocates memory
+ShaderBindingTableGenerator::Layout
+ShaderBindingTableGenerator::ComputeLayout(const SectionDesc sections[kSectionCount])
+{
+  Layout layout = {};
+  uint32_t offset = 0;
+  for (uint32_t i = 0; i < kSectionCount; i++)
+  {
+    // A SBT entry is made of a program ID and its root arguments. The entries of the shader
+    // binding table must be 32-bytes-aligned
+    layout.entrySize[i] =
+        ROUND_UP(D3D12_SHADER_IDENTIFIER_SIZE_IN_BYTES + sections[i].maxArgumentSize,
+                 D3D12_RAYTRACING_SHADER_RECORD_BYTE_ALIGNMENT);
+    layout.sectionSize[i] = layout.entrySize[i] * sections[i].recordCount;
+
+    // Each table passed to DispatchRays must start on a 64-byte boundary
+    layout.sectionOffset[i] = ROUND_UP(offset, D3D12_RAYTRACING_SHADER_TABLE_BYTE_ALIGNMENT);
+    offset = layout.sectionOffset[i] + layout.sectionSize[i];
+  }
+
+  // The total SBT size is aligned on 256 bytes
+  layout.totalSize = ROUND_UP(offset, 256);
+  return layout;
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -80,21 +299,14 @@ void ShaderBindingTableGenerator::AddHitGroup(const std::wstring& entryPoint,
 // Compute the size of the SBT based on the set of programs and hit groups it contains
 uint32_t ShaderBindingTableGenerator::ComputeSBTSize()
 {
-  // Size of a program identifier
-  m_progIdSize = D3D12_RAYTRACING_SHADER_RECORD_BYTE_ALIGNMENT;
-  // Compute the entry size of each program type depending on the maximum number of parameters in
-  // each category
-  m_rayGenEntrySize = GetEntrySize(m_rayGen);
-  m_missEntrySize = GetEntrySize(m_miss);
-  m_hitGroupEntrySize = GetEntrySize(m_hitGroup);
-
-  // The total SBT size is the sum of the entries for ray generation, miss and hit groups, aligned
-  // on 256 bytes
-  uint32_t sbtSize = ROUND_UP(m_rayGenEntrySize * static_cast<UINT>(m_rayGen.size()) +
-                                  m_missEntrySize * static_cast<UINT>(m_miss.size()) +
-                                  m_hitGroupEntrySize * static_cast<UINT>(m_hitGroup.size()),
-                              256);
-  return sbtSize;
+  SectionDesc sections[kSectionCount];
+  for (uint32_t i = 0; i < kSectionCount; i++)
+  {
+    sections[i].recordCount = static_cast<uint32_t>(GetSection(i, nullptr, nullptr).size());
+    sections[i].maxArgumentSize = m_maxArgumentSize[i];
+  }
+  m_layout = ComputeLayout(sections);
+  return m_layout.totalSize;
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -103,8 +315,15 @@ uint32_t ShaderBindingTableGenerator::ComputeSBTSize()
 // Access to the raytracing pipeline object is required to fetch program identifiers using their
 // names
 void ShaderBindingTableGenerator::Generate(ID3D12Resource* sbtBuffer,
-                                           ID3D12StateObjectProperties* raytracingPipeline)
+                                           ID3D12StateObjectProperties* raytracingPipeline,
+                                           uint32_t bufferIndex /*= 0*/)
 {
+  if (bufferIndex >= m_dirtyRecords.size())
+  {
+    throw std::logic_error("Invalid shader binding table buffer index");
+  }
+  ResolveShaderIdentifiers(raytracingPipeline);
+
   // Map the SBT
   uint8_t* pData;
   HRESULT hr = sbtBuffer->Map(0, nullptr, reinterpret_cast<void**>(&pData));
@@ -113,19 +332,116 @@ void ShaderBindingTableGenerator::Generate(ID3D12Resource* sbtBuffer,
     throw std::logic_error("Could not map the shader binding table");
   }
   // Copy the shader identifiers followed by their resource pointers or root constants: first the
-  // ray generation, then the miss shaders, and finally the set of hit groups
-  uint32_t offset = 0;
-
-  offset = CopyShaderData(raytracingPipeline, pData, m_rayGen, m_rayGenEntrySize);
-  pData += offset;
-
-  offset = CopyShaderData(raytracingPipeline, pData, m_miss, m_missEntrySize);
-  pData += offset;
+  // ray generation, then the miss shaders, and finally the set of hit groups. The records are
+  // split into blocks of records, filled in parallel straight into the mapped buffer. Blocks are
+  // numbered across the sections, so that no task list needs to be allocated
+  uint32_t firstBlock[kSectionCount + 1] = {};
+  for (uint32_t section = 0; section < kSectionCount; section++)
+  {
+    uint32_t recordCount = static_cast<uint32_t>(GetSection(section, nullptr, nullptr).size());
+    firstBlock[section + 1] =
+        firstBlock[section] + (recordCount + kRecordsPerFillTask - 1) / kRecordsPerFillTask;
+  }
+  uint32_t blockCount = firstBlock[kSectionCount];
+  uint32_t recordCount = 0;
+  for (uint32_t section = 0; section < kSectionCount; section++)
+  {
+    recordCount += static_cast<uint32_t>(GetSection(section, nullptr, nullptr).size());
+  }
 
-  offset = CopyShaderData(raytracingPipeline, pData, m_hitGroup, m_hitGroupEntrySize);
+  std::atomic<uint32_t> nextBlock = 0;
+  auto fill = [&]() {
+    for (uint32_t block = nextBlock++; block < blockCount; block = nextBlock++)
+    {
+      uint32_t section = 0;
+      while (block >= firstBlock[section + 1])
+      {
+        section++;
+      }
+      const std::vector<SBTEntry>& entries = GetSection(section, nullptr, nullptr);
+      uint32_t first = (block - firstBlock[section]) * kRecordsPerFillTask;
+      uint32_t count = static_cast<uint32_t>(entries.size()) - first;
+      count = count < kRecordsPerFillTask ? count : kRecordsPerFillTask;
+      uint32_t entrySize = m_layout.entrySize[section];
+      CopyShaderData(pData + m_layout.sectionOffset[section] + first * entrySize,
+                     entries.data() + first, count, entrySize);
+    }
+  };
+
+  // One thread is used per kMinRecordsPerFillWorker records, up to the number of hardware threads.
+  // Tables smaller than that, such as the ones of the sample, are filled on the calling thread
+  // without starting any worker
+  uint32_t threadCount = std::thread::hardware_concurrency();
+  uint32_t workerCount = recordCount / kMinRecordsPerFillWorker;
+  workerCount = workerCount < threadCount ? workerCount : threadCount;
+  workerCount = workerCount < blockCount ? workerCount : blockCount;
+  std::vector<std::future<void>> workers;
+  for (uint32_t i = 1; i < workerCount; i++)
+  {
+    workers.push_back(std::async(std::launch::async, fill));
+  }
+  fill();
+  for (auto& worker : workers)
+  {
+    worker.get();
+  }
 
   // Unmap the SBT
   sbtBuffer->Unmap(0, nullptr);
+
+  // All the records are up to date in this buffer
+  for (const RecordHandle& record : m_dirtyRecords[bufferIndex])
+  {
+    GetSection(record.section, nullptr, nullptr)[record.index].m_dirtyMask &= ~(1u << bufferIndex);
+  }
+  m_dirtyRecords[bufferIndex].clear();
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Rewrite only the records of sbtBuffer modified since it was last generated or patched. Only
+// the range of modified records is flushed when unmapping the buffer
+void ShaderBindingTableGenerator::Patch(ID3D12Resource* sbtBuffer,
+                                        ID3D12StateObjectProperties* raytracingPipeline,
+                                        uint32_t bufferIndex /*= 0*/)
+{
+  if (bufferIndex >= m_dirtyRecords.size())
+  {
+    throw std::logic_error("Invalid shader binding table buffer index");
+  }
+  std::vector<RecordHandle>& dirtyRecords = m_dirtyRecords[bufferIndex];
+  if (dirtyRecords.empty())
+  {
+    return;
+  }
+  ResolveShaderIdentifiers(raytracingPipeline);
+
+  // The CPU does not read from the SBT
+  uint8_t* pData;
+  D3D12_RANGE readRange = {0, 0};
+  HRESULT hr = sbtBuffer->Map(0, &readRange, reinterpret_cast<void**>(&pData));
+  if (FAILED(hr))
+  {
+    throw std::logic_error("Could not map the shader binding table");
+  }
+
+  D3D12_RANGE writtenRange = {SIZE_MAX, 0};
+  for (const RecordHandle& record : dirtyRecords)
+  {
+    uint32_t entrySize = 0;
+    uint32_t sectionOffset = 0;
+    SBTEntry& entry = GetSection(record.section, &entrySize, &sectionOffset)[record.index];
+    SIZE_T recordOffset = sectionOffset + static_cast<SIZE_T>(record.index) * entrySize;
+    CopyShaderRecord(pData + recordOffset, entry);
+    entry.m_dirtyMask &= ~(1u << bufferIndex);
+
+    writtenRange.Begin = recordOffset < writtenRange.Begin ? recordOffset : writtenRange.Begin;
+    writtenRange.End =
+        recordOffset + entrySize > writtenRange.End ? recordOffset + entrySize : writtenRange.End;
+  }
+  dirtyRecords.clear();
+
+  sbtBuffer->Unmap(0, &writtenRange);
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -136,11 +452,55 @@ void ShaderBindingTableGenerator::Reset()
   m_rayGen.clear();
   m_miss.clear();
   m_hitGroup.clear();
+  m_reservedInstances.clear();
+  m_argumentArena.clear();
+  for (auto& dirtyRecords : m_dirtyRecords)
+  {
+    dirtyRecords.clear();
+  }
+  m_exportIds.clear();
+  m_exportNames.clear();
+  InvalidateShaderIdentifiers();
 
-  m_rayGenEntrySize = 0;
-  m_missEntrySize = 0;
-  m_hitGroupEntrySize = 0;
-  m_progIdSize = 0;
+  m_layout = {};
+  for (uint32_t& maxArgumentSize : m_maxArgumentSize)
+  {
+    maxArgumentSize = 0;
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Discard the shader identifiers fetched from the raytracing pipeline
+void ShaderBindingTableGenerator::InvalidateShaderIdentifiers()
+{
+  m_shaderIdentifiers.clear();
+  m_resolvedExportCount = 0;
+  m_identifierSource = nullptr;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Mark all the records as modified for all the SBT buffers
+void ShaderBindingTableGenerator::MarkAllRecordsModified()
+{
+  const uint32_t allBuffers = static_cast<uint32_t>((1ull << m_dirtyRecords.size()) - 1);
+  for (auto& dirtyRecords : m_dirtyRecords)
+  {
+    dirtyRecords.clear();
+  }
+  for (uint32_t section = 0; section < kSectionCount; section++)
+  {
+    std::vector<SBTEntry>& entries = GetSection(section, nullptr, nullptr);
+    for (uint32_t index = 0; index < static_cast<uint32_t>(entries.size()); index++)
+    {
+      entries[index].m_dirtyMask = allBuffers;
+      for (auto& dirtyRecords : m_dirtyRecords)
+      {
+        dirtyRecords.push_back({section, index});
+      }
+    }
+  }
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -152,7 +512,7 @@ void ShaderBindingTableGenerator::Reset()
 // Get the size in bytes of the SBT section dedicated to ray generation programs
 UINT ShaderBindingTableGenerator::GetRayGenSectionSize() const
 {
-  return m_rayGenEntrySize * static_cast<UINT>(m_rayGen.size());
+  return m_layout.sectionSize[0];
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -160,7 +520,7 @@ UINT ShaderBindingTableGenerator::GetRayGenSectionSize() const
 // Get the size in bytes of one ray generation program entry in the SBT
 UINT ShaderBindingTableGenerator::GetRayGenEntrySize() const
 {
-  return m_rayGenEntrySize;
+  return m_layout.entrySize[0];
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -168,15 +528,23 @@ UINT ShaderBindingTableGenerator::GetRayGenEntrySize() const
 // Get the size in bytes of the SBT section dedicated to miss programs
 UINT ShaderBindingTableGenerator::GetMissSectionSize() const
 {
-  return m_missEntrySize * static_cast<UINT>(m_miss.size());
+  return m_layout.sectionSize[1];
 }
 
 //--------------------------------------------------------------------------------------------------
 //
 // Get the size in bytes of one miss program entry in the SBT
-UINT ShaderBindingTableGenerator::GetMissEntrySize()
+UINT ShaderBindingTableGenerator::GetMissEntrySize() const
 {
-  return m_missEntrySize;
+  return m_layout.entrySize[1];
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Get the offset in bytes of the SBT section dedicated to miss programs
+UINT ShaderBindingTableGenerator::GetMissSectionOffset() const
+{
+  return m_layout.sectionOffset[1];
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -184,7 +552,7 @@ UINT ShaderBindingTableGenerator::GetMissEntrySize()
 // Get the size in bytes of the SBT section dedicated to hit groups
 UINT ShaderBindingTableGenerator::GetHitGroupSectionSize() const
 {
-  return m_hitGroupEntrySize * static_cast<UINT>(m_hitGroup.size());
+  return m_layout.sectionSize[2];
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -192,68 +560,236 @@ UINT ShaderBindingTableGenerator::GetHitGroupSectionSize() const
 // Get the size in bytes of one hit group entry in the SBT
 UINT ShaderBindingTableGenerator::GetHitGroupEntrySize() const
 {
-  return m_hitGroupEntrySize;
+  return m_layout.entrySize[2];
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Get the offset in bytes of the SBT section dedicated to hit groups
+UINT ShaderBindingTableGenerator::GetHitGroupSectionOffset() const
+{
+  return m_layout.sectionOffset[2];
 }
 
 //--------------------------------------------------------------------------------------------------
 //
 // For each entry, copy the shader identifier followed by its resource pointers and/or root
-// constants in outputData, with a stride in bytes of entrySize, and returns the size in bytes
-// actually written to outputData.
-uint32_t ShaderBindingTableGenerator::CopyShaderData(
-    ID3D12StateObjectProperties* raytracingPipeline, uint8_t* outputData,
-    const std::vector<SBTEntry>& shaders, uint32_t entrySize)
+// constants in outputData, with a stride in bytes of entrySize
+void ShaderBindingTableGenerator::CopyShaderData(uint8_t* outputData, const SBTEntry* shaders,
+                                                 uint32_t shaderCount, uint32_t entrySize) const
 {
   uint8_t* pData = outputData;
-  for (const auto& shader : shaders)
+  for (uint32_t i = 0; i < shaderCount; i++)
+  {
+    CopyShaderRecord(pData, shaders[i]);
+    pData += entrySize;
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Copy the shader identifier of an entry followed by its resource pointers and/or root
+// constants in outputData
+void ShaderBindingTableGenerator::CopyShaderRecord(uint8_t* outputData,
+                                                   const SBTEntry& shader) const
+{
+  // Copy the shader identifier, resolved beforehand. A zero identifier is a null hit group, for
+  // which no shader is invoked
+  if (shader.m_exportId == kNullExport)
+  {
+    memset(outputData, 0, m_progIdSize);
+  }
+  else
+  {
+    memcpy(outputData, m_shaderIdentifiers.data() + shader.m_exportId * m_progIdSize,
+           m_progIdSize);
+  }
+  // Copy all its root arguments in bulk
+  if (shader.m_argumentSize > 0)
+  {
+    memcpy(outputData + m_progIdSize, m_argumentArena.data() + shader.m_argumentOffset,
+           shader.m_argumentSize);
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Add an entry to a section, copying its root arguments into the argument arena
+ShaderBindingTableGenerator::RecordHandle
+ShaderBindingTableGenerator::AddEntry(uint32_t section, std::wstring_view entryPoint,
+                                      const void* arguments, uint32_t argumentSize)
+{
+  std::vector<SBTEntry>& entries = GetSection(section, nullptr, nullptr);
+  uint32_t argumentOffset = static_cast<uint32_t>(m_argumentArena.size());
+  m_argumentArena.resize(m_argumentArena.size() + argumentSize);
+  if (argumentSize > 0)
+  {
+    memcpy(m_argumentArena.data() + argumentOffset, arguments, argumentSize);
+  }
+  entries.emplace_back(SBTEntry(InternExport(entryPoint), argumentOffset, argumentSize));
+  m_maxArgumentSize[section] =
+      argumentSize > m_maxArgumentSize[section] ? argumentSize : m_maxArgumentSize[section];
+  return {section, static_cast<uint32_t>(entries.size() - 1)};
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Replace the root arguments of a record, and add it to the list of modified records of each SBT
+// buffer which does not already have it
+void ShaderBindingTableGenerator::UpdateEntry(RecordHandle record, const void* arguments,
+                                              uint32_t argumentSize)
+{
+  uint32_t entrySize = 0;
+  uint32_t offset = 0;
+  std::vector<SBTEntry>& entries = GetSection(record.section, &entrySize, &offset);
+  if (record.index >= entries.size())
+  {
+    throw std::logic_error("Invalid shader binding table record handle");
+  }
+  // Once the layout of the SBT is computed, the entries of a section have a fixed size
+  if (entrySize != 0 && m_progIdSize + argumentSize > entrySize)
+  {
+    throw std::logic_error("Shader binding table record data larger than its entry size");
+  }
+
+  // The arguments are overwritten in place if they fit, and appended to the arena otherwise. The
+  // previous location is then unused until the next reset
+  SBTEntry& entry = entries[record.index];
+  if (argumentSize > entry.m_argumentSize)
+  {
+    entry.m_argumentOffset = static_cast<uint32_t>(m_argumentArena.size());
+    m_argumentArena.resize(m_argumentArena.size() + argumentSize);
+  }
+  entry.m_argumentSize = argumentSize;
+  m_maxArgumentSize[record.section] = argumentSize > m_maxArgumentSize[record.section]
+                                          ? argumentSize
+                                          : m_maxArgumentSize[record.section];
+  if (argumentSize > 0)
+  {
+    memcpy(m_argumentArena.data() + entry.m_argumentOffset, arguments, argumentSize);
+  }
+
+  for (uint32_t i = 0; i < m_dirtyRecords.size(); i++)
+  {
+    if ((entry.m_dirtyMask & (1u << i)) == 0)
+    {
+      entry.m_dirtyMask |= 1u << i;
+      m_dirtyRecords[i].push_back(record);
+    }
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Set the program and root arguments of a hit group record reserved by AddHitGroupInstance. The
+// record is marked as modified, as its program may have changed along with its arguments
+ShaderBindingTableGenerator::RecordHandle ShaderBindingTableGenerator::SetInstanceEntry(
+    uint32_t instanceContribution, uint32_t geometryIndex, uint32_t rayType,
+    std::wstring_view entryPoint, const void* arguments, uint32_t argumentSize)
+{
+  if (rayType >= m_rayTypeCount)
+  {
+    throw std::logic_error("Ray type out of range of the ray type count");
+  }
+
+  // A geometry index beyond the reserved count would silently address the records of the next
+  // instance, so the instance is looked up to check it
+  auto instance = std::lower_bound(
+      m_reservedInstances.begin(), m_reservedInstances.end(), instanceContribution,
+      [](const ReservedInstance& reserved, uint32_t contribution) {
+        return reserved.instanceContribution < contribution;
+      });
+  if (instance == m_reservedInstances.end() ||
+      instance->instanceContribution != instanceContribution)
+  {
+    throw std::logic_error("Hit group instance contribution not reserved by AddHitGroupInstance");
+  }
+  if (geometryIndex >= instance->geometryCount)
+  {
+    throw std::logic_error("Geometry index out of range of the reserved instance geometries");
+  }
+  RecordHandle record = {2, GetHitGroupIndex(instanceContribution, geometryIndex, rayType)};
+  m_hitGroup[record.index].m_exportId = InternExport(entryPoint);
+  UpdateEntry(record, arguments, argumentSize);
+  return record;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Return the index of a program name in the export table, adding it if needed
+uint32_t ShaderBindingTableGenerator::InternExport(std::wstring_view entryPoint)
+{
+  auto it = m_exportIds.find(entryPoint);
+  if (it != m_exportIds.end())
+  {
+    return it->second;
+  }
+  uint32_t exportId = static_cast<uint32_t>(m_exportNames.size());
+  m_exportIds.emplace(std::wstring(entryPoint), exportId);
+  m_exportNames.emplace_back(entryPoint);
+  return exportId;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Fetch the shader identifiers of the exports which have not been resolved yet for this pipeline.
+// Each identifier is looked up once per program name, regardless of the number of records using it
+void ShaderBindingTableGenerator::ResolveShaderIdentifiers(
+    ID3D12StateObjectProperties* raytracingPipeline)
+{
+  if (raytracingPipeline != m_identifierSource)
+  {
+    InvalidateShaderIdentifiers();
+    m_identifierSource = raytracingPipeline;
+  }
+
+  uint32_t exportCount = static_cast<uint32_t>(m_exportNames.size());
+  m_shaderIdentifiers.resize(static_cast<size_t>(exportCount) * m_progIdSize);
+  for (uint32_t i = m_resolvedExportCount; i < exportCount; i++)
   {
     // Get the shader identifier, and check whether that identifier is known
-    void* id = raytracingPipeline->GetShaderIdentifier(shader.m_entryPoint.c_str());
+    void* id = raytracingPipeline->GetShaderIdentifier(m_exportNames[i].c_str());
     if (!id)
     {
       std::wstring errMsg(std::wstring(L"Unknown shader identifier used in the SBT: ") +
-                          shader.m_entryPoint);
+                          m_exportNames[i]);
       throw std::logic_error(std::string(errMsg.begin(), errMsg.end()));
     }
-    // Copy the shader identifier
-    memcpy(pData, id, m_progIdSize);
-    // Copy all its resources pointers or values in bulk
-    memcpy(pData + m_progIdSize, shader.m_inputData.data(), shader.m_inputData.size() * 8);
-
-    pData += entrySize;
+    memcpy(m_shaderIdentifiers.data() + i * m_progIdSize, id, m_progIdSize);
+    m_resolvedExportCount = i + 1;
   }
-  // Return the number of bytes actually written to the output buffer
-  return static_cast<uint32_t>(shaders.size()) * entrySize;
 }
 
 //--------------------------------------------------------------------------------------------------
 //
-// Compute the size of the SBT entries for a set of entries, which is determined by the maximum
-// number of parameters of their root signature
-uint32_t ShaderBindingTableGenerator::GetEntrySize(const std::vector<SBTEntry>& entries)
+// Get the entries of a section, along with their entry size and the offset of the section
+// within the SBT
+std::vector<ShaderBindingTableGenerator::SBTEntry>&
+ShaderBindingTableGenerator::GetSection(uint32_t section, uint32_t* entrySize, uint32_t* offset)
 {
-  // Find the maximum number of parameters used by a single entry
-  size_t maxArgs = 0;
-  for (const auto& shader : entries)
+  static_assert(kSectionCount == 3, "Sections are ray generation, miss and hit groups");
+  std::vector<SBTEntry>* sections[kSectionCount] = {&m_rayGen, &m_miss, &m_hitGroup};
+  if (section >= kSectionCount)
   {
-    maxArgs = max(maxArgs, shader.m_inputData.size());
+    throw std::logic_error("Invalid shader binding table section");
   }
-  // A SBT entry is made of a program ID and a set of parameters, taking 8 bytes each. Those
-  // parameters can either be 8-bytes pointers, or 4-bytes constants
-  uint32_t entrySize = m_progIdSize + 8 * static_cast<uint32_t>(maxArgs);
-
-  // The entries of the shader binding table must be 16-bytes-aligned
-  entrySize = ROUND_UP(entrySize, D3D12_RAYTRACING_SHADER_RECORD_BYTE_ALIGNMENT);
-
-  return entrySize;
+  if (entrySize)
+  {
+    *entrySize = m_layout.entrySize[section];
+  }
+  if (offset)
+  {
+    *offset = m_layout.sectionOffset[section];
+  }
+  return *sections[section];
 }
 
 //--------------------------------------------------------------------------------------------------
 //
 //
-ShaderBindingTableGenerator::SBTEntry::SBTEntry(std::wstring entryPoint,
-                                                std::vector<void*> inputData)
-    : m_entryPoint(std::move(entryPoint)), m_inputData(std::move(inputData))
+ShaderBindingTableGenerator::SBTEntry::SBTEntry(uint32_t exportId, uint32_t argumentOffset,
+                                                uint32_t argumentSize)
+    : m_exportId(exportId), m_argumentOffset(argumentOffset), m_argumentSize(argumentSize)
 {
 }
 } // namespace nv_helpers_dx12
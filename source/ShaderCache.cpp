@@ -0,0 +1,378 @@
+/*
+The shader cache stores the DXIL libraries compiled by DXC on disk. See ShaderCache.h for an
+overview.
+*/
+
+#include "ShaderCache.h"
+#include "ContentHash.h"
+#include "MappedFile.h"
+
+#include <cstring>
+#include <stdexcept>
+
+namespace nv_helpers_dx12
+{
+
+namespace
+{
+//--------------------------------------------------------------------------------------------------
+//
+// DXC instances of the calling thread. The DXC objects cannot be used by several threads at once,
+// hence each compiling thread creates its own set on first use, and releases it when it exits
+struct ThreadCompiler
+{
+  IDxcCompiler* compiler = nullptr;
+  IDxcLibrary* library = nullptr;
+  IDxcIncludeHandler* includeHandler = nullptr;
+
+  ~ThreadCompiler()
+  {
+    if (includeHandler)
+    {
+      includeHandler->Release();
+    }
+    if (library)
+    {
+      library->Release();
+    }
+    if (compiler)
+    {
+      compiler->Release();
+    }
+  }
+};
+
+ThreadCompiler& GetThreadCompiler()
+{
+  thread_local ThreadCompiler threadCompiler;
+  if (!threadCompiler.compiler)
+  {
+    if (FAILED(DxcCreateInstance(CLSID_DxcCompiler, IID_PPV_ARGS(&threadCompiler.compiler))) ||
+        FAILED(DxcCreateInstance(CLSID_DxcLibrary, IID_PPV_ARGS(&threadCompiler.library))) ||
+        FAILED(threadCompiler.library->CreateIncludeHandler(&threadCompiler.includeHandler)))
+    {
+      throw std::logic_error("Cannot create the shader compiler");
+    }
+  }
+  return threadCompiler;
+}
+} // namespace
+
+//--------------------------------------------------------------------------------------------------
+//
+// Include handler forwarding to the default DXC include handler, and recording the name and the
+// content hash of each file it loads. The recorder lives on the stack for the duration of a
+// compilation, hence the reference count is never used to delete it
+class ShaderCache::IncludeRecorder : public IDxcIncludeHandler
+{
+public:
+  IncludeRecorder(IDxcIncludeHandler* handler, std::vector<IncludedFile>& includedFiles)
+      : m_handler(handler), m_includedFiles(includedFiles)
+  {
+  }
+
+  HRESULT STDMETHODCALLTYPE LoadSource(LPCWSTR pFilename, IDxcBlob** ppIncludeSource) override
+  {
+    HRESULT hr = m_handler->LoadSource(pFilename, ppIncludeSource);
+    if (SUCCEEDED(hr) && *ppIncludeSource)
+    {
+      m_includedFiles.push_back({pFilename, HashBytes((*ppIncludeSource)->GetBufferPointer(),
+                                                      (*ppIncludeSource)->GetBufferSize())});
+    }
+    return hr;
+  }
+
+  HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void** ppvObject) override
+  {
+    if (riid == __uuidof(IDxcIncludeHandler) || riid == __uuidof(IUnknown))
+    {
+      *ppvObject = static_cast<IDxcIncludeHandler*>(this);
+      AddRef();
+      return S_OK;
+    }
+    *ppvObject = nullptr;
+    return E_NOINTERFACE;
+  }
+
+  ULONG STDMETHODCALLTYPE AddRef() override { return ++m_refCount; }
+  ULONG STDMETHODCALLTYPE Release() override { return --m_refCount; }
+
+private:
+  IDxcIncludeHandler* m_handler;
+  std::vector<IncludedFile>& m_includedFiles;
+  ULONG m_refCount = 1;
+};
+
+//--------------------------------------------------------------------------------------------------
+//
+// Get the cache shared by the whole process
+ShaderCache& ShaderCache::Get()
+{
+  static ShaderCache cache;
+  return cache;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Set the directory in which the compiled libraries are stored. The directory is created if it
+// does not exist
+void ShaderCache::SetDirectory(const std::wstring& directory)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_directory = directory;
+  if (!m_directory.empty() && m_directory.back() != L'\\' && m_directory.back() != L'/')
+  {
+    m_directory += L'/';
+  }
+  // Failing to create the directory only disables the storage of new libraries
+  FileSystem::CreateDirectories(m_directory);
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Compile a HLSL file into a DXIL library, or load it from the cache if the file, its includes, the
+// profile and the arguments did not change
+IDxcBlob* ShaderCache::CompileLibrary(const std::wstring& fileName,
+                                      const std::wstring& targetProfile /*= L"lib_6_3"*/,
+                                      const std::vector<std::wstring>& arguments /*= {}*/)
+{
+  MappedFile source;
+  if (!source.Open(fileName))
+  {
+    throw std::logic_error("Cannot find shader file");
+  }
+
+  // The file name is part of the key since it appears in the debug information of the library
+  uint64_t key = HashValue(kFileVersion);
+  key = HashString(fileName, key);
+  key = HashString(targetProfile, key);
+  key = HashValue(static_cast<uint64_t>(arguments.size()), key);
+  for (const std::wstring& argument : arguments)
+  {
+    key = HashString(argument, key);
+  }
+  key = HashBytes(source.GetData(), static_cast<size_t>(source.GetSize()), key);
+
+  ThreadCompiler& compiler = GetThreadCompiler();
+  std::wstring cacheFileName = GetFileName(key);
+
+  std::vector<IncludedFile> includedFiles;
+  IDxcBlob* pBlob =
+      cacheFileName.empty() ? nullptr : Load(cacheFileName, key, compiler.library, includedFiles);
+  if (pBlob)
+  {
+    m_hitCount++;
+    SetDependencies(fileName, includedFiles);
+    return pBlob;
+  }
+  m_missCount++;
+
+  // Create blob from the mapped file
+  IDxcBlobEncoding* pTextBlob;
+  if (FAILED(compiler.library->CreateBlobWithEncodingFromPinned(
+          source.GetData(), static_cast<uint32_t>(source.GetSize()), 0, &pTextBlob)))
+  {
+    throw std::logic_error("Cannot create shader source blob");
+  }
+
+  std::vector<LPCWSTR> argumentPointers;
+  for (const std::wstring& argument : arguments)
+  {
+    argumentPointers.push_back(argument.c_str());
+  }
+
+  // Compile, recording the included files
+  includedFiles.clear();
+  IncludeRecorder includeRecorder(compiler.includeHandler, includedFiles);
+  IDxcOperationResult* pResult = nullptr;
+  HRESULT hr = compiler.compiler->Compile(
+      pTextBlob, fileName.c_str(), L"", targetProfile.c_str(), argumentPointers.data(),
+      static_cast<UINT32>(argumentPointers.size()), nullptr, 0, &includeRecorder, &pResult);
+  pTextBlob->Release();
+  if (FAILED(hr))
+  {
+    throw std::logic_error("Cannot invoke the shader compiler");
+  }
+
+  // Verify the result
+  HRESULT resultCode;
+  if (FAILED(pResult->GetStatus(&resultCode)) || FAILED(resultCode))
+  {
+    std::string errorMsg = "Shader compiler error:\n";
+    IDxcBlobEncoding* pError = nullptr;
+    if (SUCCEEDED(pResult->GetErrorBuffer(&pError)) && pError)
+    {
+      errorMsg.append(static_cast<const char*>(pError->GetBufferPointer()),
+                      pError->GetBufferSize());
+      pError->Release();
+    }
+    pResult->Release();
+    throw std::logic_error(errorMsg);
+  }
+
+  hr = pResult->GetResult(&pBlob);
+  pResult->Release();
+  if (FAILED(hr))
+  {
+    throw std::logic_error("Cannot get the compiled shader library");
+  }
+
+  if (!cacheFileName.empty())
+  {
+    Store(cacheFileName, key, pBlob, includedFiles);
+  }
+  SetDependencies(fileName, includedFiles);
+  return pBlob;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Run CompileLibrary on another thread, which uses its own compiler instance
+std::future<IDxcBlob*> ShaderCache::CompileLibraryAsync(
+    const std::wstring& fileName, const std::wstring& targetProfile /*= L"lib_6_3"*/,
+    const std::vector<std::wstring>& arguments /*= {}*/)
+{
+  return std::async(std::launch::async, [this, fileName, targetProfile, arguments]() {
+    return CompileLibrary(fileName, targetProfile, arguments);
+  });
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Absolute paths of the source file of a library and of all the files it includes
+std::vector<std::wstring> ShaderCache::GetDependencies(const std::wstring& fileName)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  auto it = m_dependencies.find(fileName);
+  if (it == m_dependencies.end())
+  {
+    return {GetAbsolutePath(fileName)};
+  }
+  return it->second;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Record the dependencies of a library, returned by GetDependencies
+void ShaderCache::SetDependencies(const std::wstring& fileName,
+                                  const std::vector<IncludedFile>& includedFiles)
+{
+  std::vector<std::wstring> dependencies = {GetAbsolutePath(fileName)};
+  for (const IncludedFile& includedFile : includedFiles)
+  {
+    dependencies.push_back(GetAbsolutePath(includedFile.name));
+  }
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_dependencies[fileName] = std::move(dependencies);
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Load the library stored in the cache file if all its included files are unchanged. Any mismatch
+// in the file is treated as a miss, the file will simply be overwritten
+IDxcBlob* ShaderCache::Load(const std::wstring& fileName, uint64_t key, IDxcLibrary* library,
+                            std::vector<IncludedFile>& includedFiles)
+{
+  MappedFile file;
+  if (!file.Open(fileName))
+  {
+    return nullptr;
+  }
+
+  const uint8_t* data = file.GetData();
+  uint64_t size = file.GetSize();
+  const FileHeader* header = reinterpret_cast<const FileHeader*>(data);
+  if (size < sizeof(FileHeader) || header->magic != kFileMagic ||
+      header->version != kFileVersion || header->key != key || header->blobSize == 0 ||
+      header->blobOffset > size || header->blobSize > size - header->blobOffset)
+  {
+    return nullptr;
+  }
+
+  // Each included file has to be unchanged for the library to be valid
+  uint64_t offset = sizeof(FileHeader);
+  for (uint32_t i = 0; i < header->dependencyCount; i++)
+  {
+    if (offset + sizeof(Dependency) > header->blobOffset)
+    {
+      return nullptr;
+    }
+    const Dependency* dependency = reinterpret_cast<const Dependency*>(data + offset);
+    offset += sizeof(Dependency);
+    uint64_t nameSize = dependency->nameLength * sizeof(wchar_t);
+    if (offset + nameSize > header->blobOffset)
+    {
+      return nullptr;
+    }
+    std::wstring name(reinterpret_cast<const wchar_t*>(data + offset), dependency->nameLength);
+    offset = (offset + nameSize + alignof(Dependency) - 1) & ~(alignof(Dependency) - 1);
+
+    MappedFile includedFile;
+    if (!includedFile.Open(name) ||
+        HashBytes(includedFile.GetData(), static_cast<size_t>(includedFile.GetSize())) !=
+            dependency->contentHash)
+    {
+      return nullptr;
+    }
+    includedFiles.push_back({name, dependency->contentHash});
+  }
+
+  IDxcBlobEncoding* pBlob = nullptr;
+  if (FAILED(library->CreateBlobWithEncodingOnHeapCopy(
+          data + header->blobOffset, static_cast<UINT32>(header->blobSize), 0, &pBlob)))
+  {
+    return nullptr;
+  }
+  return pBlob;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Write a compiled library, preceded by the list of its included files. Each file name is padded
+// so that the next descriptor is aligned
+void ShaderCache::Store(const std::wstring& fileName, uint64_t key, IDxcBlob* library,
+                        const std::vector<IncludedFile>& includedFiles)
+{
+  std::vector<uint8_t> fileData(sizeof(FileHeader));
+  for (const IncludedFile& includedFile : includedFiles)
+  {
+    Dependency dependency = {includedFile.contentHash,
+                             static_cast<uint32_t>(includedFile.name.size()), 0};
+    size_t offset = fileData.size();
+    size_t nameSize = includedFile.name.size() * sizeof(wchar_t);
+    fileData.resize((offset + sizeof(Dependency) + nameSize + alignof(Dependency) - 1) &
+                    ~(alignof(Dependency) - 1));
+    memcpy(fileData.data() + offset, &dependency, sizeof(Dependency));
+    memcpy(fileData.data() + offset + sizeof(Dependency), includedFile.name.data(), nameSize);
+  }
+
+  FileHeader header = {};
+  header.magic = kFileMagic;
+  header.version = kFileVersion;
+  header.key = key;
+  header.dependencyCount = static_cast<uint32_t>(includedFiles.size());
+  header.blobOffset = fileData.size();
+  header.blobSize = library->GetBufferSize();
+  memcpy(fileData.data(), &header, sizeof(FileHeader));
+
+  const uint8_t* blob = static_cast<const uint8_t*>(library->GetBufferPointer());
+  fileData.insert(fileData.end(), blob, blob + library->GetBufferSize());
+
+  // A failed write only means the library will be compiled again by the next run
+  WriteFileAtomically(fileName, fileData.data(), fileData.size());
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Name of the file storing a compiled library, or an empty string if no directory is set
+std::wstring ShaderCache::GetFileName(uint64_t key)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if (m_directory.empty())
+  {
+    return std::wstring();
+  }
+  return m_directory + HashToString(key) + L".dxil";
+}
+
+} // namespace nv_helpers_dx12
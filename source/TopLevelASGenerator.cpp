@@ -46,6 +46,7 @@ buffer needs to be kept until the command list execution is finished.
 */
 
 #include "TopLevelASGenerator.h"
+#include "ResourceStateTracker.h"
 #include <stdexcept>
 
 // Helper to compute aligned buffer sizes
@@ -71,8 +72,8 @@ void TopLevelASGenerator::AddInstance(
     UINT instanceID,                    // Instance ID, which can be used in the shaders to
                                         // identify this specific instance
     UINT hitGroupIndex                  // Hit group index, corresponding the the index of the
-                                        // hit group in the Shader Binding Table that will be
-                                        // invocated upon hitting the geometry
+                                        // first hit group record of the instance in the Shader
+                                        // Binding Table
 )
 {
   m_instances.emplace_back(Instance(bottomLevelAS, transform, instanceID, hitGroupIndex));
@@ -155,9 +156,12 @@ void TopLevelASGenerator::Generate(
                                        // descriptors, has to be in upload heap
     bool updateOnly /*= false*/,       // If true, simply refit the existing
                                        // acceleration structure
-    ID3D12Resource* previousResult /*= nullptr*/ // Optional previous acceleration
-                                                 // structure, used if an iterative update
-                                                 // is requested
+    ID3D12Resource* previousResult /*= nullptr*/, // Optional previous acceleration
+                                                  // structure, used if an iterative update
+                                                  // is requested
+    ResourceStateTracker* stateTracker /*= nullptr*/ // Optional tracker flushed before the
+                                                     // build, and in which to queue the UAV
+                                                     // barrier on the result
 )
 {
   // Copy the descriptors in the target descriptor buffer
@@ -236,12 +240,24 @@ void TopLevelASGenerator::Generate(
   buildDesc.SourceAccelerationStructureData = pSourceAS;
   buildDesc.Inputs.Flags = flags;
 
+  // The bottom-level builds queued in the tracker must complete before the
+  // top-level build reads them
+  if (stateTracker)
+  {
+    stateTracker->Flush(commandList);
+  }
+
   // Build the top-level AS
   commandList->BuildRaytracingAccelerationStructure(&buildDesc, 0, nullptr);
 
   // Wait for the builder to complete by setting a barrier on the resulting
   // buffer. This can be important in case the rendering is triggered
   // immediately afterwards, without executing the command list
+  if (stateTracker)
+  {
+    stateTracker->UAVBarrier(resultBuffer);
+    return;
+  }
   D3D12_RESOURCE_BARRIER uavBarrier;
   uavBarrier.Type = D3D12_RESOURCE_BARRIER_TYPE_UAV;
   uavBarrier.UAV.pResource = resultBuffer;
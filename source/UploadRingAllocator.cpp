@@ -0,0 +1,126 @@
+/*
+The upload ring allocator hands out short-lived suballocations of a single upload buffer. See
+UploadRingAllocator.h for an overview.
+*/
+
+#include "UploadRingAllocator.h"
+#include "d3dx12.h"
+
+#include <stdexcept>
+
+// Helper to compute aligned buffer sizes
+#ifndef ROUND_UP
+#define ROUND_UP(v, powerOf2Alignment) (((v) + (powerOf2Alignment)-1) & ~((powerOf2Alignment)-1))
+#endif
+
+namespace nv_helpers_dx12
+{
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+UploadRingAllocator::~UploadRingAllocator()
+{
+  Release();
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Create the upload buffer and map it for the lifetime of the allocator. Upload heaps are
+// write-combined, the CPU should only write sequentially into the allocations and never read them
+void UploadRingAllocator::Initialize(ID3D12Device* device, uint64_t capacity)
+{
+  Release();
+
+  m_capacity = ROUND_UP(capacity, D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT);
+  CD3DX12_HEAP_PROPERTIES heapProps(D3D12_HEAP_TYPE_UPLOAD);
+  CD3DX12_RESOURCE_DESC bufDesc = CD3DX12_RESOURCE_DESC::Buffer(m_capacity);
+  if (FAILED(device->CreateCommittedResource(&heapProps, D3D12_HEAP_FLAG_NONE, &bufDesc,
+                                             D3D12_RESOURCE_STATE_GENERIC_READ, nullptr,
+                                             IID_PPV_ARGS(&m_buffer))))
+  {
+    throw std::logic_error("Could not allocate the upload ring buffer");
+  }
+
+  CD3DX12_RANGE readRange(0, 0);
+  if (FAILED(m_buffer->Map(0, &readRange, reinterpret_cast<void**>(&m_cpuAddress))))
+  {
+    throw std::logic_error("Could not map the upload ring buffer");
+  }
+  m_gpuAddress = m_buffer->GetGPUVirtualAddress();
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Allocate data valid until the end of the current frame. If the allocation does not fit before
+// the end of the buffer, it starts at the beginning of the buffer instead
+UploadRingAllocator::Allocation UploadRingAllocator::Allocate(uint64_t size, uint64_t alignment)
+{
+  if (size == 0 || size > m_capacity)
+  {
+    throw std::logic_error("Invalid upload ring allocation size");
+  }
+
+  // The capacity is only a multiple of 64 KB, so the wrap cannot use the power-of-two rounding
+  uint64_t position = ROUND_UP(m_head, alignment);
+  if (position % m_capacity + size > m_capacity)
+  {
+    position = (position / m_capacity + 1) * m_capacity;
+  }
+  if (position + size - m_tail > m_capacity)
+  {
+    throw std::logic_error("The upload ring is full, its capacity is too small for the frames "
+                           "in flight");
+  }
+  m_head = position + size;
+
+  Allocation allocation;
+  allocation.offset = position % m_capacity;
+  allocation.cpuAddress = m_cpuAddress + allocation.offset;
+  allocation.gpuAddress = m_gpuAddress + allocation.offset;
+  allocation.resource = m_buffer;
+  return allocation;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Tag the allocations made since the previous call with the fence value signaled once the GPU no
+// longer uses them
+void UploadRingAllocator::FinishFrame(uint64_t fenceValue)
+{
+  m_frames.push_back({fenceValue, m_head});
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Free the allocations of the completed frames. The frames are finished in increasing order of
+// fence values, so the completed ones are at the front of the list
+void UploadRingAllocator::Reclaim(uint64_t completedFenceValue)
+{
+  while (!m_frames.empty() && m_frames.front().first <= completedFenceValue)
+  {
+    m_tail = m_frames.front().second;
+    m_frames.pop_front();
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+void UploadRingAllocator::Release()
+{
+  if (m_buffer)
+  {
+    m_buffer->Unmap(0, nullptr);
+    m_buffer->Release();
+    m_buffer = nullptr;
+  }
+  m_cpuAddress = nullptr;
+  m_gpuAddress = 0;
+  m_capacity = 0;
+  m_head = 0;
+  m_tail = 0;
+  m_frames.clear();
+}
+
+} // namespace nv_helpers_dx12
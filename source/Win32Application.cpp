@@ -11,16 +11,17 @@
 
 #include "stdafx.h"
 #include "Win32Application.h"
+#include "Win32Platform.h"
+#include "Windowsx.h"
 
 HWND Win32Application::m_hwnd = nullptr;
 
 int Win32Application::Run(DXPipeline *pPipeline, HINSTANCE hInstance, int nCmdShow)
 {
-	// Parse the command line parameters
-	int argc;
-	LPWSTR *argv = CommandLineToArgvW(GetCommandLineW(), &argc);
-	pPipeline->ParseCommandLineArgs(argv, argc);
-	LocalFree(argv);
+	// The pipeline reaches the window, the file system and the clock through
+	// the platform
+	Win32Platform platform;
+	pPipeline->SetPlatform(&platform);
 
 	// Initialize the window class.
 	WNDCLASSEX windowClass = {0};
@@ -48,6 +49,7 @@ int Win32Application::Run(DXPipeline *pPipeline, HINSTANCE hInstance, int nCmdSh
 		nullptr, // We aren't using menus.
 		hInstance,
 		pPipeline);
+	platform.SetWindow(m_hwnd);
 
 	// Initialize the sample. OnInit is defined in each child-implementation of DXSample.
 	pPipeline->OnInit();
@@ -90,31 +92,30 @@ LRESULT CALLBACK Win32Application::WindowProc(HWND hWnd, UINT message, WPARAM wP
 	case WM_MOUSEMOVE:
 		if (pPipeline)
 		{
-			pPipeline->OnMouseMove(static_cast<uint8_t>(wParam), static_cast<uint32_t>(lParam));
+			pPipeline->OnMouseMove(GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam), Win32Platform::TranslateMouseButtons(wParam));
 		}
 		return 0;
 
 	case WM_KEYDOWN:
 		if (pPipeline)
 		{
-			pPipeline->OnKeyDown(static_cast<uint8_t>(wParam));
-			if (static_cast<uint8_t>(wParam) == VK_ESCAPE)
-				PostQuitMessage;
+			pPipeline->OnKeyDown(Win32Platform::TranslateKey(wParam));
+			if (Win32Platform::TranslateKey(wParam) == Key::Escape)
+				PostQuitMessage(0);
 		}
 		return 0;
 
 	case WM_KEYUP:
 		if (pPipeline)
 		{
-			pPipeline->OnKeyUp(static_cast<uint8_t>(wParam));
+			pPipeline->OnKeyUp(Win32Platform::TranslateKey(wParam));
 		}
 		return 0;
 
 	case WM_PAINT:
 		if (pPipeline)
 		{
-			pPipeline->OnUpdate();
-			pPipeline->OnRender();
+			pPipeline->RenderFrame();
 		}
 		return 0;
 
@@ -0,0 +1,232 @@
+#include "stdafx.h"
+#include "Win32Platform.h"
+
+#include <cstring>
+#include <stdexcept>
+
+Win32Platform::Win32Platform()
+{
+	QueryPerformanceFrequency(&m_frequency);
+}
+
+std::wstring Win32Platform::GetExecutableDirectory() const
+{
+	WCHAR path[512];
+	DWORD size = GetModuleFileName(nullptr, path, _countof(path));
+	if (size == 0 || size == _countof(path))
+	{
+		// Method failed or path was truncated.
+		throw std::logic_error("Cannot get the path of the executable");
+	}
+
+	WCHAR *lastSlash = wcsrchr(path, L'\\');
+	if (lastSlash)
+	{
+		*(lastSlash + 1) = L'\0';
+	}
+	return path;
+}
+
+void Win32Platform::SetWindowTitle(const std::wstring &title)
+{
+	if (m_hwnd)
+		SetWindowText(m_hwnd, title.c_str());
+}
+
+double Win32Platform::GetTime() const
+{
+	LARGE_INTEGER counter;
+	QueryPerformanceCounter(&counter);
+	return static_cast<double>(counter.QuadPart) / static_cast<double>(m_frequency.QuadPart);
+}
+
+// The virtual keys of the letters, digits, space and escape are the key codes
+// of the platform
+uint8_t Win32Platform::TranslateKey(WPARAM wParam)
+{
+	return static_cast<uint8_t>(wParam);
+}
+
+uint32_t Win32Platform::TranslateMouseButtons(WPARAM wParam)
+{
+	uint32_t buttons = 0;
+	if (wParam & MK_LBUTTON)
+		buttons |= MouseButton::Left;
+	if (wParam & MK_RBUTTON)
+		buttons |= MouseButton::Right;
+	if (wParam & MK_MBUTTON)
+		buttons |= MouseButton::Middle;
+	return buttons;
+}
+
+bool FileSystem::MapFile(const std::wstring &fileName, FileMapping &mapping)
+{
+	UnmapFile(mapping);
+
+	HANDLE file = CreateFileW(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+							  FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	// The mapping keeps a reference on the file, whose handle is not needed anymore
+	LARGE_INTEGER fileSize = {};
+	if (GetFileSizeEx(file, &fileSize) && fileSize.QuadPart > 0)
+	{
+		mapping.size = static_cast<uint64_t>(fileSize.QuadPart);
+		mapping.handle = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	}
+	CloseHandle(file);
+	if (mapping.handle)
+		mapping.data = static_cast<const uint8_t *>(MapViewOfFile(mapping.handle, FILE_MAP_READ, 0, 0, 0));
+
+	if (mapping.data == nullptr)
+	{
+		UnmapFile(mapping);
+		return false;
+	}
+	return true;
+}
+
+void FileSystem::UnmapFile(FileMapping &mapping)
+{
+	if (mapping.data)
+		UnmapViewOfFile(mapping.data);
+	if (mapping.handle)
+		CloseHandle(mapping.handle);
+	mapping = FileMapping();
+}
+
+std::FILE *FileSystem::OpenFile(const std::wstring &fileName, const char *mode)
+{
+	std::wstring wideMode(mode, mode + strlen(mode));
+	std::FILE *file = nullptr;
+	if (_wfopen_s(&file, fileName.c_str(), wideMode.c_str()) != 0)
+		return nullptr;
+	return file;
+}
+
+bool FileSystem::RenameFile(const std::wstring &fileName, const std::wstring &newFileName)
+{
+	return MoveFileExW(fileName.c_str(), newFileName.c_str(), MOVEFILE_REPLACE_EXISTING) != FALSE;
+}
+
+bool FileSystem::RemoveFile(const std::wstring &fileName)
+{
+	return DeleteFileW(fileName.c_str()) != FALSE;
+}
+
+// GetFullPathNameW removes the "." and ".." components, and does not require
+// the path to exist
+std::wstring FileSystem::GetAbsolutePath(const std::wstring &path)
+{
+	DWORD size = GetFullPathNameW(path.c_str(), 0, nullptr, nullptr);
+	if (size == 0)
+		return path;
+	std::wstring absolutePath(size, L'\0');
+	size = GetFullPathNameW(path.c_str(), size, &absolutePath[0], nullptr);
+	if (size == 0 || size >= absolutePath.size())
+		return path;
+	absolutePath.resize(size);
+	return absolutePath;
+}
+
+// The parents are created first, the existing ones being skipped
+bool FileSystem::CreateDirectories(const std::wstring &directory)
+{
+	std::wstring path = directory;
+	while (!path.empty() && (path.back() == L'\\' || path.back() == L'/'))
+		path.pop_back();
+	if (path.empty())
+		return false;
+
+	const DWORD attributes = GetFileAttributesW(path.c_str());
+	if (attributes != INVALID_FILE_ATTRIBUTES)
+		return (attributes & FILE_ATTRIBUTE_DIRECTORY) != 0;
+
+	const size_t parentEnd = path.find_last_of(L"\\/");
+	if (parentEnd != std::wstring::npos && parentEnd > 0 && path[parentEnd - 1] != L':')
+		CreateDirectories(path.substr(0, parentEnd));
+	return CreateDirectoryW(path.c_str(), nullptr) || GetLastError() == ERROR_ALREADY_EXISTS;
+}
+
+// The directory is opened for asynchronous reads, so that the waiting thread
+// can be woken up by either a notification or the cancellation
+struct FileSystem::DirectoryWatch
+{
+	HANDLE directory = INVALID_HANDLE_VALUE;
+	HANDLE stopEvent = nullptr;
+	OVERLAPPED overlapped = {};
+	// The notification records are DWORD-aligned
+	alignas(DWORD) uint8_t buffer[16384];
+};
+
+FileSystem::DirectoryWatch *FileSystem::OpenDirectoryWatch(const std::wstring &directory)
+{
+	DirectoryWatch *watch = new DirectoryWatch;
+	watch->directory = CreateFileW(directory.c_str(), FILE_LIST_DIRECTORY,
+								   FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING,
+								   FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, nullptr);
+	watch->stopEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+	watch->overlapped.hEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+	if (watch->directory == INVALID_HANDLE_VALUE || watch->stopEvent == nullptr || watch->overlapped.hEvent == nullptr)
+	{
+		CloseDirectoryWatch(watch);
+		return nullptr;
+	}
+	return watch;
+}
+
+// Each completed read returns a list of FILE_NOTIFY_INFORMATION records, whose
+// file names are relative to the watched directory
+bool FileSystem::WaitForDirectoryChanges(DirectoryWatch *watch, std::vector<std::wstring> &modifiedFiles, bool &overflow)
+{
+	const DWORD filter = FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_SIZE;
+	ResetEvent(watch->overlapped.hEvent);
+	if (!ReadDirectoryChangesW(watch->directory, watch->buffer, sizeof(watch->buffer), TRUE, filter, nullptr,
+							   &watch->overlapped, nullptr))
+		return false;
+
+	HANDLE events[2] = {watch->overlapped.hEvent, watch->stopEvent};
+	DWORD result = WaitForMultipleObjects(2, events, FALSE, INFINITE);
+	DWORD bytesReturned = 0;
+	if (result != WAIT_OBJECT_0)
+	{
+		// The pending read has to complete before the buffer can be released
+		CancelIo(watch->directory);
+		GetOverlappedResult(watch->directory, &watch->overlapped, &bytesReturned, TRUE);
+		return false;
+	}
+	if (!GetOverlappedResult(watch->directory, &watch->overlapped, &bytesReturned, FALSE))
+		return false;
+
+	overflow = bytesReturned == 0;
+	const uint8_t *record = watch->buffer;
+	while (bytesReturned > 0)
+	{
+		const FILE_NOTIFY_INFORMATION *info = reinterpret_cast<const FILE_NOTIFY_INFORMATION *>(record);
+		if (info->Action != FILE_ACTION_REMOVED && info->Action != FILE_ACTION_RENAMED_OLD_NAME)
+			modifiedFiles.push_back(std::wstring(info->FileName, info->FileNameLength / sizeof(WCHAR)));
+		if (info->NextEntryOffset == 0)
+			break;
+		record += info->NextEntryOffset;
+	}
+	return true;
+}
+
+void FileSystem::CancelDirectoryWatch(DirectoryWatch *watch)
+{
+	SetEvent(watch->stopEvent);
+}
+
+void FileSystem::CloseDirectoryWatch(DirectoryWatch *watch)
+{
+	if (watch == nullptr)
+		return;
+	if (watch->overlapped.hEvent)
+		CloseHandle(watch->overlapped.hEvent);
+	if (watch->stopEvent)
+		CloseHandle(watch->stopEvent);
+	if (watch->directory != INVALID_HANDLE_VALUE)
+		CloseHandle(watch->directory);
+	delete watch;
+}
@@ -11,10 +11,21 @@
 
 #include "stdafx.h"
 #include "DX12HelloTriangle.h"
+#include "HeadlessApplication.h"
+#include "Win32Application.h"
 
 _Use_decl_annotations_
 int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int nCmdShow)
 {
 	DX12HelloTriangle sample(1280, 720, L"D3D12 Hello Triangle");
+
+	// Parse the command line parameters, which select the offline rendering
+	int argc;
+	LPWSTR *argv = CommandLineToArgvW(GetCommandLineW(), &argc);
+	sample.ParseCommandLineArgs(argv, argc);
+	LocalFree(argv);
+
+	if (sample.IsHeadless())
+		return HeadlessApplication::Run(&sample);
 	return Win32Application::Run(&sample, hInstance, nCmdShow);
 }
\ No newline at end of file
@@ -0,0 +1,184 @@
+/*
+Test of the AsyncBuildQueue against the software queues of SoftwareD3D12, mirroring the refits of
+DX12HelloTriangle: the frames submitted on the direct queue trace the current version of the TLAS,
+while the refits submitted on the build queue write the next version from the current one. Over
+200 frames, the test checks that a refit never overwrites a version traced by a frame in flight,
+that it always reads a completed version, that the frames always trace a completed version, and
+that the synchronization happens on the simulated GPU rather than by blocking the CPU.
+
+Build and run from the repository root, e.g.:
+g++ -std=c++20 -pthread -Itests/SoftwareD3D12 -Iinclude tests/AsyncBuildQueueTest.cpp
+    source/AsyncBuildQueue.cpp source/FrameContextRing.cpp -o AsyncBuildQueueTest &&
+    ./AsyncBuildQueueTest
+*/
+
+#include "AsyncBuildQueue.h"
+#include "FrameContextRing.h"
+
+#include <cstdio>
+#include <cstdlib>
+
+namespace
+{
+
+const uint32_t kTlasVersionCount = 2;
+const uint32_t kFrameCount = 2;
+const uint32_t kRenderedFrameCount = 200;
+
+/// Version of the TLAS, with the number of GPU operations reading and writing it
+struct TlasVersion
+{
+  std::atomic<int> readerCount{0};
+  std::atomic<int> writerCount{0};
+  /// Number of the refit which wrote the version
+  std::atomic<uint64_t> content{0};
+};
+
+void GpuWork(uint32_t milliseconds)
+{
+  std::this_thread::sleep_for(std::chrono::milliseconds(milliseconds));
+}
+
+} // namespace
+
+int main()
+{
+  ID3D12Device* device = new ID3D12Device;
+  ID3D12CommandQueue* directQueue = nullptr;
+  D3D12_COMMAND_QUEUE_DESC queueDesc = {};
+  device->CreateCommandQueue(&queueDesc, IID_PPV_ARGS(&directQueue));
+
+  TlasVersion versions[kTlasVersionCount];
+  std::atomic<int> violationCount{0};
+  double cpuBlockedMilliseconds = 0.0;
+  double totalMilliseconds = 0.0;
+  uint32_t frameStallCount = 0;
+  {
+    nv_helpers_dx12::FrameContextRing frameRing;
+    frameRing.Initialize(device, directQueue, kFrameCount);
+    nv_helpers_dx12::AsyncBuildQueue buildQueue;
+    buildQueue.Initialize(device, kTlasVersionCount);
+
+    // The command list of each frame slot is reused once the slot is available again
+    ID3D12CommandAllocator* frameAllocators[kFrameCount] = {};
+    ID3D12GraphicsCommandList4* frameLists[kFrameCount] = {};
+    for (uint32_t i = 0; i < kFrameCount; i++)
+    {
+      device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT,
+                                     IID_PPV_ARGS(&frameAllocators[i]));
+      device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, frameAllocators[i], nullptr,
+                                IID_PPV_ARGS(&frameLists[i]));
+      frameLists[i]->Close();
+    }
+
+    // Fence value of the last frame tracing each version
+    uint64_t versionFenceValues[kTlasVersionCount] = {};
+    uint32_t tlasVersion = 0;
+    uint64_t refitNumber = 1;
+
+    // Initial build of the first version
+    ID3D12GraphicsCommandList4* buildList = buildQueue.Begin();
+    buildList->Record([&]() {
+      versions[0].writerCount++;
+      GpuWork(5);
+      versions[0].content = 1;
+      versions[0].writerCount--;
+    });
+    buildQueue.MakeQueueWait(directQueue, buildQueue.Submit());
+
+    auto startTime = std::chrono::steady_clock::now();
+    for (uint32_t frame = 0; frame < kRenderedFrameCount; frame++)
+    {
+      // Refit into the next version from the current one, skipping some frames as when the
+      // animation is paused
+      if (frame % 3 != 2)
+      {
+        const uint32_t version = (tlasVersion + 1) % kTlasVersionCount;
+        const uint32_t sourceVersion = tlasVersion;
+        const uint64_t content = ++refitNumber;
+
+        auto beginTime = std::chrono::steady_clock::now();
+        buildList = buildQueue.Begin();
+        cpuBlockedMilliseconds += std::chrono::duration<double, std::milli>(
+                                      std::chrono::steady_clock::now() - beginTime)
+                                      .count();
+        buildQueue.WaitOnGpu(frameRing.GetFence(), versionFenceValues[version]);
+        buildList->Record([&, version, sourceVersion, content]() {
+          if (versions[version].readerCount > 0)
+          {
+            violationCount++;
+          }
+          versions[version].writerCount++;
+          if (versions[sourceVersion].writerCount > 0 ||
+              versions[sourceVersion].content != content - 1)
+          {
+            violationCount++;
+          }
+          GpuWork(3);
+          versions[version].content = content;
+          versions[version].writerCount--;
+        });
+        buildQueue.MakeQueueWait(directQueue, buildQueue.Submit());
+        tlasVersion = version;
+      }
+
+      // Trace the current version
+      frameRing.BeginFrame();
+      versionFenceValues[tlasVersion] = frameRing.GetFrameFenceValue();
+      ID3D12CommandAllocator* frameAllocator = frameAllocators[frameRing.GetFrameIndex()];
+      ID3D12GraphicsCommandList4* frameList = frameLists[frameRing.GetFrameIndex()];
+      if (FAILED(frameAllocator->Reset()) || FAILED(frameList->Reset(frameAllocator, nullptr)))
+      {
+        printf("FAILED: the frame slot was reused while its frame was executing\n");
+        violationCount++;
+        break;
+      }
+      const uint32_t version = tlasVersion;
+      const uint64_t content = refitNumber;
+      frameList->Record([&, version, content]() {
+        versions[version].readerCount++;
+        if (versions[version].writerCount > 0 || versions[version].content != content)
+        {
+          violationCount++;
+        }
+        GpuWork(4);
+        versions[version].readerCount--;
+      });
+      frameList->Close();
+      ID3D12CommandList* lists[] = {frameList};
+      directQueue->ExecuteCommandLists(1, lists);
+      frameRing.EndFrame();
+    }
+    buildQueue.WaitForIdle();
+    frameRing.WaitForIdle();
+    totalMilliseconds =
+        std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime)
+            .count();
+    frameStallCount = frameRing.GetStallCount();
+
+    for (uint32_t i = 0; i < kFrameCount; i++)
+    {
+      frameLists[i]->Release();
+      frameAllocators[i]->Release();
+    }
+  }
+  directQueue->Release();
+  device->Release();
+
+  printf("AsyncBuildQueue: %d violations, %u frame stalls, CPU blocked in Begin for %.1f ms of "
+         "%.1f ms\n",
+         violationCount.load(), frameStallCount, cpuBlockedMilliseconds, totalMilliseconds);
+  if (violationCount > 0)
+  {
+    printf("FAILED: a refit and a frame accessed the same TLAS version concurrently\n");
+    return EXIT_FAILURE;
+  }
+  // The CPU only waits when it gets ahead of the simulated GPU, not for each refit
+  if (cpuBlockedMilliseconds > 0.5 * totalMilliseconds)
+  {
+    printf("FAILED: the CPU waited for the refits instead of the GPU\n");
+    return EXIT_FAILURE;
+  }
+  printf("AsyncBuildQueue: all tests passed\n");
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,220 @@
+/*
+Test of the FileSystem services of PosixPlatform, through the helpers built on them: MappedFile,
+AtomicFileWriter, GetAbsolutePath and DirectoryWatcher. The files are created in a temporary
+directory whose name is not ASCII, and the locale is left to "C", so that the test checks that the
+paths are converted to UTF-8 whatever the locale.
+
+Build and run from the repository root, e.g.:
+g++ -std=c++20 -pthread -Iinclude tests/FileSystemTest.cpp source/PosixPlatform.cpp
+    source/MappedFile.cpp source/DirectoryWatcher.cpp -o FileSystemTest && ./FileSystemTest
+*/
+
+#include "DirectoryWatcher.h"
+#include "MappedFile.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <thread>
+#include <unistd.h>
+
+namespace
+{
+
+int g_failureCount = 0;
+
+void Check(bool condition, const char* message)
+{
+  if (!condition)
+  {
+    printf("FAILED: %s\n", message);
+    g_failureCount++;
+  }
+}
+
+bool Contains(const std::vector<std::wstring>& files, const std::wstring& file)
+{
+  return std::find(files.begin(), files.end(), file) != files.end();
+}
+
+/// Create a file with the given contents, outside of the tested services
+void CreateFile(const std::wstring& fileName, const char* contents)
+{
+  std::FILE* file = FileSystem::OpenFile(fileName, "wb");
+  if (file == nullptr)
+  {
+    throw std::runtime_error("Cannot create a test file");
+  }
+  std::fwrite(contents, 1, strlen(contents), file);
+  std::fclose(file);
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Create nested directories, write files atomically and map them back
+void TestFiles(const std::wstring& root)
+{
+  const std::wstring directory = root + L"caché/ünïcode/";
+  Check(FileSystem::CreateDirectories(directory), "The nested directories were not created");
+  Check(FileSystem::CreateDirectories(directory), "Creating existing directories failed");
+
+  const std::wstring fileName = directory + L"données.bin";
+  const char contents[] = "serialized data";
+  Check(nv_helpers_dx12::WriteFileAtomically(fileName, contents, sizeof(contents)),
+        "The file was not written");
+
+  nv_helpers_dx12::MappedFile file;
+  Check(file.Open(fileName), "The written file cannot be mapped");
+  Check(file.GetSize() == sizeof(contents) &&
+            memcmp(file.GetData(), contents, sizeof(contents)) == 0,
+        "The mapped file does not hold the written data");
+
+  // Replacing the file while it is mapped keeps the mapping valid
+  const char newContents[] = "new data";
+  Check(nv_helpers_dx12::WriteFileAtomically(fileName, newContents, sizeof(newContents)),
+        "The file was not replaced");
+  Check(memcmp(file.GetData(), contents, sizeof(contents)) == 0,
+        "The mapping changed when the file was replaced");
+  file.Close();
+  Check(!file.IsOpen() && file.GetData() == nullptr, "The file is still mapped once closed");
+  Check(file.Open(fileName) && file.GetSize() == sizeof(newContents),
+        "The replaced file does not hold the new data");
+  file.Close();
+
+  // Missing and empty files cannot be mapped
+  Check(!file.Open(directory + L"missing.bin"), "A missing file was mapped");
+  CreateFile(directory + L"empty.bin", "");
+  Check(!file.Open(directory + L"empty.bin") && !file.IsOpen(), "An empty file was mapped");
+
+  // An aborted writer leaves neither the file nor its temporary file
+  {
+    nv_helpers_dx12::AtomicFileWriter writer;
+    Check(writer.Open(directory + L"aborted.bin") && writer.Write(contents, sizeof(contents)),
+          "The aborted file was not written");
+  }
+  Check(!file.Open(directory + L"aborted.bin"), "The aborted file was committed");
+  Check(FileSystem::RemoveFile(directory + L"empty.bin") && FileSystem::RemoveFile(fileName),
+        "The files were not removed");
+  Check(!FileSystem::RemoveFile(fileName), "A missing file was removed");
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Relative paths are resolved from the current directory, and the "." and ".." components removed
+void TestAbsolutePath(const std::wstring& root, const char* nativeRoot)
+{
+  Check(nv_helpers_dx12::GetAbsolutePath(root + L"répertoire/./a/../b.txt") ==
+            root + L"répertoire/b.txt",
+        "The absolute path was not normalized");
+
+  if (chdir(nativeRoot) != 0)
+  {
+    throw std::runtime_error("Cannot change the current directory");
+  }
+  Check(nv_helpers_dx12::GetAbsolutePath(L"répertoire/../b.txt") == root + L"b.txt",
+        "The relative path was not resolved from the current directory");
+  Check(nv_helpers_dx12::GetAbsolutePath(L"") == L"", "The empty path was changed");
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Poll the watcher until the expected files are reported, or a timeout
+std::vector<std::wstring> WaitForFiles(nv_helpers_dx12::DirectoryWatcher& watcher,
+                                       const std::vector<std::wstring>& expectedFiles)
+{
+  std::vector<std::wstring> reportedFiles;
+  for (int i = 0; i < 200; i++)
+  {
+    std::vector<std::wstring> files;
+    if (watcher.PollModifiedFiles(files))
+    {
+      reportedFiles.insert(reportedFiles.end(), files.begin(), files.end());
+    }
+    if (std::all_of(expectedFiles.begin(), expectedFiles.end(),
+                    [&](const std::wstring& file) { return Contains(reportedFiles, file); }))
+    {
+      break;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  return reportedFiles;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// The watcher reports the absolute paths of the modified files, including in the subdirectories
+// created while watching, and once per save
+void TestDirectoryWatcher(const std::wstring& root)
+{
+  const std::wstring directory = root + L"déjà/";
+  FileSystem::CreateDirectories(directory + L"sub");
+
+  nv_helpers_dx12::DirectoryWatcher watcher;
+  watcher.SetSettlingDelay(30);
+  watcher.Start(directory);
+  Check(watcher.GetDirectory() == directory, "The watched directory is not the given one");
+
+  CreateFile(directory + L"sub/shader.hlsl", "float4 main();");
+  CreateFile(directory + L"sub/shader.hlsl", "float4 main() : SV_Target;");
+  std::vector<std::wstring> files = WaitForFiles(watcher, {directory + L"sub/shader.hlsl"});
+  Check(Contains(files, directory + L"sub/shader.hlsl"), "The modified file was not reported");
+  Check(std::count(files.begin(), files.end(), directory + L"sub/shader.hlsl") == 1,
+        "The modified file was reported more than once");
+
+  // The files of a new directory are watched once it exists
+  FileSystem::CreateDirectories(directory + L"nouveau");
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  CreateFile(directory + L"nouveau/include.hlsli", "#define A 1");
+  files = WaitForFiles(watcher, {directory + L"nouveau/include.hlsli"});
+  Check(Contains(files, directory + L"nouveau/include.hlsli"),
+        "The file of a new directory was not reported");
+
+  // Nothing is reported without modifications
+  std::this_thread::sleep_for(std::chrono::milliseconds(60));
+  files.clear();
+  Check(!watcher.PollModifiedFiles(files), "A file was reported without modification");
+
+  watcher.Stop();
+  bool thrown = false;
+  try
+  {
+    watcher.Start(root + L"missing");
+  }
+  catch (const std::logic_error&)
+  {
+    thrown = true;
+  }
+  Check(thrown, "Watching a missing directory did not throw");
+}
+
+} // namespace
+
+int main()
+{
+  char rootTemplate[] = "/tmp/FileSystemTestXXXXXX";
+  if (mkdtemp(rootTemplate) == nullptr)
+  {
+    printf("FAILED: cannot create the temporary directory\n");
+    return EXIT_FAILURE;
+  }
+  const std::wstring root = std::wstring(rootTemplate, rootTemplate + strlen(rootTemplate)) + L"/";
+
+  TestFiles(root);
+  TestAbsolutePath(root, rootTemplate);
+  TestDirectoryWatcher(root);
+
+  std::string removeCommand = std::string("rm -rf ") + rootTemplate;
+  if (system(removeCommand.c_str()) != 0)
+  {
+    printf("Cannot remove %s\n", rootTemplate);
+  }
+  if (g_failureCount > 0)
+  {
+    return EXIT_FAILURE;
+  }
+  printf("FileSystem: all tests passed\n");
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,183 @@
+/*
+Test of the FrameContextRing against the software queue of SoftwareD3D12, whose simulated GPU runs
+several milliseconds behind the CPU. Each frame writes into the per-frame resource of its slot on
+the CPU and reads it back on the simulated GPU: the test checks that the CPU never overwrites a
+slot still read by a frame in flight, never gets more than GetFrameCount() frames ahead, and that
+the deferred objects are only released once the frames using them have completed.
+
+Build and run from the repository root, e.g.:
+g++ -std=c++20 -pthread -Itests/SoftwareD3D12 -Iinclude tests/FrameContextRingTest.cpp
+    source/FrameContextRing.cpp -o FrameContextRingTest && ./FrameContextRingTest
+*/
+
+#include "FrameContextRing.h"
+
+#include <cstdio>
+#include <cstdlib>
+
+namespace
+{
+
+int g_failureCount = 0;
+
+void Check(bool condition, const char* message)
+{
+  if (!condition)
+  {
+    printf("FAILED: %s\n", message);
+    g_failureCount++;
+  }
+}
+
+/// Object released through DeferRelease, flagged while a frame executing on the GPU uses it
+struct TrackedObject : IUnknown
+{
+  TrackedObject(std::atomic<int>& inUse, std::atomic<bool>& released)
+      : m_inUse(inUse), m_released(released)
+  {
+  }
+  ~TrackedObject() override
+  {
+    Check(m_inUse == 0, "An object was released while a frame was using it");
+    m_released = true;
+  }
+
+  std::atomic<int>& m_inUse;
+  std::atomic<bool>& m_released;
+};
+
+//--------------------------------------------------------------------------------------------------
+//
+// Render frames with a GPU slower than the CPU, each frame checking on the GPU that its slot was
+// not overwritten by the CPU while it executes
+void TestFramesInFlight(ID3D12Device* device, ID3D12CommandQueue* queue)
+{
+  const uint32_t frameCount = 3;
+  const uint32_t renderedFrameCount = 60;
+
+  nv_helpers_dx12::FrameContextRing frameRing;
+  frameRing.Initialize(device, queue, frameCount);
+  queue->SetLatency(std::chrono::milliseconds(3));
+
+  // Per-frame resource, written by the CPU when the frame starts and read by the GPU
+  std::atomic<uint64_t> slotContents[frameCount] = {};
+  std::atomic<int> slotReaders[frameCount] = {};
+  std::atomic<int> overwriteCount{0};
+
+  std::vector<ID3D12CommandAllocator*> allocators;
+  std::vector<ID3D12GraphicsCommandList4*> commandLists;
+  for (uint32_t frame = 0; frame < renderedFrameCount; frame++)
+  {
+    frameRing.BeginFrame();
+    Check(frameRing.GetFrameFenceValue() - frameRing.GetCompletedFenceValue() <= frameCount,
+          "The CPU is more than the frame count ahead of the GPU");
+
+    const uint32_t slot = frameRing.GetFrameIndex();
+    if (slotReaders[slot] > 0)
+    {
+      overwriteCount++;
+    }
+    slotContents[slot] = frame;
+
+    ID3D12CommandAllocator* allocator = nullptr;
+    ID3D12GraphicsCommandList4* commandList = nullptr;
+    device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&allocator));
+    device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, allocator, nullptr,
+                              IID_PPV_ARGS(&commandList));
+    commandList->Record([&, slot, frame]() {
+      slotReaders[slot]++;
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      if (slotContents[slot] != frame)
+      {
+        overwriteCount++;
+      }
+      slotReaders[slot]--;
+    });
+    commandList->Close();
+    ID3D12CommandList* lists[] = {commandList};
+    queue->ExecuteCommandLists(1, lists);
+    allocators.push_back(allocator);
+    commandLists.push_back(commandList);
+    frameRing.EndFrame();
+  }
+  frameRing.WaitForIdle();
+
+  Check(overwriteCount == 0, "A slot was overwritten while a frame in flight was reading it");
+  Check(frameRing.GetStallCount() > 0, "The CPU never waited for the slower GPU");
+  Check(frameRing.GetCompletedFenceValue() >= renderedFrameCount,
+        "WaitForIdle returned before the frames completed");
+  for (size_t i = 0; i < commandLists.size(); i++)
+  {
+    commandLists[i]->Release();
+    allocators[i]->Release();
+  }
+  queue->SetLatency(std::chrono::milliseconds(0));
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// An object deferred during a frame is released once the GPU has completed that frame, and not
+// before
+void TestDeferRelease(ID3D12Device* device, ID3D12CommandQueue* queue)
+{
+  nv_helpers_dx12::FrameContextRing frameRing;
+  frameRing.Initialize(device, queue, 2);
+  queue->SetLatency(std::chrono::milliseconds(20));
+
+  std::atomic<int> inUse{0};
+  std::atomic<bool> released{false};
+  TrackedObject* object = new TrackedObject(inUse, released);
+
+  ID3D12CommandAllocator* allocator = nullptr;
+  ID3D12GraphicsCommandList4* commandList = nullptr;
+  device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&allocator));
+  device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, allocator, nullptr,
+                            IID_PPV_ARGS(&commandList));
+
+  // The frame uses the object on the GPU, while the CPU replaces it
+  frameRing.BeginFrame();
+  inUse++;
+  commandList->Record([&]() {
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    inUse--;
+  });
+  commandList->Close();
+  ID3D12CommandList* lists[] = {commandList};
+  queue->ExecuteCommandLists(1, lists);
+  frameRing.DeferRelease(object);
+  frameRing.EndFrame();
+
+  // The next frame starts while the previous one is still executing
+  frameRing.BeginFrame();
+  Check(!released, "The object was released while the frame using it was in flight");
+  frameRing.EndFrame();
+
+  frameRing.WaitForIdle();
+  Check(released, "The object was not released once the GPU was idle");
+
+  commandList->Release();
+  allocator->Release();
+  queue->SetLatency(std::chrono::milliseconds(0));
+}
+
+} // namespace
+
+int main()
+{
+  ID3D12Device* device = new ID3D12Device;
+  ID3D12CommandQueue* queue = nullptr;
+  D3D12_COMMAND_QUEUE_DESC queueDesc = {};
+  device->CreateCommandQueue(&queueDesc, IID_PPV_ARGS(&queue));
+
+  TestFramesInFlight(device, queue);
+  TestDeferRelease(device, queue);
+
+  queue->Release();
+  device->Release();
+  if (g_failureCount > 0)
+  {
+    return EXIT_FAILURE;
+  }
+  printf("FrameContextRing: all tests passed\n");
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,277 @@
+/*
+Test of the heap suballocators: the buddy allocator splitting and merging its free blocks, the
+alignment of the allocations, the host memory pages of HostHeapSuballocator, and the placed buffers
+of PlacedResourceAllocator against the software heaps of SoftwareD3D12, whose ranges are only
+reused once the fence value of the freed buffers has been reached.
+
+Build and run from the repository root, e.g.:
+g++ -std=c++20 -pthread -Itests/SoftwareD3D12 -Iinclude tests/HeapSuballocatorTest.cpp
+    source/HeapSuballocator.cpp source/PlacedResourceAllocator.cpp -o HeapSuballocatorTest &&
+    ./HeapSuballocatorTest
+*/
+
+#include "HeapSuballocator.h"
+#include "PlacedResourceAllocator.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+namespace
+{
+
+int g_failureCount = 0;
+
+void Check(bool condition, const char* message)
+{
+  if (!condition)
+  {
+    printf("FAILED: %s\n", message);
+    g_failureCount++;
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Allocations split the free blocks in halves, and freeing both halves merges them back
+void TestBuddySplitMerge()
+{
+  const uint64_t invalid = nv_helpers_dx12::BuddyAllocator::kInvalidOffset;
+  nv_helpers_dx12::BuddyAllocator buddy(1024, 64);
+
+  Check(buddy.Allocate(64, 1) == 0 && buddy.Allocate(64, 1) == 64,
+        "The smallest blocks were not split from the start of the range");
+  Check(buddy.Allocate(100, 1) == 128, "The size was not rounded up to the next block");
+  Check(buddy.Allocate(256, 1) == 256 && buddy.Allocate(512, 1) == 512,
+        "The larger blocks were not split in order");
+  Check(buddy.GetAllocatedSize() == 1024, "The allocated size is not the sum of the blocks");
+  Check(buddy.Allocate(64, 1) == invalid, "An allocation succeeded in a full range");
+
+  // The two halves of the first 128 bytes merge back once both are free
+  buddy.Free(64);
+  Check(buddy.Allocate(128, 1) == invalid, "A block was merged with an allocated buddy");
+  buddy.Free(0);
+  Check(buddy.Allocate(128, 1) == 0, "The free buddies were not merged");
+
+  buddy.Free(0);
+  buddy.Free(128);
+  buddy.Free(256);
+  buddy.Free(512);
+  Check(buddy.IsEmpty() && buddy.GetAllocatedSize() == 0, "The range is not empty once freed");
+  Check(buddy.Allocate(1024, 1) == 0, "The blocks were not merged back into the whole range");
+  Check(buddy.Allocate(1, 1) == invalid, "The whole range was allocated twice");
+
+  bool thrown = false;
+  try
+  {
+    buddy.Free(64);
+  }
+  catch (const std::logic_error&)
+  {
+    thrown = true;
+  }
+  Check(thrown, "Freeing an offset which was not allocated did not throw");
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Random allocations are aligned and never overlap, and freeing them in any order leaves the range
+// as a single free block
+void TestAlignment()
+{
+  struct Block
+  {
+    uint64_t offset;
+    uint64_t size;
+  };
+
+  const uint64_t capacity = 1 << 20;
+  nv_helpers_dx12::BuddyAllocator buddy(capacity, 256);
+  Check(buddy.GetBlockSize(16, 4096) == 4096, "The block size does not cover the alignment");
+  Check(buddy.Allocate(16, 4096) % 4096 == 0, "The allocation is not aligned");
+  buddy.Free(0);
+
+  std::mt19937 random(1);
+  std::vector<Block> blocks;
+  bool misaligned = false;
+  bool overlap = false;
+  for (int i = 0; i < 500; i++)
+  {
+    const uint64_t size = std::uniform_int_distribution<uint64_t>(1, 16 * 1024)(random);
+    const uint64_t alignment = 1ull << std::uniform_int_distribution<int>(0, 16)(random);
+    const uint64_t offset = buddy.Allocate(size, alignment);
+    if (offset == nv_helpers_dx12::BuddyAllocator::kInvalidOffset)
+    {
+      continue;
+    }
+    misaligned |= offset % alignment != 0 || offset + size > capacity;
+    for (const Block& block : blocks)
+    {
+      overlap |= offset < block.offset + block.size && block.offset < offset + size;
+    }
+    blocks.push_back({offset, size});
+  }
+  Check(!blocks.empty(), "No allocation succeeded");
+  Check(!misaligned, "An allocation was not aligned or exceeded the capacity");
+  Check(!overlap, "Two allocations overlapped");
+
+  std::shuffle(blocks.begin(), blocks.end(), random);
+  for (const Block& block : blocks)
+  {
+    buddy.Free(block.offset);
+  }
+  Check(buddy.IsEmpty() && buddy.Allocate(capacity, capacity) == 0,
+        "The range was not merged back once all the allocations were freed");
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// The pages are created when full and released when empty, and the addresses of the allocations
+// are aligned and do not overlap
+void TestHostHeapSuballocator()
+{
+  const uint64_t pageSize = 64 * 1024;
+  nv_helpers_dx12::HostHeapSuballocator heap(pageSize, 256);
+
+  std::vector<nv_helpers_dx12::HeapSuballocator::Allocation> allocations;
+  for (uint32_t i = 0; i < 6; i++)
+  {
+    allocations.push_back(heap.Allocate(20 * 1024, 1024));
+    memset(heap.GetAddress(allocations.back()), static_cast<int>(i), 20 * 1024);
+  }
+  Check(heap.GetPageCount() == 3, "Six 32 KB blocks do not take three 64 KB pages");
+  Check(heap.GetAllocatedSize() == 6 * 32 * 1024, "The allocated size is not the sum of blocks");
+
+  bool misaligned = false;
+  bool overwritten = false;
+  for (uint32_t i = 0; i < 6; i++)
+  {
+    const uint8_t* data = static_cast<const uint8_t*>(heap.GetAddress(allocations[i]));
+    misaligned |= reinterpret_cast<uintptr_t>(data) % 1024 != 0;
+    overwritten |= data[0] != i || data[20 * 1024 - 1] != i;
+  }
+  Check(!misaligned, "An address was not aligned");
+  Check(!overwritten, "An allocation was overwritten by another one");
+
+  // The empty page is released, and its slot reused by the next page
+  heap.Free(allocations[0]);
+  heap.Free(allocations[2]);
+  heap.ReleaseEmptyPages();
+  Check(heap.GetPageCount() == 3, "A page with allocations was released");
+  heap.Free(allocations[1]);
+  heap.ReleaseEmptyPages();
+  Check(heap.GetPageCount() == 2, "The empty page was not released");
+  nv_helpers_dx12::HeapSuballocator::Allocation allocation = heap.Allocate(pageSize, 1);
+  Check(allocation.page == 0 && heap.GetPageCount() == 3,
+        "The slot of the released page was not reused");
+
+  bool thrown = false;
+  try
+  {
+    heap.Allocate(pageSize + 1, 1);
+  }
+  catch (const std::logic_error&)
+  {
+    thrown = true;
+  }
+  Check(thrown, "An allocation larger than a page did not throw");
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Freed buffers keep their range until the GPU reaches their fence value. The software heaps fail
+// to place a buffer over a live one, so a range reused early makes CreateBuffer throw
+void TestPlacedResourceAllocator(ID3D12Device* device)
+{
+  const uint64_t heapSize = 1024 * 1024;
+  nv_helpers_dx12::PlacedResourceAllocator allocator;
+  allocator.Initialize(device, heapSize);
+
+  try
+  {
+    ID3D12Resource* first = allocator.CreateBuffer(100 * 1024, D3D12_RESOURCE_FLAG_NONE,
+                                                   D3D12_RESOURCE_STATE_COMMON,
+                                                   D3D12_HEAP_TYPE_DEFAULT);
+    ID3D12Resource* second = allocator.CreateBuffer(100 * 1024, D3D12_RESOURCE_FLAG_NONE,
+                                                    D3D12_RESOURCE_STATE_COMMON,
+                                                    D3D12_HEAP_TYPE_DEFAULT);
+    Check(first->heap != nullptr && first->heap == second->heap,
+          "The buffers were not placed in the same heap");
+    Check(first->heapOffset % D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT == 0 &&
+              second->heapOffset != first->heapOffset,
+          "The buffers were not placed at distinct aligned offsets");
+    Check(allocator.GetHeapCount() == 1 && allocator.GetPlacedBufferCount() == 2,
+          "The buffers were not counted");
+
+    // Keep the heap to inspect it once the allocator releases it
+    ID3D12Heap* heap = first->heap;
+    heap->AddRef();
+    const uint64_t firstOffset = first->heapOffset;
+
+    allocator.Free(first, 5);
+    allocator.Reclaim(4);
+    Check(heap->liveRanges.count(firstOffset) == 1, "A buffer was released before its fence");
+    ID3D12Resource* third = allocator.CreateBuffer(100 * 1024, D3D12_RESOURCE_FLAG_NONE,
+                                                   D3D12_RESOURCE_STATE_COMMON,
+                                                   D3D12_HEAP_TYPE_DEFAULT);
+    Check(third->heapOffset != firstOffset, "The range of a buffer in flight was reused");
+    allocator.Reclaim(5);
+    Check(heap->liveRanges.count(firstOffset) == 0, "The buffer was not released at its fence");
+    ID3D12Resource* fourth = allocator.CreateBuffer(100 * 1024, D3D12_RESOURCE_FLAG_NONE,
+                                                    D3D12_RESOURCE_STATE_COMMON,
+                                                    D3D12_HEAP_TYPE_DEFAULT);
+    Check(fourth->heapOffset == firstOffset, "The reclaimed range was not reused");
+
+    // A lower fence value freed later is clamped, as the frames complete in order
+    allocator.Free(second, 7);
+    allocator.Free(third, 6);
+    allocator.Reclaim(6);
+    Check(heap->liveRanges.size() == 3, "A buffer was released before the previous fence");
+    allocator.Reclaim(7);
+    Check(heap->liveRanges.size() == 1, "The buffers were not released at their fence");
+
+    // Buffers larger than the heaps are committed, and only released
+    ID3D12Resource* large = allocator.CreateBuffer(2 * heapSize, D3D12_RESOURCE_FLAG_NONE,
+                                                   D3D12_RESOURCE_STATE_COMMON,
+                                                   D3D12_HEAP_TYPE_DEFAULT);
+    Check(large->heap == nullptr && allocator.GetPlacedBufferCount() == 1,
+          "A buffer larger than the heaps was placed");
+    allocator.Free(large, 8);
+    allocator.Free(fourth, 8);
+    allocator.Reclaim(8);
+    Check(allocator.GetHeapCount() == 0 && allocator.GetPlacedBufferCount() == 0,
+          "The empty heap was not released");
+    Check(heap->liveRanges.empty() && heap->referenceCount == 1,
+          "The heap is still referenced once released");
+    heap->Release();
+  }
+  catch (const std::logic_error& error)
+  {
+    printf("FAILED: %s\n", error.what());
+    g_failureCount++;
+  }
+}
+
+} // namespace
+
+int main()
+{
+  TestBuddySplitMerge();
+  TestAlignment();
+  TestHostHeapSuballocator();
+
+  ID3D12Device* device = new ID3D12Device;
+  TestPlacedResourceAllocator(device);
+  device->Release();
+
+  if (g_failureCount > 0)
+  {
+    return EXIT_FAILURE;
+  }
+  printf("HeapSuballocator: all tests passed\n");
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,191 @@
+/*
+Test of the ParallelCommandRecorder with the CommandListPool, on the software queue of
+SoftwareD3D12. The test checks that the passes are submitted in the order they were added whatever
+the order in which they finish recording, that the worker threads are kept across frames, and that
+the command lists of a frame whose pass throws go back to the pool.
+
+Build and run from the repository root, e.g.:
+g++ -std=c++20 -pthread -Itests/SoftwareD3D12 -Iinclude tests/ParallelCommandRecorderTest.cpp
+    source/CommandListPool.cpp -o ParallelCommandRecorderTest && ./ParallelCommandRecorderTest
+*/
+
+#include "CommandListPool.h"
+#include "ParallelCommandRecorder.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <set>
+
+namespace
+{
+
+using Recorder = nv_helpers_dx12::ParallelCommandRecorder<ID3D12GraphicsCommandList4>;
+
+int g_failureCount = 0;
+
+void Check(bool condition, const char* message)
+{
+  if (!condition)
+  {
+    printf("FAILED: %s\n", message);
+    g_failureCount++;
+  }
+}
+
+/// Queue, fence and pool of the simulated frames
+struct FrameQueue
+{
+  FrameQueue()
+  {
+    device = new ID3D12Device;
+    D3D12_COMMAND_QUEUE_DESC queueDesc = {};
+    device->CreateCommandQueue(&queueDesc, IID_PPV_ARGS(&queue));
+    device->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&fence));
+    pool.Initialize(device, queue);
+  }
+  ~FrameQueue()
+  {
+    // The pool releases its command lists once destroyed, after the queue
+    WaitForIdle();
+    fence->Release();
+    queue->Release();
+    device->Release();
+  }
+
+  /// Submit the end of a frame, keeping at most 3 frames in flight
+  void EndFrame()
+  {
+    pool.FinishFrame(frameNumber);
+    queue->Signal(fence, frameNumber);
+    frameNumber++;
+    if (frameNumber > 3)
+    {
+      fence->WaitForValue(frameNumber - 3);
+    }
+    pool.Reclaim(fence->GetCompletedValue());
+  }
+  void WaitForIdle()
+  {
+    queue->Signal(fence, frameNumber);
+    fence->WaitForValue(frameNumber);
+    frameNumber++;
+  }
+
+  ID3D12Device* device = nullptr;
+  ID3D12CommandQueue* queue = nullptr;
+  ID3D12Fence* fence = nullptr;
+  nv_helpers_dx12::CommandListPool pool;
+  uint64_t frameNumber = 1;
+};
+
+//--------------------------------------------------------------------------------------------------
+//
+// The passes finish recording in random order, and must execute in the order they were added
+void TestSubmissionOrder()
+{
+  FrameQueue frameQueue;
+  Recorder recorder;
+  std::mt19937 random(1);
+  std::mutex executionMutex;
+  std::vector<uint32_t> executionOrder;
+  std::set<std::thread::id> recordingThreads;
+
+  for (uint32_t frame = 0; frame < 100; frame++)
+  {
+    // Alternates the parallel and the inline paths
+    const uint32_t passCount = 1 + random() % (2 * Recorder::kMinParallelPassCount);
+    for (uint32_t pass = 0; pass < passCount; pass++)
+    {
+      const uint32_t sleepMicroseconds = random() % 300;
+      recorder.AddPass([&, pass, sleepMicroseconds](ID3D12GraphicsCommandList4* commandList) {
+        {
+          std::lock_guard<std::mutex> lock(executionMutex);
+          recordingThreads.insert(std::this_thread::get_id());
+        }
+        std::this_thread::sleep_for(std::chrono::microseconds(sleepMicroseconds));
+        commandList->Record([&, pass]() {
+          std::lock_guard<std::mutex> lock(executionMutex);
+          executionOrder.push_back(pass);
+        });
+      });
+    }
+    recorder.Execute(frameQueue.pool, 4);
+    recorder.Clear();
+    frameQueue.EndFrame();
+
+    frameQueue.WaitForIdle();
+    std::lock_guard<std::mutex> lock(executionMutex);
+    bool inOrder = executionOrder.size() == passCount;
+    for (uint32_t i = 0; inOrder && i < passCount; i++)
+    {
+      inOrder = executionOrder[i] == i;
+    }
+    Check(inOrder, "The passes were not executed in the order they were added");
+    executionOrder.clear();
+  }
+
+  // The 4 workers are kept across the frames, along with the calling thread for the inline path
+  Check(recordingThreads.size() <= 5, "The worker threads were not reused across frames");
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// A pass throwing stops the frame, and its command lists are returned to the pool instead of
+// staying out of it forever
+void TestErrorReturnsCommandLists(uint32_t passCount)
+{
+  FrameQueue frameQueue;
+  Recorder recorder;
+  std::atomic<uint32_t> executedCount{0};
+
+  for (uint32_t frame = 0; frame < 50; frame++)
+  {
+    const uint32_t failingPass = frame % passCount;
+    for (uint32_t pass = 0; pass < passCount; pass++)
+    {
+      recorder.AddPass([&, pass, failingPass](ID3D12GraphicsCommandList4* commandList) {
+        if (pass == failingPass)
+        {
+          throw std::runtime_error("Pass failure");
+        }
+        commandList->Record([&]() { executedCount++; });
+      });
+    }
+    bool thrown = false;
+    try
+    {
+      recorder.Execute(frameQueue.pool, 4);
+    }
+    catch (const std::runtime_error&)
+    {
+      thrown = true;
+    }
+    recorder.Clear();
+    frameQueue.EndFrame();
+    Check(thrown, "The error of a pass was not rethrown");
+  }
+  frameQueue.WaitForIdle();
+
+  // Without the aborted lists going back to the pool, each frame would create new lists
+  Check(frameQueue.pool.GetCommandListCount() <= 4 * passCount,
+        "The command lists of the failed frames were not returned to the pool");
+  // Only the passes added before the failing one can have been submitted
+  Check(executedCount <= 50 * (passCount - 1), "A pass was submitted after a failed pass");
+}
+
+} // namespace
+
+int main()
+{
+  TestSubmissionOrder();
+  TestErrorReturnsCommandLists(3);
+  TestErrorReturnsCommandLists(2 * Recorder::kMinParallelPassCount);
+
+  if (g_failureCount > 0)
+  {
+    return EXIT_FAILURE;
+  }
+  printf("ParallelCommandRecorder: all tests passed\n");
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,226 @@
+/*
+Test of the ShaderCache on disk: a library is loaded from the cache by a new cache instance as long
+as its source, profile, arguments and included files are unchanged, and compiled again as soon as
+one of them changes, including when only the contents of an included file change.
+
+The test only uses the public API of the cache. It can be built against the software DXC of
+tests/SoftwareDXC, or against the DXC release for Linux by replacing -Itests/SoftwareDXC with the
+include directory of DXC and linking with -ldxcompiler.
+
+Build and run from the repository root, e.g.:
+g++ -std=c++20 -pthread -Itests/SoftwareDXC -Iinclude tests/ShaderCacheTest.cpp
+    source/ShaderCache.cpp source/MappedFile.cpp source/PosixPlatform.cpp -o ShaderCacheTest &&
+    ./ShaderCacheTest
+*/
+
+#include "ShaderCache.h"
+#include "MappedFile.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+namespace
+{
+
+int g_failureCount = 0;
+
+void Check(bool condition, const char* message)
+{
+  if (!condition)
+  {
+    printf("FAILED: %s\n", message);
+    g_failureCount++;
+  }
+}
+
+/// Write a test file, through the atomic writer so that the file is replaced as an editor would
+void WriteFile(const std::wstring& fileName, const char* contents)
+{
+  if (!nv_helpers_dx12::WriteFileAtomically(fileName, contents, strlen(contents)))
+  {
+    throw std::runtime_error("Cannot write a test file");
+  }
+}
+
+/// Contents of a compiled library
+std::string GetBytes(IDxcBlob* blob)
+{
+  std::string bytes(static_cast<const char*>(blob->GetBufferPointer()), blob->GetBufferSize());
+  blob->Release();
+  return bytes;
+}
+
+const char kCommon[] = "#define SCALE 1.0\n";
+
+const char kMiss[] = "#include \"Common.hlsli\"\n"
+                     "struct Payload { float4 color; };\n"
+                     "[shader(\"miss\")]\n"
+                     "void Miss(inout Payload payload)\n"
+                     "{\n"
+                     "  payload.color = float4(SCALE, 0, 0, 1);\n"
+                     "}\n";
+
+//--------------------------------------------------------------------------------------------------
+//
+// Each cache instance stands for a run of the application: the hits and misses are those of a warm
+// start with the files on disk as of the call
+void TestInvalidation(const std::wstring& root)
+{
+  const std::wstring cacheDirectory = root + L"cache";
+  const std::wstring shader = root + L"shaders/Miss.hlsl";
+  const std::wstring common = root + L"shaders/Common.hlsli";
+  FileSystem::CreateDirectories(root + L"shaders");
+  WriteFile(common, kCommon);
+  WriteFile(shader, kMiss);
+
+  // The first compilation is a miss, and stored
+  std::string library;
+  {
+    nv_helpers_dx12::ShaderCache cache;
+    cache.SetDirectory(cacheDirectory);
+    library = GetBytes(cache.CompileLibrary(shader));
+    Check(cache.GetMissCount() == 1 && cache.GetHitCount() == 0,
+          "The first compilation was not a miss");
+    std::vector<std::wstring> dependencies = cache.GetDependencies(shader);
+    Check(dependencies.size() == 2 && dependencies[0] == shader && dependencies[1] == common,
+          "The included file is not a dependency of the library");
+  }
+
+  // Unchanged source and includes hit, and return the stored library
+  {
+    nv_helpers_dx12::ShaderCache cache;
+    cache.SetDirectory(cacheDirectory);
+    Check(GetBytes(cache.CompileLibrary(shader)) == library,
+          "The cached library differs from the compiled one");
+    Check(cache.GetMissCount() == 0 && cache.GetHitCount() == 1,
+          "The unchanged library was not loaded from the cache");
+    Check(cache.GetDependencies(shader).size() == 2,
+          "The dependencies were not restored from the cache");
+  }
+
+  // Changing the arguments or the profile misses, while the previous variant is still cached
+  {
+    nv_helpers_dx12::ShaderCache cache;
+    cache.SetDirectory(cacheDirectory);
+    cache.CompileLibrary(shader, L"lib_6_3", {L"-DVARIANT=1"})->Release();
+    cache.CompileLibrary(shader, L"lib_6_5")->Release();
+    Check(cache.GetMissCount() == 2 && cache.GetHitCount() == 0,
+          "A change of the arguments or the profile hit the cache");
+    cache.CompileLibrary(shader, L"lib_6_3", {L"-DVARIANT=1"})->Release();
+    cache.CompileLibrary(shader)->Release();
+    Check(cache.GetMissCount() == 2 && cache.GetHitCount() == 2,
+          "The variants were not cached separately");
+  }
+
+  // Changing the source misses
+  {
+    WriteFile(shader, (std::string(kMiss) + "// edited\n").c_str());
+    nv_helpers_dx12::ShaderCache cache;
+    cache.SetDirectory(cacheDirectory);
+    cache.CompileLibrary(shader)->Release();
+    Check(cache.GetMissCount() == 1, "A modified source hit the cache");
+    WriteFile(shader, kMiss);
+  }
+
+  // Changing only the contents of the included file misses, even with the same size
+  {
+    nv_helpers_dx12::ShaderCache cache;
+    cache.SetDirectory(cacheDirectory);
+    cache.CompileLibrary(shader)->Release();
+    WriteFile(common, "#define SCALE 2.0\n");
+    Check(GetBytes(cache.CompileLibrary(shader)) != library,
+          "The library was not compiled again with the modified include");
+    Check(cache.GetMissCount() == 1 && cache.GetHitCount() == 1,
+          "A modified include hit the cache");
+    cache.CompileLibrary(shader)->Release();
+    Check(cache.GetHitCount() == 2,
+          "The library compiled with the modified include was not cached");
+  }
+
+  // A removed include misses, and the compilation error is reported
+  {
+    FileSystem::RemoveFile(common);
+    nv_helpers_dx12::ShaderCache cache;
+    cache.SetDirectory(cacheDirectory);
+    bool thrown = false;
+    try
+    {
+      cache.CompileLibrary(shader)->Release();
+    }
+    catch (const std::logic_error&)
+    {
+      thrown = true;
+    }
+    Check(thrown && cache.GetHitCount() == 0, "A library with a missing include hit the cache");
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Libraries compiled on several threads are stored and loaded like the others
+void TestAsync(const std::wstring& root)
+{
+  const std::wstring cacheDirectory = root + L"asynccache";
+  std::vector<std::wstring> shaders;
+  for (int i = 0; i < 4; i++)
+  {
+    shaders.push_back(root + L"shaders/Async" + std::to_wstring(i) + L".hlsl");
+    WriteFile(shaders.back(), ("// library " + std::to_string(i) + "\n").c_str());
+  }
+
+  for (uint32_t run = 0; run < 2; run++)
+  {
+    nv_helpers_dx12::ShaderCache cache;
+    cache.SetDirectory(cacheDirectory);
+    std::vector<std::future<IDxcBlob*>> libraries;
+    for (const std::wstring& shader : shaders)
+    {
+      libraries.push_back(cache.CompileLibraryAsync(shader));
+    }
+    for (std::future<IDxcBlob*>& library : libraries)
+    {
+      library.get()->Release();
+    }
+    Check(run == 0 ? cache.GetMissCount() == 4 : cache.GetHitCount() == 4,
+          "The libraries compiled concurrently were not cached");
+  }
+}
+
+} // namespace
+
+int main()
+{
+  char rootTemplate[] = "/tmp/ShaderCacheTestXXXXXX";
+  if (mkdtemp(rootTemplate) == nullptr)
+  {
+    printf("FAILED: cannot create the temporary directory\n");
+    return EXIT_FAILURE;
+  }
+  const std::wstring root = std::wstring(rootTemplate, rootTemplate + strlen(rootTemplate)) + L"/";
+
+  try
+  {
+    TestInvalidation(root);
+    TestAsync(root);
+  }
+  catch (const std::exception& error)
+  {
+    printf("FAILED: %s\n", error.what());
+    g_failureCount++;
+  }
+
+  std::string removeCommand = std::string("rm -rf ") + rootTemplate;
+  if (system(removeCommand.c_str()) != 0)
+  {
+    printf("Cannot remove %s\n", rootTemplate);
+  }
+  if (g_failureCount > 0)
+  {
+    return EXIT_FAILURE;
+  }
+  printf("ShaderCache: all tests passed\n");
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,437 @@
+/*
+Software stand-in for the D3D12 queues, fences, command allocators, command lists, buffers and
+heaps, used to test the frame synchronization helpers (FrameContextRing, AsyncBuildQueue,
+CommandListPool) and the memory allocators (UploadRingAllocator, PlacedResourceAllocator) without a
+GPU. Each queue is a thread executing its submissions in order, after a configurable latency which
+simulates a GPU running behind the CPU. Fences are shared between queues, and a queue waiting on a
+fence blocks until another queue signals it, as on the GPU.
+
+Command lists record std::function objects instead of GPU commands: they run on the queue thread
+when the list is executed, and let the tests check which data the simulated GPU accesses, and when.
+
+Buffers are backed by host memory, their GPU virtual address being the address of that memory.
+Placed buffers keep a reference on their heap, and the heap tracks the ranges of its live buffers.
+
+The stand-in enforces the rules of the API which the helpers rely on: an allocator cannot be reset
+while one of its command lists is executing, a command list cannot be reset while it is open, and
+only closed command lists can be executed. The first two return E_FAIL like D3D12, the last one
+throws std::logic_error. Placing a buffer over the range of a live buffer of the same heap also
+returns E_FAIL: D3D12 allows aliasing, but the allocators never rely on it.
+
+Example:
+
+ID3D12Device* device = new ID3D12Device;
+ID3D12CommandQueue* queue = nullptr;
+D3D12_COMMAND_QUEUE_DESC queueDesc = {};
+device->CreateCommandQueue(&queueDesc, IID_PPV_ARGS(&queue));
+queue->SetLatency(std::chrono::milliseconds(5));
+
+commandList->Record([&]() { CheckResource(...); });
+commandList->Close();
+queue->ExecuteCommandLists(1, lists);
+
+*/
+
+#pragma once
+
+#include "windows.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+enum D3D12_COMMAND_LIST_TYPE
+{
+  D3D12_COMMAND_LIST_TYPE_DIRECT = 0,
+  D3D12_COMMAND_LIST_TYPE_COMPUTE = 2,
+};
+enum D3D12_FENCE_FLAGS
+{
+  D3D12_FENCE_FLAG_NONE = 0,
+};
+enum D3D12_COMMAND_QUEUE_FLAGS
+{
+  D3D12_COMMAND_QUEUE_FLAG_NONE = 0,
+};
+struct D3D12_COMMAND_QUEUE_DESC
+{
+  D3D12_COMMAND_LIST_TYPE Type;
+  int Priority;
+  D3D12_COMMAND_QUEUE_FLAGS Flags;
+  UINT NodeMask;
+};
+
+typedef UINT64 D3D12_GPU_VIRTUAL_ADDRESS;
+#define D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT 256
+#define D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT 65536
+
+enum D3D12_HEAP_TYPE
+{
+  D3D12_HEAP_TYPE_DEFAULT = 1,
+  D3D12_HEAP_TYPE_UPLOAD = 2,
+  D3D12_HEAP_TYPE_READBACK = 3,
+};
+enum D3D12_HEAP_FLAGS
+{
+  D3D12_HEAP_FLAG_NONE = 0,
+  D3D12_HEAP_FLAG_ALLOW_ONLY_BUFFERS = 0xc0,
+};
+enum D3D12_RESOURCE_FLAGS
+{
+  D3D12_RESOURCE_FLAG_NONE = 0,
+  D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS = 0x4,
+};
+enum D3D12_RESOURCE_STATES
+{
+  D3D12_RESOURCE_STATE_COMMON = 0,
+  D3D12_RESOURCE_STATE_UNORDERED_ACCESS = 0x8,
+  D3D12_RESOURCE_STATE_GENERIC_READ = 0xac3,
+};
+struct D3D12_HEAP_PROPERTIES
+{
+  D3D12_HEAP_TYPE Type;
+};
+struct D3D12_HEAP_DESC
+{
+  UINT64 SizeInBytes;
+  D3D12_HEAP_PROPERTIES Properties;
+  UINT64 Alignment;
+  D3D12_HEAP_FLAGS Flags;
+};
+/// Only buffers are supported, the fields of the textures are omitted
+struct D3D12_RESOURCE_DESC
+{
+  UINT64 Alignment;
+  UINT64 Width;
+  D3D12_RESOURCE_FLAGS Flags;
+};
+struct D3D12_RESOURCE_ALLOCATION_INFO
+{
+  UINT64 SizeInBytes;
+  UINT64 Alignment;
+};
+struct D3D12_RANGE
+{
+  size_t Begin;
+  size_t End;
+};
+
+/// Fence whose value is raised by the queues, and waited upon by the CPU and the other queues
+struct ID3D12Fence : IUnknown
+{
+  UINT64 GetCompletedValue()
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    return completedValue;
+  }
+  HRESULT SetEventOnCompletion(UINT64 value, HANDLE event)
+  {
+    event->fence = this;
+    event->value = value;
+    return S_OK;
+  }
+
+  /// Raise the value, called from a queue thread
+  void SetValue(UINT64 value)
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      completedValue = value > completedValue ? value : completedValue;
+    }
+    condition.notify_all();
+  }
+  /// Block the calling thread until the fence has reached the value
+  void WaitForValue(UINT64 value)
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    condition.wait(lock, [&]() { return completedValue >= value; });
+  }
+
+  std::mutex mutex;
+  std::condition_variable condition;
+  UINT64 completedValue = 0;
+};
+
+inline unsigned long WaitForSingleObject(HANDLE handle, unsigned long)
+{
+  handle->fence->WaitForValue(handle->value);
+  return 0;
+}
+
+/// Allocator backing the commands of its lists, which cannot be reset while they execute
+struct ID3D12CommandAllocator : IUnknown
+{
+  HRESULT Reset() { return executingListCount > 0 ? E_FAIL : S_OK; }
+
+  std::atomic<int> executingListCount{0};
+};
+
+/// Operation executed by the simulated GPU
+typedef std::function<void()> SoftwareCommand;
+
+struct ID3D12CommandList : IUnknown
+{
+  std::vector<SoftwareCommand> commands;
+  ID3D12CommandAllocator* allocator = nullptr;
+  bool open = false;
+};
+
+struct ID3D12GraphicsCommandList : ID3D12CommandList
+{
+  HRESULT Reset(ID3D12CommandAllocator* commandAllocator, void*)
+  {
+    if (open)
+    {
+      return E_FAIL;
+    }
+    allocator = commandAllocator;
+    commands.clear();
+    open = true;
+    return S_OK;
+  }
+  HRESULT Close()
+  {
+    if (!open)
+    {
+      return E_FAIL;
+    }
+    open = false;
+    return S_OK;
+  }
+
+  /// Record an operation, run on the queue thread when the list is executed
+  void Record(SoftwareCommand command) { commands.push_back(std::move(command)); }
+};
+
+struct ID3D12GraphicsCommandList4 : ID3D12GraphicsCommandList
+{
+};
+
+/// Queue executing its submissions in order on its own thread
+struct ID3D12CommandQueue : IUnknown
+{
+  ID3D12CommandQueue() : thread(&ID3D12CommandQueue::Run, this) {}
+  ~ID3D12CommandQueue() override
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stopping = true;
+    }
+    condition.notify_all();
+    thread.join();
+  }
+
+  void ExecuteCommandLists(UINT count, ID3D12CommandList* const* commandLists)
+  {
+    for (UINT i = 0; i < count; i++)
+    {
+      ID3D12CommandList* commandList = commandLists[i];
+      if (commandList->open)
+      {
+        throw std::logic_error("Executing a command list which is not closed");
+      }
+      ID3D12CommandAllocator* allocator = commandList->allocator;
+      allocator->executingListCount++;
+      std::vector<SoftwareCommand> commands = commandList->commands;
+      Push([this, allocator, commands]() {
+        std::this_thread::sleep_for(latency.load());
+        for (const SoftwareCommand& command : commands)
+        {
+          command();
+        }
+        allocator->executingListCount--;
+      });
+    }
+  }
+  HRESULT Signal(ID3D12Fence* fence, UINT64 value)
+  {
+    Push([fence, value]() { fence->SetValue(value); });
+    return S_OK;
+  }
+  HRESULT Wait(ID3D12Fence* fence, UINT64 value)
+  {
+    Push([fence, value]() { fence->WaitForValue(value); });
+    return S_OK;
+  }
+
+  /// Time spent by the simulated GPU before executing each command list
+  void SetLatency(std::chrono::milliseconds value) { latency = value; }
+
+  void Push(SoftwareCommand command)
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      pending.push_back(std::move(command));
+    }
+    condition.notify_all();
+  }
+  /// Execute the submissions in order, until the queue is destroyed
+  void Run()
+  {
+    for (;;)
+    {
+      SoftwareCommand command;
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        condition.wait(lock, [this]() { return stopping || !pending.empty(); });
+        if (pending.empty())
+        {
+          return;
+        }
+        command = std::move(pending.front());
+        pending.pop_front();
+      }
+      command();
+    }
+  }
+
+  std::mutex mutex;
+  std::condition_variable condition;
+  std::deque<SoftwareCommand> pending;
+  std::atomic<std::chrono::milliseconds> latency{std::chrono::milliseconds(0)};
+  bool stopping = false;
+  std::thread thread;
+};
+
+/// Heap whose ranges are bound to placed buffers
+struct ID3D12Heap : IUnknown
+{
+  /// Bind a range to a buffer, failing if it overlaps the range of a live buffer
+  bool Place(UINT64 offset, UINT64 size)
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (offset + size > desc.SizeInBytes || offset % desc.Alignment != 0)
+    {
+      return false;
+    }
+    auto next = liveRanges.lower_bound(offset);
+    if (next != liveRanges.end() && next->first < offset + size)
+    {
+      return false;
+    }
+    if (next != liveRanges.begin() && std::prev(next)->second > offset)
+    {
+      return false;
+    }
+    liveRanges[offset] = offset + size;
+    return true;
+  }
+  void Unplace(UINT64 offset)
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    liveRanges.erase(offset);
+  }
+
+  D3D12_HEAP_DESC desc = {};
+  std::mutex mutex;
+  /// End of the range of each live buffer, by offset
+  std::map<UINT64, UINT64> liveRanges;
+};
+
+/// Buffer backed by host memory, either committed or placed in a heap
+struct ID3D12Resource : IUnknown
+{
+  ~ID3D12Resource() override
+  {
+    if (heap)
+    {
+      heap->Unplace(heapOffset);
+      heap->Release();
+    }
+  }
+
+  HRESULT Map(UINT, const D3D12_RANGE*, void** ppData)
+  {
+    *ppData = memory.data();
+    return S_OK;
+  }
+  void Unmap(UINT, const D3D12_RANGE*) {}
+  D3D12_GPU_VIRTUAL_ADDRESS GetGPUVirtualAddress()
+  {
+    return reinterpret_cast<D3D12_GPU_VIRTUAL_ADDRESS>(memory.data());
+  }
+
+  D3D12_RESOURCE_DESC desc = {};
+  std::vector<uint8_t> memory;
+  /// Heap of a placed buffer, with a reference held by the buffer
+  ID3D12Heap* heap = nullptr;
+  UINT64 heapOffset = 0;
+};
+
+struct ID3D12Device : IUnknown
+{
+  /// Buffers are 64 KB aligned, and their size rounded up to the alignment
+  D3D12_RESOURCE_ALLOCATION_INFO GetResourceAllocationInfo(UINT, UINT,
+                                                           const D3D12_RESOURCE_DESC* desc)
+  {
+    const UINT64 alignment = D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT;
+    return {(desc->Width + alignment - 1) / alignment * alignment, alignment};
+  }
+  HRESULT CreateCommittedResource(const D3D12_HEAP_PROPERTIES*, D3D12_HEAP_FLAGS,
+                                  const D3D12_RESOURCE_DESC* desc, D3D12_RESOURCE_STATES,
+                                  const void*, GUID, void** ppResource)
+  {
+    ID3D12Resource* resource = new ID3D12Resource;
+    resource->desc = *desc;
+    resource->memory.resize(desc->Width);
+    *ppResource = resource;
+    return S_OK;
+  }
+  HRESULT CreateHeap(const D3D12_HEAP_DESC* desc, GUID, void** ppHeap)
+  {
+    ID3D12Heap* heap = new ID3D12Heap;
+    heap->desc = *desc;
+    *ppHeap = heap;
+    return S_OK;
+  }
+  HRESULT CreatePlacedResource(ID3D12Heap* heap, UINT64 offset, const D3D12_RESOURCE_DESC* desc,
+                               D3D12_RESOURCE_STATES, const void*, GUID, void** ppResource)
+  {
+    if (!heap->Place(offset, desc->Width))
+    {
+      return E_FAIL;
+    }
+    ID3D12Resource* resource = new ID3D12Resource;
+    resource->desc = *desc;
+    resource->memory.resize(desc->Width);
+    resource->heap = heap;
+    resource->heapOffset = offset;
+    heap->AddRef();
+    *ppResource = resource;
+    return S_OK;
+  }
+
+  HRESULT CreateCommandQueue(const D3D12_COMMAND_QUEUE_DESC*, GUID, void** ppQueue)
+  {
+    *ppQueue = new ID3D12CommandQueue;
+    return S_OK;
+  }
+  HRESULT CreateFence(UINT64 initialValue, D3D12_FENCE_FLAGS, GUID, void** ppFence)
+  {
+    ID3D12Fence* fence = new ID3D12Fence;
+    fence->completedValue = initialValue;
+    *ppFence = fence;
+    return S_OK;
+  }
+  HRESULT CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE, GUID, void** ppAllocator)
+  {
+    *ppAllocator = new ID3D12CommandAllocator;
+    return S_OK;
+  }
+  /// Like D3D12, the command list is created open
+  HRESULT CreateCommandList(UINT, D3D12_COMMAND_LIST_TYPE, ID3D12CommandAllocator* allocator,
+                            void*, GUID, void** ppCommandList)
+  {
+    ID3D12GraphicsCommandList4* commandList = new ID3D12GraphicsCommandList4;
+    commandList->Reset(allocator, nullptr);
+    *ppCommandList = commandList;
+    return S_OK;
+  }
+};
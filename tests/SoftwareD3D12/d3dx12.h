@@ -0,0 +1,36 @@
+/*
+Minimal stand-in for the helper structures of d3dx12.h used by the memory allocators, so that they
+can be tested without a GPU. See d3d12.h in this directory for an overview.
+*/
+
+#pragma once
+
+#include "d3d12.h"
+
+struct CD3DX12_HEAP_PROPERTIES : D3D12_HEAP_PROPERTIES
+{
+  explicit CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE type) { Type = type; }
+};
+
+struct CD3DX12_RESOURCE_DESC : D3D12_RESOURCE_DESC
+{
+  static CD3DX12_RESOURCE_DESC Buffer(UINT64 width,
+                                      D3D12_RESOURCE_FLAGS flags = D3D12_RESOURCE_FLAG_NONE,
+                                      UINT64 alignment = 0)
+  {
+    CD3DX12_RESOURCE_DESC desc;
+    desc.Alignment = alignment;
+    desc.Width = width;
+    desc.Flags = flags;
+    return desc;
+  }
+};
+
+struct CD3DX12_RANGE : D3D12_RANGE
+{
+  CD3DX12_RANGE(size_t begin, size_t end)
+  {
+    Begin = begin;
+    End = end;
+  }
+};
@@ -0,0 +1,71 @@
+/*
+Minimal stand-in for the parts of windows.h used by the frame synchronization helpers, so that they
+can be tested without a GPU. See d3d12.h in this directory for an overview.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+typedef long HRESULT;
+typedef unsigned int UINT;
+typedef uint64_t UINT64;
+typedef int BOOL;
+
+#define S_OK 0
+#define E_FAIL (-1)
+#define E_INVALIDARG (-2)
+#define SUCCEEDED(hr) ((hr) >= 0)
+#define FAILED(hr) ((hr) < 0)
+#define FALSE 0
+#define TRUE 1
+#define INFINITE 0xFFFFFFFF
+
+/// Interface identifiers are not checked by the stand-in
+struct GUID
+{
+};
+#define IID_PPV_ARGS(ppObject) GUID{}, reinterpret_cast<void**>(ppObject)
+
+/// Reference counted object. The count can be read by the tests to check the releases
+struct IUnknown
+{
+  virtual ~IUnknown() = default;
+  UINT AddRef() { return ++referenceCount; }
+  UINT Release()
+  {
+    UINT count = --referenceCount;
+    if (count == 0)
+    {
+      delete this;
+    }
+    return count;
+  }
+
+  std::atomic<UINT> referenceCount{1};
+};
+
+struct ID3D12Fence;
+
+/// Event set when a fence reaches a value, see ID3D12Fence::SetEventOnCompletion
+struct SoftwareEvent
+{
+  ID3D12Fence* fence = nullptr;
+  UINT64 value = 0;
+};
+typedef SoftwareEvent* HANDLE;
+
+inline HANDLE CreateEvent(void*, BOOL, BOOL, const wchar_t*)
+{
+  return new SoftwareEvent;
+}
+
+inline BOOL CloseHandle(HANDLE handle)
+{
+  delete handle;
+  return TRUE;
+}
+
+/// Defined in d3d12.h, as it blocks on the fence of the event
+inline unsigned long WaitForSingleObject(HANDLE handle, unsigned long milliseconds);
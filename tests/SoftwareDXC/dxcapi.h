@@ -0,0 +1,266 @@
+/*
+Software stand-in for the parts of the DXC API used by the ShaderCache, so that the cache can be
+tested without the compiler. The tests only use the public ShaderCache API, and can be built
+against the real DXC release for Linux instead of this directory.
+
+The "compiled" library is the text of the source prefixed by the target profile and the arguments,
+with each #include "name" line replaced by the contents of the file loaded through the include
+handler. As with DXC, the include names are resolved relative to the directory of the source file.
+A source containing #error fails to compile, with the line in the error buffer.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+typedef long HRESULT;
+typedef unsigned long ULONG;
+typedef uint32_t UINT32;
+typedef const wchar_t* LPCWSTR;
+
+#define S_OK 0
+#define E_FAIL (-1)
+#define E_NOINTERFACE (-3)
+#define SUCCEEDED(hr) ((hr) >= 0)
+#define FAILED(hr) ((hr) < 0)
+#define STDMETHODCALLTYPE
+
+/// Interface identifier, declared by each interface as its kIid member
+struct IID
+{
+  uint32_t value;
+  bool operator==(const IID& other) const { return value == other.value; }
+};
+typedef const IID& REFIID;
+#define __uuidof(type) (type::kIid)
+#define IID_PPV_ARGS(ppObject)                                                                     \
+  std::remove_reference_t<decltype(**(ppObject))>::kIid, reinterpret_cast<void**>(ppObject)
+
+struct IUnknown
+{
+  static constexpr IID kIid = {0};
+  virtual ~IUnknown() = default;
+  virtual HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void** ppvObject) = 0;
+  virtual ULONG STDMETHODCALLTYPE AddRef() = 0;
+  virtual ULONG STDMETHODCALLTYPE Release() = 0;
+};
+
+/// Reference counting of the objects created by the stand-in
+template <typename Interface>
+struct SoftwareObject : Interface
+{
+  HRESULT STDMETHODCALLTYPE QueryInterface(REFIID, void** ppvObject) override
+  {
+    *ppvObject = nullptr;
+    return E_NOINTERFACE;
+  }
+  ULONG STDMETHODCALLTYPE AddRef() override { return ++referenceCount; }
+  ULONG STDMETHODCALLTYPE Release() override
+  {
+    ULONG count = --referenceCount;
+    if (count == 0)
+    {
+      delete this;
+    }
+    return count;
+  }
+
+  std::atomic<ULONG> referenceCount{1};
+};
+
+struct IDxcBlob : IUnknown
+{
+  static constexpr IID kIid = {1};
+  virtual void* STDMETHODCALLTYPE GetBufferPointer() = 0;
+  virtual size_t STDMETHODCALLTYPE GetBufferSize() = 0;
+};
+
+struct IDxcBlobEncoding : IDxcBlob
+{
+  static constexpr IID kIid = {2};
+};
+
+struct IDxcIncludeHandler : IUnknown
+{
+  static constexpr IID kIid = {3};
+  virtual HRESULT STDMETHODCALLTYPE LoadSource(LPCWSTR pFilename, IDxcBlob** ppIncludeSource) = 0;
+};
+
+/// Blob owning a copy of its data
+struct SoftwareBlob : SoftwareObject<IDxcBlobEncoding>
+{
+  SoftwareBlob(const void* data, size_t size)
+      : bytes(static_cast<const char*>(data), static_cast<const char*>(data) + size)
+  {
+  }
+  void* STDMETHODCALLTYPE GetBufferPointer() override { return bytes.data(); }
+  size_t STDMETHODCALLTYPE GetBufferSize() override { return bytes.size(); }
+
+  std::vector<char> bytes;
+};
+
+/// Path of the file system from the UTF-32 wide strings of the stand-in
+inline std::filesystem::path ToSoftwarePath(const std::wstring& path)
+{
+  return std::filesystem::path(std::u32string(path.begin(), path.end()));
+}
+
+/// Include handler loading the files from the disk
+struct SoftwareIncludeHandler : SoftwareObject<IDxcIncludeHandler>
+{
+  HRESULT STDMETHODCALLTYPE LoadSource(LPCWSTR pFilename, IDxcBlob** ppIncludeSource) override
+  {
+    std::ifstream file(ToSoftwarePath(pFilename), std::ios::binary);
+    if (!file)
+    {
+      *ppIncludeSource = nullptr;
+      return E_FAIL;
+    }
+    std::string contents((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    *ppIncludeSource = new SoftwareBlob(contents.data(), contents.size());
+    return S_OK;
+  }
+};
+
+struct IDxcOperationResult : IUnknown
+{
+  static constexpr IID kIid = {4};
+  virtual HRESULT STDMETHODCALLTYPE GetStatus(HRESULT* pStatus) = 0;
+  virtual HRESULT STDMETHODCALLTYPE GetResult(IDxcBlob** pResult) = 0;
+  virtual HRESULT STDMETHODCALLTYPE GetErrorBuffer(IDxcBlobEncoding** pErrors) = 0;
+};
+
+/// Result of a compilation, holding either the library or the error message
+struct SoftwareOperationResult : SoftwareObject<IDxcOperationResult>
+{
+  HRESULT STDMETHODCALLTYPE GetStatus(HRESULT* pStatus) override
+  {
+    *pStatus = status;
+    return S_OK;
+  }
+  HRESULT STDMETHODCALLTYPE GetResult(IDxcBlob** pResult) override
+  {
+    *pResult = SUCCEEDED(status) ? new SoftwareBlob(output.data(), output.size()) : nullptr;
+    return S_OK;
+  }
+  HRESULT STDMETHODCALLTYPE GetErrorBuffer(IDxcBlobEncoding** pErrors) override
+  {
+    *pErrors = FAILED(status) ? new SoftwareBlob(output.data(), output.size()) : nullptr;
+    return S_OK;
+  }
+
+  HRESULT status = S_OK;
+  std::string output;
+};
+
+struct DxcDefine;
+
+struct IDxcCompiler : SoftwareObject<IUnknown>
+{
+  static constexpr IID kIid = {5};
+
+  HRESULT Compile(IDxcBlob* pSource, LPCWSTR pSourceName, LPCWSTR, LPCWSTR pTargetProfile,
+                  LPCWSTR* pArguments, UINT32 argCount, const DxcDefine*, UINT32,
+                  IDxcIncludeHandler* pIncludeHandler, IDxcOperationResult** ppResult)
+  {
+    SoftwareOperationResult* result = new SoftwareOperationResult;
+    *ppResult = result;
+
+    std::wstring header = std::wstring(pTargetProfile);
+    for (UINT32 i = 0; i < argCount; i++)
+    {
+      header += L' ' + std::wstring(pArguments[i]);
+    }
+    result->output.assign(header.begin(), header.end());
+    result->output += '\n';
+
+    const std::filesystem::path directory = ToSoftwarePath(pSourceName).parent_path();
+    const std::string source(static_cast<const char*>(pSource->GetBufferPointer()),
+                             pSource->GetBufferSize());
+    size_t lineStart = 0;
+    while (lineStart < source.size())
+    {
+      size_t lineEnd = source.find('\n', lineStart);
+      lineEnd = lineEnd == std::string::npos ? source.size() : lineEnd + 1;
+      const std::string line = source.substr(lineStart, lineEnd - lineStart);
+      lineStart = lineEnd;
+
+      if (line.compare(0, 6, "#error") == 0)
+      {
+        result->status = E_FAIL;
+        result->output = line;
+        return S_OK;
+      }
+      if (line.compare(0, 10, "#include \"") != 0)
+      {
+        result->output += line;
+        continue;
+      }
+      const std::string name = line.substr(10, line.find('"', 10) - 10);
+      const std::u32string path = (directory / name).u32string();
+      IDxcBlob* include = nullptr;
+      if (FAILED(pIncludeHandler->LoadSource(std::wstring(path.begin(), path.end()).c_str(),
+                                             &include)))
+      {
+        result->status = E_FAIL;
+        result->output = "cannot open include file " + name;
+        return S_OK;
+      }
+      result->output.append(static_cast<const char*>(include->GetBufferPointer()),
+                            include->GetBufferSize());
+      include->Release();
+    }
+    return S_OK;
+  }
+};
+
+struct IDxcLibrary : SoftwareObject<IUnknown>
+{
+  static constexpr IID kIid = {6};
+
+  HRESULT CreateBlobWithEncodingFromPinned(const void* pText, UINT32 size, UINT32,
+                                           IDxcBlobEncoding** pBlobEncoding)
+  {
+    *pBlobEncoding = new SoftwareBlob(pText, size);
+    return S_OK;
+  }
+  HRESULT CreateBlobWithEncodingOnHeapCopy(const void* pText, UINT32 size, UINT32,
+                                           IDxcBlobEncoding** pBlobEncoding)
+  {
+    *pBlobEncoding = new SoftwareBlob(pText, size);
+    return S_OK;
+  }
+  HRESULT CreateIncludeHandler(IDxcIncludeHandler** ppResult)
+  {
+    *ppResult = new SoftwareIncludeHandler;
+    return S_OK;
+  }
+};
+
+/// Class identifiers of the objects created by DxcCreateInstance
+static constexpr IID CLSID_DxcCompiler = {100};
+static constexpr IID CLSID_DxcLibrary = {101};
+
+inline HRESULT DxcCreateInstance(REFIID rclsid, REFIID, void** ppv)
+{
+  if (rclsid == CLSID_DxcCompiler)
+  {
+    *ppv = static_cast<IDxcCompiler*>(new IDxcCompiler);
+    return S_OK;
+  }
+  if (rclsid == CLSID_DxcLibrary)
+  {
+    *ppv = static_cast<IDxcLibrary*>(new IDxcLibrary);
+    return S_OK;
+  }
+  *ppv = nullptr;
+  return E_FAIL;
+}
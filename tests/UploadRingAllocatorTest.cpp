@@ -0,0 +1,161 @@
+/*
+Test of the UploadRingAllocator against the software buffers of SoftwareD3D12. Frames of random
+allocations are made while older frames are still in flight: the test checks that the allocations
+are aligned, never straddle the end of the buffer and never overlap the allocations of a frame
+which has not been reclaimed yet. The capacities are not powers of two, so that wrapping around
+the end of the buffer does not rely on a power-of-two rounding.
+
+Build and run from the repository root, e.g.:
+g++ -std=c++20 -pthread -Itests/SoftwareD3D12 -Iinclude tests/UploadRingAllocatorTest.cpp
+    source/UploadRingAllocator.cpp -o UploadRingAllocatorTest && ./UploadRingAllocatorTest
+*/
+
+#include "UploadRingAllocator.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+namespace
+{
+
+int g_failureCount = 0;
+
+void Check(bool condition, const char* message)
+{
+  if (!condition)
+  {
+    printf("FAILED: %s\n", message);
+    g_failureCount++;
+  }
+}
+
+bool Allocates(nv_helpers_dx12::UploadRingAllocator& ring, uint64_t size,
+               nv_helpers_dx12::UploadRingAllocator::Allocation& allocation)
+{
+  try
+  {
+    allocation = ring.Allocate(size);
+    return true;
+  }
+  catch (const std::logic_error&)
+  {
+    return false;
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// An allocation which does not fit before the end of the buffer starts at its beginning, once the
+// frame using it has been reclaimed
+void TestWrapAround(ID3D12Device* device)
+{
+  nv_helpers_dx12::UploadRingAllocator ring;
+  ring.Initialize(device, 3 * 64 * 1024);
+  Check(ring.GetCapacity() == 3 * 64 * 1024, "The capacity was changed");
+
+  nv_helpers_dx12::UploadRingAllocator::Allocation allocation;
+  Check(Allocates(ring, 128 * 1024 + 256, allocation) && allocation.offset == 0,
+        "The first allocation does not start the buffer");
+  ring.FinishFrame(1);
+  ring.Reclaim(1);
+
+  Check(Allocates(ring, 80 * 1024, allocation), "The ring was full after wrapping around");
+  Check(allocation.offset == 0, "The wrapped allocation does not start the buffer");
+  Check(static_cast<uint8_t*>(allocation.cpuAddress) - allocation.offset ==
+            allocation.resource->memory.data(),
+        "The CPU address does not match the offset");
+  Check(allocation.gpuAddress - allocation.offset == allocation.resource->GetGPUVirtualAddress(),
+        "The GPU address does not match the offset");
+
+  // The frame in flight keeps its allocation until reclaimed
+  ring.FinishFrame(2);
+  Check(!Allocates(ring, 96 * 1024, allocation), "An allocation overlapped a frame in flight");
+  ring.Reclaim(2);
+  Check(Allocates(ring, 96 * 1024, allocation) && allocation.offset == 80 * 1024,
+        "The reclaimed space was not reused");
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Random allocations over many frames, with a few frames in flight
+void TestFramesInFlight(ID3D12Device* device, uint64_t capacity)
+{
+  struct Range
+  {
+    uint64_t begin;
+    uint64_t end;
+  };
+
+  const uint64_t framesInFlight = 3;
+  nv_helpers_dx12::UploadRingAllocator ring;
+  ring.Initialize(device, capacity);
+
+  std::mt19937 random(static_cast<uint32_t>(capacity));
+  std::uniform_int_distribution<uint64_t> sizes(1, ring.GetCapacity() / 16);
+  std::vector<std::vector<Range>> frames;
+  bool overlap = false;
+  bool straddle = false;
+  bool misaligned = false;
+  for (uint64_t frame = 1; frame <= 200; frame++)
+  {
+    if (frame > framesInFlight)
+    {
+      ring.Reclaim(frame - framesInFlight);
+    }
+
+    std::vector<Range> ranges;
+    for (int i = 0; i < 4; i++)
+    {
+      nv_helpers_dx12::UploadRingAllocator::Allocation allocation;
+      const uint64_t size = sizes(random);
+      if (!Allocates(ring, size, allocation))
+      {
+        continue;
+      }
+      const Range range = {allocation.offset, allocation.offset + size};
+      misaligned |= range.begin % D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT != 0;
+      straddle |= range.end > ring.GetCapacity();
+      for (size_t previous = frames.size() >= framesInFlight ? frames.size() - framesInFlight + 1
+                                                             : 0;
+           previous < frames.size(); previous++)
+      {
+        for (const Range& other : frames[previous])
+        {
+          overlap |= range.begin < other.end && other.begin < range.end;
+        }
+      }
+      for (const Range& other : ranges)
+      {
+        overlap |= range.begin < other.end && other.begin < range.end;
+      }
+      ranges.push_back(range);
+    }
+    frames.push_back(ranges);
+    ring.FinishFrame(frame);
+  }
+  Check(!misaligned, "An allocation was not aligned");
+  Check(!straddle, "An allocation straddled the end of the buffer");
+  Check(!overlap, "An allocation overlapped an allocation in use");
+}
+
+} // namespace
+
+int main()
+{
+  ID3D12Device* device = new ID3D12Device;
+
+  TestWrapAround(device);
+  TestFramesInFlight(device, 3 * 64 * 1024);
+  TestFramesInFlight(device, 5 * 64 * 1024);
+
+  device->Release();
+  if (g_failureCount > 0)
+  {
+    return EXIT_FAILURE;
+  }
+  printf("UploadRingAllocator: all tests passed\n");
+  return EXIT_SUCCESS;
+}